@@ -1,584 +1,894 @@
 #include <FSM.h>
+#include <string.h>
+
+FSM_THREAD_LOCAL unsigned long FsmUpdatable::_updateBudget = 0;
+FSM_THREAD_LOCAL unsigned long FsmUpdatable::_updateStarted = 0;
+FSM_THREAD_LOCAL bool FsmUpdatable::_updateStopped = false;
+
+void FsmUpdatable::_checkLayout(FsmLayout) {
+}
+
+FSM_EXACT_CLASS_DEFINE(FsmCollection)
+FSM_EXACT_CLASS_DEFINE(FsmSequence)
+FSM_EXACT_CLASS_DEFINE(FsmSelectStateFromCondition)
+FSM_EXACT_CLASS_DEFINE(FsmDelay)
+FSM_EXACT_CLASS_DEFINE(FsmStartTimer)
+FSM_EXACT_CLASS_DEFINE(FsmWaitUntilTimerIsComplete)
+FSM_EXACT_CLASS_DEFINE(FsmFinish)
+FSM_EXACT_CLASS_DEFINE(FsmBranchOnEndOfList)
+FSM_EXACT_CLASS_DEFINE(FsmFinishOnEndOfList)
+FSM_EXACT_CLASS_DEFINE(FsmBranchOnConditionFalse)
+FSM_EXACT_CLASS_DEFINE(FsmAssignConditionToValue)
+FSM_EXACT_CLASS_DEFINE(FsmDebugPrint)
+FSM_EXACT_CLASS_DEFINE(FsmIdle)
+FSM_EXACT_CLASS_DEFINE(FsmDebugState)
+
+void FsmUpdatable::update(unsigned long budget) {
+  // no limit, or already within a budgeted update (whose budget applies)
+  if (!budget || _updateBudget) {
+    update();
+    return;
+  }
+  
+  _updateStarted = micros();
+  _updateBudget = budget;
+  _updateStopped = false;
+  
+  update();
+  
+  _updateBudget = 0;
+}
 
-void FsmState::_markAsLeaving() {
-#ifdef DEBUG_TRACE
-  //Serial.print(name);
-  Serial.println(F(" #Entered FsmState::_markAsLeaving"));
-#endif
+FsmColdData* FsmUpdatable::_getCold() {
+  FsmColdData* cold = _findCold();
+  
+  // an FSM without the flag has no entry of its own (any at its address is left from an FSM released with its arena)
+  if (!cold && (cold = FsmColdTable::add(this))) {
+    _flags |= FSM_FLAG_COLD;
+  }
+  
+  return cold;
+}
 
-  _leaving = true;
+bool FsmUpdatable::setName(const char* name) {
+  FsmColdData* cold = name ? _getCold() : _findCold();
   
-#ifdef DEBUG_TRACE
-  //Serial.print(name);
-  Serial.println(F(" #Leaving FsmState::_markAsLeaving"));
-#endif
+  if (cold) {
+    cold->name = name;
+  }
+  
+  return cold || !name;
+}
+
+void FsmUpdatable::wake() {
+  FsmUpdatable* fsm = this;
+  
+  _flags &= ~FSM_FLAG_QUIESCENT;
+  
+  while (!(fsm->_flags & FSM_FLAG_PROXY) && (fsm = fsm->_parent) && (fsm->_flags & (FSM_FLAG_QUIESCENT | FSM_FLAG_PROXY))) {
+    fsm->_flags &= ~FSM_FLAG_QUIESCENT;
+  }
+  
+  // the rest of the path is elsewhere (eg; in an FsmTable)
+  if (fsm && (fsm->_flags & FSM_FLAG_PROXY)) {
+    fsm->_wakeProxied();
+  }
+}
+
+void FsmUpdatable::_saveQuiescence(FsmSnapshotWriter& writer, byte flags) {
+  if (_flags & FSM_FLAG_QUIESCENT) {
+    flags |= FSM_SNAPSHOT_QUIESCENT;
+    
+    if (_flags & FSM_FLAG_WAKE_TIMED) {
+      flags |= FSM_SNAPSHOT_WAKE_TIMED;
+    }
+  }
+  
+  writer.writeByte(flags);
+  
+  if (flags & FSM_SNAPSHOT_WAKE_TIMED) {
+    writer.writeTime(_wakeTime);
+  }
+}
+
+byte FsmUpdatable::_restoreQuiescence(FsmSnapshotReader& reader) {
+  byte flags = reader.readByte();
+  
+  _flags &= ~(FSM_FLAG_QUIESCENT | FSM_FLAG_WAKE_TIMED);
+  
+  if (flags & FSM_SNAPSHOT_QUIESCENT) {
+    _flags |= FSM_FLAG_QUIESCENT;
+  }
+  
+  if (flags & FSM_SNAPSHOT_WAKE_TIMED) {
+    _flags |= FSM_FLAG_WAKE_TIMED;
+    _wakeTime = reader.readTime();
+  }
+  
+  return flags;
 }
 
-void FsmState::_transitionAncestorTo(byte childInd, byte depth) {
-#ifdef DEBUG_TRACE
-  //Serial.print(name);
-  Serial.println(F(" #Entered FsmState::_transitionAncestorTo"));
+void FsmState::saveState(FsmSnapshotWriter& writer) {
+  _saveQuiescence(writer, (_flags & FSM_FLAG_ENTERED) ? FSM_SNAPSHOT_ENTERED : 0);
+}
+
+void FsmState::restoreState(FsmSnapshotReader& reader) {
+  byte flags = _restoreQuiescence(reader);
+  
+  _flags &= ~(FSM_FLAG_ENTERED | FSM_FLAG_LEAVING);
+  if (flags & FSM_SNAPSHOT_ENTERED) {
+    _flags |= FSM_FLAG_ENTERED;
+  }
+  
+#ifdef FSM_STATS
+  // the restored visit is counted from now
+  _stats.enteredAt = FSM_STATS_CLOCK();
 #endif
+}
 
+void FsmState::_markAsLeaving() {
+  _flags |= FSM_FLAG_LEAVING;
+}
+
+void FsmState::_transitionAncestorTo(FsmIndex childInd, FsmIndex depth) {
+  FSM_TRACE_EVENT(traceId, FSM_TRACE_REQUEST_TO, depth, childInd);
+  
   if (_parent) {
     if (depth == 1) { 
       _markAsLeaving(); 
     }
      
-    ((FsmSequence*)_parent)->transitionAncestorTo(childInd, depth - 1);
+    _parent->transitionAncestorTo(childInd, depth - 1);
   }
   else {
     //Serial.println(F("no ancestor"));
   }
-  
-#ifdef DEBUG_TRACE
-  //Serial.print(name);
-  Serial.println(F(" #Leaving FsmState::_transitionAncestorTo"));
-#endif
 }
 
-void FsmState::_transitionAncestorToNext(byte depth) {
-#ifdef DEBUG_TRACE
-  //Serial.print(name);
-  Serial.println(F(" #Entered FsmState::_transitionAncestorToNext"));
-#endif
-
+void FsmState::_transitionAncestorToNext(FsmIndex depth) {
+  FSM_TRACE_EVENT(traceId, FSM_TRACE_REQUEST_NEXT, depth);
+  
   if (_parent) {
     if (depth == 1) { 
       _markAsLeaving(); 
     }
     
-    ((FsmSequence*)_parent)->transitionAncestorToNext(depth - 1);
+    _parent->transitionAncestorToNext(depth - 1);
   }
   else {
     //Serial.println(F("no ancestor"));
   }
-  
-#ifdef DEBUG_TRACE
-  //Serial.print(name);
-  Serial.println(F(" #Leaving FsmState::_transitionAncestorToNext"));
-#endif
 }
 
-void FsmState::_transitionAncestorToPrevious(byte depth) {
-#ifdef DEBUG_TRACE
-  //Serial.print(name);
-  Serial.println(F(" #Entered FsmState::_transitionAncestorToPrevious"));
-#endif
-
+void FsmState::_transitionAncestorToPrevious(FsmIndex depth) {
+  FSM_TRACE_EVENT(traceId, FSM_TRACE_REQUEST_PREVIOUS, depth);
+  
   if (_parent) {
     if (depth == 1) { 
       _markAsLeaving(); 
     }
     
-    ((FsmSequence*)_parent)->transitionAncestorToPrevious(depth - 1);
+    _parent->transitionAncestorToPrevious(depth - 1);
   }
   else {
     //Serial.println(F("no ancestor"));
   }
-
-#ifdef DEBUG_TRACE
-  //Serial.print(name);
-  Serial.println(F(" #Leaving FsmState::_transitionAncestorToPrevious"));
-#endif
 }
 
-void FsmState::_transitionAncestorToStart(byte depth) {
-#ifdef DEBUG_TRACE
-  //Serial.print(name);
-  Serial.println(F(" #Entered FsmState::_transitionAncestorToStart"));
-#endif
-
+void FsmState::_transitionAncestorToStart(FsmIndex depth) {
+  FSM_TRACE_EVENT(traceId, FSM_TRACE_REQUEST_START, depth);
+  
   if (_parent) {
     if (depth == 1) { 
       _markAsLeaving(); 
     }
     
-    ((FsmSequence*)_parent)->transitionAncestorToStart(depth - 1);
+    _parent->transitionAncestorToStart(depth - 1);
   }
   else {
     //Serial.println(F("no ancestor"));
   }
+}
 
-#ifdef DEBUG_TRACE
-  //Serial.print(name);
-  Serial.println(F(" #Leaving FsmState::_transitionAncestorToStart"));
-#endif
+bool FsmState::_setBranchName(const char* branchName) {
+  FsmColdData* cold = branchName ? _getCold() : _findCold();
+  
+  if (cold) {
+    cold->branchName = branchName;
+  }
+  
+  return cold || !branchName;
+}
+
+void FsmState::_resolveBranch(FsmIndex& branchInd) {
+  FsmColdData* cold = _findCold();
+  
+  if (cold && cold->branchName && _parent) {
+    FsmIndex index = _parent->indexOf(cold->branchName);
+    
+    if (index != FSM_INDEX_NONE) {
+      branchInd = index;
+    }
+  }
 }
 
 void FsmState::update() { 
-#ifdef DEBUG_TRACE
-  //Serial.print(name);
-  Serial.println(F(" #Entered FsmState::update"));
-#endif
+  if (_flags & FSM_FLAG_QUIESCENT) {
+    if (isDormant()) {
+      return;
+    }
+    
+    _flags &= ~FSM_FLAG_QUIESCENT;
+  }
   
-  if (!_entered) {
-    _entered = true;
+  if (!(_flags & FSM_FLAG_ENTERED)) {
+    _flags |= FSM_FLAG_ENTERED;
+    FSM_TRACE_EVENT(traceId, FSM_TRACE_ENTER);
+#ifdef FSM_STATS
+    _stats.enterCount++;
+    _stats.enteredAt = FSM_STATS_CLOCK();
+#endif
     _enterState();
   }
   
+#ifdef FSM_STATS
+  unsigned long started = FSM_STATS_CLOCK();
   _updateState();
+  unsigned long elapsed = FSM_STATS_CLOCK() - started;
   
-  if (_leaving) {
-    _leaveState();
+  _stats.updateCount++;
+  _stats.updateTime += elapsed;
+  if (elapsed > _stats.maxUpdateTime) {
+    _stats.maxUpdateTime = elapsed;
   }
-  
-#ifdef DEBUG_TRACE
-  //Serial.print(name);
-  Serial.println(F(" #Leaving FsmState::update"));
+#else
+  _updateState();
 #endif
+  
+  if (_flags & FSM_FLAG_LEAVING) {
+    _leaveState();
+  }
 }
 
 void FsmState::forceExit() {
-#ifdef DEBUG_TRACE
-  //Serial.print(name);
-  Serial.println(F(" #Entered FsmState::forceExit"));
-#endif
+  FSM_TRACE_EVENT(traceId, FSM_TRACE_FORCE_EXIT);
   
   //_markAsLeaving();
   _leaveState();
+}
+
+bool FsmState::dispatch(const FsmEvent& event) {
+  if (!(_flags & FSM_FLAG_ENTERED)) {
+    return false;
+  }
   
-#ifdef DEBUG_TRACE
-  //Serial.print(name);
-  Serial.println(F(" #Leaving FsmState::forceExit"));
-#endif
+  _onEvent(event);
+  
+  // the request marked this State, or one of its ancestors, as leaving; outside of update() nothing else will
+  FsmState* leaving = (_flags & FSM_FLAG_LEAVING) ? this : NULL;
+  FsmCollection* top = NULL;
+  
+  for (FsmCollection* ancestor = _parent; ancestor; ancestor = ancestor->_parent) {
+    if (ancestor->_flags & FSM_FLAG_LEAVING) {
+      leaving = ancestor;
+    }
+    
+    top = ancestor;
+  }
+  
+  // past a proxy (eg; in an FsmTable) an ancestor is higher than any leaving State here
+  if (top && (top->_flags & FSM_FLAG_PROXY) && top->_leaveProxied()) {
+    return true;
+  }
+  
+  if (leaving) {
+    leaving->_leaveState();
+    
+    // so that the ancestor that changed focus is updated, and enters its new State
+    if (leaving->_parent) {
+      leaving->_parent->wake();
+    }
+  }
+  else {
+    wake();
+  }
+  
+  return true;
 }
 
 void FsmCollection::_updateState() { 
-#ifdef DEBUG_TRACE
-  //Serial.print(name);
-  Serial.println(F(" #Entered FsmCollection::_updateState"));
-#endif
-
-  for (byte i=0; i<_children.size(); i++) {
-  //  Serial.print("  Updating child "));
-  //  Serial.println(i);
-    _children.get(i)->update();
+  FsmUpdatable* earliest = NULL;
+  bool awake = false;
+  unsigned long now = 0;
+  bool haveNow = false;
+  
+  FsmIndex count = _children.size();
+  
+  // finish the pass a budgeted update stopped in, from where it stopped (else make a whole pass)
+  FsmIndex childInd = (_resumeChildInd < count) ? _resumeChildInd : 0;
+  bool resuming = (childInd != 0);
+  
+  _resumeChildInd = 0;
+  
+  for (; childInd < count; childInd++) {
+    FsmUpdatable* child = _children.get(childInd);
+    
+    // read the clock at most once per update, and only if a child sleeps on a timer
+    if (!haveNow && child->isQuiescent() && child->isWakeTimed()) {
+      now = millis();
+      haveNow = true;
+    }
+    
+    if (!child->isDormant(now)) {
+      child->update();
+      
+      // out of time: next update carries on inside the child, if it stopped short, else with the rest
+      if (isOverBudget() && (_updateStopped || (childInd + 1 < count))) {
+        _resumeChildInd = _updateStopped ? childInd : childInd + 1;
+        _updateStopped = true;
+        
+        return;
+      }
+      
+      if (!child->isQuiescent()) {
+        awake = true;
+        continue;
+      }
+    }
+    
+    if (!awake && child->isWakeTimed() && 
+        (!earliest || ((int32_t) (child->getWakeTime() - earliest->getWakeTime()) < 0))) {
+      earliest = child;
+    }
   }
   
-#ifdef DEBUG_TRACE
-  //Serial.print(name);
-  Serial.println(F(" #Leaving FsmCollection::_updateState"));
-#endif
+  // (only a whole pass has seen every child)
+  if (!awake && !resuming && !(_flags & FSM_FLAG_LEAVING) && _canSleep()) {
+    if (earliest) {
+      _sleepWith(earliest);
+    }
+    else {
+      _sleep();
+    }
+  }
 }
 
 void FsmCollection::_forceDescendantsToExit() { 
-#ifdef DEBUG_TRACE
-  //Serial.print(name);
-  Serial.println(F(" #Entered FsmCollection::_forceDescendatsToExit"));
-#endif
+  for (FsmUpdatable** child = _children.begin(); child != _children.end(); child++) {
+    (*child)->forceExit();
+  }
+}
 
-  for (byte i=0; i<_children.size(); i++) {
-    _children.get(i)->forceExit();
+unsigned long FsmCollection::_timeToDeadline() { 
+  unsigned long deadline = FSM_NO_DEADLINE;
+  
+  for (FsmUpdatable** child = _children.begin(); child != _children.end(); child++) {
+    unsigned long childDeadline = (*child)->timeToDeadline();
+    
+    if (childDeadline < deadline) {
+      deadline = childDeadline;
+      
+      if (deadline == 0) {
+        break;
+      }
+    }
   }
   
-#ifdef DEBUG_TRACE
-  //Serial.print(name);
-  Serial.println(F(" #Leaving FsmCollection::_forceDescendatsToExit"));
-#endif
+  return deadline;
+}
+    
+void FsmCollection::transitionAncestorTo(FsmIndex childInd, FsmIndex depth) {
+  // a Collection has no focus, so only requests for ancestors are honoured
+  if ((depth > 0) && _parent) {
+    if (depth == 1) { 
+      _markAsLeaving(); 
+    }
+
+    _parent->transitionAncestorTo(childInd, depth - 1);
+  }
+}
+
+void FsmCollection::transitionAncestorToNext(FsmIndex depth) {
+  // a Collection has no focus, so only requests for ancestors are honoured
+  if ((depth > 0) && _parent) {
+    if (depth == 1) { 
+      _markAsLeaving(); 
+    }
+
+    _parent->transitionAncestorToNext(depth - 1);
+  }
+}
+
+void FsmCollection::transitionAncestorToPrevious(FsmIndex depth) {
+  // a Collection has no focus, so only requests for ancestors are honoured
+  if ((depth > 0) && _parent) {
+    if (depth == 1) { 
+      _markAsLeaving(); 
+    }
+
+    _parent->transitionAncestorToPrevious(depth - 1);
+  }
+}
+
+void FsmCollection::transitionAncestorToStart(FsmIndex depth) {
+  // a Collection has no focus, so only requests for ancestors are honoured
+  if ((depth > 0) && _parent) {
+    if (depth == 1) { 
+      _markAsLeaving(); 
+    }
+
+    _parent->transitionAncestorToStart(depth - 1);
+  }
+}
+
+bool FsmCollection::resolveTransition(FsmTransition& transition, FsmIndex depth) {
+  // a Collection has no focus, so only ancestors can be bound
+  if ((depth > 0) && _parent && _canBindTransitions()) {
+    if (depth == 1) {
+      transition._leaving = this;
+    }
+    
+    return _parent->resolveTransition(transition, depth - 1);
+  }
+  
+  return false;
+}
+
+void FsmCollection::saveState(FsmSnapshotWriter& writer) {
+  FsmState::saveState(writer);
+  writer.writeUInt16(_resumeChildInd);
+}
+
+void FsmCollection::restoreState(FsmSnapshotReader& reader) {
+  FsmState::restoreState(reader);
+  FsmIndex childInd = (FsmIndex) reader.readUInt16();
+  
+  if ((childInd != 0) && (childInd >= _children.size())) {
+    reader.fail();
+    return;
+  }
+  
+  _resumeChildInd = childInd;
+}
+
+void FsmCollection::resolve() {
+  _buildNameIndex();
+  
+  for (FsmUpdatable** child = _children.begin(); child != _children.end(); child++) {
+    (*child)->resolve();
+  }
+}
+
+uint16_t FsmCollection::_hashName(const char* name) {
+  uint16_t hash = 0x9DC5;
+  
+  while (*name) {
+    hash = (hash ^ (byte) *name++) * 0x0193;
+  }
+  
+  return hash;
+}
+
+void FsmCollection::_buildNameIndex() {
+  FsmColdData* cold = _findCold();
+  
+  if (cold) {
+    FsmArena::release(cold->nameSlots);
+    cold->nameSlots = NULL;
+    cold->nameSlotCount = 0;
+  }
+  
+  FsmIndex namedCount = 0;
+  for (FsmUpdatable** child = _children.begin(); child != _children.end(); child++) {
+    if ((*child)->getName()) {
+      namedCount++;
+    }
+  }
+  
+  // at most half full, so probes stay short
+  uint16_t slotCount = 4;
+  while ((slotCount < 0x8000) && (slotCount < 2 * (unsigned long) namedCount)) {
+    slotCount <<= 1;
+  }
+  
+  if ((namedCount == 0) || (slotCount < 2 * (unsigned long) namedCount)) {
+    return;
+  }
+  
+  FsmIndex* slots = (FsmIndex*) FsmArena::allocate(slotCount * sizeof(FsmIndex));
+  if (!slots) {
+    return;
+  }
+  
+  for (uint16_t slot = 0; slot < slotCount; slot++) {
+    slots[slot] = FSM_INDEX_NONE;
+  }
+  
+  for (FsmIndex childInd = 0; childInd < _children.size(); childInd++) {
+    const char* name = _children.get(childInd)->getName();
+    
+    if (name) {
+      uint16_t slot = _hashName(name) & (slotCount - 1);
+      
+      // the first child of a name wins, as with the linear search
+      while ((slots[slot] != FSM_INDEX_NONE) && strcmp(_children.get(slots[slot])->getName(), name)) {
+        slot = (slot + 1) & (slotCount - 1);
+      }
+      
+      if (slots[slot] == FSM_INDEX_NONE) {
+        slots[slot] = childInd;
+      }
+    }
+  }
+  
+  cold = _getCold();
+  if (!cold) {
+    FsmArena::release(slots);
+    return;
+  }
+  
+  cold->nameSlots = slots;
+  cold->nameSlotCount = slotCount;
 }
 
+FsmIndex FsmCollection::indexOf(const char* name) {
+  FsmColdData* cold = _findCold();
+  
+  if (cold && cold->nameSlotCount) {
+    FsmIndex* slots = cold->nameSlots;
+    uint16_t slotCount = cold->nameSlotCount;
+    uint16_t slot = _hashName(name) & (slotCount - 1);
     
+    while (slots[slot] != FSM_INDEX_NONE) {
+      FsmIndex childInd = slots[slot];
+      const char* childName = (childInd < _children.size()) ? _children.get(childInd)->getName() : NULL;
+      
+      if (childName && !strcmp(childName, name)) {
+        return childInd;
+      }
+      
+      slot = (slot + 1) & (slotCount - 1);
+    }
+  }
+  
+  // not hashed yet, or added since resolve()
+  for (FsmIndex childInd = 0; childInd < _children.size(); childInd++) {
+    const char* childName = _children.get(childInd)->getName();
     
-byte FsmCollection::addChild(FsmUpdatable* child) {
-#ifdef DEBUG_TRACE
-  //Serial.print(name);
-  Serial.println(F(" #Entered FsmCollection::addChild"));
-#endif
+    if (childName && !strcmp(childName, name)) {
+      return childInd;
+    }
+  }
+  
+  return FSM_INDEX_NONE;
+}
 
+FsmIndex FsmCollection::addChild(FsmUpdatable* child) {
+  // FSM_INDEX_NONE is reserved, so that the index after the last child is always representable
+  if ((_children.size() >= FSM_INDEX_NONE) || !_children.add(child)) {
+    return FSM_INDEX_NONE;
+  }
+  
   child->setParent(this);
-  _children.add(child);
   
   return _children.size() - 1;
-  
-#ifdef DEBUG_TRACE
-  //Serial.print(name);
-  Serial.println(F(" #Leaving FsmCollection::addChild"));
-#endif
 }
 
 void FsmSequence::_enterState() { 
-#ifdef DEBUG_TRACE
-  //Serial.print(name);
-  Serial.println(F(" #Entered FsmSequence::_enterState"));
-#endif
-  
-#ifdef DEBUG_TRACE
-  //Serial.print(name);
-  Serial.println(F(" #Leaving FsmSequence::_enterState"));
-#endif
 }
 
 void FsmSequence::_updateState() { 
-#ifdef DEBUG_TRACE
-  //Serial.print(name);
-  Serial.println(F(" #Entered FsmSequence::_updateState"));
-#endif
-
-  _children.get(_currentChildInd)->update();
+  FsmUpdatable* child = _children.get(_currentChildInd);
+  FsmIndex microsteps = _microsteps;
   
-#ifdef DEBUG_TRACE
-  //Serial.print(name);
-  Serial.println(F(" #Leaving FsmSequence::_updateState"));
-#endif
+  for (;;) {
+    FsmIndex childInd = _currentChildInd;
+    child->update();
+    
+    // the focused child may have changed, if so it has yet to be entered
+    child = _children.get(_currentChildInd);
+    
+    // run to completion: enter it now, unless the child stayed, this Sequence is leaving too, the limit is reached, or the budget
+    if ((_currentChildInd == childInd) || (_flags & FSM_FLAG_LEAVING) || (--microsteps == 0) || isOverBudget()) {
+      break;
+    }
+  }
+  
+  if (child->isQuiescent() && !(_flags & FSM_FLAG_LEAVING) && _canSleep()) {
+    _sleepWith(child);
+  }
 }
 
 void FsmSequence::_exitState() { 
-#ifdef DEBUG_TRACE
-  //Serial.print(name);
-  Serial.println(F(" #Entered FsmSequence::_exitState"));
-#endif
-
-#ifdef DEBUG_TRACE
-  //Serial.print(name);
-  Serial.println(F(" #Leaving FsmSequence::_exitState"));
-#endif
 }
 
+unsigned long FsmSequence::_timeToDeadline() { 
+  return _children.get(_currentChildInd)->timeToDeadline();
+}
 
-void FsmSequence::_transitionTo(byte childInd) {
-#ifdef DEBUG_TRACE
-  //Serial.print(name);
-  Serial.println(F(" #Entered FsmSequence::_transitionTo"));
-#endif
-  
+void FsmSequence::_transitionTo(FsmIndex childInd) {
   _currentChildInd = childInd;
   
   if (_currentChildInd >= _children.size()) {
     //_currentChildInd = 0;
     _currentChildInd = _startChildInd;
   }
-  
-  if (_currentChildInd < 0) {
-    _currentChildInd = _children.size() - 1;
-  }
-
-#ifdef DEBUG_TRACE
-  //Serial.print(name);
-  Serial.println(F(" #Leaving FsmSequence::_transitionTo"));
-#endif
 }
 
 void FsmSequence::_transitionToNext() {
-#ifdef DEBUG_TRACE
-  //Serial.print(name);
-  Serial.println(F(" #Entered FsmSequence::_transitionToNext"));
-#endif
-  
   _currentChildInd++;
   
   _transitionTo(_currentChildInd);
-  
-#ifdef DEBUG_TRACE
-  //Serial.print(name);
-  Serial.println(F(" #Leaving FsmSequence::_transitionToNext"));
-#endif
 }
 
 void FsmSequence::_transitionToPrevious() {
-#ifdef DEBUG_TRACE
-  //Serial.print(name);
-  Serial.println(F(" #Entered FsmSequence::_transitionToPrevious"));
-#endif
-
+  // wrap from the first State to the last (FsmIndex is unsigned, so test before decrementing)
+  if (_currentChildInd == 0) {
+    _currentChildInd = _children.size();
+  }
+  
   _currentChildInd--;
   
   _transitionTo(_currentChildInd);
-
-#ifdef DEBUG_TRACE
-  //Serial.print(name);
-  Serial.println(F(" #Leaving FsmSequence::_transitionToPrevious"));
-#endif
 }
 
 
 void FsmSequence::_transitionToStart() {
-#ifdef DEBUG_TRACE
-  //Serial.print(name);
-  Serial.println(F(" #Entered FsmSequence::_transitionToStart"));
-#endif
-
   _currentChildInd = _startChildInd;
   _transitionTo(_currentChildInd);
-  
-#ifdef DEBUG_TRACE
-  //Serial.print(name);
-  Serial.println(F(" #Leaving FsmSequence::_transitionToStart"));
-#endif
 }
 
 void FsmSequence::_forceDescendantsToExit() { 
-#ifdef DEBUG_TRACE
-  //Serial.print(name);
-  Serial.println(F(" #Entered FsmSequence::_forceDescendatsToExit"));
-#endif
-
   _children.get(_currentChildInd)->forceExit();
-  
-#ifdef DEBUG_TRACE
-  //Serial.print(name);
-  Serial.println(F(" #Leaving FsmSequence::_forceDescendatsToExit"));
-#endif
 }
 
-void FsmSequence::transitionAncestorTo(byte childInd, byte depth) {
-#ifdef DEBUG_TRACE
-  //Serial.print(name);
-  Serial.println(F(" #Entered FsmSequence::transitionAncestorTo"));
-#endif
-
+void FsmSequence::transitionAncestorTo(FsmIndex childInd, FsmIndex depth) {
   if (depth == 0)  {
     _transitionTo(childInd);
   } 
   else {
-    if (_parent) {
-      if (depth == 1) { 
-        _markAsLeaving(); 
-      }
-      
-      ((FsmSequence*)_parent)->transitionAncestorTo(childInd, depth - 1);
-    }
+    FsmCollection::transitionAncestorTo(childInd, depth);
   }
-  
-#ifdef DEBUG_TRACE
-  //Serial.print(name);
-  Serial.println(F(" #Leaving FsmSequence::transitionAncestorTo"));
-#endif
 }
 
-void FsmSequence::transitionAncestorToNext(byte depth) {
-#ifdef DEBUG_TRACE
-  //Serial.print(name);
-  Serial.println(F(" #Entered FsmSequence::transitionAncestorToNext"));
-#endif
-
+void FsmSequence::transitionAncestorToNext(FsmIndex depth) {
   if (depth == 0)  {
     _transitionToNext();
   } 
   else {
-    if (_parent) {
-      if (depth == 1) { 
-        _markAsLeaving(); 
-      }
-
-      ((FsmSequence*)_parent)->transitionAncestorToNext(depth - 1);
-    }
+    FsmCollection::transitionAncestorToNext(depth);
   }
-  
-#ifdef DEBUG_TRACE
-  //Serial.print(name);
-  Serial.println(F(" #Leaving FsmSequence::transitionAncestorToNext"));
-#endif
 }
 
-void FsmSequence::transitionAncestorToPrevious(byte depth) {
-#ifdef DEBUG_TRACE
-  //Serial.print(name);
-  Serial.println(F(" #Entered FsmSequence::transitionAncestorToPrevious"));
-#endif
-
+void FsmSequence::transitionAncestorToPrevious(FsmIndex depth) {
   if (depth == 0)  {
     _transitionToPrevious();
   } 
   else {
-    if (_parent) {
-      if (depth == 1) { 
-        _markAsLeaving(); 
-      }
-
-      ((FsmSequence*)_parent)->transitionAncestorToPrevious(depth - 1);
-    }
+    FsmCollection::transitionAncestorToPrevious(depth);
   }
-  
-#ifdef DEBUG_TRACE
-  //Serial.print(name);
-  Serial.println(F(" #Leaving FsmSequence::transitionAncestorToPrevious"));
-#endif
 }
 
-void FsmSequence::transitionAncestorToStart(byte depth) {
-#ifdef DEBUG_TRACE
-  //Serial.print(name);
-  Serial.println(F(" #Entered FsmSequence::transitionAncestorToStart"));
-#endif
-
+void FsmSequence::transitionAncestorToStart(FsmIndex depth) {
   if (depth == 0)  {
     _transitionToStart();
   } 
   else {
-    if (_parent) {
-      if (depth == 1) { 
-        _markAsLeaving(); 
-      }
+    FsmCollection::transitionAncestorToStart(depth);
+  }
+}
 
-      ((FsmSequence*)_parent)->transitionAncestorToPrevious(depth - 1);
-    }
+void FsmSequence::saveState(FsmSnapshotWriter& writer) {
+  FsmCollection::saveState(writer);
+  writer.writeUInt16(_currentChildInd);
+}
+
+void FsmSequence::restoreState(FsmSnapshotReader& reader) {
+  FsmCollection::restoreState(reader);
+  FsmIndex childInd = (FsmIndex) reader.readUInt16();
+  
+  if (childInd >= _children.size()) {
+    reader.fail();
+    return;
   }
   
-#ifdef DEBUG_TRACE
-  //Serial.print(name);
-  Serial.println(F(" #Leaving FsmSequence::transitionAncestorToStart"));
-#endif
+  _currentChildInd = childInd;
 }
 
 void FsmSequence::forceExit() {
-  #ifdef DEBUG_TRACE
-  //Serial.print(name);
-  Serial.println(F(" #Entered FsmSequence::forceExit"));
-#endif
-  
   FsmState::forceExit();
   _transitionToStart();    
-  
-#ifdef DEBUG_TRACE
-  //Serial.print(name);
-  Serial.println(F(" #Leaving FsmSequence::forceExit"));
-#endif
 }
 
 
 
 void FsmSelectStateFromCondition::_enterState() {
-#ifdef DEBUG_TRACE
-  //Serial.print(name);
-  Serial.println(F(" #Entered FsmSelectStateFromCondition::_enterState"));
-#endif
-  
+  _addWatch();
+  _watch.changed = false;
   _oldValue = _value->getValue();
-  _transitionTo((byte) _value->getValue());
-  
-#ifdef DEBUG_TRACE
-  //Serial.print(name);
-  Serial.println(F(" #Leaving FsmSelectStateFromCondition::_enterState"));
-#endif
+  _transitionTo((FsmIndex) _oldValue);
 }
 
 void FsmSelectStateFromCondition::_updateState() {
-  #ifdef DEBUG_TRACE
-  //Serial.print(name);
-  Serial.println(F(" #Entered FsmSelectStateFromCondition::_updateState"));
-#endif
-  
-  if (_oldValue != _value->getValue()) {
-    _oldValue = _value->getValue();
-    _forceDescendantsToExit();
-    _transitionTo((byte) _value->getValue());
+  // a watched Condition need only be read once it has changed
+  if (!_watch.fsm || _watch.changed) {
+    bool value = _value->getValue();
+    
+    _watch.changed = false;
+    
+    if (_oldValue != value) {
+      _oldValue = value;
+      _forceDescendantsToExit();
+      _transitionTo((FsmIndex) value);
+    }
   }
   
   FsmSequence::_updateState();
-  
-#ifdef DEBUG_TRACE
-  //Serial.print(name);
-  Serial.println(F(" #Leaving FsmSelectStateFromCondition::_updateState"));
-#endif
 }
 
 
-void FsmDelay::_enterState() {
-#ifdef DEBUG_TRACE
-  //Serial.print(name);
-  Serial.println(F(" #Entered FsmDelay::_enterState"));
-#endif
+void FsmSelectStateFromCondition::saveState(FsmSnapshotWriter& writer) {
+  FsmSequence::saveState(writer);
+  writer.writeByte(_oldValue);
+}
 
-  _timer->start(_durationValue->getValue());
+void FsmSelectStateFromCondition::restoreState(FsmSnapshotReader& reader) {
+  FsmSequence::restoreState(reader);
+  _oldValue = reader.readByte();
   
-#ifdef DEBUG_TRACE
-  //Serial.print(name);
-  Serial.println(F(" #Leaving FsmDelay::_enterState"));
-#endif
+  // registered only while entered
+  if (isEntered()) {
+    _addWatch();
+  }
+  else {
+    _removeWatch();
+  }
+  
+  // the Condition may have changed while the snapshot was stored
+  _watch.changed = true;
 }
 
-void FsmDelay::_updateState() {
-#ifdef DEBUG_TRACE
-  //Serial.print(name);
-  Serial.println(F(" #Entered FsmDelay::_updateState"));
-#endif
 
-  if (_timer->isComplete()) {
+void FsmDelay::_startTimer(Duration duration) {
+  _timer.start(duration);
+  
+  if (_canSleep()) {
+    _sleepFor(duration);
+  }
+  else {
+    _wakeTime = (uint32_t) (millis() + duration);
+  }
+}
+
+void FsmDelay::_enterState() {
+  _startTimer(_durationValue->getValue());
+}
+
+void FsmDelay::_updateState() {
+  if (_timer.isComplete()) {
     _transitionAncestorToNext(1);
   }
+  else if (_canSleep()) {
+    // (_wakeTime is the timer's deadline, even if woken early)
+    _sleepFor(_timeUntil(_wakeTime));
+  }
+}
+
+void FsmDelay::saveState(FsmSnapshotWriter& writer) {
+  FsmState::saveState(writer);
   
-#ifdef DEBUG_TRACE
-  //Serial.print(name);
-  Serial.println(F(" #Leaving FsmDelay::_updateState"));
-#endif
+  if (_flags & FSM_FLAG_ENTERED) {
+    writer.writeUInt32(_timeUntil(_wakeTime));
+  }
 }
 
-void FsmStartTimer::_enterState() {
-#ifdef DEBUG_TRACE
-  //Serial.print(name);
-  Serial.println(F(" #Entered FsmStartTimer::_enterState"));
-#endif
+void FsmDelay::restoreState(FsmSnapshotReader& reader) {
+  FsmState::restoreState(reader);
+  
+  if (_flags & FSM_FLAG_ENTERED) {
+    _startTimer(reader.readUInt32());
+  }
+}
 
-  _timer->start(_durationValue->getValue());
+void FsmStartTimer::_enterState() {
+  Duration duration = _durationValue->getValue();
+  
+  _timer->start(duration);
+  _deadline = millis() + duration;
   _transitionAncestorToNext(1);
+}
+
+void FsmStartTimer::saveState(FsmSnapshotWriter& writer) {
+  FsmState::saveState(writer);
+  writer.writeUInt32(getTimeRemaining());
+}
+
+void FsmStartTimer::restoreState(FsmSnapshotReader& reader) {
+  FsmState::restoreState(reader);
   
-#ifdef DEBUG_TRACE
-  //Serial.print(name);
-  Serial.println(F(" #Leaving FsmStartTimer::_enterState"));
-#endif
+  Duration remaining = reader.readUInt32();
+  
+  _timer->start(remaining);
+  _deadline = millis() + remaining;
+}
 
+/**
+ * count the FsmStartTimers in the tree below fsm that start timer, keeping the last found
+ */
+static byte _findStarter(FsmUpdatable* fsm, Timer* timer, FsmStartTimer** starter) {
+  FsmDescription description;
+  fsm->describe(description);
+  
+  if ((description.kind == FSM_KIND_START_TIMER) && (description.operand1 == timer)) {
+    *starter = (FsmStartTimer*) fsm;
+    return 1;
+  }
+  
+  byte count = 0;
+  FsmCollection* collection = fsm->asCollection();
+  
+  if (collection) {
+    for (FsmIndex i=0; (i<collection->getChildCount()) && (count < 2); i++) {
+      count += _findStarter(collection->getChild(i), timer, starter);
+    }
+  }
+  
+  return count;
 }
 
-void FsmWaitUntilTimerIsComplete::_updateState() {
-#ifdef DEBUG_TRACE
-  //Serial.print(name);
-  Serial.println(F(" #Entered FsmWaitUntilTimerIsComplete::_updateState"));
-#endif
+void FsmWaitUntilTimerIsComplete::resolve() {
+  FsmUpdatable* root = this;
+  
+  while (root->getParent()) {
+    root = root->getParent();
+  }
+  
+  // with more than one, the Timer's deadline is not known
+  if (_findStarter(root, _timer, &_starter) != 1) {
+    _starter = NULL;
+  }
+}
 
+unsigned long FsmWaitUntilTimerIsComplete::_timeToDeadline() {
+  return (_starter && !_timer->isComplete()) ? _starter->getTimeRemaining() : 0;
+}
+
+void FsmWaitUntilTimerIsComplete::_updateState() {
   if (_timer->isComplete()) {
     _transitionAncestorToNext(1);
   }
-  
-#ifdef DEBUG_TRACE
-  //Serial.print(name);
-  Serial.println(F(" #Leaving FsmWaitUntilTimerIsComplete::_updateState"));
-#endif
+  else if (_starter) {
+    // once past the deadline, the Timer has been started again by something else: poll it
+    unsigned long remaining = _starter->getTimeRemaining();
+    
+    if (remaining) {
+      _sleepFor(remaining);
+    }
+  }
 }
 
 void FsmFinish::_enterState() {
-#ifdef DEBUG_TRACE
-  //Serial.print(name);
-  Serial.println(F(" #Entered FsmFinish::_enterState"));
-#endif
-
   //Serial.print(F("Finishing "));
   //Serial.println(_parent->name);
 
   _transitionAncestorToStart(1);
   _transitionAncestorToNext(2);
-
-#ifdef DEBUG_TRACE
-  //Serial.print(name);
-  Serial.println(F(" #Leaving FsmFinish::_enterState"));
-#endif
 }
 
 void FsmBranchOnEndOfList::_enterState() {
-#ifdef DEBUG_TRACE
-  //Serial.print(name);
-  Serial.println(F(" #Entered FsmBranchOnEndOfList::_enterState"));
-#endif
-
   if (_enumerator->moveNext()) {
     _transitionAncestorToNext(1);
   }
   else {
     _transitionAncestorTo(_branchInd, 1);
   }
-  
-#ifdef DEBUG_TRACE
-  //Serial.print(name);
-  Serial.println(F(" #Leaving FsmBranchOnEndOfList::_enterState"));
-#endif
 }
 
-void FsmFinishOnEndOfList::_enterState() {
-#ifdef DEBUG_TRACE
-  //Serial.print(name);
-  Serial.println(F(" #Entered FsmFinishOnEndOfList::_enterState"));
-#endif
+void FsmBranchOnEndOfList::resolve() {
+  _resolveBranch(_branchInd);
+}
 
+void FsmFinishOnEndOfList::_enterState() {
   if (_enumerator->moveNext()) {
     _transitionAncestorToNext(1);
   }
@@ -586,19 +896,37 @@ void FsmFinishOnEndOfList::_enterState() {
     _transitionAncestorToStart(1);
     _transitionAncestorToNext(2);
   }
+}
+
+void FsmForEach::_updateState() {
+  unsigned long started = _budget ? micros() : 0;
   
-#ifdef DEBUG_TRACE
-  //Serial.print(name);
-  Serial.println(F(" #Leaving FsmFinishOnEndOfList::_enterState"));
-#endif
+  for (uint16_t i=0; i<_batch; i++) {
+    if (!_enumerator->moveNext()) {
+      if (_branchInd == FSM_INDEX_NONE) {
+        _transitionAncestorToNext(1);
+      }
+      else {
+        _transitionAncestorTo(_branchInd, 1);
+      }
+      
+      return;
+    }
+    
+    _forEachItem();
+    
+    // the body made a transition, or the update (or the budgeted update it is part of) is out of time
+    if ((_flags & FSM_FLAG_LEAVING) || (_budget && (micros() - started >= _budget)) || isOverBudget()) {
+      return;
+    }
+  }
+}
+
+void FsmForEach::resolve() {
+  _resolveBranch(_branchInd);
 }
 
 void FsmBranchOnConditionFalse::_enterState() {
-#ifdef DEBUG_TRACE
-  //Serial.print(name);
-  Serial.println(F(" #Entered FsmBranchOnConditionFalse::_enterState"));
-#endif
-  
   if ((*_condition)->getValue()) {
     //Serial.println(F("Condition is True - Doing Actions"));
     _transitionAncestorToNext(1);
@@ -607,28 +935,86 @@ void FsmBranchOnConditionFalse::_enterState() {
     //Serial.println(F("Condition is False - Skipping Actions"));
     _transitionAncestorTo(_branchInd, 1);
   }
-
-#ifdef DEBUG_TRACE
-  //Serial.print(name);
-  Serial.println(F(" #Leaving FsmBranchOnConditionFalse::_enterState"));
-#endif
 }
 
+void FsmBranchOnConditionFalse::resolve() {
+  _resolveBranch(_branchInd);
+}
 
 void FsmAssignConditionToValue::_enterState() {
-#ifdef DEBUG_TRACE
-  //Serial.print(name);
-  Serial.println(F(" #Entered FsmAssignConditionToValue::_enterState"));
-#endif
-  
   //Serial.print(F("FsmAssignConditionToValue, value is "));
   //Serial.println(_condition->getValue());
   
   _value->setValue(_condition->getValue());
   _transitionAncestorToNext(1);
+}
 
-#ifdef DEBUG_TRACE
-  //Serial.print(name);
-  Serial.println(F(" #Leaving FsmAssignConditionToValue::_enterState"));
-#endif
+bool FsmSequence::resolveTransition(FsmTransition& transition, FsmIndex depth) {
+  if (!_canBindTransitions()) {
+    return false;
+  }
+  
+  if (depth == 0) {
+    transition._target = this;
+    return true;
+  }
+  
+  return FsmCollection::resolveTransition(transition, depth);
+}
+
+bool FsmTransition::bind(FsmState* from, FsmIndex depth) {
+  _from = from;
+  _depth = depth;
+  _target = NULL;
+  _leaving = from;
+  
+  if ((depth == 0) || !from->getParent() || !from->getParent()->resolveTransition(*this, depth - 1)) {
+    _target = NULL;
+  }
+  
+  return _target != NULL;
+}
+
+void FsmTransition::toNext() {
+  if (_target) {
+    FSM_TRACE_EVENT(_from->traceId, FSM_TRACE_REQUEST_NEXT, _depth);
+    _leaving->_markAsLeaving();
+    _target->_transitionToNext();
+  }
+  else if (_from) {
+    _from->_transitionAncestorToNext(_depth);
+  }
+}
+
+void FsmTransition::toPrevious() {
+  if (_target) {
+    FSM_TRACE_EVENT(_from->traceId, FSM_TRACE_REQUEST_PREVIOUS, _depth);
+    _leaving->_markAsLeaving();
+    _target->_transitionToPrevious();
+  }
+  else if (_from) {
+    _from->_transitionAncestorToPrevious(_depth);
+  }
+}
+
+void FsmTransition::to(FsmIndex childInd) {
+  if (_target) {
+    FSM_TRACE_EVENT(_from->traceId, FSM_TRACE_REQUEST_TO, _depth, childInd);
+    _leaving->_markAsLeaving();
+    _target->_transitionTo(childInd);
+  }
+  else if (_from) {
+    _from->_transitionAncestorTo(childInd, _depth);
+  }
+}
+
+void FsmTransition::toStart() {
+  if (_target) {
+    FSM_TRACE_EVENT(_from->traceId, FSM_TRACE_REQUEST_START, _depth);
+    _leaving->_markAsLeaving();
+    _target->_transitionToStart();
+  }
+  else if (_from) {
+    _from->_transitionAncestorToStart(_depth);
+  }
 }
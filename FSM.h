@@ -12,36 +12,317 @@
 #include <Condition.h>
 #include <Enumerator.h>
 
+#include "FsmConfig.h"
+#include "FsmArray.h"
+#include "FsmCold.h"
+#include "FsmTrace.h"
+#include "FsmStats.h"
+#include "FsmEvent.h"
+#include "FsmWatch.h"
+#include "FsmSnapshot.h"
 
-//#define DEBUG_TRACE
+
+/**
+ * returned by timeToDeadline() when only an external change (eg; to a Value) can create work
+ */
+#define FSM_NO_DEADLINE ((unsigned long) -1)
+
+/**
+ * storage of the running update(budget), one per thread that updates FSMs (see FsmParallelCollection)
+ *  Arduino cores have one such thread, and AVR has no thread local storage
+ */
+#ifdef ARDUINO
+ #define FSM_THREAD_LOCAL
+#else
+ #define FSM_THREAD_LOCAL thread_local
+#endif
+
+#if defined(__GXX_RTTI) || defined(__cpp_rtti)
+ #include <typeinfo>
+ #define FSM_RTTI
+#endif
+
+/**
+ * Declares T::isExactly(fsm): is fsm exactly a T, rather than of a class derived from T (that may behave differently)
+ *  Each constructor of T calls _recordClass().
+ *
+ * With RTTI, by typeid. Without (eg; AVR), by vtable pointer: T records its own as it is constructed (while the
+ *  vtable pointer is T's, whatever is being built), which assumes the vtable pointer starts the object, as it does 
+ *  for GCC (and so AVR) and Clang. Until a T has been constructed, nothing is exactly a T.
+ */
+#ifdef FSM_RTTI
+ #define FSM_EXACT_CLASS(T) \
+  public: \
+    static bool isExactly(FsmUpdatable* fsm) { return typeid(*fsm) == typeid(T); } \
+  protected: \
+    void _recordClass() { }
+#else
+ #define FSM_EXACT_CLASS(T) \
+  public: \
+    static bool isExactly(FsmUpdatable* fsm) { return *(const void* const*) fsm == _vtable; } \
+  protected: \
+    static const void* _vtable; \
+    void _recordClass() { _vtable = *(const void* const*) this; }
+#endif
+
+/**
+ * Defines the static of FSM_EXACT_CLASS(T), in one .cpp
+ */
+#ifdef FSM_RTTI
+ #define FSM_EXACT_CLASS_DEFINE(T)
+#else
+ #define FSM_EXACT_CLASS_DEFINE(T) const void* T::_vtable = NULL;
+#endif
 
 
 class FsmState;
 class FsmCollection;
 class FsmSequence;
+class FsmTransition;
+
+/**
+ * Bits of FsmUpdatable::_flags
+ *  the runtime state every FSM checks on each update, packed into one byte
+ */
+enum FsmFlag {
+  FSM_FLAG_QUIESCENT  = 0x01,  /**< has no work to do until woken (see FsmUpdatable::_sleep()) */
+  FSM_FLAG_WAKE_TIMED = 0x02,  /**< wakes automatically at _wakeTime (see FsmUpdatable::_sleepFor()) */
+  FSM_FLAG_ENTERED    = 0x04,  /**< the State has been entered (FsmState) */
+  FSM_FLAG_LEAVING    = 0x08,  /**< the State is leaving (FsmState) */
+  FSM_FLAG_PROXY      = 0x10,  /**< stands in for a parent elsewhere, so wake() carries on there (see FsmUpdatable::_wakeProxied()) */
+  FSM_FLAG_COLD       = 0x20   /**< has an entry in the FsmColdTable (a name, a branch name, or an index of its children's names) */
+};
+
+/**
+ * The kinds of FSM reported by FsmUpdatable::describe()
+ */
+enum FsmKind {
+  FSM_KIND_USER,                     /**< a user defined FSM, behaviour unknown */
+  FSM_KIND_COLLECTION,               /**< FsmCollection */
+  FSM_KIND_SEQUENCE,                 /**< FsmSequence, index is the start State */
+  FSM_KIND_SELECT,                   /**< FsmSelectStateFromCondition, operand1 is the Value<bool> */
+  FSM_KIND_DELAY,                    /**< FsmDelay, operand1 is the Timer, operand2 the Value<Duration> */
+  FSM_KIND_START_TIMER,              /**< FsmStartTimer, operand1 is the Timer, operand2 the Value<Duration> */
+  FSM_KIND_WAIT_TIMER,               /**< FsmWaitUntilTimerIsComplete, operand1 is the Timer */
+  FSM_KIND_FINISH,                   /**< FsmFinish */
+  FSM_KIND_BRANCH_ON_END_OF_LIST,    /**< FsmBranchOnEndOfList, operand1 is the EnumeratorBase, index the branch */
+  FSM_KIND_FINISH_ON_END_OF_LIST,    /**< FsmFinishOnEndOfList, operand1 is the EnumeratorBase */
+  FSM_KIND_BRANCH_ON_CONDITION_FALSE,/**< FsmBranchOnConditionFalse, operand1 is the Condition**, index the branch */
+  FSM_KIND_ASSIGN_CONDITION,         /**< FsmAssignConditionToValue, operand1 is the Condition, operand2 the Value<bool> */
+  FSM_KIND_DEBUG_PRINT,              /**< FsmDebugPrint, operand1 is the message (char*) */
+  FSM_KIND_IDLE,                     /**< FsmIdle */
+  FSM_KIND_DEBUG_STATE               /**< FsmDebugState, operand1 is the message (char*) */
+};
+
+/**
+ * What an FSM is, and what it works with
+ *  filled in by FsmUpdatable::describe(), used by tools that analyse or compile a built tree
+ */
+struct FsmDescription {
+  byte kind;        /**< the FsmKind */
+  FsmIndex index;   /**< start or branch index, depending on kind */
+  void* operand1;   /**< first operand, depending on kind */
+  void* operand2;   /**< second operand, depending on kind */
+  FsmIndex microsteps;  /**< States a Sequence may enter per update, see FsmSequence::setMicrosteps() */
+};
 
 /**
  * The base of all Finite State Machines (FSM)
  *
  * Requires that subclasses implement update()
  * Provides ability to attach to a parent FSM Collection
+ *
+ * A node holds only what update() reads. Data used while building, resolving or inspecting the tree
+ *  (names, branch names, the index of child names) is held beside it, in the FsmColdTable.
  */
 class FsmUpdatable {
   protected:
-    FsmCollection* _parent;  /**< protected variable  _parent Pointer to parent FSM (if any) */ 
+    FsmCollection* _parent;   /**< protected variable  _parent Pointer to parent FSM (if any) */ 
+    uint32_t _wakeTime;       /**< protected variable  _wakeTime millis() at which to wake, if FSM_FLAG_WAKE_TIMED (32 bits, wrapping as on Arduino) */ 
+    byte _flags;              /**< protected variable  _flags FsmFlag bits (quiescence here, entered & leaving for FsmState) */ 
+    
+    static FSM_THREAD_LOCAL unsigned long _updateBudget;   /**< protected variable  _updateBudget Microseconds the running update(budget) may take, 0 for no limit */ 
+    static FSM_THREAD_LOCAL unsigned long _updateStarted;  /**< protected variable  _updateStarted micros() at which the running update(budget) started */ 
+    static FSM_THREAD_LOCAL bool _updateStopped;           /**< protected variable  _updateStopped Did the FSM just updated stop short of its budgeted traversal */ 
+    
+   /**
+    * declare that this FSM has no work to do until wake() is called
+    *  while quiescent, update() is skipped (and so is the FSM's whole subtree)
+    */
+    void _sleep() {
+      _flags = (_flags | FSM_FLAG_QUIESCENT) & ~FSM_FLAG_WAKE_TIMED;
+    }
+    
+   /**
+    * declare that this FSM has no work to do for the specified time (or until wake() is called)
+    *
+    * @param duration Milliseconds until the FSM needs an update (at most ~24 days)
+    */
+    void _sleepFor(unsigned long duration) {
+      _flags |= FSM_FLAG_QUIESCENT | FSM_FLAG_WAKE_TIMED;
+      _wakeTime = (uint32_t) (millis() + duration);
+    }
+    
+   /**
+    * get the time from now until a millis() time
+    *  eg; a Timer's deadline: the Ozbotics Timer reports only isComplete(), so an FSM that starts one keeps its deadline
+    *  Compared in 32 bits, as millis() is on Arduino, so a time held in a _wakeTime compares the same on every platform
+    *
+    * @param time The millis() time
+    * @return milliseconds, 0 once time has passed
+    */
+    static unsigned long _timeUntil(unsigned long time) {
+      int32_t remaining = (int32_t) ((uint32_t) time - (uint32_t) millis());
+      
+      return (remaining > 0) ? (unsigned long) remaining : 0;
+    }
+    
+   /**
+    * write the flags byte that starts this FSM's snapshot record, and the time to wake (if any)
+    *
+    * @param flags FsmSnapshotFlag bits of the derived class (eg; FSM_SNAPSHOT_ENTERED)
+    */
+    void _saveQuiescence(FsmSnapshotWriter& writer, byte flags);
+    
+   /**
+    * read what _saveQuiescence() wrote
+    *
+    * @return the flags byte, for the derived class's bits
+    */
+    byte _restoreQuiescence(FsmSnapshotReader& reader);
+    
+   /**
+    * defined only for the layout the library is built with (see FsmLayout), so that mixing settings fails to link
+    */
+    static void _checkLayout(FsmLayout layout);
+    
+   /**
+    * over-ridden by an FSM that stands in for a parent elsewhere (FSM_FLAG_PROXY, eg; FsmTableProxy)
+    *  to wake the rest of the path, as wake() does
+    */
+    virtual void _wakeProxied() { }
+    
+   /**
+    * over-ridden by an FSM that stands in for a parent elsewhere (FSM_FLAG_PROXY, eg; FsmTableProxy)
+    *  to complete the leave of the highest leaving ancestor there, and wake its parent, as FsmState::dispatch() does
+    *
+    * @return false if no ancestor there is leaving
+    */
+    virtual bool _leaveProxied() {
+      return false;
+    }
+    
+   /**
+    * get this FSM's entry in the FsmColdTable
+    *
+    * @return NULL if it has none
+    */
+    FsmColdData* _findCold() {
+      return (_flags & FSM_FLAG_COLD) ? FsmColdTable::find(this) : NULL;
+    }
+    
+   /**
+    * get this FSM's entry in the FsmColdTable, adding one if it has none
+    *
+    * @return NULL if the table could not grow
+    */
+    FsmColdData* _getCold();
     
   public:
-  
+#ifdef FSM_TRACE
+    uint16_t traceId;         /**< public variable  traceId Identifies this FSM in FsmTrace events (construction order), packed beside _flags */ 
+#endif
+    
    /**
     * Constructor
     */
-    FsmUpdatable() { }  
+    FsmUpdatable() : _parent(NULL), _wakeTime(0), _flags(0) { 
+      _checkLayout(FsmLayout());
+      
+#ifdef FSM_TRACE
+      traceId = FsmTrace::nextId();
+#endif
+    }  
+    
+   /**
+    * Destructor
+    *  virtual, so that deleting a Collection runs the destructors of its children
+    */
+    virtual ~FsmUpdatable() {
+      if (_flags & FSM_FLAG_COLD) {
+        FsmColdTable::remove(this);
+      }
+    }
+    
+   /**
+    * get this FSM's name
+    *
+    * @return the name, NULL if it has none
+    */
+    const char* getName() {
+      FsmColdData* cold = _findCold();
+      
+      return cold ? cold->name : NULL;
+    }
+    
+   /**
+    * name this FSM, uniquely among its siblings (see FsmCollection::indexOf())
+    *  the name is not copied: use a literal. It is held in the FsmColdTable, not the FSM
+    *
+    * @param name The name, NULL for none
+    * @return false if it could not be recorded (out of memory)
+    */
+    bool setName(const char* name);
+    
+   /**
+    * FSMs come from the current FsmArena, if any (see FsmArena::Scope)
+    *  NULL if memory is exhausted (so nothing is constructed)
+    */
+    static void* operator new(size_t size) noexcept {
+      return FsmArena::allocate(size);
+    }
+    
+    static void* operator new[](size_t size) noexcept {
+      return FsmArena::allocate(size);
+    }
+    
+   /**
+    * heap memory is freed, arena memory is released with its arena
+    */
+    static void operator delete(void* p) {
+      FsmArena::release(p);
+    }
+    
+    static void operator delete[](void* p) {
+      FsmArena::release(p);
+    }
     
    /**
     * require update method
     */
     virtual void update()=0;
     
+   /**
+    * update the FSM, but stop traversing it once the budget is spent
+    *  a Collection that runs out of time records where it stopped, and its next update finishes that pass from there:
+    *  from inside the child it stopped in (which resumes in turn), else from the next child. So every child is updated
+    *  once per pass, however many updates the pass takes, and none is starved. A Sequence stops running microsteps.
+    *  The budget is checked between children, so a tick takes at most the budget plus the longest single child update.
+    *  Inside another budgeted update the outer budget applies, including in the regions of an FsmParallelCollection.
+    *  (FsmTable and FsmBank do not stop early.)
+    *
+    * @param budget Microseconds, 0 for no limit (ie; update())
+    */
+    void update(unsigned long budget);
+    
+   /**
+    * has the running update(budget) spent its budget
+    *  (eg; for a State that does work in slices; always false outside update(budget))
+    */
+    static bool isOverBudget() {
+      return _updateBudget && ((unsigned long) (micros() - _updateStarted) >= _updateBudget);
+    }
+    
    /**
     * over-ride this to define what happens when the FSM is forced to exit
     *  by default does nothing
@@ -56,6 +337,136 @@ class FsmUpdatable {
     virtual void setParent(FsmCollection* parent) {
       _parent = parent;
     }
+    
+   /**
+    * get the time until this FSM next needs to be updated
+    *  by default 0, ie; the FSM must be polled on every update
+    *
+    * A main loop may sleep for this long (or until an external change) instead of busy-polling
+    *
+    * @return milliseconds until the earliest pending deadline, 0 if an update is due now, 
+    *   FSM_NO_DEADLINE if only an external change can create work
+    */
+    virtual unsigned long timeToDeadline() { 
+      return 0; 
+    }
+    
+   /**
+    * describe what this FSM is (see FsmKind)
+    *  built-in FSMs over-ride this, anything else is FSM_KIND_USER.
+    *  Tools treat a class derived from a built-in FSM as user defined, whatever it reports (see FsmTable::describeExact())
+    *
+    * @param description Filled in with the kind and operands
+    */
+    virtual void describe(FsmDescription& description) {
+      description.kind = FSM_KIND_USER;
+      description.index = 0;
+      description.operand1 = NULL;
+      description.operand2 = NULL;
+      description.microsteps = 1;
+    }
+    
+   /**
+    * resolve build time references (eg; bind FsmTransition handles)
+    *  call once on the root, after the tree is complete (and before the first update)
+    *  by default does nothing; Collections pass it on to their children
+    */
+    virtual void resolve() { }
+    
+   /**
+    * write this FSM's runtime state (not its children's) to a snapshot, see FsmSnapshot
+    *  FSMs that keep state of their own over-ride saveState() and restoreState() to append it, calling the base first
+    */
+    virtual void saveState(FsmSnapshotWriter& writer) {
+      _saveQuiescence(writer, 0);
+    }
+    
+   /**
+    * read what saveState() wrote, without running any enter actions
+    */
+    virtual void restoreState(FsmSnapshotReader& reader) {
+      _restoreQuiescence(reader);
+    }
+    
+   /**
+    * get this FSM as a Collection
+    *
+    * @return NULL if this FSM has no children
+    */
+    virtual FsmCollection* asCollection() {
+      return NULL;
+    }
+    
+   /**
+    * get this FSM as a State
+    *
+    * @return NULL if this FSM is not an FsmState
+    */
+    virtual FsmState* asState() {
+      return NULL;
+    }
+    
+   /**
+    * get the parent FSM
+    */
+    FsmCollection* getParent() {
+      return _parent;
+    }
+    
+   /**
+    * is this FSM quiescent (see _sleep())
+    */
+    bool isQuiescent() {
+      return _flags & FSM_FLAG_QUIESCENT;
+    }
+    
+   /**
+    * is this FSM quiescent and not yet due to wake
+    *  ie; can update() be skipped
+    */
+    bool isDormant() {
+      return (_flags & FSM_FLAG_QUIESCENT) && (!(_flags & FSM_FLAG_WAKE_TIMED) || ((int32_t) ((uint32_t) millis() - _wakeTime) < 0));
+    }
+    
+   /**
+    * is this FSM quiescent and not yet due to wake at time now
+    *
+    * @param now The current millis()
+    */
+    bool isDormant(unsigned long now) {
+      return (_flags & FSM_FLAG_QUIESCENT) && (!(_flags & FSM_FLAG_WAKE_TIMED) || ((int32_t) ((uint32_t) now - _wakeTime) < 0));
+    }
+    
+   /**
+    * does this FSM wake automatically (see _sleepFor())
+    */
+    bool isWakeTimed() {
+      return _flags & FSM_FLAG_WAKE_TIMED;
+    }
+    
+   /**
+    * get the millis() at which this FSM wakes automatically, if isWakeTimed()
+    *  its low 32 bits: compare wake times as (int32_t) (a - b)
+    */
+    uint32_t getWakeTime() {
+      return _wakeTime;
+    }
+    
+   /**
+    * get the time until this (quiescent) FSM wakes automatically
+    *
+    * @return milliseconds, FSM_NO_DEADLINE if not timed
+    */
+    unsigned long timeToWake() {
+      return (_flags & FSM_FLAG_WAKE_TIMED) ? _timeUntil(_wakeTime) : FSM_NO_DEADLINE;
+    }
+    
+   /**
+    * end quiescence, so that this FSM (and its ancestors) are updated again
+    *  eg; after changing a Value that a quiescent State depends on
+    *  (through an FsmTableProxy, the path carries on through the table)
+    */
+    void wake();
 };
 
 /* --------------------------------------------------------------------------------------- */
@@ -71,9 +482,12 @@ class FsmUpdatable {
  * Provides ability to request that the Parent FSM (or Ancestor) transition to another State
  */
 class FsmState : public FsmUpdatable {
+  friend class FsmTransition;
+  
   protected:
-    bool _entered;  /**< protected variable  _entered Is Entering State */ 
-    bool _leaving;  /**< protected variable  _leaving Is Leaving State */ 
+#ifdef FSM_STATS
+    FsmStateStats _stats;  /**< protected variable  _stats Performance counters, see FsmStats */ 
+#endif
 
    /**
     * over-ride this to define what happens when the State is Entered
@@ -96,15 +510,47 @@ class FsmState : public FsmUpdatable {
     */
     virtual void _exitState() { }
 
+   /**
+    * over-ride this to report when the (entered) State next needs an update, see timeToDeadline()
+    *  by default 0, ie; the State polls in _updateState()
+    */
+    virtual unsigned long _timeToDeadline() { 
+      return 0; 
+    }
+
+   /**
+    * may this State sleep (become quiescent, see FsmUpdatable::_sleep()) rather than be polled in _updateState()
+    *  by default true. The built-in States that sleep on their own (eg; FsmDelay, FsmIdle, the Collections)
+    *  over-ride this to be true for the built-in class only, so a derived class that polls in _updateState() is still updated
+    */
+    virtual bool _canSleep() {
+      return true;
+    }
+
+   /**
+    * over-ride this to react to the events declared by getEvents()
+    *  called (while the State is entered) by dispatch(); typically makes a transition request
+    *  by default does nothing
+    *
+    * @param event The event
+    */
+    virtual void _onEvent(const FsmEvent& /*event*/) { }
+
    /**
     * handle leaving the state.
     *  calls user defined _exitState()
     */
     virtual void _leaveState() {
+      FSM_TRACE_EVENT(traceId, FSM_TRACE_EXIT);
       _exitState();
       
-      _leaving = false;
-      _entered = false;
+#ifdef FSM_STATS
+      if (_flags & FSM_FLAG_ENTERED) {
+        _stats.timeInState += FSM_STATS_CLOCK() - _stats.enteredAt;
+      }
+#endif
+      
+      _flags &= ~(FSM_FLAG_LEAVING | FSM_FLAG_ENTERED | FSM_FLAG_QUIESCENT);
     }
     
    /**
@@ -119,7 +565,7 @@ class FsmState : public FsmUpdatable {
     * 
     * @param depth The number of ancestor hops (parent=1)
     */
-    void _transitionAncestorToNext(byte depth);
+    void _transitionAncestorToNext(FsmIndex depth);
 
    /**
     * make request to leave state by requesting that an Ancestor (usually the Parent) move its focus to the previous state
@@ -127,7 +573,7 @@ class FsmState : public FsmUpdatable {
     *
     * @param depth The number of ancestor hops (parent=1)
     */
-    void _transitionAncestorToPrevious(byte depth);
+    void _transitionAncestorToPrevious(FsmIndex depth);
     
    /**
     * make request to leave state by requesting that an Ancestor (usually the Parent) move its focus to the next state
@@ -136,7 +582,7 @@ class FsmState : public FsmUpdatable {
     * @param childInd The target state identifier
     * @param depth The number of ancestor hops (parent=1)
     */
-    void _transitionAncestorTo(byte childInd, byte depth);
+    void _transitionAncestorTo(FsmIndex childInd, FsmIndex depth);
     
    /**
     * make request to leave state by requesting that an Ancestor (usually the Parent) move its focus to its first state
@@ -144,7 +590,22 @@ class FsmState : public FsmUpdatable {
     *
     * @param depth The number of ancestor hops (parent=1)
     */
-    void _transitionAncestorToStart(byte depth);
+    void _transitionAncestorToStart(FsmIndex depth);
+    
+   /**
+    * record the name of a sibling to branch to, resolved by _resolveBranch() (held in the FsmColdTable)
+    *
+    * @param branchName The name of the target, NULL for none
+    * @return false if it could not be recorded (out of memory)
+    */
+    bool _setBranchName(const char* branchName);
+    
+   /**
+    * resolve the branch target recorded by _setBranchName() (see FsmCollection::indexOf()), typically from resolve()
+    *
+    * @param branchInd Set to the target's index, left as it is if no name was recorded or it names no sibling
+    */
+    void _resolveBranch(FsmIndex& branchInd);
     
    /**
     * request leave state
@@ -155,13 +616,18 @@ class FsmState : public FsmUpdatable {
    /**
     * Constructor
     */
-    FsmState() : _entered(false), _leaving(false), FsmUpdatable() { }
+    FsmState() : FsmUpdatable() { 
+#ifdef FSM_STATS
+      _stats.clear();
+#endif
+    }
     
    /**
     * Implement the update Interface
     *  on update, call _enterState(), _updateState() & _exitState (via _leaveState()) as required
     */
     virtual void update();
+    using FsmUpdatable::update;
 
    /**
     * Implement the forceExit Interface
@@ -176,6 +642,78 @@ class FsmState : public FsmUpdatable {
       FsmUpdatable::setParent(parent);
     }
 
+   /**
+    * over-ride this to declare the events the State reacts to (see FsmEventDispatcher)
+    *  by default none
+    *
+    * @param count Set to the number of event ids
+    * @return the event ids
+    */
+    virtual const FsmEventId* getEvents(FsmIndex& count) {
+      count = 0;
+      return NULL;
+    }
+
+   /**
+    * deliver an event to the State, if it is entered (called by FsmEventDispatcher)
+    *  calls _onEvent(), then completes any transition it requested: the State (or the ancestor) marked as leaving leaves now,
+    *  and the ancestors are woken so that the next update() enters the new State
+    *
+    * @param event The event
+    * @return false if the State is not entered
+    */
+    bool dispatch(const FsmEvent& event);
+
+   /**
+    * over-ride asState
+    */
+    virtual FsmState* asState() {
+      return this;
+    }
+
+   /**
+    * is the State entered (and not yet left)
+    */
+    bool isEntered() {
+      return _flags & FSM_FLAG_ENTERED;
+    }
+
+   /**
+    * over-ride saveState to record whether the State is entered
+    */
+    virtual void saveState(FsmSnapshotWriter& writer);
+
+   /**
+    * over-ride restoreState to re-enter (or leave) the State, without running _enterState() or _exitState()
+    */
+    virtual void restoreState(FsmSnapshotReader& reader);
+
+#ifdef FSM_STATS
+   /**
+    * get the performance counters, see FsmStats
+    */
+    FsmStateStats& getStats() {
+      return _stats;
+    }
+#endif
+
+   /**
+    * Implement the timeToDeadline Interface
+    *  a State that is yet to be entered, or is leaving, needs an update now
+    *  otherwise ask _timeToDeadline()
+    */
+    virtual unsigned long timeToDeadline() {
+      if ((_flags & (FSM_FLAG_ENTERED | FSM_FLAG_LEAVING)) != FSM_FLAG_ENTERED) {
+        return 0;
+      }
+      
+      if (_flags & FSM_FLAG_QUIESCENT) {
+        return timeToWake();
+      }
+      
+      return _timeToDeadline();
+    }
+
 };
 
 /* --------------------------------------------------------------------------------------- */
@@ -185,16 +723,70 @@ class FsmState : public FsmUpdatable {
  *
  * Provides a means to group FSMs into a Collection
  * All child States are considered to be active and consequently execute 'simultaneously'
+ *
+ * Quiescent children are skipped. When every active child is quiescent, so is the Collection 
+ *  (waking when its earliest child would), so whole idle subtrees cost nothing per update.
+ * A derived Collection may do its own work in _updateState(), so is never quiescent unless it over-rides _canSleep()
  */
 class FsmCollection : public FsmState {
+  friend class FsmOptimizer;
+  
+  FSM_EXACT_CLASS(FsmCollection)
+  
   protected:
-    LinkedList<FsmUpdatable*> _children;  /**< protected variable  _children List of pointers to child FSMs */ 
+    FsmArray<FsmUpdatable*> _children;  /**< protected variable  _children Contiguous array of pointers to child FSMs */ 
+    FsmIndex _resumeChildInd;           /**< protected variable  _resumeChildInd Child the next update carries on from, where a budgeted update stopped (0 for a whole pass) */ 
+    
+   /**
+    * hash a name (FNV-1a)
+    */
+    static uint16_t _hashName(const char* name);
+    
+   /**
+    * (re-)build the hash of child names
+    */
+    void _buildNameIndex();
+
+   /**
+    * over-ride _canSleep: may this Collection become quiescent when its active children are
+    *  true for the built-in class only: a derived class over-rides this to opt in
+    */
+    virtual bool _canSleep() {
+      return isExactly(this);
+    }
+    
+   /**
+    * may an FsmTransition be bound through (or to) this Collection, bypassing transitionAncestorTo*()
+    *  true for the built-in class only: a derived class may handle transitions itself, so over-rides this to opt in
+    */
+    virtual bool _canBindTransitions() {
+      return isExactly(this);
+    }
+    
+   /**
+    * become quiescent along with child, waking when it would
+    *
+    * @param child A quiescent child
+    */
+    void _sleepWith(FsmUpdatable* child) {
+      if (child->isWakeTimed()) {
+        _sleepFor(child->timeToWake());
+      }
+      else {
+        _sleep();
+      }
+    }
 
    /**
     * update all child States
     */
     virtual void _updateState();
 
+   /**
+    * the earliest deadline of all child States
+    */
+    virtual unsigned long _timeToDeadline();
+
    /**
     * overr-ride leaveState
     *  do normal_leaveState and also force children (And descendants) to exit
@@ -202,6 +794,8 @@ class FsmCollection : public FsmState {
     virtual void _leaveState() {
       FsmState::_leaveState();
       
+      // a pass stopped short is abandoned with the visit
+      _resumeChildInd = 0;
       _forceDescendantsToExit();
     }
     
@@ -215,14 +809,22 @@ class FsmCollection : public FsmState {
    /**
     * Constructor
     */
-    FsmCollection() : FsmState() { }
+    FsmCollection() : _resumeChildInd(0), FsmState() { 
+      _recordClass();
+    }
     
    /**
     * Destructor
     */
     ~FsmCollection() {
-      for (byte i=0; i<_children.size(); i++) {
-        delete _children.get(i);
+      for (FsmUpdatable** child = _children.begin(); child != _children.end(); child++) {
+        delete *child;
+      }
+      
+      FsmColdData* cold = _findCold();
+      
+      if (cold) {
+        FsmArena::release(cold->nameSlots);
       }
     }
     
@@ -230,9 +832,127 @@ class FsmCollection : public FsmState {
     * add a child State
     *
     * @param child Pointer to an FSM
+    * @return the index of the child, FSM_INDEX_NONE if the Collection is full (or out of memory)
+    */
+    FsmIndex addChild(FsmUpdatable* child);
+    
+   /**
+    * pre-size the child storage, avoiding re-allocation while children are added
+    *
+    * @param count The expected number of children
+    */
+    void reserveChildren(FsmIndex count) {
+      _children.reserve(count);
+    }
+    
+   /**
+    * get the number of child States
+    */
+    FsmIndex getChildCount() {
+      return _children.size();
+    }
+    
+   /**
+    * get a child State
+    *
+    * @param childInd The index of the child
+    */
+    FsmUpdatable* getChild(FsmIndex childInd) {
+      return _children.get(childInd);
+    }
+    
+    virtual FsmCollection* asCollection() {
+      return this;
+    }
+    
+    virtual void describe(FsmDescription& description) {
+      FsmUpdatable::describe(description);
+      description.kind = FSM_KIND_COLLECTION;
+    }
+    
+   /**
+    * make request to leave state by requesting that an Ancestor (usually the Parent) move its focus to the next state
+    *  called by descendants, see FsmState::_transitionAncestorToNext()
+    *  a Collection has no focus, so at depth 0 the request is ignored
+    *
+    * @param depth The number of ancestor hops (parent=1)
+    */
+    virtual void transitionAncestorToNext(FsmIndex depth);
+    
+   /**
+    * make request to leave state by requesting that an Ancestor (usually the Parent) move its focus to the previous state
+    *  called by descendants, see FsmState::_transitionAncestorToPrevious()
+    *  a Collection has no focus, so at depth 0 the request is ignored
+    *
+    * @param depth The number of ancestor hops (parent=1)
+    */
+    virtual void transitionAncestorToPrevious(FsmIndex depth);
+
+   /**
+    * make request to leave state by requesting that an Ancestor (usually the Parent) move its focus to the specified state
+    *  called by descendants, see FsmState::_transitionAncestorTo()
+    *  a Collection has no focus, so at depth 0 the request is ignored
+    *
+    * @param childInd The is of the target state
+    * @param depth The number of ancestor hops (parent=1)
+    */
+    virtual void transitionAncestorTo(FsmIndex childInd, FsmIndex depth);
+
+   /**
+    * make request to leave state by requesting that an Ancestor (usually the Parent) move its focus to its first state
+    *  called by descendants, see FsmState::_transitionAncestorToStart()
+    *  a Collection has no focus, so at depth 0 the request is ignored
+    *
+    * @param depth The number of ancestor hops (parent=1)
+    */
+    virtual void transitionAncestorToStart(FsmIndex depth);
+    
+   /**
+    * bind a transition handle to the Sequence depth hops above this Collection's child (see FsmTransition::bind())
+    *  a Collection has no focus, so at depth 0 there is nothing to bind to;
+    *  nor is anything bound through a derived class that has not opted in (see _canBindTransitions())
+    *
+    * @param transition The handle being bound
+    * @param depth The number of ancestor hops remaining (this Collection=0)
+    * @return false if no Sequence can be bound
+    */
+    virtual bool resolveTransition(FsmTransition& transition, FsmIndex depth);
+    
+   /**
+    * over-ride saveState to record where a budgeted update stopped
+    */
+    virtual void saveState(FsmSnapshotWriter& writer);
+    
+   /**
+    * over-ride restoreState to carry on from where the saved budgeted update stopped
+    */
+    virtual void restoreState(FsmSnapshotReader& reader);
+    
+   /**
+    * resolve all children, and hash the names of named children
+    */
+    virtual void resolve();
+    
+   /**
+    * find a child by name
+    *  a hash lookup once resolve() has been called, otherwise a linear search
+    *
+    * @param name The name of the child
+    * @return the index of the child, FSM_INDEX_NONE if there is no such child
     */
-    byte addChild(FsmUpdatable* child);
+    FsmIndex indexOf(const char* name);
     
+   /**
+    * get a child by name
+    *
+    * @param name The name of the child
+    * @return NULL if there is no such child
+    */
+    FsmUpdatable* findChild(const char* name) {
+      FsmIndex childInd = indexOf(name);
+      
+      return (childInd == FSM_INDEX_NONE) ? NULL : _children.get(childInd);
+    }
 };
 
 /* --------------------------------------------------------------------------------------- */
@@ -243,11 +963,36 @@ class FsmCollection : public FsmState {
  * Provides a means to group FSMs into an ordered Sequence
  * Only one child State is considered to be active at any one. 
  * The other child States are inactive nad nust wait until they are transitioned to
+ *
+ * By default a State entered by a transition is first updated on the following update().
+ *  With setMicrosteps(n), up to n States are entered within one update(), so a chain of transient States
+ *  (eg; FsmStartTimer, FsmAssignConditionToValue, FsmBranchOnEndOfList) runs to completion in a single tick,
+ *  stopping at the first State that stays focused (ie; waits), or when the Sequence itself is left.
  */
 class FsmSequence : public FsmCollection {
+  friend class FsmTransition;
+  friend class FsmOptimizer;
+  
+  FSM_EXACT_CLASS(FsmSequence)
+  
   protected:
-    byte _currentChildInd;             /**< protected variable  _currentChildInd Index of the currently selected state */
-    byte _startChildInd;               /**< protected variable  _startChildInd Index of the start state */
+    FsmIndex _currentChildInd;         /**< protected variable  _currentChildInd Index of the currently selected state */
+    FsmIndex _startChildInd;           /**< protected variable  _startChildInd Index of the start state */
+    FsmIndex _microsteps;              /**< protected variable  _microsteps Number of States that may be entered per update */
+    
+   /**
+    * over-ride _canSleep, true for the built-in class only (see FsmCollection::_canSleep())
+    */
+    virtual bool _canSleep() {
+      return isExactly(this);
+    }
+    
+   /**
+    * over-ride _canBindTransitions, true for the built-in class only (see FsmCollection::_canBindTransitions())
+    */
+    virtual bool _canBindTransitions() {
+      return isExactly(this);
+    }
     
    /**
     * over-ride _enterState
@@ -267,12 +1012,17 @@ class FsmSequence : public FsmCollection {
     */
     virtual void _exitState();
     
+   /**
+    * the deadline of the focused State
+    */
+    virtual unsigned long _timeToDeadline();
+    
    /**
     * Transition to specified State
     *
     * @param childInd The index of the requested state
     */
-    void _transitionTo(byte childInd);
+    void _transitionTo(FsmIndex childInd);
     
    /**
     * Transition to the next State
@@ -301,46 +1051,175 @@ class FsmSequence : public FsmCollection {
     *
     * @param startChildInd The index of the Start Child State, defaults to 0
     */
-    FsmSequence(byte startChildInd) : _startChildInd(startChildInd), _currentChildInd(startChildInd), FsmCollection() { }
+    FsmSequence(FsmIndex startChildInd) : _startChildInd(startChildInd), _currentChildInd(startChildInd), _microsteps(FSM_MICROSTEPS), FsmCollection() { 
+      _recordClass();
+    }
     FsmSequence() : FsmSequence(0) { }
 
    /**
-    * make request to leave state by requesting that an Ancestor (usually the Parent) move its focus to the next state
-    *  called from within _updateState()
-    *
-    * @param depth The number of ancestor hops (parent=1)
+    * get the index of the focused State
+    */
+    FsmIndex getCurrentChildInd() {
+      return _currentChildInd;
+    }
+    
+   /**
+    * get the index of the start State
     */
-    void transitionAncestorToNext(byte depth);
+    FsmIndex getStartChildInd() {
+      return _startChildInd;
+    }
     
    /**
-    * make request to leave state by requesting that an Ancestor (usually the Parent) move its focus to the previous state
-    *  called from within _updateState()
+    * set the number of States that may be entered in one update (run to completion)
+    *  1 (the default, see FSM_MICROSTEPS) enters a State's successor on the following update
     *
-    * @param depth The number of ancestor hops (parent=1)
+    * @param microsteps The limit, at least 1
     */
-    void transitionAncestorToPrevious(byte depth);
+    void setMicrosteps(FsmIndex microsteps) {
+      _microsteps = microsteps ? microsteps : 1;
+    }
+    
+   /**
+    * get the number of States that may be entered in one update
+    */
+    FsmIndex getMicrosteps() {
+      return _microsteps;
+    }
+    
+    virtual void describe(FsmDescription& description) {
+      FsmUpdatable::describe(description);
+      description.kind = FSM_KIND_SEQUENCE;
+      description.index = _startChildInd;
+      description.microsteps = _microsteps;
+    }
 
    /**
-    * make request to leave state by requesting that an Ancestor (usually the Parent) move its focus to the next state
-    *  called from within _updateState()
-    *
-    * @param childInd The is of the target state
-    * @param depth The number of ancestor hops (parent=1)
+    * over-ride saveState to record the focused State
     */
-    void transitionAncestorTo(byte childInd, byte depth);
+    virtual void saveState(FsmSnapshotWriter& writer);
+    
+   /**
+    * over-ride restoreState to focus the saved State
+    */
+    virtual void restoreState(FsmSnapshotReader& reader);
 
    /**
-    * make request to leave state by requesting that an Ancestor (usually the Parent) move its focus to its first state
-    *  called from within _updateState()
+    * over-ride transitionAncestorToNext, at depth 0 focus on the next state
+    */
+    virtual void transitionAncestorToNext(FsmIndex depth);
+    
+   /**
+    * over-ride transitionAncestorToPrevious, at depth 0 focus on the previous state
+    */
+    virtual void transitionAncestorToPrevious(FsmIndex depth);
+
+   /**
+    * over-ride transitionAncestorTo, at depth 0 focus on the specified state
+    */
+    virtual void transitionAncestorTo(FsmIndex childInd, FsmIndex depth);
+
+   /**
+    * over-ride transitionAncestorToStart, at depth 0 focus on the start state
+    */
+    virtual void transitionAncestorToStart(FsmIndex depth);
+    
+   /**
+    * over-ride resolveTransition, at depth 0 bind to this Sequence
+    */
+    virtual bool resolveTransition(FsmTransition& transition, FsmIndex depth);
+    
+   /**
+    * over-ride forceExit to reset focus to start State
+    */
+    virtual void forceExit();
+};
+
+/* --------------------------------------------------------------------------------------- */
+
+/**
+ * A transition bound once to the Sequence it changes, then fired without walking the ancestors
+ *
+ * FsmState::_transitionAncestorToNext(depth) (and its siblings) walk up depth parents on every call.
+ *  A handle does that walk once, in bind(), and records the target Sequence and the State that leaves
+ *  (the target's child on the path). Firing is then constant time, whatever the depth.
+ *
+ * Bind when the tree is complete, typically from an over-ridden resolve():
+ *
+ *   class Worker : public FsmState {
+ *     FsmTransition _done;
+ *     virtual void _updateState() { if (finished()) _done.toNext(); }
+ *   public:
+ *     virtual void resolve() { _done.bind(this, 3); }
+ *   };
+ *
+ * If no Sequence can be bound (eg; the path crosses an FsmTableProxy, an FsmParallelCollection, or a class derived
+ *  from a built-in Collection, which may handle transitions itself), the handle falls back to the ancestor walk,
+ *  so it always behaves as the walk would.
+ *  Re-bind if the tree is re-arranged.
+ */
+class FsmTransition {
+  friend class FsmCollection;
+  friend class FsmSequence;
+  
+  protected:
+    FsmState* _from;        /**< protected variable _from The State making the request */
+    FsmIndex _depth;        /**< protected variable _depth The number of ancestor hops (parent=1) */
+    FsmSequence* _target;   /**< protected variable _target The bound Sequence, NULL if unbound */
+    FsmState* _leaving;     /**< protected variable _leaving The target's child on the path, marked as leaving */
+    
+  public:
+   /**
+    * Constructor
+    */
+    FsmTransition() : _from(NULL), _depth(0), _target(NULL), _leaving(NULL) { }
+    
+   /**
+    * resolve the Sequence depth hops above from
     *
+    * @param from The State making the requests
     * @param depth The number of ancestor hops (parent=1)
+    * @return false if the handle is unbound, and will walk the ancestors when fired
+    */
+    bool bind(FsmState* from, FsmIndex depth);
+    
+   /**
+    * is the handle bound to a Sequence
+    */
+    bool isBound() {
+      return _target != NULL;
+    }
+    
+   /**
+    * get the bound Sequence
+    *
+    * @return NULL if unbound
+    */
+    FsmSequence* getTarget() {
+      return _target;
+    }
+    
+   /**
+    * focus the target on its next State, see FsmState::_transitionAncestorToNext()
+    */
+    void toNext();
+    
+   /**
+    * focus the target on its previous State, see FsmState::_transitionAncestorToPrevious()
+    */
+    void toPrevious();
+    
+   /**
+    * focus the target on the specified State, see FsmState::_transitionAncestorTo()
+    *
+    * @param childInd The index of the target state
     */
-    void transitionAncestorToStart(byte depth);
+    void to(FsmIndex childInd);
     
    /**
-    * over-ride forceExit to reset focus to start State
+    * focus the target on its start State, see FsmState::_transitionAncestorToStart()
     */
-    virtual void forceExit();
+    void toStart();
 };
 
 /* --------------------------------------------------------------------------------------- */
@@ -349,30 +1228,127 @@ class FsmSequence : public FsmCollection {
  * Choose between two states based on a Condition (Value<bool>)
  *
  * When the Condition changes, the selected state is forced to exit the other state becomes focused
+ *
+ * A plain Value<bool> is polled on every update. An FsmWatchedValue<bool> is read only after it has changed,
+ *  and in between the Select sleeps whenever its focused state does (setValue() wakes it).
+ *  The Select is registered with it only while entered, so nothing is left registered once it has left
+ *  (eg; a tree in an FsmArena, whose destructors never run, must be forceExit()ed before the arena is reset).
  */
 class FsmSelectStateFromCondition : public FsmSequence {
+  FSM_EXACT_CLASS(FsmSelectStateFromCondition)
+  
   protected:
-    Value<bool>* _value;  /**< protected variable _value Pointer to the Condition (Value<bool>) */ 
-    bool _oldValue;       /**< protected variable _oldValue last value */ 
+    Value<bool>* _value;            /**< protected variable _value Pointer to the Condition (Value<bool>) */ 
+    bool _oldValue;                 /**< protected variable _oldValue last value */ 
+    FsmWatchedValueBase* _watched;  /**< protected variable _watched The Condition, if it notifies changes (else NULL) */
+    FsmWatch _watch;                /**< protected variable _watch Registration with _watched (fsm is NULL when not registered) */
+    
+   /**
+    * register with _watched (if registration fails, the Condition is polled)
+    */
+    void _addWatch() {
+      if (_watched && !_watch.fsm && _watched->addWatch(&_watch)) {
+        _watch.fsm = this;
+      }
+    }
+    
+   /**
+    * unregister from _watched
+    */
+    void _removeWatch() {
+      if (_watch.fsm) {
+        _watched->removeWatch(&_watch);
+        _watch.fsm = NULL;
+      }
+    }
     
    /**
-    * over-ride _enterState to select initial focused state
+    * over-ride _enterState to register with a watched Condition, and select initial focused state
     */
     virtual void _enterState();
     
+   /**
+    * over-ride _leaveState to unregister from a watched Condition
+    */
+    virtual void _leaveState() {
+      FsmSequence::_leaveState();
+      _removeWatch();
+    }
+    
    /**
     * over-ride _updateState to force transition when value changes
     */
     virtual void _updateState();
     
+   /**
+    * a polled Condition is read on every update; a watched one leaves the deadline to the focused state
+    */
+    virtual unsigned long _timeToDeadline() {
+      return _watch.fsm ? FsmSequence::_timeToDeadline() : 0;
+    }
+    
+   /**
+    * a polled Condition is read on every update, so never become quiescent; a watched one wakes the Select
+    *  (a derived class over-rides this to opt in)
+    */
+    virtual bool _canSleep() {
+      return _watch.fsm && isExactly(this);
+    }
+    
+   /**
+    * over-ride _canBindTransitions, true for the built-in class only (see FsmCollection::_canBindTransitions())
+    */
+    virtual bool _canBindTransitions() {
+      return isExactly(this);
+    }
+    
   public:
   
    /**
     * Constructor
     *
-    * @param value Pointer to the Condition (Value<bool>) 
+    * @param value Pointer to the Condition (Value<bool>), polled on every update
+    */
+    FsmSelectStateFromCondition(Value<bool>* value) : _value(value), _oldValue(false), _watched(NULL), FsmSequence() {
+      _recordClass();
+      _watch.fsm = NULL;
+      _watch.changed = false;
+    }
+    
+   /**
+    * Constructor
+    *
+    * @param value Pointer to the Condition, read only when it changes. It must out-live the Select
+    */
+    FsmSelectStateFromCondition(FsmWatchedValue<bool>* value) : _value(value), _oldValue(false), _watched(value), FsmSequence() {
+      _recordClass();
+      _watch.fsm = NULL;
+      _watch.changed = false;
+    }
+    
+   /**
+    * Destructor
+    */
+    ~FsmSelectStateFromCondition() {
+      _removeWatch();
+    }
+    
+    virtual void describe(FsmDescription& description) {
+      FsmUpdatable::describe(description);
+      description.kind = FSM_KIND_SELECT;
+      description.operand1 = _value;
+      description.microsteps = _microsteps;
+    }
+    
+   /**
+    * over-ride saveState to record the last value seen
     */
-    FsmSelectStateFromCondition(Value<bool>* value) : _value(value), FsmSequence() {}
+    virtual void saveState(FsmSnapshotWriter& writer);
+    
+   /**
+    * over-ride restoreState to restore the last value seen (the Condition is read again on the next update)
+    */
+    virtual void restoreState(FsmSnapshotReader& reader);
 };
 
 /* --------------------------------------------------------------------------------------- */
@@ -381,12 +1357,28 @@ class FsmSelectStateFromCondition : public FsmSequence {
  * Remain in this State for the specified duration 
  *
  * When the duration has passed, transition to the next state
+ * While waiting, the State is quiescent (it sleeps until the timer is due, _wakeTime holding the timer's deadline)
  */
 class FsmDelay : public FsmState {
+  FSM_EXACT_CLASS(FsmDelay)
+  
   protected:
-    Timer* _timer;                    /**< protected variable  _timer Timer used to countdown duration */
+    Timer _timer;                     /**< protected variable  _timer Timer used to countdown duration (held inline, beside the State's flags) */
     Value<Duration>* _durationValue;  /**< protected variable _value Pointer to the duration Value (Value<Duration>) */
     
+   /**
+    * over-ride _canSleep, true for the built-in class only (see FsmState::_canSleep())
+    */
+    virtual bool _canSleep() {
+      return isExactly(this);
+    }
+    
+   /**
+    * start the timer, and sleep until it is due (if the class can sleep, see _canSleep())
+    *  either way, _wakeTime holds the timer's deadline
+    */
+    void _startTimer(Duration duration);
+    
    /**
     * over-ride _enterState to start the timer (using the duration specified by _durationValue 
     */
@@ -397,6 +1389,13 @@ class FsmDelay : public FsmState {
     */
     virtual void _updateState();
     
+   /**
+    * over-ride _timeToDeadline to report the time remaining on the timer
+    */
+    virtual unsigned long _timeToDeadline() {
+      return _timeUntil(_wakeTime);
+    }
+    
   public:
   
    /**
@@ -405,15 +1404,25 @@ class FsmDelay : public FsmState {
     * @param durationValue Pointer to the duration Value
     */
     FsmDelay(Value<Duration>* durationValue) : _durationValue(durationValue), FsmState() {
-      _timer = new Timer();  
+      _recordClass();
+    }
+    
+    virtual void describe(FsmDescription& description) {
+      FsmUpdatable::describe(description);
+      description.kind = FSM_KIND_DELAY;
+      description.operand1 = &_timer;
+      description.operand2 = _durationValue;
     }
     
    /**
-    * Destructor
+    * over-ride saveState to record the time remaining on the timer (if entered)
     */
-    ~FsmDelay() {
-      delete _timer;
-    }
+    virtual void saveState(FsmSnapshotWriter& writer);
+    
+   /**
+    * over-ride restoreState to restart the timer with the time it had remaining
+    */
+    virtual void restoreState(FsmSnapshotReader& reader);
 };
 
 /* --------------------------------------------------------------------------------------- */
@@ -425,9 +1434,12 @@ class FsmDelay : public FsmState {
  * Another state ('FsmWaitUntilTimerIsComplete') will monitor the timer.
  */
 class FsmStartTimer : public FsmState {
+  FSM_EXACT_CLASS(FsmStartTimer)
+  
   protected:
     Timer* _timer;                   /**< protected variable  _parent Pointer to the Timer */ 
     Value<Duration>* _durationValue; /**< protected variable _value Pointer to the duration Value (Value<Duration>) */
+    unsigned long _deadline;         /**< protected variable _deadline millis() at which the Timer, as last started here, completes */
     
    /**
     * over-ride _enterState to start the timer (using the duration specified by _durationValue, 
@@ -442,7 +1454,36 @@ class FsmStartTimer : public FsmState {
     * @param timer Pointer to the Timer
     * @param durationValue Pointer to the duration Value
     */
-    FsmStartTimer(Timer* timer, Value<Duration>* durationValue) : _timer(timer), _durationValue(durationValue), FsmState() {}
+    FsmStartTimer(Timer* timer, Value<Duration>* durationValue) : _timer(timer), _durationValue(durationValue), _deadline(0), FsmState() {
+      _recordClass();
+    }
+    
+   /**
+    * get the time left on the Timer, as last started by this State
+    *  (the Timer may have been started since by something else)
+    *
+    * @return milliseconds, 0 once due
+    */
+    unsigned long getTimeRemaining() {
+      return _timeUntil(_deadline);
+    }
+    
+    virtual void describe(FsmDescription& description) {
+      FsmUpdatable::describe(description);
+      description.kind = FSM_KIND_START_TIMER;
+      description.operand1 = _timer;
+      description.operand2 = _durationValue;
+    }
+    
+   /**
+    * over-ride saveState to record the time remaining on the timer (whether or not entered: it runs on after the State)
+    */
+    virtual void saveState(FsmSnapshotWriter& writer);
+    
+   /**
+    * over-ride restoreState to restart the timer with the time it had remaining
+    */
+    virtual void restoreState(FsmSnapshotReader& reader);
 };
 
 /* --------------------------------------------------------------------------------------- */
@@ -452,24 +1493,47 @@ class FsmStartTimer : public FsmState {
  *
  * Works in conjunction with 'FsmStartTimer'
  * Transitions to the next state when the timer is complete
+ * The Timer reports only whether it is complete, so resolve() looks for the one FsmStartTimer in the tree that starts it.
+ *  While waiting, the State is then quiescent (it sleeps until that FsmStartTimer's deadline), otherwise it polls the Timer.
+ *  If the timer is re-started with a shorter duration while waiting, call wake()
  */
 class FsmWaitUntilTimerIsComplete : public FsmState {
+  FSM_EXACT_CLASS(FsmWaitUntilTimerIsComplete)
+  
   protected:
-    Timer* _timer;  /**< protected variable  _timer Pointer to the Timer */ 
+    Timer* _timer;           /**< protected variable  _timer Pointer to the Timer */ 
+    FsmStartTimer* _starter; /**< protected variable  _starter The FsmStartTimer that starts the Timer (found by resolve()), NULL to poll */ 
     
    /**
     * over-ride _updateState to request transitioon when the timer is complete
     */
     virtual void _updateState();
     
+   /**
+    * over-ride _timeToDeadline to report the time remaining on the timer (0, to poll, if it is not known)
+    */
+    virtual unsigned long _timeToDeadline();
+    
   public:
    /**
     * Constructor
     *
     * @param timer Pointer to the Timer
     */
-    FsmWaitUntilTimerIsComplete(Timer* timer) : _timer(timer), FsmState() {}
-
+    FsmWaitUntilTimerIsComplete(Timer* timer) : _timer(timer), _starter(NULL), FsmState() {
+      _recordClass();
+    }
+    
+   /**
+    * find the FsmStartTimer that starts the Timer, if there is exactly one in the tree
+    */
+    virtual void resolve();
+    
+    virtual void describe(FsmDescription& description) {
+      FsmUpdatable::describe(description);
+      description.kind = FSM_KIND_WAIT_TIMER;
+      description.operand1 = _timer;
+    }
 };
 
 /* --------------------------------------------------------------------------------------- */
@@ -481,6 +1545,8 @@ class FsmWaitUntilTimerIsComplete : public FsmState {
  *  and the parent's parent FSM to transition to the next state
  */
 class FsmFinish : public FsmState {
+  FSM_EXACT_CLASS(FsmFinish)
+  
   protected:
    /**
     * over-ride _updateState to request transitioon to start and ancestor transition to next
@@ -491,7 +1557,14 @@ class FsmFinish : public FsmState {
    /**
     * Constructor
     */
-    FsmFinish() : FsmState() {}
+    FsmFinish() : FsmState() {
+      _recordClass();
+    }
+    
+    virtual void describe(FsmDescription& description) {
+      FsmUpdatable::describe(description);
+      description.kind = FSM_KIND_FINISH;
+    }
 
 };
 
@@ -507,9 +1580,13 @@ class FsmFinish : public FsmState {
  *   at which point this state will request a transition to the specified state
  */
 class FsmBranchOnEndOfList : public FsmState {
+  FSM_EXACT_CLASS(FsmBranchOnEndOfList)
+  
+  friend class FsmOptimizer;
+  
   protected:
     EnumeratorBase* _enumerator;  /**< protected variable _enumerator The Enumerator used to traverse a List */
-    byte _branchInd;              /**< protected variable _branchInd The state to transition to at end of list */
+    FsmIndex _branchInd;          /**< protected variable _branchInd The state to transition to at end of list */
     
    /**
     * over-ride _updateState to iterate enumerator and request a transition when necessary
@@ -523,7 +1600,32 @@ class FsmBranchOnEndOfList : public FsmState {
     * @param enumerator The Enumerator used to traverse a List
     * @param branchInd The state to transition to at end of list 
     */  
-    FsmBranchOnEndOfList(EnumeratorBase* enumerator, byte branchInd=0) : _enumerator(enumerator), _branchInd(branchInd), FsmState() {}
+    FsmBranchOnEndOfList(EnumeratorBase* enumerator, FsmIndex branchInd=0) : _enumerator(enumerator), _branchInd(branchInd), FsmState() {
+      _recordClass();
+    }
+    
+   /**
+    * branch to a sibling by name instead of index
+    *  resolved by resolve(); an unknown name leaves the branch index unchanged
+    *
+    * @param branchName The name of the state to transition to at end of list
+    * @return false if it could not be recorded (out of memory)
+    */
+    bool setBranchName(const char* branchName) {
+      return _setBranchName(branchName);
+    }
+    
+   /**
+    * resolve the branch name (if any) to an index
+    */
+    virtual void resolve();
+    
+    virtual void describe(FsmDescription& description) {
+      FsmUpdatable::describe(description);
+      description.kind = FSM_KIND_BRANCH_ON_END_OF_LIST;
+      description.index = _branchInd;
+      description.operand1 = _enumerator;
+    }
 };
 
 /* --------------------------------------------------------------------------------------- */
@@ -534,6 +1636,8 @@ class FsmBranchOnEndOfList : public FsmState {
  * Same as FsmBranchOnEndOfList, however rather than branching the Sequence simply finishes
  */
 class FsmFinishOnEndOfList : public FsmState {
+  FSM_EXACT_CLASS(FsmFinishOnEndOfList)
+  
   protected:
     EnumeratorBase* _enumerator;  /**< protected variable _enumerator The Enumerator used to traverse a List */
     
@@ -549,7 +1653,122 @@ class FsmFinishOnEndOfList : public FsmState {
     * @param enumerator The Enumerator used to traverse a List
     * @param branchInd The id of the state to branch to
     */  
-    FsmFinishOnEndOfList(EnumeratorBase* enumerator, byte branchInd=0) : _enumerator(enumerator), FsmState() {}
+    FsmFinishOnEndOfList(EnumeratorBase* enumerator, FsmIndex branchInd=0) : _enumerator(enumerator), FsmState() {
+      _recordClass();
+    }
+    
+    virtual void describe(FsmDescription& description) {
+      FsmUpdatable::describe(description);
+      description.kind = FSM_KIND_FINISH_ON_END_OF_LIST;
+      description.operand1 = _enumerator;
+    }
+};
+
+/* --------------------------------------------------------------------------------------- */
+
+/**
+ * For each item of an Enumerator, do the body (_forEachItem()), then at the end of the list move on
+ *
+ * Replaces the FsmBranchOnEndOfList, body State(s), FsmFinish loop with one State: the Enumerator is reset on entry,
+ *  then each update moves through up to a batch of items (see setBatch()), calling _forEachItem() for each,
+ *  and stops early once the update has used its budget of time (see setBudget()). At the end of the list it transitions
+ *  to the next State, or to the branch if one is set. So a list of n items takes about n / batch updates, not several per item.
+ *
+ *   class PrintEach : public FsmForEach {
+ *     protected:
+ *       Enumerator<int>* _items;
+ *       virtual void _forEachItem() { Serial.println(_items->getCurrent()); }
+ *     public:
+ *       PrintEach(Enumerator<int>* items) : _items(items), FsmForEach(items) { }
+ *   };
+ *
+ * The body may make a transition itself (eg; to stop at an item), which ends the batch.
+ *  As it runs user code, it describes itself as user defined (so FsmTable runs it as it is).
+ */
+class FsmForEach : public FsmState {
+  protected:
+    EnumeratorBase* _enumerator;  /**< protected variable _enumerator The Enumerator used to traverse a List */
+    FsmIndex _branchInd;          /**< protected variable _branchInd The state to transition to at end of list, FSM_INDEX_NONE for the next */
+    uint16_t _batch;              /**< protected variable _batch Most items processed per update */
+    unsigned long _budget;        /**< protected variable _budget Microseconds an update may spend on items, 0 for no limit */
+    
+   /**
+    * over-ride this to do the body for the Enumerator's current item
+    *  by default does nothing
+    */
+    virtual void _forEachItem() { }
+    
+   /**
+    * over-ride _enterState to start from the first item
+    */
+    virtual void _enterState() {
+      _enumerator->reset();
+    }
+    
+   /**
+    * over-ride _updateState to process a batch of items, and request a transition at the end of the list
+    */
+    virtual void _updateState();
+    
+  public:
+   /**
+    * Constructor
+    *
+    * @param enumerator The Enumerator used to traverse a List
+    * @param branchInd The state to transition to at end of list, by default the next
+    */
+    FsmForEach(EnumeratorBase* enumerator, FsmIndex branchInd=FSM_INDEX_NONE) : 
+      _enumerator(enumerator), _branchInd(branchInd), _batch(FSM_FOR_EACH_BATCH), _budget(0), FsmState() {}
+    
+   /**
+    * set the most items processed in one update
+    *  1 is one item per update (as a FsmBranchOnEndOfList loop, without its extra States)
+    *
+    * @param batch The limit, at least 1 (default FSM_FOR_EACH_BATCH)
+    */
+    void setBatch(uint16_t batch) {
+      _batch = batch ? batch : 1;
+    }
+    
+   /**
+    * get the most items processed in one update
+    */
+    uint16_t getBatch() {
+      return _batch;
+    }
+    
+   /**
+    * set the time an update may spend on items: once used, the rest of the batch waits for the next update
+    *  at least one item is processed per update; the clock is only read if a budget is set
+    *
+    * @param budget Microseconds, 0 (the default) for no limit
+    */
+    void setBudget(unsigned long budget) {
+      _budget = budget;
+    }
+    
+   /**
+    * get the time an update may spend on items, in microseconds
+    */
+    unsigned long getBudget() {
+      return _budget;
+    }
+    
+   /**
+    * branch to a sibling by name instead of index
+    *  resolved by resolve(); an unknown name leaves the branch index unchanged
+    *
+    * @param branchName The name of the state to transition to at end of list
+    * @return false if it could not be recorded (out of memory)
+    */
+    bool setBranchName(const char* branchName) {
+      return _setBranchName(branchName);
+    }
+    
+   /**
+    * resolve the branch name (if any) to an index
+    */
+    virtual void resolve();
 };
 
 /* --------------------------------------------------------------------------------------- */
@@ -561,9 +1780,13 @@ class FsmFinishOnEndOfList : public FsmState {
  *  It can cause a Sequence to take a different path through its child states based on a Condition Value<bool>)
  */
 class FsmBranchOnConditionFalse : public FsmState {
+  FSM_EXACT_CLASS(FsmBranchOnConditionFalse)
+  
+  friend class FsmOptimizer;
+  
   protected:
     Condition** _condition;  /**< protected variable _condition Pointer to Pointer to Condition */
-    byte _branchInd;         /**< protected variable _branchInd The state to transition to at end of list */
+    FsmIndex _branchInd;     /**< protected variable _branchInd The state to transition to at end of list */
     
    /**
     * over-ride _enterState to evaluate the condition and transition to next or branch to the specified state
@@ -580,7 +1803,32 @@ class FsmBranchOnConditionFalse : public FsmState {
     * @param condition Pointer to Pointer to Condition used to decide on wether to branch
     * @param branchInd The state to transition when the condition evaluates to false
     */
-    FsmBranchOnConditionFalse(Condition** condition, byte branchInd=0) : _condition(condition), _branchInd(branchInd), FsmState() {}
+    FsmBranchOnConditionFalse(Condition** condition, FsmIndex branchInd=0) : _condition(condition), _branchInd(branchInd), FsmState() {
+      _recordClass();
+    }
+    
+   /**
+    * branch to a sibling by name instead of index
+    *  resolved by resolve(); an unknown name leaves the branch index unchanged
+    *
+    * @param branchName The name of the state to transition to when the condition evaluates to false
+    * @return false if it could not be recorded (out of memory)
+    */
+    bool setBranchName(const char* branchName) {
+      return _setBranchName(branchName);
+    }
+    
+   /**
+    * resolve the branch name (if any) to an index
+    */
+    virtual void resolve();
+    
+    virtual void describe(FsmDescription& description) {
+      FsmUpdatable::describe(description);
+      description.kind = FSM_KIND_BRANCH_ON_CONDITION_FALSE;
+      description.index = _branchInd;
+      description.operand1 = _condition;
+    }
 };
 
 /* --------------------------------------------------------------------------------------- */
@@ -594,6 +1842,8 @@ class FsmBranchOnConditionFalse : public FsmState {
  * @todo - make equivalent 'FsmAssignValueExpressionToValue'
  */
 class FsmAssignConditionToValue : public FsmState {
+  FSM_EXACT_CLASS(FsmAssignConditionToValue)
+  
   protected:
     Condition* _condition;  /**< protected variable _condition Pointer to Condition */
     Value<bool>* _value;    /**< protected variable _value Pointer to the output Value (Value<bool>) */
@@ -610,7 +1860,16 @@ class FsmAssignConditionToValue : public FsmState {
     * @param condition Pointer to Pointer to Condition used to decide on wether to branch
     * @param value The Value that will be set to the value of the Condition
     */
-    FsmAssignConditionToValue(Condition* condition, Value<bool>* value) : _condition(condition), _value(value), FsmState() {}
+    FsmAssignConditionToValue(Condition* condition, Value<bool>* value) : _condition(condition), _value(value), FsmState() {
+      _recordClass();
+    }
+    
+    virtual void describe(FsmDescription& description) {
+      FsmUpdatable::describe(description);
+      description.kind = FSM_KIND_ASSIGN_CONDITION;
+      description.operand1 = _condition;
+      description.operand2 = _value;
+    }
 };
 
 /* --------------------------------------------------------------------------------------- */
@@ -622,14 +1881,16 @@ class FsmAssignConditionToValue : public FsmState {
  *  to send a literal charcter string to Serial
  */
 class FsmDebugPrint : public FsmState {
+  FSM_EXACT_CLASS(FsmDebugPrint)
+  
   protected:
-    String* _msg;  /**< protected variable _msg Pointer to message String */
+    char* _msg;  /**< protected variable _msg Copy of the message */
     
    /**
     * over-ride _enterState to display the message then request transition to next
     */
     virtual void _enterState() {
-      Serial.println(*_msg);
+      Serial.println(_msg);
       _transitionAncestorToNext(1);
     }
     
@@ -640,14 +1901,21 @@ class FsmDebugPrint : public FsmState {
     * @param msg Literal character string
     */
     FsmDebugPrint(char* msg) : FsmState() {
-      _msg = new String(msg);
+      _recordClass();
+      _msg = FsmArena::copyString(msg);
+    }
+    
+    virtual void describe(FsmDescription& description) {
+      FsmUpdatable::describe(description);
+      description.kind = FSM_KIND_DEBUG_PRINT;
+      description.operand1 = _msg;
     }
     
    /**
     * Destructor
     */
     ~FsmDebugPrint(){
-      delete _msg;
+      FsmArena::release(_msg);
     }
 };
 
@@ -663,12 +1931,99 @@ class FsmDebugPrint : public FsmState {
  * FsmIdle(s) are typically used with 'FsmSelectStateFromCondition'
  */
 class FsmIdle : public FsmState {
+  FSM_EXACT_CLASS(FsmIdle)
+  
+  protected:
+   /**
+    * over-ride _canSleep, true for the built-in class only (see FsmState::_canSleep())
+    */
+    virtual bool _canSleep() {
+      return isExactly(this);
+    }
+    
+   /**
+    * FsmIdle is quiescent as soon as it is entered
+    */
+    virtual void _enterState() {
+      if (_canSleep()) {
+        _sleep();
+      }
+    }
+    
+   /**
+    * FsmIdle never needs an update (unless a derived class polls)
+    */
+    virtual unsigned long _timeToDeadline() {
+      return _canSleep() ? FSM_NO_DEADLINE : 0;
+    }
+    
+  public:
+   /**
+    * Constructor
+    */
+    FsmIdle() : FsmState() {
+      _recordClass();
+    }
+    
+    virtual void describe(FsmDescription& description) {
+      FsmUpdatable::describe(description);
+      description.kind = FSM_KIND_IDLE;
+    }
+};
+
+/* --------------------------------------------------------------------------------------- */
+
+/**
+ * Wait For Event
+ *
+ * Quiescent until the event is dispatched (see FsmEventDispatcher), then transitions to the next State
+ *  (or, if a branch is set, to that State). Unlike a polled Condition, it costs nothing while waiting
+ *  and reacts within the dispatch.
+ */
+class FsmWaitForEvent : public FsmState {
+  protected:
+    FsmEventId _eventId;  /**< protected variable _eventId The event waited for */
+    FsmIndex _branchInd;  /**< protected variable _branchInd The state to transition to, FSM_INDEX_NONE for the next */
+    
+   /**
+    * over-ride _enterState to sleep until the event
+    */
+    virtual void _enterState() {
+      _sleep();
+    }
+    
+   /**
+    * over-ride _onEvent to transition
+    */
+    virtual void _onEvent(const FsmEvent& /*event*/) {
+      if (_branchInd == FSM_INDEX_NONE) {
+        _transitionAncestorToNext(1);
+      }
+      else {
+        _transitionAncestorTo(_branchInd, 1);
+      }
+    }
+    
+   /**
+    * FsmWaitForEvent never needs an update
+    */
+    virtual unsigned long _timeToDeadline() {
+      return FSM_NO_DEADLINE;
+    }
     
   public:
    /**
     * Constructor
+    *
+    * @param eventId The event to wait for
+    * @param branchInd The state to transition to when it arrives, by default the next
     */
-    FsmIdle() : FsmState() {}
+    FsmWaitForEvent(FsmEventId eventId, FsmIndex branchInd=FSM_INDEX_NONE) : _eventId(eventId), _branchInd(branchInd), FsmState() {}
+    
+    virtual const FsmEventId* getEvents(FsmIndex& count) {
+      count = 1;
+      return &_eventId;
+    }
 };
 
 /* --------------------------------------------------------------------------------------- */
@@ -682,8 +2037,17 @@ class FsmIdle : public FsmState {
  * FsmDebugState(s) are typically used with 'FsmSelectStateFromCondition'
  */
 class FsmDebugState : public FsmState {
+  FSM_EXACT_CLASS(FsmDebugState)
+  
   protected:
-    String* _msg;  /**< protected variable _msg Pointer to message String */
+    char* _msg;  /**< protected variable _msg Copy of the message */
+    
+   /**
+    * over-ride _canSleep, true for the built-in class only (see FsmState::_canSleep())
+    */
+    virtual bool _canSleep() {
+      return isExactly(this);
+    }
   
   public:
    /**
@@ -692,7 +2056,14 @@ class FsmDebugState : public FsmState {
     * @param msg Literal character string
     */
     FsmDebugState(char* msg) : FsmState() {
-      _msg = new String(msg);
+      _recordClass();
+      _msg = FsmArena::copyString(msg);
+    }
+    
+    virtual void describe(FsmDescription& description) {
+      FsmUpdatable::describe(description);
+      description.kind = FSM_KIND_DEBUG_STATE;
+      description.operand1 = _msg;
     }
     
    /**
@@ -700,7 +2071,11 @@ class FsmDebugState : public FsmState {
     */
     virtual void _enterState() {
       Serial.print(F("Entering "));
-      Serial.println(*_msg);
+      Serial.println(_msg);
+      
+      if (_canSleep()) {
+        _sleep();
+      }
     }
 
    /**
@@ -708,7 +2083,14 @@ class FsmDebugState : public FsmState {
     */
     virtual void _updateState() {
       //Serial.print(F("Updating "));
-      //Serial.println(*_msg);
+      //Serial.println(_msg);
+    }
+    
+   /**
+    * FsmDebugState never needs an update
+    */
+    virtual unsigned long _timeToDeadline() {
+      return _canSleep() ? FSM_NO_DEADLINE : 0;
     }
     
    /**
@@ -716,14 +2098,14 @@ class FsmDebugState : public FsmState {
     */
     virtual void _exitState() {
       Serial.print(F("Exiting "));
-      Serial.println(*_msg);
+      Serial.println(_msg);
     }
     
    /**
     * Destructor
     */
     ~FsmDebugState(){
-      delete _msg;
+      FsmArena::release(_msg);
     }
   
 };
@@ -0,0 +1,143 @@
+#include <FsmArena.h>
+#include <string.h>
+
+FsmArena* FsmArena::_current = NULL;
+FsmArena* FsmArena::_first = NULL;
+
+FsmArena::FsmArena(size_t capacity) : _next(NULL), _used(0), _last(0), _overflowCount(0), _ownsBlock(true) {
+  _block = (char*) malloc(capacity);
+  _capacity = _block ? capacity : 0;
+
+  _link();
+}
+
+FsmArena::FsmArena(void* buffer, size_t capacity) : _next(NULL), _block((char*) buffer), _capacity(capacity), _used(0), _last(0), _overflowCount(0), _ownsBlock(false) {
+  _link();
+}
+
+FsmArena::~FsmArena() {
+  _unlink();
+
+  if (_current == this) {
+    _current = NULL;
+  }
+
+  if (_ownsBlock) {
+    free(_block);
+  }
+}
+
+void FsmArena::_link() {
+  _next = _first;
+  _first = this;
+}
+
+void FsmArena::_unlink() {
+  for (FsmArena** arena = &_first; *arena; arena = &(*arena)->_next) {
+    if (*arena == this) {
+      *arena = _next;
+      return;
+    }
+  }
+}
+
+void* FsmArena::allocateFrom(size_t size) {
+  size_t aligned = _align(size ? size : 1);
+
+  if (aligned > _capacity - _used) {
+    return NULL;
+  }
+
+  _last = _used;
+  _used += aligned;
+
+  return _block + _last;
+}
+
+void* FsmArena::allocate(size_t size) {
+  if (_current) {
+    void* p = _current->allocateFrom(size);
+
+    if (p) {
+      return p;
+    }
+
+    _current->_overflowCount++;
+  }
+
+  return malloc(size);
+}
+
+void* FsmArena::allocateCleared(size_t size) {
+  void* p = allocate(size);
+
+  if (p) {
+    memset(p, 0, size);
+  }
+
+  return p;
+}
+
+void* FsmArena::reallocate(void* p, size_t oldSize, size_t newSize) {
+  if (!p) {
+    return allocate(newSize);
+  }
+
+  for (FsmArena* arena = _first; arena; arena = arena->_next) {
+    if (arena->contains(p)) {
+      // the most recent allocation can grow in place
+      if (((char*) p == arena->_block + arena->_last) && (_align(newSize) <= arena->_capacity - arena->_last)) {
+        arena->_used = arena->_last + _align(newSize);
+        return p;
+      }
+
+      void* resized = allocate(newSize);
+
+      if (resized) {
+        memcpy(resized, p, (oldSize < newSize) ? oldSize : newSize);
+      }
+
+      return resized;
+    }
+  }
+
+  // heap memory, moving into the current arena if there is one
+  if (_current) {
+    void* resized = _current->allocateFrom(newSize);
+
+    if (resized) {
+      memcpy(resized, p, (oldSize < newSize) ? oldSize : newSize);
+      free(p);
+      return resized;
+    }
+  }
+
+  return realloc(p, newSize);
+}
+
+void FsmArena::release(void* p) {
+  if (p && !isArenaMemory(p)) {
+    free(p);
+  }
+}
+
+char* FsmArena::copyString(const char* str) {
+  size_t size = strlen(str) + 1;
+  char* copy = (char*) allocate(size);
+
+  if (copy) {
+    memcpy(copy, str, size);
+  }
+
+  return copy;
+}
+
+bool FsmArena::isArenaMemory(const void* p) {
+  for (FsmArena* arena = _first; arena; arena = arena->_next) {
+    if (arena->contains(p)) {
+      return true;
+    }
+  }
+
+  return false;
+}
@@ -0,0 +1,223 @@
+/** @file FsmArena.h
+  *  Copyright (c) 2016 Ozbotics
+  *  Distributed under the MIT license (see LICENSE)
+  */
+#ifndef _FSM_ARENA_H
+ #define _FSM_ARENA_H
+
+#include <stdlib.h>
+#include <stddef.h>
+
+#define FSM_ARENA_ALIGN (sizeof(double) > sizeof(void*) ? sizeof(double) : sizeof(void*))  /**< alignment of every arena allocation */
+
+/**
+ * Tag selecting the placement form of operator new below
+ *  (AVR cores do not all provide <new>)
+ */
+struct FsmPlacement { };
+
+inline void* operator new(size_t, void* ptr, FsmPlacement) noexcept {
+  return ptr;
+}
+
+inline void operator delete(void*, void*, FsmPlacement) noexcept { }
+
+/**
+ * A pre-sized block of memory that whole FSMs are built in, and freed from in one operation
+ *
+ * While an FsmArena::Scope is alive, every FSM built with `new` comes from the arena,
+ *  along with the storage the built-in FSMs allocate for themselves
+ *  (Collection child arrays, FsmDebugPrint / FsmDebugState messages, and the nodes of an FsmTable or FsmBank compiled within the scope).
+ *  Allocation is a pointer bump; if the block is exhausted, allocations fall back to the heap
+ *  (and are counted, see getOverflowCount()).
+ *
+ * When the machine is no longer needed, either delete its root as usual (arena memory is then simply not reused),
+ *  or call reset() / destroy the arena to release the whole machine at once, without running destructors.
+ *  The latter is only correct when no State built in the arena owns a resource outside of it,
+ *  ie; for the built-in FSMs, and user FSMs that only hold pointers to objects they do not own.
+ *  The exception is a registration with an FsmWatchedValue that out-lives the arena: an entered FsmSelectStateFromCondition
+ *  is registered until it leaves, so forceExit() the machine before reset(), and unwatch() an FsmCachedCondition built in the arena.
+ *
+ * Build machines from one thread at a time; the current arena is shared.
+ *
+ *   static byte buffer[1024];
+ *   FsmArena arena(buffer, sizeof(buffer));
+ *   {
+ *     FsmArena::Scope scope(arena);
+ *     fsm = buildMachine();
+ *   }
+ */
+class FsmArena {
+  protected:
+    static FsmArena* _current;  /**< protected variable _current The arena allocations come from, NULL for the heap */
+    static FsmArena* _first;    /**< protected variable _first The first live arena (to recognise arena memory) */
+
+    FsmArena* _next;            /**< protected variable _next The next live arena */
+    char* _block;               /**< protected variable _block The memory block */
+    size_t _capacity;           /**< protected variable _capacity Size of the block */
+    size_t _used;               /**< protected variable _used Bytes allocated from the block */
+    size_t _last;               /**< protected variable _last Offset of the most recent allocation (which may grow in place) */
+    unsigned int _overflowCount;/**< protected variable _overflowCount Allocations that did not fit, and came from the heap */
+    bool _ownsBlock;            /**< protected variable _ownsBlock The block was malloc()ed by the arena */
+
+    void _link();
+    void _unlink();
+
+    static size_t _align(size_t size) {
+      return (size + FSM_ARENA_ALIGN - 1) & ~(FSM_ARENA_ALIGN - 1);
+    }
+
+  public:
+   /**
+    * Constructor
+    *  allocates the block from the heap
+    *
+    * @param capacity Size of the block in bytes
+    */
+    FsmArena(size_t capacity);
+
+   /**
+    * Constructor
+    *  uses memory provided by the caller (eg; a static buffer), which must out-live the arena
+    *
+    * @param buffer The memory to allocate from
+    * @param capacity Size of buffer in bytes
+    */
+    FsmArena(void* buffer, size_t capacity);
+
+   /**
+    * Destructor
+    *  releases everything allocated from the arena (without running destructors)
+    */
+    ~FsmArena();
+
+   /**
+    * allocate from this arena
+    *
+    * @param size Number of bytes
+    * @return NULL if the arena is exhausted
+    */
+    void* allocateFrom(size_t size);
+
+   /**
+    * release everything allocated from the arena at once (without running destructors)
+    */
+    void reset() {
+      _used = 0;
+      _last = 0;
+      _overflowCount = 0;
+    }
+
+   /**
+    * does this arena's block hold p
+    */
+    bool contains(const void* p) const {
+      return ((const char*) p >= _block) && ((const char*) p < _block + _capacity);
+    }
+
+   /**
+    * get the number of bytes allocated (eg; to size the arena after building a machine once)
+    */
+    size_t getUsed() const {
+      return _used;
+    }
+
+   /**
+    * get the size of the block
+    */
+    size_t getCapacity() const {
+      return _capacity;
+    }
+
+   /**
+    * get the number of allocations that did not fit, and came from the heap
+    */
+    unsigned int getOverflowCount() const {
+      return _overflowCount;
+    }
+
+   /**
+    * allocate from the current arena, or the heap if there is none (or it is full)
+    *
+    * @param size Number of bytes
+    */
+    static void* allocate(size_t size);
+
+   /**
+    * allocate, as allocate(), memory filled with zeros (as calloc())
+    *
+    * @param size Number of bytes
+    */
+    static void* allocateCleared(size_t size);
+
+   /**
+    * resize an allocation made by allocate(), preserving its contents
+    *  the most recent arena allocation grows in place, heap allocations use realloc()
+    *
+    * @param p The allocation (may be NULL)
+    * @param oldSize Its current size
+    * @param newSize The required size
+    * @return NULL (leaving p intact) if memory is exhausted
+    */
+    static void* reallocate(void* p, size_t oldSize, size_t newSize);
+
+   /**
+    * release an allocation made by allocate()
+    *  heap memory is freed, arena memory is left for reset()
+    */
+    static void release(void* p);
+
+   /**
+    * copy a string into memory from allocate()
+    */
+    static char* copyString(const char* str);
+
+   /**
+    * the arena allocations come from, NULL for the heap
+    */
+    static FsmArena* getCurrent() {
+      return _current;
+    }
+
+   /**
+    * does any live arena hold p
+    */
+    static bool isArenaMemory(const void* p);
+
+   /**
+    * Directs allocations to an arena for its lifetime, then restores the previous arena
+    */
+    class Scope {
+      protected:
+        FsmArena* _previous;  /**< protected variable _previous The arena that was current before */
+
+      public:
+        Scope(FsmArena& arena) : _previous(FsmArena::_current) {
+          FsmArena::_current = &arena;
+        }
+
+        ~Scope() {
+          FsmArena::_current = _previous;
+        }
+    };
+
+   /**
+    * Directs allocations to the heap for its lifetime, then restores the previous arena
+    *  (for storage that belongs to something outside the arena, and so must out-live reset())
+    */
+    class HeapScope {
+      protected:
+        FsmArena* _previous;  /**< protected variable _previous The arena that was current before */
+
+      public:
+        HeapScope() : _previous(FsmArena::_current) {
+          FsmArena::_current = NULL;
+        }
+
+        ~HeapScope() {
+          FsmArena::_current = _previous;
+        }
+    };
+};
+
+#endif  // _FSM_ARENA_H
@@ -0,0 +1,140 @@
+/** @file FsmArray.h 
+  *  Copyright (c) 2016 Ozbotics 
+  *  Distributed under the MIT license (see LICENSE)
+  */ 
+#ifndef _FSM_ARRAY_H
+ #define _FSM_ARRAY_H
+
+#include <stdlib.h>
+#include "FsmArena.h"
+
+/**
+ * A growable, contiguous array of trivially copyable items (eg; pointers)
+ *
+ * Used by FSM Collections to hold their children.
+ * Unlike LinkedList, get() is a single load regardless of the index,
+ *  and iterating the items touches one contiguous block of memory.
+ */
+template <typename T>
+class FsmArray {
+  protected:
+    T* _items;           /**< protected variable _items Pointer to the first item */
+    int _size;           /**< protected variable _size Number of items */
+    int _capacity;       /**< protected variable _capacity Number of items that fit without growing */
+    
+  public:
+   /**
+    * Constructor
+    */
+    FsmArray() : _items(NULL), _size(0), _capacity(0) { }
+    
+   /**
+    * Destructor
+    *  releases the storage (but not anything the items point to)
+    */
+    ~FsmArray() {
+      FsmArena::release(_items);
+    }
+    
+   /**
+    * make room for at least capacity items
+    *  storage comes from the current FsmArena, if any
+    *
+    * @param capacity The required capacity
+    * @return false if the storage could not be allocated
+    */
+    bool reserve(int capacity) {
+      if (capacity <= _capacity) {
+        return true;
+      }
+      
+      T* items = (T*) FsmArena::reallocate(_items, _capacity * sizeof(T), capacity * sizeof(T));
+      if (!items) {
+        return false;
+      }
+      
+      _items = items;
+      _capacity = capacity;
+      
+      return true;
+    }
+    
+   /**
+    * append an item
+    *  grows by a few items at a time while small, then by half again
+    *
+    * @param item The item to append
+    * @return false if the storage could not be grown
+    */
+    bool add(T item) {
+      if (_size == _capacity) {
+        if (!reserve(_capacity < 4 ? _capacity + 2 : _capacity + (_capacity >> 1))) {
+          return false;
+        }
+      }
+      
+      _items[_size++] = item;
+      
+      return true;
+    }
+    
+   /**
+    * remove an item, moving the last item into its place (the order is not preserved)
+    *
+    * @param index The index of the item (not range checked)
+    */
+    void removeUnordered(int index) {
+      _items[index] = _items[--_size];
+    }
+    
+   /**
+    * keep the first size items, dropping the rest
+    *
+    * @param size The number of items to keep (no more than size())
+    */
+    void truncate(int size) {
+      _size = size;
+    }
+    
+   /**
+    * get an item
+    *
+    * @param index The index of the item (not range checked)
+    */
+    T get(int index) const {
+      return _items[index];
+    }
+    
+   /**
+    * replace an item
+    *
+    * @param index The index of the item (not range checked)
+    * @param item The new item
+    */
+    void set(int index, T item) {
+      _items[index] = item;
+    }
+    
+   /**
+    * get the number of items
+    */
+    int size() const {
+      return _size;
+    }
+    
+   /**
+    * pointer to the first item, for iteration
+    */
+    T* begin() const {
+      return _items;
+    }
+    
+   /**
+    * pointer past the last item, for iteration
+    */
+    T* end() const {
+      return _items + _size;
+    }
+};
+
+#endif  // _FSM_ARRAY_H
@@ -0,0 +1,625 @@
+#include <FsmBank.h>
+
+static bool _isSequenceKind(byte kind) {
+  return (kind == FSM_KIND_SEQUENCE) || (kind == FSM_KIND_SELECT);
+}
+
+static bool _isTimerKind(byte kind) {
+  return (kind == FSM_KIND_DELAY) || (kind == FSM_KIND_START_TIMER) || (kind == FSM_KIND_WAIT_TIMER);
+}
+
+/**
+ * can a node of this kind sleep until a time (its own, or its earliest child's)
+ */
+static bool _isWakeTimedKind(byte kind) {
+  return (kind == FSM_KIND_COLLECTION) || (kind == FSM_KIND_SEQUENCE) || (kind == FSM_KIND_DELAY) || (kind == FSM_KIND_WAIT_TIMER);
+}
+
+
+void FsmBank::_clear() {
+  _definition._clear();
+  
+  FsmArena::release(_columns);
+  FsmArena::release(_flags);
+  FsmArena::release(_current);
+  FsmArena::release(_wake);
+  FsmArena::release(_deadlines);
+  
+  _nodes = NULL;
+  _nodeCount = 0;
+  _instanceCount = 0;
+  _columns = NULL;
+  _flags = NULL;
+  _current = NULL;
+  _wake = NULL;
+  _deadlines = NULL;
+  _sequenceColumns = 0;
+  _wakeColumns = 0;
+  _timerColumns = 0;
+}
+
+bool FsmBank::compile(FsmUpdatable* root, uint16_t instanceCount) {
+  _clear();
+  
+  if (!instanceCount || !_definition.compile(root)) {
+    return false;
+  }
+  
+  _nodes = _definition._nodes;
+  _nodeCount = _definition._nodeCount;
+  _columns = (FsmBankColumns*) FsmArena::allocate(_nodeCount * sizeof(FsmBankColumns));
+  
+  if (!_columns) {
+    _clear();
+    return false;
+  }
+  
+  // count the columns, recording the column numbers in place of the pointers
+  uint16_t* sequenceColumn = (uint16_t*) malloc(3 * _nodeCount * sizeof(uint16_t));
+  uint16_t* wakeColumn = sequenceColumn + _nodeCount;
+  uint16_t* timerColumn = wakeColumn + _nodeCount;
+  
+  if (!sequenceColumn) {
+    _clear();
+    return false;
+  }
+  
+  for (uint16_t n=0; n<_nodeCount; n++) {
+    const FsmTableNode& node = _nodes[n];
+    
+    // instances of a user defined FSM would share one object
+    if (node.kind == FSM_KIND_USER) {
+      free(sequenceColumn);
+      _clear();
+      return false;
+    }
+    
+    sequenceColumn[n] = _isSequenceKind(node.kind) ? _sequenceColumns++ : FSM_TABLE_NONE;
+    wakeColumn[n] = _isWakeTimedKind(node.kind) ? _wakeColumns++ : FSM_TABLE_NONE;
+    timerColumn[n] = FSM_TABLE_NONE;
+    
+    // nodes sharing a Timer (eg; FsmStartTimer and FsmWaitUntilTimerIsComplete) share its column,
+    //  a Delay's own Timer is not in the table (NULL) and never shared
+    if (_isTimerKind(node.kind)) {
+      void* timer = _definition._operands[node.operand];
+      
+      for (uint16_t m=0; timer && (m<n) && (timerColumn[n] == FSM_TABLE_NONE); m++) {
+        if (_isTimerKind(_nodes[m].kind) && (_definition._operands[_nodes[m].operand] == timer)) {
+          timerColumn[n] = timerColumn[m];
+        }
+      }
+      
+      if (timerColumn[n] == FSM_TABLE_NONE) {
+        timerColumn[n] = _timerColumns++;
+      }
+    }
+  }
+  
+  _instanceCount = instanceCount;
+  _flags = (byte*) FsmArena::allocateCleared((size_t) _nodeCount * instanceCount * sizeof(byte));
+  _current = (FsmIndex*) FsmArena::allocate(((size_t) _sequenceColumns * instanceCount + 1) * sizeof(FsmIndex));
+  _wake = (unsigned long*) FsmArena::allocateCleared(((size_t) _wakeColumns * instanceCount + 1) * sizeof(unsigned long));
+  _deadlines = (unsigned long*) FsmArena::allocateCleared(((size_t) _timerColumns * instanceCount + 1) * sizeof(unsigned long));
+  
+  if (!_flags || !_current || !_wake || !_deadlines) {
+    free(sequenceColumn);
+    _clear();
+    return false;
+  }
+  
+  for (uint16_t n=0; n<_nodeCount; n++) {
+    FsmBankColumns& columns = _columns[n];
+    
+    columns.flags = _flags + (size_t) n * instanceCount;
+    columns.current = (sequenceColumn[n] == FSM_TABLE_NONE) ? NULL : _current + (size_t) sequenceColumn[n] * instanceCount;
+    columns.wake = (wakeColumn[n] == FSM_TABLE_NONE) ? NULL : _wake + (size_t) wakeColumn[n] * instanceCount;
+    columns.deadline = (timerColumn[n] == FSM_TABLE_NONE) ? NULL : _deadlines + (size_t) timerColumn[n] * instanceCount;
+    
+    for (uint16_t i=0; (i<instanceCount) && columns.current; i++) {
+      columns.current[i] = _nodes[n].startChildInd;
+    }
+  }
+  
+  free(sequenceColumn);
+  
+  return true;
+}
+
+
+void FsmBank::_request(byte op, uint16_t n, uint16_t i, FsmIndex depth, FsmIndex childInd) {
+  // walk up as FsmTable::_request() does, marking the child of the target as leaving
+  while (depth > 0) {
+    uint16_t parent = _nodes[n].parent;
+    
+    if (parent == FSM_TABLE_NONE) {
+      return;
+    }
+    
+    if (depth == 1) {
+      _flag(n, i) |= FSM_TABLE_LEAVING;
+    }
+    
+    n = parent;
+    depth--;
+  }
+  
+  const FsmTableNode& node = _nodes[n];
+  
+  // a Collection has no focus
+  if (!_isSequenceKind(node.kind)) {
+    return;
+  }
+  
+  FsmIndex current = _currentChild(n, i);
+  
+  switch (op) {
+    case FSM_TABLE_NEXT:
+      _transitionTo(n, i, current + 1);
+      break;
+    
+    case FSM_TABLE_PREVIOUS:
+      _transitionTo(n, i, (current == 0) ? node.childCount - 1 : current - 1);
+      break;
+    
+    case FSM_TABLE_TO:
+      _transitionTo(n, i, childInd);
+      break;
+    
+    case FSM_TABLE_START:
+      _currentChild(n, i) = node.startChildInd;
+      break;
+  }
+}
+
+void FsmBank::_transitionTo(uint16_t n, uint16_t i, FsmIndex childInd) {
+  const FsmTableNode& node = _nodes[n];
+  
+  _currentChild(n, i) = (childInd < node.childCount) ? childInd : node.startChildInd;
+}
+
+
+void FsmBank::update() {
+  if (!_nodeCount) {
+    return;
+  }
+  
+  FsmUpdatable::_flags &= ~FSM_FLAG_QUIESCENT;
+  
+  byte* flags = _columns[0].flags;
+  unsigned long* wake = _columns[0].wake;
+  bool awake = false;
+  bool timed = false;
+  unsigned long earliest = 0;
+  unsigned long now = 0;
+  bool haveNow = false;
+  
+  // the root columns are contiguous, so skipping waiting instances is a scan
+  for (uint16_t i=0; i<_instanceCount; i++) {
+    if (!haveNow && (flags[i] & FSM_TABLE_WAKE_TIMED)) {
+      now = millis();
+      haveNow = true;
+    }
+    
+    if (!_isDormant(0, i, now)) {
+      _updateNode(0, i);
+    }
+    
+    if (!(flags[i] & FSM_TABLE_QUIESCENT)) {
+      awake = true;
+    }
+    else if (!awake && (flags[i] & FSM_TABLE_WAKE_TIMED) && (!timed || ((long)(wake[i] - earliest) < 0))) {
+      earliest = wake[i];
+      timed = true;
+    }
+  }
+  
+  // with every instance quiescent, so is the bank
+  if (!awake) {
+    FsmUpdatable::_sleep();
+    
+    if (timed) {
+      FsmUpdatable::_flags |= FSM_FLAG_WAKE_TIMED;
+      _wakeTime = earliest;
+    }
+  }
+}
+
+void FsmBank::update(uint16_t instance) {
+  if (instance < _instanceCount) {
+    _updateNode(0, instance);
+  }
+}
+
+void FsmBank::forceExit() {
+  for (uint16_t i=0; (i<_instanceCount) && _nodeCount; i++) {
+    _forceExitNode(0, i);
+  }
+}
+
+void FsmBank::wakeInstance(uint16_t instance) {
+  for (uint16_t n=0; n<_nodeCount; n++) {
+    _flag(n, instance) &= ~FSM_TABLE_QUIESCENT;
+  }
+  
+  wake();
+}
+
+void FsmBank::wakeAll() {
+  for (size_t f=0; f<(size_t) _nodeCount * _instanceCount; f++) {
+    _flags[f] &= ~FSM_TABLE_QUIESCENT;
+  }
+  
+  wake();
+}
+
+void FsmBank::saveState(FsmSnapshotWriter& writer) {
+  FsmUpdatable::saveState(writer);
+  writer.writeUInt16(_nodeCount);
+  writer.writeUInt16(_instanceCount);
+  
+  // column by column
+  for (uint16_t n=0; n<_nodeCount; n++) {
+    const FsmBankColumns& columns = _columns[n];
+    
+    for (uint16_t i=0; i<_instanceCount; i++) {
+      writer.writeByte(columns.flags[i] & ~FSM_TABLE_LEAVING);
+    }
+    
+    if (columns.current) {
+      for (uint16_t i=0; i<_instanceCount; i++) {
+        writer.writeUInt16(columns.current[i]);
+      }
+    }
+    
+    if (columns.wake) {
+      for (uint16_t i=0; i<_instanceCount; i++) {
+        if (columns.flags[i] & FSM_TABLE_WAKE_TIMED) {
+          writer.writeTime(columns.wake[i]);
+        }
+      }
+    }
+  }
+  
+  for (size_t d=0; d<(size_t) _timerColumns * _instanceCount; d++) {
+    writer.writeTime(_deadlines[d]);
+  }
+}
+
+void FsmBank::restoreState(FsmSnapshotReader& reader) {
+  FsmUpdatable::restoreState(reader);
+  
+  if ((reader.readUInt16() != _nodeCount) || (reader.readUInt16() != _instanceCount)) {
+    reader.fail();
+    return;
+  }
+  
+  for (uint16_t n=0; (n<_nodeCount) && !reader.isFailed(); n++) {
+    const FsmBankColumns& columns = _columns[n];
+    
+    for (uint16_t i=0; i<_instanceCount; i++) {
+      columns.flags[i] = reader.readByte();
+    }
+    
+    if (columns.current) {
+      for (uint16_t i=0; i<_instanceCount; i++) {
+        columns.current[i] = (FsmIndex) reader.readUInt16();
+        
+        if (columns.current[i] >= _nodes[n].childCount) {
+          reader.fail();
+        }
+      }
+    }
+    
+    if (columns.wake) {
+      for (uint16_t i=0; i<_instanceCount; i++) {
+        if (columns.flags[i] & FSM_TABLE_WAKE_TIMED) {
+          columns.wake[i] = reader.readTime();
+        }
+      }
+    }
+  }
+  
+  for (size_t d=0; d<(size_t) _timerColumns * _instanceCount; d++) {
+    _deadlines[d] = reader.readTime();
+  }
+}
+
+unsigned long FsmBank::timeToDeadline() {
+  unsigned long deadline = FSM_NO_DEADLINE;
+  
+  for (uint16_t i=0; (i<_instanceCount) && _nodeCount && (deadline > 0); i++) {
+    unsigned long instanceDeadline = _timeToDeadline(0, i);
+    
+    if (instanceDeadline < deadline) {
+      deadline = instanceDeadline;
+    }
+  }
+  
+  return deadline;
+}
+
+void FsmBank::_updateNode(uint16_t n, uint16_t i) {
+  if (_flag(n, i) & FSM_TABLE_QUIESCENT) {
+    if (_isDormant(n, i, millis())) {
+      return;
+    }
+    
+    _flag(n, i) &= ~FSM_TABLE_QUIESCENT;
+  }
+  
+  if (!(_flag(n, i) & FSM_TABLE_ENTERED)) {
+    _flag(n, i) |= FSM_TABLE_ENTERED;
+    _enterNode(n, i);
+  }
+  
+  _updateNodeState(n, i);
+  
+  if (_flag(n, i) & FSM_TABLE_LEAVING) {
+    _leaveNode(n, i);
+  }
+}
+
+void FsmBank::_enterNode(uint16_t n, uint16_t i) {
+  const FsmTableNode& node = _nodes[n];
+  
+  switch (node.kind) {
+    case FSM_KIND_SELECT: {
+      bool value = ((Value<bool>*) _operand(n, 0, i))->getValue();
+      
+      _flag(n, i) = value ? (_flag(n, i) | FSM_TABLE_OLD_VALUE) : (_flag(n, i) & ~FSM_TABLE_OLD_VALUE);
+      _transitionTo(n, i, (FsmIndex) value);
+      break;
+    }
+    
+    case FSM_KIND_DELAY:
+      _deadline(n, i) = millis() + ((Value<Duration>*) _operand(n, 1, i))->getValue();
+      break;
+    
+    case FSM_KIND_START_TIMER:
+      _deadline(n, i) = millis() + ((Value<Duration>*) _operand(n, 1, i))->getValue();
+      _request(FSM_TABLE_NEXT, n, i, 1);
+      break;
+    
+    case FSM_KIND_FINISH:
+      _request(FSM_TABLE_START, n, i, 1);
+      _request(FSM_TABLE_NEXT, n, i, 2);
+      break;
+    
+    case FSM_KIND_BRANCH_ON_END_OF_LIST:
+      if (((EnumeratorBase*) _operand(n, 0, i))->moveNext()) {
+        _request(FSM_TABLE_NEXT, n, i, 1);
+      }
+      else {
+        _request(FSM_TABLE_TO, n, i, 1, node.branchInd);
+      }
+      break;
+    
+    case FSM_KIND_FINISH_ON_END_OF_LIST:
+      if (((EnumeratorBase*) _operand(n, 0, i))->moveNext()) {
+        _request(FSM_TABLE_NEXT, n, i, 1);
+      }
+      else {
+        _request(FSM_TABLE_START, n, i, 1);
+        _request(FSM_TABLE_NEXT, n, i, 2);
+      }
+      break;
+    
+    case FSM_KIND_BRANCH_ON_CONDITION_FALSE:
+      if ((*(Condition**) _operand(n, 0, i))->getValue()) {
+        _request(FSM_TABLE_NEXT, n, i, 1);
+      }
+      else {
+        _request(FSM_TABLE_TO, n, i, 1, node.branchInd);
+      }
+      break;
+    
+    case FSM_KIND_ASSIGN_CONDITION:
+      ((Value<bool>*) _operand(n, 1, i))->setValue(((Condition*) _operand(n, 0, i))->getValue());
+      _request(FSM_TABLE_NEXT, n, i, 1);
+      break;
+    
+    case FSM_KIND_DEBUG_PRINT:
+      Serial.println((char*) _operand(n, 0, i));
+      _request(FSM_TABLE_NEXT, n, i, 1);
+      break;
+    
+    case FSM_KIND_IDLE:
+      _sleep(n, i);
+      break;
+    
+    case FSM_KIND_DEBUG_STATE:
+      Serial.print(F("Entering "));
+      Serial.println((char*) _operand(n, 0, i));
+      _sleep(n, i);
+      break;
+  }
+}
+
+void FsmBank::_updateNodeState(uint16_t n, uint16_t i) {
+  const FsmTableNode& node = _nodes[n];
+  
+  switch (node.kind) {
+    case FSM_KIND_COLLECTION:
+      _updateCollection(n, i);
+      break;
+    
+    case FSM_KIND_SEQUENCE:
+      _updateSequence(n, i);
+      break;
+    
+    case FSM_KIND_SELECT: {
+      bool value = ((Value<bool>*) _operand(n, 0, i))->getValue();
+      
+      if (value != (bool)(_flag(n, i) & FSM_TABLE_OLD_VALUE)) {
+        _flag(n, i) ^= FSM_TABLE_OLD_VALUE;
+        _forceExitNode(node.firstChild + _currentChild(n, i), i);
+        _transitionTo(n, i, (FsmIndex) value);
+      }
+      
+      // the Condition is polled on every update, so never become quiescent
+      _stepSequence(n, i);
+      break;
+    }
+    
+    case FSM_KIND_DELAY:
+    case FSM_KIND_WAIT_TIMER:
+      _updateTimer(n, i);
+      break;
+  }
+}
+
+void FsmBank::_updateTimer(uint16_t n, uint16_t i) {
+  unsigned long deadline = _deadline(n, i);
+  
+  if ((long)(millis() - deadline) >= 0) {
+    _request(FSM_TABLE_NEXT, n, i, 1);
+  }
+  else {
+    _sleepUntil(n, i, deadline);
+  }
+}
+
+void FsmBank::_updateCollection(uint16_t n, uint16_t i) {
+  const FsmTableNode& node = _nodes[n];
+  uint16_t end = node.firstChild + node.childCount;
+  uint16_t earliest = FSM_TABLE_NONE;
+  bool awake = false;
+  unsigned long now = millis();
+  
+  for (uint16_t child = node.firstChild; child < end; child++) {
+    if (!_isDormant(child, i, now)) {
+      _updateNode(child, i);
+      
+      if (!(_flag(child, i) & FSM_TABLE_QUIESCENT)) {
+        awake = true;
+        continue;
+      }
+    }
+    
+    if (!awake && (_flag(child, i) & FSM_TABLE_WAKE_TIMED) &&
+        ((earliest == FSM_TABLE_NONE) || ((long)(_wakeAt(child, i) - _wakeAt(earliest, i)) < 0))) {
+      earliest = child;
+    }
+  }
+  
+  if (!awake && !(_flag(n, i) & FSM_TABLE_LEAVING)) {
+    if (earliest != FSM_TABLE_NONE) {
+      _sleepUntil(n, i, _wakeAt(earliest, i));
+    }
+    else {
+      _sleep(n, i);
+    }
+  }
+}
+
+void FsmBank::_stepSequence(uint16_t n, uint16_t i) {
+  const FsmTableNode& node = _nodes[n];
+  FsmIndex microsteps = node.microsteps;
+  
+  for (;;) {
+    FsmIndex childInd = _currentChild(n, i);
+    _updateNode(node.firstChild + childInd, i);
+    
+    // run to completion, as FsmSequence::_updateState()
+    if ((_currentChild(n, i) == childInd) || (_flag(n, i) & FSM_TABLE_LEAVING) || (--microsteps == 0)) {
+      break;
+    }
+  }
+}
+
+void FsmBank::_updateSequence(uint16_t n, uint16_t i) {
+  const FsmTableNode& node = _nodes[n];
+  
+  _stepSequence(n, i);
+  
+  // the focused child may have changed, if so it has yet to be entered
+  uint16_t child = node.firstChild + _currentChild(n, i);
+  
+  if ((_flag(child, i) & FSM_TABLE_QUIESCENT) && !(_flag(n, i) & FSM_TABLE_LEAVING)) {
+    if (_flag(child, i) & FSM_TABLE_WAKE_TIMED) {
+      _sleepUntil(n, i, _wakeAt(child, i));
+    }
+    else {
+      _sleep(n, i);
+    }
+  }
+}
+
+void FsmBank::_leaveNode(uint16_t n, uint16_t i) {
+  const FsmTableNode& node = _nodes[n];
+  
+  if (node.kind == FSM_KIND_DEBUG_STATE) {
+    Serial.print(F("Exiting "));
+    Serial.println((char*) _operand(n, 0, i));
+  }
+  
+  _flag(n, i) &= ~(FSM_TABLE_ENTERED | FSM_TABLE_LEAVING | FSM_TABLE_QUIESCENT);
+  
+  if (node.kind == FSM_KIND_COLLECTION) {
+    for (uint16_t child = node.firstChild; child < node.firstChild + node.childCount; child++) {
+      _forceExitNode(child, i);
+    }
+  }
+  else if (_isSequenceKind(node.kind)) {
+    _forceExitNode(node.firstChild + _currentChild(n, i), i);
+  }
+}
+
+void FsmBank::_forceExitNode(uint16_t n, uint16_t i) {
+  _leaveNode(n, i);
+  
+  if (_isSequenceKind(_nodes[n].kind)) {
+    _currentChild(n, i) = _nodes[n].startChildInd;
+  }
+}
+
+unsigned long FsmBank::_timeToDeadline(uint16_t n, uint16_t i) {
+  const FsmTableNode& node = _nodes[n];
+  byte flags = _flag(n, i);
+  
+  if (!(flags & FSM_TABLE_ENTERED) || (flags & FSM_TABLE_LEAVING)) {
+    return 0;
+  }
+  
+  if (flags & FSM_TABLE_QUIESCENT) {
+    if (!(flags & FSM_TABLE_WAKE_TIMED)) {
+      return FSM_NO_DEADLINE;
+    }
+    
+    long remaining = (long)(_wakeAt(n, i) - millis());
+    
+    return (remaining > 0) ? (unsigned long) remaining : 0;
+  }
+  
+  switch (node.kind) {
+    case FSM_KIND_COLLECTION: {
+      unsigned long deadline = FSM_NO_DEADLINE;
+      
+      for (uint16_t child = node.firstChild; (child < node.firstChild + node.childCount) && (deadline > 0); child++) {
+        unsigned long childDeadline = _timeToDeadline(child, i);
+        
+        if (childDeadline < deadline) {
+          deadline = childDeadline;
+        }
+      }
+      
+      return deadline;
+    }
+    
+    case FSM_KIND_SEQUENCE:
+      return _timeToDeadline(node.firstChild + _currentChild(n, i), i);
+    
+    case FSM_KIND_DELAY:
+    case FSM_KIND_WAIT_TIMER: {
+      long remaining = (long)(_deadline(n, i) - millis());
+      
+      return (remaining > 0) ? (unsigned long) remaining : 0;
+    }
+    
+    case FSM_KIND_IDLE:
+    case FSM_KIND_DEBUG_STATE:
+      return FSM_NO_DEADLINE;
+  }
+  
+  return 0;
+}
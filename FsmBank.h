@@ -0,0 +1,249 @@
+/** @file FsmBank.h
+  *  Copyright (c) 2016 Ozbotics
+  *  Distributed under the MIT license (see LICENSE)
+  */
+#ifndef _FSM_BANK_H
+ #define _FSM_BANK_H
+
+#include <FsmTable.h>
+
+/**
+ * maps an operand of the definition to the object a bank instance uses in its place
+ *  (return operand itself to share it between instances)
+ *
+ * @param operand The operand, as reported by describe() (see FsmKind)
+ * @param instance The bank instance
+ * @param context The context given to FsmBank::setBinder()
+ */
+typedef void* (*FsmBankBinder)(void* operand, uint16_t instance, void* context);
+
+/**
+ * The per-instance state columns of a node (each indexed by instance)
+ */
+struct FsmBankColumns {
+  byte* flags;              /**< FsmTableFlag bits */
+  FsmIndex* current;        /**< focused child (Sequences), NULL if none */
+  unsigned long* wake;      /**< wake time (States that sleep until a time), NULL if none */
+  unsigned long* deadline;  /**< Timer deadline (timer States, shared by States sharing a Timer), NULL if none */
+};
+
+/**
+ * Many independent instances of one FSM, stepped together
+ *
+ * compile() flattens a definition tree once (see FsmTable); the bank then keeps only the per-instance
+ *  runtime state, in structure of arrays form: for each node, a contiguous column of flags,
+ *  and where the node needs them, columns of focused child indices, wake times and Timer deadlines.
+ *  An instance costs a few bytes per node, rather than a tree of heap objects.
+ *  Compiled within an FsmArena::Scope, the columns come from the arena.
+ *
+ * update() steps every instance. Quiescent instances are skipped by a scan of the root's flag and wake time columns,
+ *  so instances that are waiting (eg; in a Delay) cost a compare each. The bank itself becomes quiescent
+ *  when every instance is, so a parent Collection skips the whole bank.
+ *
+ * Timers are per instance: each distinct Timer of the definition becomes a deadline column
+ *  (shared by an FsmStartTimer and its FsmWaitUntilTimerIsComplete), and the Timer objects are not used.
+ *  Values, Conditions and Enumerators are shared unless a binder maps them to per instance objects, eg;
+ *
+ *   void* bindEnumerator(void* operand, uint16_t instance, void* context) {
+ *     return (operand == &prototypeEnumerator) ? &entities[instance].enumerator : operand;
+ *   }
+ *
+ * Only built-in FSMs can be banked; compile() fails if the definition contains a user defined FSM.
+ *  The definition tree is not updated, and (as for an FsmTable) may be deleted once compiled.
+ *
+ * A bank records no FsmTrace events and keeps no FSM_STATS counters (see FsmTrace, FsmStats).
+ */
+class FsmBank : public FsmUpdatable {
+  protected:
+    FsmTable _definition;        /**< protected variable _definition The compiled definition */
+    const FsmTableNode* _nodes;  /**< protected variable _nodes The nodes of the definition */
+    uint16_t _nodeCount;         /**< protected variable _nodeCount Number of nodes */
+    uint16_t _instanceCount;     /**< protected variable _instanceCount Number of instances */
+    FsmBankColumns* _columns;    /**< protected variable _columns Per node, its state columns (within the arrays below) */
+    byte* _flags;                /**< protected variable _flags FsmTableFlag bits, a column per node */
+    FsmIndex* _current;          /**< protected variable _current Focused child indices, a column per Sequence */
+    unsigned long* _wake;        /**< protected variable _wake Wake times, a column per State that sleeps until a time */
+    unsigned long* _deadlines;   /**< protected variable _deadlines Timer deadlines, a column per distinct Timer */
+    uint16_t _sequenceColumns;   /**< protected variable _sequenceColumns Number of focused child columns */
+    uint16_t _wakeColumns;       /**< protected variable _wakeColumns Number of wake time columns */
+    uint16_t _timerColumns;      /**< protected variable _timerColumns Number of Timer deadline columns */
+    FsmBankBinder _binder;       /**< protected variable _binder Maps operands to per instance objects, NULL to share all */
+    void* _binderContext;        /**< protected variable _binderContext Passed to _binder */
+    
+    void _clear();
+    
+    byte& _flag(uint16_t n, uint16_t i) {
+      return _columns[n].flags[i];
+    }
+    
+    FsmIndex& _currentChild(uint16_t n, uint16_t i) {
+      return _columns[n].current[i];
+    }
+    
+    unsigned long& _wakeAt(uint16_t n, uint16_t i) {
+      return _columns[n].wake[i];
+    }
+    
+    unsigned long& _deadline(uint16_t n, uint16_t i) {
+      return _columns[n].deadline[i];
+    }
+    
+    void* _operand(uint16_t n, byte k, uint16_t i) {
+      void* operand = _definition._operands[_nodes[n].operand + k];
+      
+      return _binder ? _binder(operand, i, _binderContext) : operand;
+    }
+    
+    bool _isDormant(uint16_t n, uint16_t i, unsigned long now) {
+      byte flags = _flag(n, i);
+      
+      return (flags & FSM_TABLE_QUIESCENT) &&
+        (!(flags & FSM_TABLE_WAKE_TIMED) || ((long)(now - _wakeAt(n, i)) < 0));
+    }
+    
+    void _sleep(uint16_t n, uint16_t i) {
+      _flag(n, i) = (_flag(n, i) | FSM_TABLE_QUIESCENT) & ~FSM_TABLE_WAKE_TIMED;
+    }
+    
+    void _sleepUntil(uint16_t n, uint16_t i, unsigned long wakeTime) {
+      _flag(n, i) |= FSM_TABLE_QUIESCENT | FSM_TABLE_WAKE_TIMED;
+      _wakeAt(n, i) = wakeTime;
+    }
+    
+    void _updateNode(uint16_t n, uint16_t i);
+    void _enterNode(uint16_t n, uint16_t i);
+    void _updateNodeState(uint16_t n, uint16_t i);
+    void _updateCollection(uint16_t n, uint16_t i);
+    void _stepSequence(uint16_t n, uint16_t i);
+    void _updateSequence(uint16_t n, uint16_t i);
+    void _updateTimer(uint16_t n, uint16_t i);
+    void _leaveNode(uint16_t n, uint16_t i);
+    void _forceExitNode(uint16_t n, uint16_t i);
+    unsigned long _timeToDeadline(uint16_t n, uint16_t i);
+    
+    void _request(byte op, uint16_t n, uint16_t i, FsmIndex depth, FsmIndex childInd=0);
+    void _transitionTo(uint16_t n, uint16_t i, FsmIndex childInd);
+  
+  public:
+   /**
+    * Constructor
+    */
+    FsmBank() : _nodes(NULL), _nodeCount(0), _instanceCount(0), _columns(NULL), _flags(NULL), _current(NULL), _wake(NULL), _deadlines(NULL),
+      _sequenceColumns(0), _wakeColumns(0), _timerColumns(0), _binder(NULL), _binderContext(NULL), FsmUpdatable() { }
+   
+   /**
+    * Destructor
+    */
+    ~FsmBank() {
+      _clear();
+    }
+   
+   /**
+    * flatten a definition tree, and allocate the state of its instances (all yet to be entered)
+    *
+    * @param root The top of the definition
+    * @param instanceCount Number of instances
+    * @return false if the definition contains a user defined FSM, is too large, or storage could not be allocated
+    */
+    bool compile(FsmUpdatable* root, uint16_t instanceCount);
+   
+   /**
+    * map operands of the definition to per instance objects (eg; Enumerators)
+    *  set before the first update
+    *
+    * @param binder The binder, NULL to share every operand
+    * @param context Passed to the binder
+    */
+    void setBinder(FsmBankBinder binder, void* context=NULL) {
+      _binder = binder;
+      _binderContext = context;
+    }
+   
+   /**
+    * step every instance that is not quiescent
+    */
+    virtual void update();
+   
+   /**
+    * step one instance
+    */
+    void update(uint16_t instance);
+   
+   /**
+    * force every instance to exit
+    */
+    virtual void forceExit();
+   
+   /**
+    * the earliest deadline of any instance, see FsmUpdatable::timeToDeadline()
+    */
+    virtual unsigned long timeToDeadline();
+   
+   /**
+    * end quiescence of one instance (eg; after changing a Value it depends on)
+    */
+    void wakeInstance(uint16_t instance);
+   
+   /**
+    * end quiescence of every instance
+    */
+    void wakeAll();
+   
+   /**
+    * over-ride saveState to record the state columns of every instance, see FsmSnapshot
+    */
+    virtual void saveState(FsmSnapshotWriter& writer);
+   
+   /**
+    * over-ride restoreState to restore the state columns of every instance
+    */
+    virtual void restoreState(FsmSnapshotReader& reader);
+   
+   /**
+    * get the number of instances
+    */
+    uint16_t getInstanceCount() {
+      return _instanceCount;
+    }
+   
+   /**
+    * get the number of nodes of the definition
+    */
+    uint16_t getNodeCount() {
+      return _nodeCount;
+    }
+   
+   /**
+    * get a node of the definition (its runtime state is not used, see isEntered() and getCurrentChild())
+    */
+    const FsmTableNode& getNode(uint16_t n) {
+      return _nodes[n];
+    }
+   
+   /**
+    * is a node of an instance entered
+    */
+    bool isEntered(uint16_t n, uint16_t instance) {
+      return _flag(n, instance) & FSM_TABLE_ENTERED;
+    }
+   
+   /**
+    * get the focused child of a Sequence node of an instance
+    */
+    FsmIndex getCurrentChild(uint16_t n, uint16_t instance) {
+      return _columns[n].current ? _currentChild(n, instance) : 0;
+    }
+   
+   /**
+    * get the number of bytes used by the bank
+    */
+    size_t getMemoryUsage() {
+      size_t perInstance = _nodeCount * sizeof(byte) + _sequenceColumns * sizeof(FsmIndex) +
+        (_wakeColumns + _timerColumns) * sizeof(unsigned long);
+      
+      return _definition.getMemoryUsage() + sizeof(FsmBank) - sizeof(FsmTable) +
+        _nodeCount * sizeof(FsmBankColumns) + (size_t) _instanceCount * perInstance;
+    }
+};
+
+#endif  // _FSM_BANK_H
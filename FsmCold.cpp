@@ -0,0 +1,79 @@
+#include <FsmCold.h>
+#include <stdlib.h>
+#include <string.h>
+
+// plain storage, with nothing to destroy at exit (FSMs at file scope may be destroyed after this file's statics)
+FsmColdTable::Entry* FsmColdTable::_entries = NULL;
+int FsmColdTable::_size = 0;
+int FsmColdTable::_capacity = 0;
+
+/**
+ * the index of the first entry not before fsm
+ */
+int FsmColdTable::_search(const FsmUpdatable* fsm) {
+  int low = 0;
+  int high = _size;
+
+  while (low < high) {
+    int middle = (low + high) >> 1;
+
+    if ((uintptr_t) _entries[middle].fsm < (uintptr_t) fsm) {
+      low = middle + 1;
+    }
+    else {
+      high = middle;
+    }
+  }
+
+  return low;
+}
+
+FsmColdData* FsmColdTable::find(const FsmUpdatable* fsm) {
+  int i = _search(fsm);
+
+  return ((i < _size) && (_entries[i].fsm == fsm)) ? &_entries[i].data : NULL;
+}
+
+FsmColdData* FsmColdTable::add(const FsmUpdatable* fsm) {
+  int i = _search(fsm);
+
+  if ((i == _size) || (_entries[i].fsm != fsm)) {
+    if (_size == _capacity) {
+      int capacity = (_capacity < 4) ? _capacity + 4 : _capacity + (_capacity >> 1);
+      Entry* entries = (Entry*) realloc(_entries, capacity * sizeof(Entry));
+
+      if (!entries) {
+        return NULL;
+      }
+
+      _entries = entries;
+      _capacity = capacity;
+    }
+
+    // FSMs are mostly built in address order, so this is usually at the end
+    memmove(&_entries[i + 1], &_entries[i], (_size - i) * sizeof(Entry));
+    _entries[i].fsm = fsm;
+    _size++;
+  }
+
+  memset(&_entries[i].data, 0, sizeof(FsmColdData));
+
+  return &_entries[i].data;
+}
+
+void FsmColdTable::remove(const FsmUpdatable* fsm) {
+  int i = _search(fsm);
+
+  if ((i == _size) || (_entries[i].fsm != fsm)) {
+    return;
+  }
+
+  _size--;
+  memmove(&_entries[i], &_entries[i + 1], (_size - i) * sizeof(Entry));
+
+  if (!_size) {
+    free(_entries);
+    _entries = NULL;
+    _capacity = 0;
+  }
+}
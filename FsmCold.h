@@ -0,0 +1,78 @@
+/** @file FsmCold.h
+  *  Copyright (c) 2016 Ozbotics
+  *  Distributed under the MIT license (see LICENSE)
+  */
+#ifndef _FSM_COLD_H
+ #define _FSM_COLD_H
+
+#include <Arduino.h>
+
+#include "FsmConfig.h"
+
+class FsmUpdatable;
+
+/**
+ * The data of an FSM that update() never reads, used only while a tree is built, resolve()d or inspected
+ */
+struct FsmColdData {
+  const char* name;         /**< the FSM's name (see FsmUpdatable::setName()) */
+  const char* branchName;   /**< the name of the sibling to branch to, resolved to an index (eg; FsmBranchOnConditionFalse::setBranchName()) */
+  FsmIndex* nameSlots;      /**< open addressed hash of the children's names to indices, built by FsmCollection::resolve() */
+  uint16_t nameSlotCount;   /**< number of nameSlots (a power of 2), 0 if not built */
+};
+
+/**
+ * Holds the FsmColdData of the FSMs that have any, beside the tree rather than in every node
+ *
+ * A node then holds only what update() reads, and most nodes (unnamed, and not branching by name) have no entry:
+ *  FSM_FLAG_COLD marks those that do, so asking any other FSM for its name costs a test of its flags.
+ *  Entries are kept sorted by FSM, and found by binary search.
+ *
+ * The entries come from the heap, as the table may out-live an FsmArena the FSMs are built in.
+ *  An FSM removes its entry as it is destroyed; the entry of one released with its arena (without its destructor)
+ *  is reused by the next FSM named at the same address. Build machines from one thread at a time.
+ */
+class FsmColdTable {
+  protected:
+    struct Entry {
+      const FsmUpdatable* fsm;  /**< the FSM */
+      FsmColdData data;         /**< its cold data */
+    };
+
+    static Entry* _entries;     /**< protected variable _entries The entries, sorted by fsm (NULL when empty) */
+    static int _size;           /**< protected variable _size Number of entries */
+    static int _capacity;       /**< protected variable _capacity Number of entries that fit without growing */
+
+    static int _search(const FsmUpdatable* fsm);
+
+  public:
+   /**
+    * get the entry of an FSM
+    *  the pointer is valid until an entry is added or removed
+    *
+    * @return NULL if the FSM has none
+    */
+    static FsmColdData* find(const FsmUpdatable* fsm);
+
+   /**
+    * add a cleared entry for an FSM (clearing the one it has, if any)
+    *  the pointer is valid until an entry is added or removed
+    *
+    * @return NULL if the table could not grow
+    */
+    static FsmColdData* add(const FsmUpdatable* fsm);
+
+   /**
+    * remove the entry of an FSM (if any)
+    */
+    static void remove(const FsmUpdatable* fsm);
+
+   /**
+    * get the number of entries (and so the memory used: size() * (sizeof(FsmColdData) + a pointer))
+    */
+    static int size() {
+      return _size;
+    }
+};
+
+#endif  // _FSM_COLD_H
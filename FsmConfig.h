@@ -0,0 +1,103 @@
+/** @file FsmConfig.h 
+  *  Copyright (c) 2016 Ozbotics 
+  *  Distributed under the MIT license (see LICENSE)
+  *
+  *  Compile time configuration of the FSM library
+  *   define these as global compiler flags (eg; -DFSM_INDEX_TYPE=uint32_t), so that the library's own .cpp files
+  *   are built with them too. A #define in a sketch, before including FSM.h, does not reach the library sources,
+  *   which the Arduino IDE compiles separately: use build flags instead, eg; compiler.cpp.extra_flags in platform.local.txt,
+  *   --build-property with arduino-cli, or build_flags with PlatformIO.
+  *
+  *   FSM_INDEX_TYPE, FSM_TRACE and FSM_STATS change the layout of the classes; a sketch built with settings
+  *   other than the library's fails to link (see FsmLayout), rather than running with mismatched classes.
+  */ 
+#ifndef _FSM_CONFIG_H
+ #define _FSM_CONFIG_H
+
+#include <stdint.h>
+
+/**
+ * the unsigned type of child indices and transition depths
+ *  its maximum value is reserved (FSM_INDEX_NONE), so a Collection holds at most FSM_INDEX_NONE children
+ *
+ * 8 bits on AVR (at most 254 children per Collection, as before), 16 bits elsewhere
+ */
+#ifndef FSM_INDEX_TYPE
+ #if defined(__AVR__)
+  #define FSM_INDEX_TYPE uint8_t
+ #else
+  #define FSM_INDEX_TYPE uint16_t
+ #endif
+#endif
+
+typedef FSM_INDEX_TYPE FsmIndex;
+
+#define FSM_INDEX_NONE ((FsmIndex) -1)  /**< no index (eg; addChild() failed) */
+
+/**
+ * Names the settings that change the layout of the classes, see FsmLayout
+ */
+template <int IndexSize, bool Trace, bool Stats> struct FsmLayoutTag { };
+
+/**
+ * define FSM_TRACE to record State events (enter, exit, transition requests, forceExit) in the FsmTrace ring buffer
+ *  every FSM then carries a 16 bit traceId; without FSM_TRACE the hooks compile to nothing
+ */
+//#define FSM_TRACE
+
+/**
+ * the clock used to timestamp trace events (32 bits, wrapping)
+ */
+#ifndef FSM_TRACE_CLOCK
+ #define FSM_TRACE_CLOCK() micros()
+#endif
+
+/**
+ * define FSM_STATS to count each FsmState's enters and updates, and time its updates and visits (see FsmStats)
+ *  without FSM_STATS the States carry no counters and update() is unchanged
+ */
+//#define FSM_STATS
+
+/**
+ * the clock used to time States (wrapping)
+ */
+#ifndef FSM_STATS_CLOCK
+ #define FSM_STATS_CLOCK() micros()
+#endif
+
+/**
+ * the default number of States a Sequence may enter in one update (see FsmSequence::setMicrosteps())
+ *  1 enters a State's successor on the following update; more run transient States (eg; FsmStartTimer, FsmFinish)
+ *  to completion within the update
+ */
+#ifndef FSM_MICROSTEPS
+ #define FSM_MICROSTEPS 1
+#endif
+
+/**
+ * the default number of items an FsmForEach may process in one update (see FsmForEach::setBatch())
+ */
+#ifndef FSM_FOR_EACH_BATCH
+ #define FSM_FOR_EACH_BATCH 8
+#endif
+
+/**
+ * The layout this translation unit is built with
+ *  FsmUpdatable's constructor passes it to a function that FSM.cpp defines only for the library's own layout,
+ *  so that mixing settings is a link error (an undefined FsmUpdatable::_checkLayout(FsmLayoutTag<...>))
+ */
+#ifdef FSM_TRACE
+ #define FSM_LAYOUT_TRACE true
+#else
+ #define FSM_LAYOUT_TRACE false
+#endif
+
+#ifdef FSM_STATS
+ #define FSM_LAYOUT_STATS true
+#else
+ #define FSM_LAYOUT_STATS false
+#endif
+
+typedef FsmLayoutTag<sizeof(FsmIndex), FSM_LAYOUT_TRACE, FSM_LAYOUT_STATS> FsmLayout;
+
+#endif  // _FSM_CONFIG_H
@@ -0,0 +1,168 @@
+#include <FsmCoroutine.h>
+
+#if !defined(ARDUINO) && defined(__cpp_impl_coroutine)
+
+#include <stddef.h>
+#include <stdlib.h>
+
+// the header before each frame, sized to keep frames aligned
+#define FSM_COROUTINE_HEADER (((sizeof(FsmCoroutinePool::Block) + alignof(max_align_t) - 1) / alignof(max_align_t)) * alignof(max_align_t))
+
+thread_local FsmCoroutinePool::Block* FsmCoroutinePool::_free = NULL;
+
+void* FsmCoroutinePool::allocate(size_t size) {
+  // first fit, but not a block more than twice the size (frames of one script are all the same size)
+  for (Block** block = &_free; *block; block = &(*block)->next) {
+    if (((*block)->size >= size) && ((*block)->size <= 2 * size)) {
+      Block* found = *block;
+      *block = found->next;
+      
+      return (char*) found + FSM_COROUTINE_HEADER;
+    }
+  }
+  
+  Block* block = (Block*) malloc(FSM_COROUTINE_HEADER + size);
+  if (!block) {
+    return NULL;
+  }
+  
+  block->size = size;
+  
+  return (char*) block + FSM_COROUTINE_HEADER;
+}
+
+void FsmCoroutinePool::release(void* p) {
+  if (!p) {
+    return;
+  }
+  
+  Block* block = (Block*)((char*) p - FSM_COROUTINE_HEADER);
+  block->next = _free;
+  _free = block;
+}
+
+void FsmCoroutinePool::clear() {
+  while (_free) {
+    Block* block = _free;
+    _free = block->next;
+    
+    free(block);
+  }
+}
+
+size_t FsmCoroutinePool::getFreeCount() {
+  size_t count = 0;
+  
+  for (Block* block = _free; block; block = block->next) {
+    count++;
+  }
+  
+  return count;
+}
+
+
+void FsmCoroutineState::_destroy() {
+  if (_handle) {
+    _handle.destroy();
+    _handle = NULL;
+  }
+  
+  _wait = FSM_COROUTINE_DONE;
+}
+
+void FsmCoroutineState::_enterState() {
+  _destroy();
+  _handle = _run().handle;
+  
+  // no frame: nothing to run
+  if (!_handle) {
+    _transitionAncestorToNext(1);
+    return;
+  }
+  
+  _wait = FSM_COROUTINE_UPDATE;
+}
+
+void FsmCoroutineState::_resume() {
+  _wait = FSM_COROUTINE_DONE;
+  _handle.resume();
+  
+  if (_handle.done()) {
+    _destroy();
+    
+    // unless the script made a transition of its own
+    if (!(_flags & FSM_FLAG_LEAVING)) {
+      _transitionAncestorToNext(1);
+    }
+  }
+}
+
+void FsmCoroutineState::_updateState() {
+  switch (_wait) {
+    case FSM_COROUTINE_UPDATE:
+      break;
+      
+    case FSM_COROUTINE_DELAY:
+      if (!_timer.isComplete()) {
+        _sleepFor(_timeUntil(_wakeTime));
+        return;
+      }
+      break;
+      
+    case FSM_COROUTINE_UNTIL:
+      if (!_condition->getValue()) {
+        return;
+      }
+      break;
+      
+    case FSM_COROUTINE_EVENT:
+      _sleep();
+      return;
+      
+    default:
+      return;
+  }
+  
+  _resume();
+  
+  // sleep straight away if the script now waits for time or an event
+  if (_wait == FSM_COROUTINE_DELAY) {
+    _sleepFor(_timeUntil(_wakeTime));
+  }
+  else if (_wait == FSM_COROUTINE_EVENT) {
+    _sleep();
+  }
+}
+
+void FsmCoroutineState::_onEvent(const FsmEvent& event) {
+  if ((_wait != FSM_COROUTINE_EVENT) || (event.id != _event.id)) {
+    return;
+  }
+  
+  _event = event;
+  _resume();
+}
+
+unsigned long FsmCoroutineState::_timeToDeadline() {
+  switch (_wait) {
+    case FSM_COROUTINE_DELAY:
+      return _timeUntil(_wakeTime);
+      
+    case FSM_COROUTINE_EVENT:
+    case FSM_COROUTINE_DONE:
+      return FSM_NO_DEADLINE;
+  }
+  
+  return 0;
+}
+
+void FsmCoroutineState::restoreState(FsmSnapshotReader& reader) {
+  FsmState::restoreState(reader);
+  
+  // the script restarts on the next update (so the ancestors, restored asleep, must be woken)
+  _destroy();
+  _flags &= ~FSM_FLAG_ENTERED;
+  wake();
+}
+
+#endif  // ARDUINO, __cpp_impl_coroutine
@@ -0,0 +1,308 @@
+/** @file FsmCoroutine.h
+  *  Copyright (c) 2016 Ozbotics
+  *  Distributed under the MIT license (see LICENSE)
+  */
+#ifndef _FSM_COROUTINE_H
+ #define _FSM_COROUTINE_H
+
+#if !defined(ARDUINO) && defined(__cpp_impl_coroutine)
+
+#include <FSM.h>
+
+#include <coroutine>
+
+/**
+ * Recycles coroutine frames, so that re-entering a coroutine State does not allocate
+ *
+ * Frames come from the heap and go back to a free list when the script ends, to be reused by the next frame that fits,
+ *  so a State re-entered in a loop allocates once. (Not from an FsmArena: a pooled frame could out-live its arena's reset().)
+ *  Each thread has its own free list.
+ */
+class FsmCoroutinePool {
+  protected:
+    struct Block {
+      Block* next;   /**< next free block */
+      size_t size;   /**< bytes available after the header */
+    };
+
+    static thread_local Block* _free;  /**< protected variable _free This thread's free blocks */
+
+  public:
+   /**
+    * allocate a frame, reusing a free block if one fits
+    *
+    * @return NULL if memory is exhausted
+    */
+    static void* allocate(size_t size);
+
+   /**
+    * return a frame to this thread's free list
+    */
+    static void release(void* p);
+
+   /**
+    * free this thread's free blocks
+    */
+    static void clear();
+
+   /**
+    * get the number of blocks in this thread's free list
+    */
+    static size_t getFreeCount();
+};
+
+/**
+ * What a coroutine State's script is suspended on
+ */
+enum FsmCoroutineWait {
+  FSM_COROUTINE_UPDATE,  /**< the next update (next()), or the first */
+  FSM_COROUTINE_DELAY,   /**< the timer (delay()) */
+  FSM_COROUTINE_UNTIL,   /**< the condition becoming true (until()) */
+  FSM_COROUTINE_EVENT,   /**< the event being dispatched (event()) */
+  FSM_COROUTINE_DONE     /**< nothing: the script has ended (or has no frame) */
+};
+
+/* --------------------------------------------------------------------------------------- */
+
+/**
+ * A State whose behaviour is a C++20 coroutine, the script
+ *
+ * Derived classes implement _run(), which co_awaits delay(), until(), event() and next() to suspend the State,
+ *  and is resumed in place when what it waits for happens. Steps that need not wait run straight on in the same update.
+ *  When the script returns, the State transitions to the next; a script may also make any transition itself, eg;
+ *  _transitionAncestorTo(), then co_return.
+ *
+ *   class Blink : public FsmCoroutineState {
+ *     protected:
+ *       virtual Script _run() {
+ *         for (int i=0; i<3; i++) {
+ *           Serial.println(F("on"));
+ *           co_await delay(1000);
+ *           co_await until(&ready);
+ *         }
+ *       }
+ *   };
+ *
+ * The frame is created when the State is entered and destroyed when it leaves (or is forced to exit);
+ *  frames come from FsmCoroutinePool. While waiting on delay() the State is quiescent until the timer is due,
+ *  and while waiting on event() until the event is dispatched (list the events the script may await in the constructor,
+ *  for FsmEventDispatcher::build()). until() polls, like FsmSelectStateFromCondition.
+ *
+ * A coroutine's position cannot be saved: a snapshot restores the State as not yet entered, so the script restarts.
+ */
+class FsmCoroutineState : public FsmState {
+  public:
+   /**
+    * The return type of a script (the coroutine's handle)
+    */
+    class Script {
+      public:
+        struct promise_type {
+          Script get_return_object() {
+            return Script(std::coroutine_handle<promise_type>::from_promise(*this));
+          }
+
+          static Script get_return_object_on_allocation_failure() {
+            return Script(std::coroutine_handle<promise_type>());
+          }
+
+          std::suspend_always initial_suspend() noexcept { return {}; }
+          std::suspend_always final_suspend() noexcept { return {}; }
+          void return_void() { }
+          void unhandled_exception() { throw; }
+
+          static void* operator new(size_t size) noexcept {
+            return FsmCoroutinePool::allocate(size);
+          }
+
+          static void operator delete(void* p) {
+            FsmCoroutinePool::release(p);
+          }
+        };
+
+        std::coroutine_handle<promise_type> handle;  /**< public variable handle The frame, NULL if it could not be allocated */
+
+        Script(std::coroutine_handle<promise_type> h) : handle(h) { }
+    };
+
+   /**
+    * Awaited by delay(): suspends until the timer is complete
+    */
+    struct DelayAwaiter {
+      FsmCoroutineState* state;
+      Duration duration;
+
+      bool await_ready() { return duration == 0; }
+      void await_suspend(std::coroutine_handle<>) { state->_timer.start(duration); state->_sleepFor(duration); state->_wait = FSM_COROUTINE_DELAY; }
+      void await_resume() { }
+    };
+
+   /**
+    * Awaited by until(): suspends until the condition is true
+    */
+    struct UntilAwaiter {
+      FsmCoroutineState* state;
+      Value<bool>* condition;
+
+      bool await_ready() { return condition->getValue(); }
+      void await_suspend(std::coroutine_handle<>) { state->_condition = condition; state->_wait = FSM_COROUTINE_UNTIL; }
+      void await_resume() { }
+    };
+
+   /**
+    * Awaited by event(): suspends until the event is dispatched, which it returns
+    */
+    struct EventAwaiter {
+      FsmCoroutineState* state;
+      FsmEventId eventId;
+
+      bool await_ready() { return false; }
+      void await_suspend(std::coroutine_handle<>) { state->_event.id = eventId; state->_wait = FSM_COROUTINE_EVENT; }
+      FsmEvent await_resume() { return state->_event; }
+    };
+
+   /**
+    * Awaited by next(): suspends until the next update
+    */
+    struct NextAwaiter {
+      FsmCoroutineState* state;
+
+      bool await_ready() { return false; }
+      void await_suspend(std::coroutine_handle<>) { state->_wait = FSM_COROUTINE_UPDATE; }
+      void await_resume() { }
+    };
+
+  protected:
+    std::coroutine_handle<Script::promise_type> _handle;  /**< protected variable _handle The script's frame, NULL while not entered */
+    byte _wait;                      /**< protected variable _wait The FsmCoroutineWait the script is suspended on */
+    Timer _timer;                    /**< protected variable _timer Counts down delay() (sleeping till its deadline, held in _wakeTime) */
+    Value<bool>* _condition;         /**< protected variable _condition Awaited by until() */
+    FsmEvent _event;                 /**< protected variable _event The event awaited by event(), then the one dispatched */
+    const FsmEventId* _events;       /**< protected variable _events The events the script may await */
+    FsmIndex _eventCount;            /**< protected variable _eventCount Number of _events */
+
+   /**
+    * implement this: the script
+    */
+    virtual Script _run() = 0;
+
+   /**
+    * resume the script, then transition to the next State if it has ended
+    */
+    void _resume();
+
+   /**
+    * destroy the script's frame
+    */
+    void _destroy();
+
+   /**
+    * over-ride _enterState to start the script (which runs from the first update)
+    */
+    virtual void _enterState();
+
+   /**
+    * over-ride _updateState to resume the script when what it waits for has happened
+    */
+    virtual void _updateState();
+
+   /**
+    * over-ride _leaveState to destroy the frame (leaving _exitState() to derived classes)
+    */
+    virtual void _leaveState() {
+      FsmState::_leaveState();
+      _destroy();
+    }
+
+   /**
+    * over-ride _onEvent to resume a script waiting on the event
+    */
+    virtual void _onEvent(const FsmEvent& event);
+
+   /**
+    * over-ride _timeToDeadline to report the timer while waiting on delay()
+    */
+    virtual unsigned long _timeToDeadline();
+
+   /**
+    * suspend the script for the specified duration
+    *
+    * @param duration Milliseconds
+    */
+    DelayAwaiter delay(Duration duration) {
+      return DelayAwaiter { this, duration };
+    }
+
+   /**
+    * suspend the script for the duration held by a Value
+    */
+    DelayAwaiter delay(Value<Duration>* durationValue) {
+      return DelayAwaiter { this, durationValue->getValue() };
+    }
+
+   /**
+    * suspend the script until the condition is true (checked on each update)
+    */
+    UntilAwaiter until(Value<bool>* condition) {
+      return UntilAwaiter { this, condition };
+    }
+
+   /**
+    * suspend the script until the event is dispatched
+    *  the event must be one of those given to the constructor
+    *
+    * @return (from co_await) the event
+    */
+    EventAwaiter event(FsmEventId eventId) {
+      return EventAwaiter { this, eventId };
+    }
+
+   /**
+    * suspend the script until the next update
+    */
+    NextAwaiter next() {
+      return NextAwaiter { this };
+    }
+
+  public:
+   /**
+    * Constructor
+    *
+    * @param events The events the script may await (must out-live the State), see getEvents()
+    * @param eventCount Number of events
+    */
+    FsmCoroutineState(const FsmEventId* events=NULL, FsmIndex eventCount=0) :
+      _handle(), _wait(FSM_COROUTINE_DONE), _condition(NULL), _events(events), _eventCount(eventCount), FsmState() {
+      _event.id = 0;
+      _event.value = 0;
+      _event.data = NULL;
+    }
+
+   /**
+    * Destructor
+    */
+    ~FsmCoroutineState() {
+      _destroy();
+    }
+
+    virtual const FsmEventId* getEvents(FsmIndex& count) {
+      count = _eventCount;
+      return _events;
+    }
+
+   /**
+    * over-ride restoreState: the script's position is not saved, so the State restarts it
+    */
+    virtual void restoreState(FsmSnapshotReader& reader);
+
+   /**
+    * get the FsmCoroutineWait the script is suspended on
+    */
+    byte getWait() {
+      return _wait;
+    }
+};
+
+#endif  // ARDUINO, __cpp_impl_coroutine
+
+#endif  // _FSM_COROUTINE_H
@@ -0,0 +1,181 @@
+#include <FsmEvent.h>
+#include <FSM.h>
+
+FsmEventQueue::FsmEventQueue(FsmIndex capacity) : _head(0), _tail(0), _dropped(0), _ownsBuffer(true) {
+  _setCapacity(capacity);
+  _events = (FsmEvent*) malloc((_mask + 1) * sizeof(FsmEvent));
+
+  if (!_events) {
+    _mask = 0;
+  }
+}
+
+FsmEventQueue::FsmEventQueue(FsmEvent* buffer, FsmIndex capacity) : _events(buffer), _head(0), _tail(0), _dropped(0), _ownsBuffer(false) {
+  _setCapacity(capacity);
+}
+
+FsmEventQueue::~FsmEventQueue() {
+  if (_ownsBuffer) {
+    free(_events);
+  }
+}
+
+void FsmEventQueue::_setCapacity(FsmIndex capacity) {
+  // the wrapping counters tell full from empty only up to half their range
+  FsmIndex limit = (FsmIndex)(FSM_INDEX_NONE / 2 + 1);
+  FsmIndex size = 1;
+
+  while ((size <= capacity / 2) && (size < limit)) {
+    size *= 2;
+  }
+
+  _mask = size - 1;
+}
+
+bool FsmEventQueue::post(const FsmEvent& event) {
+  FsmIndex head = _head;
+
+  if (!_events || ((FsmIndex)(head - _tail) > _mask)) {
+    _dropped++;
+    return false;
+  }
+
+  _events[head & _mask] = event;
+
+#if !defined(__AVR__)
+  __atomic_store_n(&_head, (FsmIndex)(head + 1), __ATOMIC_RELEASE);
+#else
+  _head = head + 1;
+#endif
+
+  return true;
+}
+
+bool FsmEventQueue::pop(FsmEvent& event) {
+  FsmIndex tail = _tail;
+
+#if !defined(__AVR__)
+  FsmIndex head = __atomic_load_n(&_head, __ATOMIC_ACQUIRE);
+#else
+  FsmIndex head = _head;
+#endif
+
+  if (head == tail) {
+    return false;
+  }
+
+  event = _events[tail & _mask];
+
+#if !defined(__AVR__)
+  __atomic_store_n(&_tail, (FsmIndex)(tail + 1), __ATOMIC_RELEASE);
+#else
+  _tail = tail + 1;
+#endif
+
+  return true;
+}
+
+
+static int _compareSubscriptions(const void* a, const void* b) {
+  const FsmEventSubscription* first = (const FsmEventSubscription*) a;
+  const FsmEventSubscription* second = (const FsmEventSubscription*) b;
+
+  if (first->id != second->id) {
+    return (first->id < second->id) ? -1 : 1;
+  }
+
+  return (first->order < second->order) ? -1 : ((first->order > second->order) ? 1 : 0);
+}
+
+uint16_t FsmEventDispatcher::_collect(FsmUpdatable* fsm, uint16_t count) {
+  FsmState* state = fsm->asState();
+
+  if (state) {
+    FsmIndex eventCount;
+    const FsmEventId* events = state->getEvents(eventCount);
+
+    for (FsmIndex e=0; e<eventCount; e++) {
+      if (_subscriptions) {
+        FsmEventSubscription& subscription = _subscriptions[count];
+
+        subscription.id = events[e];
+        subscription.order = count;
+        subscription.state = state;
+      }
+
+      count++;
+    }
+  }
+
+  FsmCollection* collection = fsm->asCollection();
+  if (collection) {
+    for (FsmIndex i=0; i<collection->getChildCount(); i++) {
+      count = _collect(collection->getChild(i), count);
+    }
+  }
+
+  return count;
+}
+
+bool FsmEventDispatcher::build(FsmUpdatable* root) {
+  free(_subscriptions);
+  _subscriptions = NULL;
+
+  // count, then fill
+  _subscriptionCount = _collect(root, 0);
+
+  if (!_subscriptionCount) {
+    return true;
+  }
+
+  _subscriptions = (FsmEventSubscription*) malloc(_subscriptionCount * sizeof(FsmEventSubscription));
+
+  if (!_subscriptions) {
+    _subscriptionCount = 0;
+    return false;
+  }
+
+  _collect(root, 0);
+  qsort(_subscriptions, _subscriptionCount, sizeof(FsmEventSubscription), _compareSubscriptions);
+
+  return true;
+}
+
+unsigned int FsmEventDispatcher::dispatch() {
+  unsigned int count = 0;
+  FsmEvent event;
+
+  while (_queue.pop(event)) {
+    dispatch(event);
+    count++;
+  }
+
+  return count;
+}
+
+unsigned int FsmEventDispatcher::dispatch(const FsmEvent& event) {
+  // the first entry for the id
+  uint16_t low = 0;
+  uint16_t high = _subscriptionCount;
+
+  while (low < high) {
+    uint16_t middle = low + (high - low) / 2;
+
+    if (_subscriptions[middle].id < event.id) {
+      low = middle + 1;
+    }
+    else {
+      high = middle;
+    }
+  }
+
+  unsigned int handled = 0;
+
+  for (uint16_t s = low; (s < _subscriptionCount) && (_subscriptions[s].id == event.id); s++) {
+    if (_subscriptions[s].state->dispatch(event)) {
+      handled++;
+    }
+  }
+
+  return handled;
+}
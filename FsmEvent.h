@@ -0,0 +1,209 @@
+/** @file FsmEvent.h
+  *  Copyright (c) 2016 Ozbotics
+  *  Distributed under the MIT license (see LICENSE)
+  */
+#ifndef _FSM_EVENT_H
+ #define _FSM_EVENT_H
+
+#include <Arduino.h>
+
+#include "FsmConfig.h"
+
+class FsmUpdatable;
+class FsmState;
+
+typedef uint16_t FsmEventId;  /**< identifies a kind of event, application defined */
+
+/**
+ * An event, posted to an FsmEventQueue and dispatched to the States that react to its id
+ */
+struct FsmEvent {
+  FsmEventId id;  /**< what happened */
+  long value;     /**< an optional value, eg; a reading */
+  void* data;     /**< optional data, which must out-live the dispatch */
+};
+
+/**
+ * A fixed size queue of events
+ *
+ * Safe for one poster and one dispatcher: eg; post from an interrupt (or another thread on hosts), dispatch from loop().
+ *  The capacity is rounded down to a power of 2, at most half the range of FsmIndex (128 on AVR).
+ */
+class FsmEventQueue {
+  protected:
+    FsmEvent* _events;       /**< protected variable _events The ring buffer */
+    FsmIndex _mask;          /**< protected variable _mask Capacity - 1 */
+    volatile FsmIndex _head; /**< protected variable _head Events posted (wrapping) */
+    volatile FsmIndex _tail; /**< protected variable _tail Events popped (wrapping) */
+    unsigned long _dropped;  /**< protected variable _dropped Events posted while the queue was full */
+    bool _ownsBuffer;        /**< protected variable _ownsBuffer The buffer was malloc()ed by the queue */
+
+    void _setCapacity(FsmIndex capacity);
+
+  public:
+   /**
+    * Constructor
+    *  allocates the buffer from the heap
+    *
+    * @param capacity Number of events
+    */
+    FsmEventQueue(FsmIndex capacity);
+
+   /**
+    * Constructor
+    *  uses a buffer provided by the caller, which must out-live the queue
+    *
+    * @param buffer Storage for the events
+    * @param capacity Number of events in buffer
+    */
+    FsmEventQueue(FsmEvent* buffer, FsmIndex capacity);
+
+   /**
+    * Destructor
+    */
+    ~FsmEventQueue();
+
+   /**
+    * add an event to the queue
+    *
+    * @return false if the queue is full (the event is dropped and counted)
+    */
+    bool post(const FsmEvent& event);
+
+   /**
+    * add an event to the queue
+    *
+    * @param id What happened
+    * @param value An optional value
+    * @param data Optional data
+    * @return false if the queue is full
+    */
+    bool post(FsmEventId id, long value=0, void* data=NULL) {
+      FsmEvent event = { id, value, data };
+
+      return post(event);
+    }
+
+   /**
+    * take the oldest event from the queue
+    *
+    * @param event Filled in with the event
+    * @return false if the queue is empty
+    */
+    bool pop(FsmEvent& event);
+
+   /**
+    * is the queue empty
+    */
+    bool isEmpty() {
+      return _head == _tail;
+    }
+
+   /**
+    * get the number of events that could not be posted
+    */
+    unsigned long getDropped() {
+      return _dropped;
+    }
+};
+
+/**
+ * One entry of an FsmEventDispatcher's lookup table
+ */
+struct FsmEventSubscription {
+  FsmEventId id;     /**< the event id */
+  uint16_t order;    /**< position of the State in the tree (depth first), so that States are reached in tree order */
+  FsmState* state;   /**< a State that reacts to id */
+};
+
+/**
+ * Delivers events to the States of a machine that react to them
+ *
+ * build() walks the machine once and records which States react to which event ids (see FsmState::getEvents()),
+ *  in a table sorted by id. Dispatching an event looks its id up in the table and reaches only those States,
+ *  and of those only the ones that are entered (ie; active). A State's _onEvent() typically makes a transition request,
+ *  which is completed immediately (see FsmState::dispatch()); the next update() then enters the new State.
+ *
+ * Posted events wait in the queue until dispatch(), eg; in loop():
+ *   events.dispatch();
+ *   root.update();
+ */
+class FsmEventDispatcher {
+  protected:
+    FsmEventQueue _queue;                   /**< protected variable _queue Posted events */
+    FsmEventSubscription* _subscriptions;   /**< protected variable _subscriptions The lookup table, sorted by id */
+    uint16_t _subscriptionCount;            /**< protected variable _subscriptionCount Number of entries */
+
+    uint16_t _collect(FsmUpdatable* fsm, uint16_t count);
+
+  public:
+   /**
+    * Constructor
+    *
+    * @param queueCapacity Number of events the queue holds
+    */
+    FsmEventDispatcher(FsmIndex queueCapacity) : _queue(queueCapacity), _subscriptions(NULL), _subscriptionCount(0) { }
+
+   /**
+    * Constructor
+    *
+    * @param buffer Storage for the queue, which must out-live the dispatcher
+    * @param queueCapacity Number of events in buffer
+    */
+    FsmEventDispatcher(FsmEvent* buffer, FsmIndex queueCapacity) : _queue(buffer, queueCapacity), _subscriptions(NULL), _subscriptionCount(0) { }
+
+   /**
+    * Destructor
+    */
+    ~FsmEventDispatcher() {
+      free(_subscriptions);
+    }
+
+   /**
+    * build the lookup table for a machine
+    *  call once the tree is complete (eg; after resolve()), and again if it changes
+    *
+    * @param root The top of the machine
+    * @return false if the table could not be allocated
+    */
+    bool build(FsmUpdatable* root);
+
+   /**
+    * queue an event for dispatch()
+    *
+    * @return false if the queue is full
+    */
+    bool post(FsmEventId id, long value=0, void* data=NULL) {
+      return _queue.post(id, value, data);
+    }
+
+   /**
+    * deliver all queued events, oldest first
+    *
+    * @return the number of events delivered
+    */
+    unsigned int dispatch();
+
+   /**
+    * deliver an event now, bypassing the queue
+    *
+    * @return the number of States that handled it
+    */
+    unsigned int dispatch(const FsmEvent& event);
+
+   /**
+    * get the queue (eg; to post from an interrupt handler)
+    */
+    FsmEventQueue& getQueue() {
+      return _queue;
+    }
+
+   /**
+    * get the number of (event id, State) entries in the lookup table
+    */
+    uint16_t getSubscriptionCount() {
+      return _subscriptionCount;
+    }
+};
+
+#endif  // _FSM_EVENT_H
@@ -0,0 +1,606 @@
+#include <FsmLoader.h>
+#include <string.h>
+
+/*
+ * binary definition: "FSD", version, FSM count (2), then per FSM (depth first):
+ *   op, depth, child count (2), index (2), number (2), then name, operand1 & operand2 as (length, bytes)
+ */
+
+#define FSM_LOADER_HEADER_SIZE 6
+#define FSM_LOADER_NO_INDEX 0xFFFF   // index of a record, when none was given
+
+/**
+ * What a kind's line holds after the kind
+ */
+enum FsmLoaderArgs {
+  FSM_LOADER_ARGS_NONE,          /**< only bindings */
+  FSM_LOADER_ARGS_START,         /**< bindings, then an optional index */
+  FSM_LOADER_ARGS_BRANCH,        /**< bindings, then an index or a sibling name */
+  FSM_LOADER_ARGS_TEXT,          /**< the rest of the line */
+  FSM_LOADER_ARGS_EVENT          /**< an event id, then an optional index */
+};
+
+struct FsmLoaderSyntax {
+  const char* keyword;  /**< the kind, as written */
+  byte op;              /**< the FsmLoaderOp */
+  byte bindings;        /**< number of bound objects named */
+  byte args;            /**< the FsmLoaderArgs */
+  bool parent;          /**< may have children */
+};
+
+static const FsmLoaderSyntax _syntax[] = {
+  { "collection",                FSM_LOADER_COLLECTION,                0, FSM_LOADER_ARGS_NONE,   true },
+  { "sequence",                  FSM_LOADER_SEQUENCE,                  0, FSM_LOADER_ARGS_START,  true },
+  { "select",                    FSM_LOADER_SELECT,                    1, FSM_LOADER_ARGS_NONE,   true },
+  { "select_watched",            FSM_LOADER_SELECT_WATCHED,            1, FSM_LOADER_ARGS_NONE,   true },
+  { "delay",                     FSM_LOADER_DELAY,                     1, FSM_LOADER_ARGS_NONE,   false },
+  { "start_timer",               FSM_LOADER_START_TIMER,               2, FSM_LOADER_ARGS_NONE,   false },
+  { "wait_timer",                FSM_LOADER_WAIT_TIMER,                1, FSM_LOADER_ARGS_NONE,   false },
+  { "finish",                    FSM_LOADER_FINISH,                    0, FSM_LOADER_ARGS_NONE,   false },
+  { "branch_on_end_of_list",     FSM_LOADER_BRANCH_ON_END_OF_LIST,     1, FSM_LOADER_ARGS_BRANCH, false },
+  { "finish_on_end_of_list",     FSM_LOADER_FINISH_ON_END_OF_LIST,     1, FSM_LOADER_ARGS_NONE,   false },
+  { "branch_on_condition_false", FSM_LOADER_BRANCH_ON_CONDITION_FALSE, 1, FSM_LOADER_ARGS_BRANCH, false },
+  { "assign_condition",          FSM_LOADER_ASSIGN_CONDITION,          2, FSM_LOADER_ARGS_NONE,   false },
+  { "debug_print",               FSM_LOADER_DEBUG_PRINT,               0, FSM_LOADER_ARGS_TEXT,   false },
+  { "idle",                      FSM_LOADER_IDLE,                      0, FSM_LOADER_ARGS_NONE,   false },
+  { "debug_state",               FSM_LOADER_DEBUG_STATE,               0, FSM_LOADER_ARGS_TEXT,   false },
+  { "wait_for_event",            FSM_LOADER_WAIT_FOR_EVENT,            0, FSM_LOADER_ARGS_EVENT,  false },
+  { "user",                      FSM_LOADER_USER,                      1, FSM_LOADER_ARGS_NONE,   true }
+};
+
+/**
+ * A piece of a line (not terminated)
+ */
+struct FsmLoaderToken {
+  const char* str;
+  size_t length;
+};
+
+static bool _isSpace(char c) {
+  return (c == ' ') || (c == '\t') || (c == '\r');
+}
+
+static bool _isEnd(char c) {
+  return (c == '\0') || (c == '\n');
+}
+
+/**
+ * take the next whitespace separated token, stopping at the end of the line or a comment
+ *
+ * @return false if there is none
+ */
+static bool _nextToken(const char*& p, FsmLoaderToken& token) {
+  while (_isSpace(*p)) {
+    p++;
+  }
+
+  if (_isEnd(*p) || (*p == '#')) {
+    return false;
+  }
+
+  token.str = p;
+  while (!_isEnd(*p) && !_isSpace(*p)) {
+    p++;
+  }
+  token.length = p - token.str;
+
+  return true;
+}
+
+/**
+ * take the rest of the line, without surrounding whitespace
+ */
+static void _restOfLine(const char*& p, FsmLoaderToken& token) {
+  while (_isSpace(*p)) {
+    p++;
+  }
+
+  token.str = p;
+  while (!_isEnd(*p)) {
+    p++;
+  }
+
+  token.length = p - token.str;
+  while (token.length && _isSpace(token.str[token.length - 1])) {
+    token.length--;
+  }
+}
+
+static bool _equals(const FsmLoaderToken& token, const char* str) {
+  return (strlen(str) == token.length) && !strncmp(token.str, str, token.length);
+}
+
+/**
+ * parse a token of decimal digits
+ *
+ * @return false if the token is not a number (below limit)
+ */
+static bool _number(const FsmLoaderToken& token, uint16_t limit, uint16_t& value) {
+  uint32_t number = 0;
+
+  for (size_t i=0; i<token.length; i++) {
+    if ((token.str[i] < '0') || (token.str[i] > '9')) {
+      return false;
+    }
+
+    number = (number * 10) + (token.str[i] - '0');
+    if (number >= limit) {
+      return false;
+    }
+  }
+
+  value = (uint16_t) number;
+
+  return token.length > 0;
+}
+
+static void _writeString(FsmSnapshotWriter& writer, const FsmLoaderToken& token) {
+  writer.writeByte((byte) token.length);
+
+  for (size_t i=0; i<token.length; i++) {
+    writer.writeByte((byte) token.str[i]);
+  }
+}
+
+
+bool FsmLoader::_fail(byte error, uint16_t line) {
+  _error = error;
+  _errorLine = line;
+
+  return false;
+}
+
+size_t FsmLoader::compile(const char* text, byte* buffer, size_t capacity) {
+  FsmSnapshotWriter writer(buffer, capacity, 0);
+  size_t indents[FSM_LOADER_MAX_DEPTH];     // indentation of the open FSM at each depth
+  size_t offsets[FSM_LOADER_MAX_DEPTH];     // and the offset of its record
+  bool parents[FSM_LOADER_MAX_DEPTH];       // and whether it may have children
+  int depth = -1;
+  uint16_t count = 0;
+  uint16_t line = 0;
+
+  _error = FSM_LOADER_OK;
+  _errorLine = 0;
+
+  writer.writeByte('F');
+  writer.writeByte('S');
+  writer.writeByte('D');
+  writer.writeByte(FSM_LOADER_VERSION);
+  writer.writeUInt16(0);
+
+  for (const char* p = text; *p; ) {
+    const char* start = p;
+    line++;
+
+    // p moves to the start of the next line, start is parsed
+    while (!_isEnd(*p)) {
+      p++;
+    }
+    if (*p) {
+      p++;
+    }
+
+    size_t indent = 0;
+    while (_isSpace(start[indent])) {
+      indent++;
+    }
+
+    const char* q = start + indent;
+    FsmLoaderToken name = { NULL, 0 };
+    FsmLoaderToken keyword;
+
+    if (!_nextToken(q, keyword)) {
+      continue;
+    }
+
+    if (keyword.str[keyword.length - 1] == ':') {
+      name.str = keyword.str;
+      name.length = keyword.length - 1;
+
+      if (!name.length || !_nextToken(q, keyword)) {
+        return _fail(FSM_LOADER_SYNTAX, line);
+      }
+    }
+
+    const FsmLoaderSyntax* syntax = NULL;
+    for (size_t s=0; s<sizeof(_syntax) / sizeof(_syntax[0]); s++) {
+      if (_equals(keyword, _syntax[s].keyword)) {
+        syntax = &_syntax[s];
+        break;
+      }
+    }
+
+    if (!syntax) {
+      return _fail(FSM_LOADER_UNKNOWN_KIND, line);
+    }
+
+    // the depth follows from the indentation
+    if (depth < 0) {
+      depth = 0;
+    }
+    else if (indent > indents[depth]) {
+      if (!parents[depth] || (depth + 1 >= FSM_LOADER_MAX_DEPTH)) {
+        return _fail(FSM_LOADER_BAD_NESTING, line);
+      }
+
+      depth++;
+    }
+    else {
+      while ((depth > 0) && (indent < indents[depth])) {
+        depth--;
+      }
+
+      if ((depth == 0) || (indent != indents[depth])) {
+        return _fail(FSM_LOADER_BAD_NESTING, line);
+      }
+    }
+
+    // count a child of the parent, in place
+    if (depth > 0) {
+      size_t childCount = offsets[depth - 1] + 2;
+
+      if (childCount + 1 < capacity) {
+        uint16_t children = buffer[childCount] | (buffer[childCount + 1] << 8);
+
+        children++;
+        buffer[childCount] = (byte) children;
+        buffer[childCount + 1] = (byte)(children >> 8);
+      }
+    }
+
+    indents[depth] = indent;
+    offsets[depth] = writer.getSize();
+    parents[depth] = syntax->parent;
+
+    // the operands
+    FsmLoaderToken operands[2] = { { NULL, 0 }, { NULL, 0 } };
+    uint16_t index = FSM_LOADER_NO_INDEX;
+    uint16_t number = 0;
+    FsmLoaderToken token;
+
+    for (byte b=0; b<syntax->bindings; b++) {
+      if (!_nextToken(q, operands[b])) {
+        return _fail(FSM_LOADER_SYNTAX, line);
+      }
+    }
+
+    switch (syntax->args) {
+      case FSM_LOADER_ARGS_START:
+        if (_nextToken(q, token) && !_number(token, FSM_INDEX_NONE, index)) {
+          return _fail(FSM_LOADER_SYNTAX, line);
+        }
+        break;
+
+      case FSM_LOADER_ARGS_BRANCH:
+        if (!_nextToken(q, token)) {
+          return _fail(FSM_LOADER_SYNTAX, line);
+        }
+
+        // a number is an index, anything else the name of a sibling
+        if (!_number(token, FSM_INDEX_NONE, index)) {
+          operands[1] = token;
+        }
+        break;
+
+      case FSM_LOADER_ARGS_TEXT:
+        _restOfLine(q, operands[0]);
+        break;
+
+      case FSM_LOADER_ARGS_EVENT:
+        if (!_nextToken(q, token) || !_number(token, 0xFFFF, number)) {
+          return _fail(FSM_LOADER_SYNTAX, line);
+        }
+
+        if (_nextToken(q, token) && !_number(token, FSM_INDEX_NONE, index)) {
+          return _fail(FSM_LOADER_SYNTAX, line);
+        }
+        break;
+    }
+
+    if (_nextToken(q, token) || (name.length > 255) || (operands[0].length > 255) || (operands[1].length > 255)) {
+      return _fail(FSM_LOADER_SYNTAX, line);
+    }
+
+    writer.writeByte(syntax->op);
+    writer.writeByte((byte) depth);
+    writer.writeUInt16(0);
+    writer.writeUInt16(index);
+    writer.writeUInt16(number);
+    _writeString(writer, name);
+    _writeString(writer, operands[0]);
+    _writeString(writer, operands[1]);
+    count++;
+  }
+
+  if (!count) {
+    return _fail(FSM_LOADER_SYNTAX, line);
+  }
+
+  if (capacity >= FSM_LOADER_HEADER_SIZE) {
+    buffer[4] = (byte) count;
+    buffer[5] = (byte)(count >> 8);
+  }
+
+  return writer.getSize();
+}
+
+
+/**
+ * copy a string from a definition (not terminated) into memory from FsmArena::allocate()
+ */
+static char* _copyString(const byte* str, byte length) {
+  char* copy = (char*) FsmArena::allocate(length + 1);
+
+  if (copy) {
+    memcpy(copy, str, length);
+    copy[length] = '\0';
+  }
+
+  return copy;
+}
+
+const FsmBinding* FsmLoader::_find(const char* name, byte length) {
+  for (uint16_t b=0; b<_bindingCount; b++) {
+    const char* bound = _bindings[b].name;
+
+    if (!strncmp(bound, name, length) && (bound[length] == '\0')) {
+      return &_bindings[b];
+    }
+  }
+
+  return NULL;
+}
+
+void* FsmLoader::_bind(const char* name, byte length) {
+  const FsmBinding* binding = _find(name, length);
+
+  if (!binding) {
+    _fail(FSM_LOADER_UNKNOWN_BINDING, 0);
+    return NULL;
+  }
+
+  return binding->object;
+}
+
+FsmUpdatable* FsmLoader::_create(byte op, FsmIndex index, uint16_t number, const byte* strings[3], const byte lengths[3]) {
+  const char* operand1 = (const char*) strings[1];
+  const char* operand2 = (const char*) strings[2];
+  void* object1 = NULL;
+  void* object2 = NULL;
+  FsmIndex branchInd = (index == FSM_INDEX_NONE) ? 0 : index;
+  switch (op) {
+    case FSM_LOADER_SELECT:
+    case FSM_LOADER_SELECT_WATCHED:
+    case FSM_LOADER_DELAY:
+    case FSM_LOADER_WAIT_TIMER:
+    case FSM_LOADER_BRANCH_ON_END_OF_LIST:
+    case FSM_LOADER_FINISH_ON_END_OF_LIST:
+    case FSM_LOADER_BRANCH_ON_CONDITION_FALSE:
+      object1 = _bind(operand1, lengths[1]);
+      break;
+
+    case FSM_LOADER_START_TIMER:
+    case FSM_LOADER_ASSIGN_CONDITION:
+      object1 = _bind(operand1, lengths[1]);
+      object2 = _bind(operand2, lengths[2]);
+      break;
+  }
+
+  if (_error != FSM_LOADER_OK) {
+    return NULL;
+  }
+
+  switch (op) {
+    case FSM_LOADER_COLLECTION:
+      return new FsmCollection();
+
+    case FSM_LOADER_SEQUENCE:
+      return new FsmSequence(branchInd);
+
+    case FSM_LOADER_SELECT:
+      return new FsmSelectStateFromCondition((Value<bool>*) object1);
+
+    case FSM_LOADER_SELECT_WATCHED:
+      return new FsmSelectStateFromCondition((FsmWatchedValue<bool>*) object1);
+
+    case FSM_LOADER_DELAY:
+      return new FsmDelay((Value<Duration>*) object1);
+
+    case FSM_LOADER_START_TIMER:
+      return new FsmStartTimer((Timer*) object1, (Value<Duration>*) object2);
+
+    case FSM_LOADER_WAIT_TIMER:
+      return new FsmWaitUntilTimerIsComplete((Timer*) object1);
+
+    case FSM_LOADER_FINISH:
+      return new FsmFinish();
+
+    case FSM_LOADER_BRANCH_ON_END_OF_LIST: {
+      FsmBranchOnEndOfList* branch = new FsmBranchOnEndOfList((EnumeratorBase*) object1, branchInd);
+
+      if (branch && lengths[2]) {
+        branch->setBranchName(_copyString(strings[2], lengths[2]));
+      }
+      return branch;
+    }
+
+    case FSM_LOADER_FINISH_ON_END_OF_LIST:
+      return new FsmFinishOnEndOfList((EnumeratorBase*) object1);
+
+    case FSM_LOADER_BRANCH_ON_CONDITION_FALSE: {
+      FsmBranchOnConditionFalse* branch = new FsmBranchOnConditionFalse((Condition**) object1, branchInd);
+
+      if (branch && lengths[2]) {
+        branch->setBranchName(_copyString(strings[2], lengths[2]));
+      }
+      return branch;
+    }
+
+    case FSM_LOADER_ASSIGN_CONDITION:
+      return new FsmAssignConditionToValue((Condition*) object1, (Value<bool>*) object2);
+
+    case FSM_LOADER_DEBUG_PRINT:
+    case FSM_LOADER_DEBUG_STATE: {
+      // the States copy their message, which must be terminated
+      char message[256];
+
+      memcpy(message, operand1, lengths[1]);
+      message[lengths[1]] = '\0';
+
+      if (op == FSM_LOADER_DEBUG_PRINT) {
+        return new FsmDebugPrint(message);
+      }
+      return new FsmDebugState(message);
+    }
+
+    case FSM_LOADER_IDLE:
+      return new FsmIdle();
+
+    case FSM_LOADER_WAIT_FOR_EVENT:
+      return new FsmWaitForEvent((FsmEventId) number, index);
+
+    case FSM_LOADER_USER: {
+      const FsmBinding* binding = _find(operand1, lengths[1]);
+
+      if (!binding || !binding->factory) {
+        _fail(FSM_LOADER_UNKNOWN_BINDING, 0);
+        return NULL;
+      }
+      return binding->factory(binding->object);
+    }
+  }
+
+  _fail(FSM_LOADER_BAD_FORMAT, 0);
+  return NULL;
+}
+
+FsmUpdatable* FsmLoader::loadBinary(const byte* definition, size_t size) {
+  FsmCollection* parents[FSM_LOADER_MAX_DEPTH] = { NULL };
+  FsmUpdatable* root = NULL;
+  byte previousDepth = 0;
+  size_t position = FSM_LOADER_HEADER_SIZE;
+
+  _error = FSM_LOADER_OK;
+  _errorLine = 0;
+
+  if ((size < FSM_LOADER_HEADER_SIZE) || (definition[0] != 'F') || (definition[1] != 'S') || (definition[2] != 'D') ||
+      (definition[3] != FSM_LOADER_VERSION)) {
+    _fail(FSM_LOADER_BAD_FORMAT, 0);
+    return NULL;
+  }
+
+  uint16_t count = definition[4] | (definition[5] << 8);
+  uint16_t f;
+
+  for (f=0; f<count; f++) {
+    // the fixed part, then the strings
+    if (position + 8 > size) {
+      _fail(FSM_LOADER_BAD_FORMAT, 0);
+      break;
+    }
+
+    const byte* record = definition + position;
+    byte op = record[0];
+    byte depth = record[1];
+    uint16_t childCount = record[2] | (record[3] << 8);
+    uint16_t index = record[4] | (record[5] << 8);
+    uint16_t number = record[6] | (record[7] << 8);
+    const byte* strings[3];
+    byte lengths[3];
+    byte s;
+
+    position += 8;
+
+    for (s=0; s<3; s++) {
+      if ((position >= size) || (position + 1 + definition[position] > size)) {
+        break;
+      }
+
+      lengths[s] = definition[position];
+      strings[s] = definition + position + 1;
+      position += 1 + lengths[s];
+    }
+
+    // depth first: the root, then each FSM at most one deeper than the one before
+    if ((s < 3) || (depth >= FSM_LOADER_MAX_DEPTH) || ((depth == 0) != (f == 0)) || (depth > previousDepth + 1) ||
+        ((depth > 0) && !parents[depth - 1]) || (childCount >= FSM_INDEX_NONE) ||
+        ((index != FSM_LOADER_NO_INDEX) && (index >= FSM_INDEX_NONE))) {
+      _fail(FSM_LOADER_BAD_FORMAT, 0);
+      break;
+    }
+
+    FsmUpdatable* fsm = _create(op, (index == FSM_LOADER_NO_INDEX) ? FSM_INDEX_NONE : (FsmIndex) index, number, strings, lengths);
+
+    if (!fsm) {
+      if (_error == FSM_LOADER_OK) {
+        _fail(FSM_LOADER_NO_MEMORY, 0);
+      }
+      break;
+    }
+
+    if (lengths[0]) {
+      fsm->setName(_copyString(strings[0], lengths[0]));
+    }
+
+    if (depth == 0) {
+      root = fsm;
+    }
+    else if (parents[depth - 1]->addChild(fsm) == FSM_INDEX_NONE) {
+      delete fsm;
+      _fail(FSM_LOADER_NO_MEMORY, 0);
+      break;
+    }
+
+    // children are only valid under the FSM just created, which has its storage reserved up front
+    previousDepth = depth;
+    parents[depth] = fsm->asCollection();
+    if (depth + 1 < FSM_LOADER_MAX_DEPTH) {
+      parents[depth + 1] = NULL;
+    }
+
+    if (childCount) {
+      if (!parents[depth]) {
+        _fail(FSM_LOADER_BAD_NESTING, 0);
+        break;
+      }
+
+      parents[depth]->reserveChildren((FsmIndex) childCount);
+    }
+  }
+
+  if ((_error == FSM_LOADER_OK) && (!root || (position != size))) {
+    _fail(FSM_LOADER_BAD_FORMAT, 0);
+  }
+
+  if (_error != FSM_LOADER_OK) {
+    _errorLine = f + 1;
+
+    delete root;
+    return NULL;
+  }
+
+  root->resolve();
+
+  return root;
+}
+
+FsmUpdatable* FsmLoader::loadText(const char* text) {
+  size_t size = compile(text, NULL, 0);
+
+  if (!size) {
+    return NULL;
+  }
+
+  byte* definition = (byte*) malloc(size);
+  if (!definition) {
+    _fail(FSM_LOADER_NO_MEMORY, 0);
+    return NULL;
+  }
+
+  compile(text, definition, size);
+  FsmUpdatable* root = loadBinary(definition, size);
+
+  free(definition);
+
+  return root;
+}
@@ -0,0 +1,152 @@
+/** @file FsmLoader.h
+  *  Copyright (c) 2016 Ozbotics
+  *  Distributed under the MIT license (see LICENSE)
+  */
+#ifndef _FSM_LOADER_H
+ #define _FSM_LOADER_H
+
+#include <FSM.h>
+
+#define FSM_LOADER_VERSION 1      /**< format of the binary definitions written by FsmLoader::compile() */
+#define FSM_LOADER_MAX_DEPTH 16   /**< deepest nesting a definition may have */
+
+/**
+ * An object a definition refers to by name (a Value, Timer, Condition, Enumerator, ...)
+ *
+ * The loader cannot check types: the object must be what the kind of State that names it expects (see FsmLoader).
+ *  For user defined FSMs, factory builds the FSM (from object, which may be NULL).
+ */
+struct FsmBinding {
+  const char* name;                          /**< the name used in definitions */
+  void* object;                              /**< the object */
+  FsmUpdatable* (*factory)(void* object);    /**< builds a user defined FSM, NULL for other objects */
+};
+
+/**
+ * Operations of a binary definition, one per kind of FSM
+ */
+enum FsmLoaderOp {
+  FSM_LOADER_COLLECTION = 1,          /**< collection */
+  FSM_LOADER_SEQUENCE,                /**< sequence [start index] */
+  FSM_LOADER_SELECT,                  /**< select <Value<bool>> */
+  FSM_LOADER_SELECT_WATCHED,          /**< select_watched <FsmWatchedValue<bool>> */
+  FSM_LOADER_DELAY,                   /**< delay <Value<Duration>> */
+  FSM_LOADER_START_TIMER,             /**< start_timer <Timer> <Value<Duration>> */
+  FSM_LOADER_WAIT_TIMER,              /**< wait_timer <Timer> */
+  FSM_LOADER_FINISH,                  /**< finish */
+  FSM_LOADER_BRANCH_ON_END_OF_LIST,   /**< branch_on_end_of_list <EnumeratorBase> <branch index or name> */
+  FSM_LOADER_FINISH_ON_END_OF_LIST,   /**< finish_on_end_of_list <EnumeratorBase> */
+  FSM_LOADER_BRANCH_ON_CONDITION_FALSE,/**< branch_on_condition_false <Condition*> <branch index or name>, binds the Condition* variable */
+  FSM_LOADER_ASSIGN_CONDITION,        /**< assign_condition <Condition> <Value<bool>> */
+  FSM_LOADER_DEBUG_PRINT,             /**< debug_print <message, the rest of the line> */
+  FSM_LOADER_IDLE,                    /**< idle */
+  FSM_LOADER_DEBUG_STATE,             /**< debug_state <message, the rest of the line> */
+  FSM_LOADER_WAIT_FOR_EVENT,          /**< wait_for_event <event id> [branch index] */
+  FSM_LOADER_USER                     /**< user <binding with a factory> */
+};
+
+/**
+ * Reasons a definition could not be compiled or loaded
+ */
+enum FsmLoaderError {
+  FSM_LOADER_OK,                /**< no error */
+  FSM_LOADER_SYNTAX,            /**< a line could not be parsed (eg; a missing operand) */
+  FSM_LOADER_UNKNOWN_KIND,      /**< a line names no known kind of FSM */
+  FSM_LOADER_BAD_NESTING,       /**< indentation does not match a parent, or a child of a State that is not a Collection */
+  FSM_LOADER_UNKNOWN_BINDING,   /**< an operand names no binding (or a user FSM's binding has no factory) */
+  FSM_LOADER_BAD_FORMAT,        /**< a binary definition is truncated, of another version, or not one */
+  FSM_LOADER_NO_MEMORY          /**< an FSM could not be allocated */
+};
+
+/**
+ * Builds FSMs from definitions, rather than code
+ *
+ * A text definition has one FSM per line; indentation nests children under a Collection, Sequence or Select.
+ *  A line is an optional name (ending with ':'), the kind, then its operands: the names of bound objects,
+ *  and numbers or sibling names where a kind takes an index. '#' starts a comment.
+ *
+ *   blink: sequence
+ *     debug_print LED on
+ *     delay onTime
+ *     branch_on_condition_false keepBlinking done
+ *     finish
+ *     done: idle
+ *
+ *   FsmBinding bindings[] = {
+ *     { "onTime", &onTime, NULL },
+ *     { "keepBlinking", &keepBlinkingPtr, NULL }
+ *   };
+ *   FsmLoader loader(bindings, 2);
+ *   FsmUpdatable* root = loader.loadText(definition);
+ *
+ * compile() turns a text definition into a compact binary one (eg; on a host, to ship to devices), which
+ *  loadBinary() builds without parsing any text. Both build the whole tree in one pass, reserving each Collection's
+ *  children up front, so within an FsmArena::Scope the machine is a handful of pointer bumps.
+ *  Names are copied with FsmArena::allocate(): load within a Scope, as heap copies (like literal names) are not freed with the tree.
+ *  The loaded tree has been resolve()d.
+ */
+class FsmLoader {
+  protected:
+    const FsmBinding* _bindings;  /**< protected variable _bindings The objects definitions may name */
+    uint16_t _bindingCount;       /**< protected variable _bindingCount Number of bindings */
+    byte _error;                  /**< protected variable _error FsmLoaderError of the last compile or load */
+    uint16_t _errorLine;          /**< protected variable _errorLine Line (text) or FSM (binary) of the error, from 1 */
+
+    const FsmBinding* _find(const char* name, byte length);
+    void* _bind(const char* name, byte length);
+    FsmUpdatable* _create(byte op, FsmIndex index, uint16_t number, const byte* strings[3], const byte lengths[3]);
+    bool _fail(byte error, uint16_t line);
+
+  public:
+   /**
+    * Constructor
+    *
+    * @param bindings The objects definitions may name (must out-live the loader)
+    * @param bindingCount Number of bindings
+    */
+    FsmLoader(const FsmBinding* bindings=NULL, uint16_t bindingCount=0) : _bindings(bindings), _bindingCount(bindingCount), _error(FSM_LOADER_OK), _errorLine(0) { }
+
+   /**
+    * translate a text definition to the binary form
+    *  binding names are not checked until the binary definition is loaded
+    *
+    * @param text The definition
+    * @param buffer Where to write the binary definition (may be NULL to get the size)
+    * @param capacity Size of buffer
+    * @return the size of the binary definition (if larger than capacity, buffer does not hold it), 0 on error
+    */
+    size_t compile(const char* text, byte* buffer, size_t capacity);
+
+   /**
+    * build an FSM from a binary definition
+    *
+    * @param definition From compile()
+    * @param size Size of definition
+    * @return the root of the tree, NULL on error (see getError())
+    */
+    FsmUpdatable* loadBinary(const byte* definition, size_t size);
+
+   /**
+    * build an FSM from a text definition
+    *  compiles it to a temporary binary definition (on the heap), then loads that
+    *
+    * @return the root of the tree, NULL on error (see getError())
+    */
+    FsmUpdatable* loadText(const char* text);
+
+   /**
+    * get the FsmLoaderError of the last compile or load
+    */
+    byte getError() {
+      return _error;
+    }
+
+   /**
+    * get the line (text) or FSM (binary, depth first) at which the last error was found, from 1
+    */
+    uint16_t getErrorLine() {
+      return _errorLine;
+    }
+};
+
+#endif  // _FSM_LOADER_H
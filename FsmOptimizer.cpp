@@ -0,0 +1,317 @@
+#include <FsmOptimizer.h>
+#include <FsmTable.h>
+#include <string.h>
+
+/**
+ * does fsm move on as soon as it is entered, having done its work (so that a run of them can be fused)
+ */
+static bool _isInstantaneous(FsmUpdatable* fsm) {
+  FsmDescription description;
+  FsmTable::describeExact(fsm, description);
+
+  return (description.kind == FSM_KIND_DEBUG_PRINT) || (description.kind == FSM_KIND_START_TIMER) ||
+    (description.kind == FSM_KIND_ASSIGN_CONDITION);
+}
+
+static bool _isBranch(byte kind) {
+  return (kind == FSM_KIND_BRANCH_ON_END_OF_LIST) || (kind == FSM_KIND_BRANCH_ON_CONDITION_FALSE);
+}
+
+
+void FsmFusedActions::_enterState() {
+  // each child does its work as it is entered, and asks to move on (which a Collection ignores), so leaves at once
+  for (FsmUpdatable** child = _children.begin(); child != _children.end(); child++) {
+    (*child)->update();
+  }
+
+  _transitionAncestorToNext(1);
+}
+
+
+bool FsmOptimizer::optimize(FsmUpdatable* root) {
+  _prunedCount = 0;
+  _fusedCount = 0;
+  _fusionCount = 0;
+
+  root->resolve();
+
+  return _optimize(root);
+}
+
+bool FsmOptimizer::_optimize(FsmUpdatable* fsm) {
+  FsmCollection* collection = fsm->asCollection();
+
+  if (!collection) {
+    return true;
+  }
+
+  FsmDescription description;
+  FsmTable::describeExact(fsm, description);
+
+  FsmSequence* sequence = NULL;
+  bool ok = true;
+
+  // decide before the children are optimized, as FsmFusedActions are opaque
+  if ((description.kind == FSM_KIND_SEQUENCE) && !((FsmSequence*) collection)->isEntered()) {
+    sequence = (FsmSequence*) collection;
+
+    for (FsmUpdatable** child = collection->_children.begin(); child != collection->_children.end(); child++) {
+      if (_isOpaque(*child)) {
+        sequence = NULL;
+        break;
+      }
+    }
+  }
+
+  if (sequence) {
+    ok = _prune(sequence);
+  }
+
+  for (FsmUpdatable** child = collection->_children.begin(); child != collection->_children.end(); child++) {
+    ok = _optimize(*child) && ok;
+  }
+
+  if (sequence) {
+    ok = _fuse(sequence) && ok;
+  }
+
+  return ok;
+}
+
+bool FsmOptimizer::_isOpaque(FsmUpdatable* fsm) {
+  FsmDescription description;
+  FsmTable::describeExact(fsm, description);
+
+  // a user defined FSM may make any transition, at any depth
+  if (description.kind == FSM_KIND_USER) {
+    return true;
+  }
+
+  FsmCollection* collection = fsm->asCollection();
+
+  if (collection) {
+    for (FsmUpdatable** child = collection->_children.begin(); child != collection->_children.end(); child++) {
+      if (_isOpaque(*child)) {
+        return true;
+      }
+    }
+  }
+
+  return false;
+}
+
+bool FsmOptimizer::_prune(FsmSequence* sequence) {
+  FsmIndex count = sequence->_children.size();
+  FsmIndex start = sequence->_startChildInd;
+
+  if (start >= count) {
+    return true;
+  }
+
+  byte* reachable = (byte*) malloc(count);
+  FsmIndex* map = (FsmIndex*) malloc(count * sizeof(FsmIndex));
+
+  if (!reachable || !map) {
+    free(reachable);
+    free(map);
+    return false;
+  }
+
+  memset(reachable, 0, count);
+
+  // depth first from the start State, using map as the stack of States to visit
+  FsmIndex stackSize = 0;
+  map[stackSize++] = start;
+  reachable[start] = 1;
+
+  while (stackSize) {
+    FsmIndex i = map[--stackSize];
+    FsmIndex successors[2];
+    byte successorCount = 0;
+
+    FsmDescription description;
+    FsmTable::describeExact(sequence->_children.get(i), description);
+
+    switch (description.kind) {
+      case FSM_KIND_IDLE:
+      case FSM_KIND_DEBUG_STATE:
+        // wait to be forced out
+        break;
+
+      case FSM_KIND_FINISH:
+        // back to the start (then the Sequence leaves)
+        break;
+
+      case FSM_KIND_BRANCH_ON_END_OF_LIST:
+      case FSM_KIND_BRANCH_ON_CONDITION_FALSE:
+        successors[successorCount++] = (description.index < count) ? description.index : start;
+        // fall through
+
+      default:
+        // built-in States (and descendants, by finishing) move their Sequence on to the next State
+        successors[successorCount++] = (i + 1 < count) ? i + 1 : start;
+        break;
+    }
+
+    for (byte s=0; s<successorCount; s++) {
+      if (!reachable[successors[s]]) {
+        reachable[successors[s]] = 1;
+        map[stackSize++] = successors[s];
+      }
+    }
+  }
+
+  FsmIndex kept = 0;
+
+  for (FsmIndex i=0; i<count; i++) {
+    FsmUpdatable* child = sequence->_children.get(i);
+
+    if (reachable[i]) {
+      map[i] = kept;
+      sequence->_children.set(kept++, child);
+    }
+    else {
+      map[i] = FSM_INDEX_NONE;
+      _prunedCount += _countNodes(child);
+      delete child;
+    }
+  }
+
+  if (kept < count) {
+    sequence->_children.truncate(kept);
+    _renumber(sequence, map, count);
+  }
+
+  free(reachable);
+  free(map);
+
+  return true;
+}
+
+bool FsmOptimizer::_fuse(FsmSequence* sequence) {
+  FsmIndex count = sequence->_children.size();
+  FsmIndex start = sequence->_startChildInd;
+
+  if ((count < 2) || (start >= count)) {
+    return true;
+  }
+
+  byte* target = (byte*) malloc(count);
+  FsmIndex* map = (FsmIndex*) malloc(count * sizeof(FsmIndex));
+
+  if (!target || !map) {
+    free(target);
+    free(map);
+    return false;
+  }
+
+  // States entered other than by moving on, which must stay the first of any run
+  memset(target, 0, count);
+  target[start] = 1;
+
+  for (FsmIndex i=0; i<count; i++) {
+    FsmDescription description;
+    FsmTable::describeExact(sequence->_children.get(i), description);
+
+    if (_isBranch(description.kind) && (description.index < count)) {
+      target[description.index] = 1;
+    }
+  }
+
+  // fuse runs, compacting the children in place (a run is read before its first slot is written)
+  FsmIndex kept = 0;
+  FsmIndex i = 0;
+
+  while (i < count) {
+    FsmUpdatable* first = sequence->_children.get(i);
+    FsmIndex last = i;
+
+    if (_isInstantaneous(first)) {
+      while ((last + 1 < count) && !target[last + 1] && !sequence->_children.get(last + 1)->getName() &&
+             _isInstantaneous(sequence->_children.get(last + 1))) {
+        last++;
+      }
+    }
+
+    FsmFusedActions* fused = NULL;
+
+    if (last > i) {
+      fused = new FsmFusedActions();
+
+      if (fused && !fused->_children.reserve(last - i + 1)) {
+        delete fused;
+        fused = NULL;
+      }
+
+      if (!fused) {
+        // leave the run as it is
+        last = i;
+      }
+    }
+
+    if (fused) {
+      fused->setName(first->getName());
+
+      for (FsmIndex k=i; k<=last; k++) {
+        fused->addChild(sequence->_children.get(k));
+        map[k] = kept;
+      }
+
+      fused->setParent(sequence);
+      sequence->_children.set(kept++, fused);
+
+      _fusedCount += last - i + 1;
+      _fusionCount++;
+    }
+    else {
+      map[i] = kept;
+      sequence->_children.set(kept++, first);
+    }
+
+    i = last + 1;
+  }
+
+  if (kept < count) {
+    sequence->_children.truncate(kept);
+    _renumber(sequence, map, count);
+  }
+
+  free(target);
+  free(map);
+
+  return true;
+}
+
+void FsmOptimizer::_renumber(FsmSequence* sequence, const FsmIndex* map, FsmIndex oldCount) {
+  sequence->_startChildInd = map[sequence->_startChildInd];
+  sequence->_currentChildInd = sequence->_startChildInd;
+
+  // branch targets past the end (ie; the start) stay past the end
+  for (FsmUpdatable** child = sequence->_children.begin(); child != sequence->_children.end(); child++) {
+    FsmDescription description;
+    FsmTable::describeExact(*child, description);
+
+    if ((description.kind == FSM_KIND_BRANCH_ON_END_OF_LIST) && (description.index < oldCount)) {
+      ((FsmBranchOnEndOfList*) *child)->_branchInd = map[description.index];
+    }
+    else if ((description.kind == FSM_KIND_BRANCH_ON_CONDITION_FALSE) && (description.index < oldCount)) {
+      ((FsmBranchOnConditionFalse*) *child)->_branchInd = map[description.index];
+    }
+  }
+
+  // rebuild the name index, and re-resolve branches by name against the new indices
+  sequence->resolve();
+}
+
+uint16_t FsmOptimizer::_countNodes(FsmUpdatable* fsm) {
+  uint16_t count = 1;
+  FsmCollection* collection = fsm->asCollection();
+
+  if (collection) {
+    for (FsmUpdatable** child = collection->_children.begin(); child != collection->_children.end(); child++) {
+      count += _countNodes(*child);
+    }
+  }
+
+  return count;
+}
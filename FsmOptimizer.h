@@ -0,0 +1,124 @@
+/** @file FsmOptimizer.h
+  *  Copyright (c) 2016 Ozbotics
+  *  Distributed under the MIT license (see LICENSE)
+  */
+#ifndef _FSM_OPTIMIZER_H
+ #define _FSM_OPTIMIZER_H
+
+#include <FSM.h>
+
+/**
+ * A run of instantaneous States, made by FsmOptimizer, that does all their work as it is entered
+ *
+ * Each child is entered (doing its work) and left in turn, within the one update, then the run transitions to the next State.
+ *  It describes itself as user defined, so that an FsmTable runs it as it is.
+ */
+class FsmFusedActions : public FsmCollection {
+  protected:
+   /**
+    * over-ride _enterState to enter and leave each child, then request transition to next
+    */
+    virtual void _enterState();
+
+   /**
+    * over-ride _updateState: there is nothing left to do
+    */
+    virtual void _updateState() { }
+
+   /**
+    * over-ride _leaveState: the children have already left
+    */
+    virtual void _leaveState() {
+      FsmState::_leaveState();
+    }
+
+   /**
+    * over-ride _timeToDeadline: the children are never left entered
+    */
+    virtual unsigned long _timeToDeadline() {
+      return 0;
+    }
+
+  public:
+   /**
+    * Constructor
+    */
+    FsmFusedActions() : FsmCollection() { }
+
+    virtual void describe(FsmDescription& description) {
+      FsmUpdatable::describe(description);
+    }
+};
+
+/* --------------------------------------------------------------------------------------- */
+
+/**
+ * Makes a built tree smaller, and quicker to run, without changing what it does
+ *
+ * For each FsmSequence (not Select) that has not been entered, and holds nothing user defined that could make
+ *  transitions of its own:
+ *  - States that cannot be reached from the start index, by moving on or by a branch, are deleted (with their descendants);
+ *    eg; those before a start index, or after an FsmIdle that nothing branches past
+ *  - runs of consecutive FsmDebugPrint, FsmStartTimer and FsmAssignConditionToValue, which move on as soon as they
+ *    are entered, are fused into one FsmFusedActions, so the run takes one update (or microstep) rather than one per State.
+ *    A run is not fused across a State that is a branch target, the start State, or named (it could be looked up).
+ *  Start and branch indices are renumbered, and the Sequences resolve()d again.
+ *
+ *   FsmUpdatable* root = buildMachine();
+ *   FsmOptimizer optimizer;
+ *   optimizer.optimize(root);
+ *
+ * Optimize once, after the tree is built and before the first update (or snapshot: the tree's shape changes);
+ *  pointers the application holds to deleted States dangle. Within an FsmArena::Scope, FsmFusedActions come from the arena.
+ *  As for FsmTable, classes derived from built-in FSMs are detected, and treated as user defined (see FsmTable::describeExact()).
+ */
+class FsmOptimizer {
+  protected:
+    uint16_t _prunedCount;  /**< protected variable _prunedCount FSMs deleted (with descendants) by the last optimize() */
+    uint16_t _fusedCount;   /**< protected variable _fusedCount States fused into FsmFusedActions by the last optimize() */
+    uint16_t _fusionCount;  /**< protected variable _fusionCount FsmFusedActions made by the last optimize() */
+
+    bool _optimize(FsmUpdatable* fsm);
+    bool _isOpaque(FsmUpdatable* fsm);
+    bool _prune(FsmSequence* sequence);
+    bool _fuse(FsmSequence* sequence);
+    void _renumber(FsmSequence* sequence, const FsmIndex* map, FsmIndex oldCount);
+    uint16_t _countNodes(FsmUpdatable* fsm);
+
+  public:
+   /**
+    * Constructor
+    */
+    FsmOptimizer() : _prunedCount(0), _fusedCount(0), _fusionCount(0) { }
+
+   /**
+    * optimize a built tree (resolve()ing it first)
+    *
+    * @param root The top of the tree (is never itself deleted)
+    * @return false if scratch memory could not be allocated (the tree is left valid, but perhaps not fully optimized)
+    */
+    bool optimize(FsmUpdatable* root);
+
+   /**
+    * get the number of FSMs deleted by the last optimize(), counting descendants
+    */
+    uint16_t getPrunedCount() {
+      return _prunedCount;
+    }
+
+   /**
+    * get the number of States fused by the last optimize()
+    */
+    uint16_t getFusedCount() {
+      return _fusedCount;
+    }
+
+   /**
+    * get the number of FsmFusedActions made by the last optimize()
+    */
+    uint16_t getFusionCount() {
+      return _fusionCount;
+    }
+};
+
+#endif  // _FSM_OPTIMIZER_H
@@ -0,0 +1,287 @@
+#ifndef ARDUINO
+
+#include <FsmParallel.h>
+
+FsmThreadPool::FsmThreadPool(unsigned int threadCount) : _generation(0), _stop(false), _busy(0), _running(false),
+  _task(NULL), _context(NULL), _count(0), _grain(1), _next(0) {
+  for (unsigned int t=0; t<threadCount; t++) {
+    _threads.push_back(std::thread(&FsmThreadPool::_work, this));
+  }
+}
+
+FsmThreadPool::~FsmThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stop = true;
+  }
+  _start.notify_all();
+  
+  for (std::thread& thread : _threads) {
+    thread.join();
+  }
+}
+
+void FsmThreadPool::_drain() {
+  for (;;) {
+    size_t first = _next.fetch_add(_grain, std::memory_order_relaxed);
+    
+    if (first >= _count) {
+      return;
+    }
+    
+    size_t last = (first + _grain < _count) ? first + _grain : _count;
+    
+    for (size_t index = first; index < last; index++) {
+      _task(_context, index);
+    }
+  }
+}
+
+void FsmThreadPool::_work() {
+  unsigned long seen = 0;
+  
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _start.wait(lock, [&] { return _stop || (_generation != seen); });
+      
+      if (_stop) {
+        return;
+      }
+      
+      seen = _generation;
+    }
+    
+    _drain();
+    
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (--_busy == 0) {
+      _done.notify_one();
+    }
+  }
+}
+
+void FsmThreadPool::run(void (*task)(void* context, size_t index), void* context, size_t count, size_t grain) {
+  bool idle = false;
+  
+  // one loop at a time; a nested (or concurrent) loop runs on the calling thread
+  if (_threads.empty() || (count < 2) || !_running.compare_exchange_strong(idle, true)) {
+    for (size_t index = 0; index < count; index++) {
+      task(context, index);
+    }
+    return;
+  }
+  
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _task = task;
+    _context = context;
+    _count = count;
+    _grain = grain ? grain : 1;
+    _next.store(0, std::memory_order_relaxed);
+    _busy = (unsigned int) _threads.size();
+    _generation++;
+  }
+  _start.notify_all();
+  
+  _drain();
+  
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _done.wait(lock, [this] { return _busy == 0; });
+  }
+  
+  _running.store(false);
+}
+
+
+thread_local FsmParallelCollection* FsmParallelCollection::_regionOwner = NULL;
+thread_local FsmIndex FsmParallelCollection::_region = 0;
+
+FSM_EXACT_CLASS_DEFINE(FsmParallelCollection)
+
+void FsmParallelCollection::_updateRegion(void* context, size_t index) {
+  FsmParallelCollection* collection = (FsmParallelCollection*) context;
+  FsmUpdatable* child = collection->_children.get((FsmIndex) index);
+  
+  // finishing a pass: only the regions that stopped short
+  if (collection->_resuming && !collection->_stopped[index]) {
+    return;
+  }
+  
+  collection->_stopped[index] = false;
+  
+  if (child->isDormant(collection->_now)) {
+    return;
+  }
+  
+  // the thread may be updating a region of an enclosing parallel Collection (or its own update(budget))
+  FsmParallelCollection* owner = _regionOwner;
+  FsmIndex region = _region;
+  unsigned long budget = _updateBudget;
+  unsigned long started = _updateStarted;
+  bool stopped = _updateStopped;
+  
+  _regionOwner = collection;
+  _region = (FsmIndex) index;
+  _updateBudget = collection->_regionBudget;
+  _updateStarted = collection->_regionStarted;
+  _updateStopped = false;
+  
+  child->update();
+  
+  collection->_stopped[index] = _updateStopped;
+  
+  _regionOwner = owner;
+  _region = region;
+  _updateBudget = budget;
+  _updateStarted = started;
+  _updateStopped = stopped;
+}
+
+bool FsmParallelCollection::_defer(byte op, FsmIndex childInd, FsmIndex depth) {
+  if (_regionOwner != this) {
+    return false;
+  }
+  
+  FsmParallelRequest request = { op, childInd, depth };
+  _deferred[_region].push_back(request);
+  
+  return true;
+}
+
+void FsmParallelCollection::_updateState() {
+  FsmIndex count = _children.size();
+  
+  if (_deferred.size() < count) {
+    _deferred.resize(count);
+  }
+  
+  if (_stopped.size() < count) {
+    _stopped.resize(count, false);
+  }
+  
+  _now = millis();
+  _regionBudget = _updateBudget;
+  _regionStarted = _updateStarted;
+  _resuming = false;
+  
+  for (FsmIndex region = 0; region < count; region++) {
+    _resuming = _resuming || _stopped[region];
+  }
+  
+  _pool->run(_updateRegion, this, count, _grain);
+  
+  // after the barrier: apply the requests that left their regions, in child order
+  for (FsmIndex region = 0; region < count; region++) {
+    std::vector<FsmParallelRequest>& requests = _deferred[region];
+    
+    for (size_t r = 0; r < requests.size(); r++) {
+      const FsmParallelRequest& request = requests[r];
+      
+      switch (request.op) {
+        case FSM_PARALLEL_NEXT:
+          FsmCollection::transitionAncestorToNext(request.depth);
+          break;
+        
+        case FSM_PARALLEL_PREVIOUS:
+          FsmCollection::transitionAncestorToPrevious(request.depth);
+          break;
+        
+        case FSM_PARALLEL_TO:
+          FsmCollection::transitionAncestorTo(request.childInd, request.depth);
+          break;
+        
+        case FSM_PARALLEL_START:
+          FsmCollection::transitionAncestorToStart(request.depth);
+          break;
+      }
+    }
+    
+    requests.clear();
+  }
+  
+  // out of time: the next update carries on inside the regions that stopped short
+  for (FsmIndex region = 0; region < count; region++) {
+    if (_stopped[region]) {
+      _updateStopped = true;
+      return;
+    }
+  }
+  
+  // and become quiescent with the regions, as FsmCollection::_updateState() (only a whole pass has seen every region)
+  if (_resuming) {
+    return;
+  }
+  
+  FsmUpdatable* earliest = NULL;
+  
+  for (FsmUpdatable** child = _children.begin(); child != _children.end(); child++) {
+    if (!(*child)->isQuiescent()) {
+      return;
+    }
+    
+    if ((*child)->isWakeTimed() && (!earliest || ((int32_t) ((*child)->getWakeTime() - earliest->getWakeTime()) < 0))) {
+      earliest = *child;
+    }
+  }
+  
+  if (!(_flags & FSM_FLAG_LEAVING) && _canSleep()) {
+    if (earliest) {
+      _sleepWith(earliest);
+    }
+    else {
+      _sleep();
+    }
+  }
+}
+
+void FsmParallelCollection::transitionAncestorToNext(FsmIndex depth) {
+  if ((depth == 0) || !_defer(FSM_PARALLEL_NEXT, 0, depth)) {
+    FsmCollection::transitionAncestorToNext(depth);
+  }
+}
+
+void FsmParallelCollection::transitionAncestorToPrevious(FsmIndex depth) {
+  if ((depth == 0) || !_defer(FSM_PARALLEL_PREVIOUS, 0, depth)) {
+    FsmCollection::transitionAncestorToPrevious(depth);
+  }
+}
+
+void FsmParallelCollection::transitionAncestorTo(FsmIndex childInd, FsmIndex depth) {
+  if ((depth == 0) || !_defer(FSM_PARALLEL_TO, childInd, depth)) {
+    FsmCollection::transitionAncestorTo(childInd, depth);
+  }
+}
+
+void FsmParallelCollection::transitionAncestorToStart(FsmIndex depth) {
+  if ((depth == 0) || !_defer(FSM_PARALLEL_START, 0, depth)) {
+    FsmCollection::transitionAncestorToStart(depth);
+  }
+}
+
+void FsmParallelCollection::_leaveState() {
+  FsmCollection::_leaveState();
+  
+  _stopped.assign(_stopped.size(), false);
+}
+
+void FsmParallelCollection::saveState(FsmSnapshotWriter& writer) {
+  FsmCollection::saveState(writer);
+  
+  for (FsmIndex region = 0; region < _children.size(); region++) {
+    writer.writeByte((region < _stopped.size()) && _stopped[region]);
+  }
+}
+
+void FsmParallelCollection::restoreState(FsmSnapshotReader& reader) {
+  FsmCollection::restoreState(reader);
+  
+  _stopped.assign(_children.size(), false);
+  
+  for (FsmIndex region = 0; region < _children.size(); region++) {
+    _stopped[region] = (reader.readByte() != 0);
+  }
+}
+
+#endif  // ARDUINO
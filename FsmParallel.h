@@ -0,0 +1,223 @@
+/** @file FsmParallel.h
+  *  Copyright (c) 2016 Ozbotics
+  *  Distributed under the MIT license (see LICENSE)
+  */
+#ifndef _FSM_PARALLEL_H
+ #define _FSM_PARALLEL_H
+
+#ifndef ARDUINO
+
+#include <FSM.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * A fixed set of worker threads that run the iterations of a loop together
+ *
+ * run() hands out the iterations in chunks, claimed from a shared counter by the workers and the calling thread,
+ *  so a thread that finishes early takes the next chunk (rather than each thread owning a fixed share).
+ *  run() returns once every iteration is complete, ie; it is a barrier.
+ *
+ * A pool runs one loop at a time: a run() while the pool is busy (eg; from within an iteration) runs its loop
+ *  on the calling thread.
+ */
+class FsmThreadPool {
+  protected:
+    std::vector<std::thread> _threads;     /**< protected variable _threads The workers */
+    std::mutex _mutex;                     /**< protected variable _mutex Guards _generation, _stop & _busy */
+    std::condition_variable _start;        /**< protected variable _start Signalled when a loop starts (or stop) */
+    std::condition_variable _done;         /**< protected variable _done Signalled when the last worker finishes a loop */
+    unsigned long _generation;             /**< protected variable _generation Number of loops started */
+    bool _stop;                            /**< protected variable _stop The workers should exit */
+    unsigned int _busy;                    /**< protected variable _busy Workers yet to finish the current loop */
+    std::atomic<bool> _running;            /**< protected variable _running A loop is running */
+    
+    void (*_task)(void* context, size_t index);  /**< protected variable _task The body of the loop */
+    void* _context;                        /**< protected variable _context Passed to _task */
+    size_t _count;                         /**< protected variable _count Number of iterations */
+    size_t _grain;                         /**< protected variable _grain Iterations per claim */
+    std::atomic<size_t> _next;             /**< protected variable _next The next unclaimed iteration */
+    
+    void _work();
+    void _drain();
+  
+  public:
+   /**
+    * Constructor
+    *
+    * @param threadCount Number of worker threads (in addition to the thread calling run()),
+    *   by default one less than the number of cores
+    */
+    FsmThreadPool(unsigned int threadCount=defaultThreadCount());
+   
+   /**
+    * Destructor
+    *  stops and joins the workers
+    */
+    ~FsmThreadPool();
+   
+   /**
+    * run task(context, index) for every index in [0, count), returning when all are complete
+    *
+    * @param task The body of the loop
+    * @param context Passed to task
+    * @param count Number of iterations
+    * @param grain Number of consecutive iterations claimed at a time
+    */
+    void run(void (*task)(void* context, size_t index), void* context, size_t count, size_t grain=1);
+   
+   /**
+    * get the number of worker threads
+    */
+    unsigned int getThreadCount() {
+      return (unsigned int) _threads.size();
+    }
+   
+   /**
+    * one less than the number of cores (the thread calling run() is the other)
+    */
+    static unsigned int defaultThreadCount() {
+      unsigned int cores = std::thread::hardware_concurrency();
+      
+      return (cores > 1) ? cores - 1 : 0;
+    }
+};
+
+/* --------------------------------------------------------------------------------------- */
+
+/**
+ * Operations of a deferred FsmParallelRequest
+ */
+enum FsmParallelOp {
+  FSM_PARALLEL_NEXT,      /**< transitionAncestorToNext() */
+  FSM_PARALLEL_PREVIOUS,  /**< transitionAncestorToPrevious() */
+  FSM_PARALLEL_TO,        /**< transitionAncestorTo() */
+  FSM_PARALLEL_START      /**< transitionAncestorToStart() */
+};
+
+/**
+ * A transition request that crossed out of a region, applied after the barrier
+ */
+struct FsmParallelRequest {
+  byte op;            /**< the FsmParallelOp */
+  FsmIndex childInd;  /**< target State index (FSM_PARALLEL_TO) */
+  FsmIndex depth;     /**< ancestor hops remaining, from the FsmParallelCollection */
+};
+
+/**
+ * A Collection whose children (its regions) are updated concurrently, on an FsmThreadPool (hosts only)
+ *
+ * Each update, the regions that are not dormant are updated on the pool, followed by a barrier.
+ *  Then, on the calling thread: transition requests that left a region are applied (in child order),
+ *  and the Collection becomes quiescent if all its regions are, just as FsmCollection.
+ *
+ * Rules for regions:
+ *  - a transition whose target is within the region (eg; a State moving its parent Sequence on) is applied at once
+ *  - a transition that leaves the region (reaching the Collection with depth > 0, ie; aimed at an ancestor of the Collection)
+ *    is deferred until every region has been updated, then applied in child order.
+ *    The outcome is the same as FsmCollection's serial update would give
+ *  - FsmTransition handles that would cross the Collection are left unbound, so that they are deferred too
+ *  - during an update a region must not touch another region's States, nor write an object another region uses
+ *    (Values, Timers, Enumerators, ...) without its own synchronisation; reading shared Values is fine
+ *  - FSMs must not be built (or deleted) while the Collection is being updated, and FsmArena scopes are per process
+ *
+ * Within update(budget), each region stops once the budget is spent, as FsmCollection's children do, and the next update
+ *  finishes the pass in only the regions that stopped short (deferred requests are applied either way).
+ *
+ * Nested parallel Collections run their regions on the calling thread if the pool is busy.
+ *  Parallelism pays off when regions do substantial work per update: dispatching to the pool costs microseconds.
+ *
+ *   FsmThreadPool pool;
+ *   FsmParallelCollection regions(&pool);
+ */
+class FsmParallelCollection : public FsmCollection {
+  FSM_EXACT_CLASS(FsmParallelCollection)
+  
+  protected:
+    FsmThreadPool* _pool;                                  /**< protected variable _pool Runs the regions */
+    size_t _grain;                                         /**< protected variable _grain Regions per claim */
+    unsigned long _now;                                    /**< protected variable _now millis() at the start of the update */
+    unsigned long _regionBudget;                           /**< protected variable _regionBudget The calling thread's update(budget), which applies in every region */
+    unsigned long _regionStarted;                          /**< protected variable _regionStarted micros() at which the calling thread's update(budget) started */
+    bool _resuming;                                        /**< protected variable _resuming Only the regions that stopped short are being updated */
+    std::vector<std::vector<FsmParallelRequest> > _deferred;  /**< protected variable _deferred Per region, requests that left it */
+    std::vector<byte> _stopped;                            /**< protected variable _stopped Per region, did its last update stop short of its budgeted traversal */
+    
+    static thread_local FsmParallelCollection* _regionOwner;  /**< protected variable _regionOwner The Collection whose region this thread is updating */
+    static thread_local FsmIndex _region;                      /**< protected variable _region The region this thread is updating */
+    
+    static void _updateRegion(void* context, size_t index);
+   
+   /**
+    * defer a request that left the region being updated by this thread
+    *
+    * @return false if this thread is not updating one of this Collection's regions (the request is then applied at once)
+    */
+    bool _defer(byte op, FsmIndex childInd, FsmIndex depth);
+   
+   /**
+    * update all regions concurrently, then apply deferred requests
+    */
+    virtual void _updateState();
+    
+   /**
+    * over-ride _canSleep, true for the built-in class only (see FsmCollection::_canSleep())
+    */
+    virtual bool _canSleep() {
+      return isExactly(this);
+    }
+    
+   /**
+    * over-ride _leaveState to abandon a pass stopped short, as FsmCollection::_leaveState()
+    */
+    virtual void _leaveState();
+  
+  public:
+   /**
+    * Constructor
+    *
+    * @param pool The pool to run the regions on (may be shared by many Collections)
+    * @param grain Number of consecutive regions a thread claims at a time
+    */
+    FsmParallelCollection(FsmThreadPool* pool, size_t grain=1) : _pool(pool), _grain(grain), _now(0), _regionBudget(0), _regionStarted(0),
+      _resuming(false), FsmCollection() { 
+      _recordClass();
+    }
+   
+   /**
+    * the regions run concurrently, which the table interpreter does not model
+    */
+    virtual void describe(FsmDescription& description) {
+      FsmUpdatable::describe(description);
+    }
+    
+    virtual void transitionAncestorToNext(FsmIndex depth);
+    virtual void transitionAncestorToPrevious(FsmIndex depth);
+    virtual void transitionAncestorTo(FsmIndex childInd, FsmIndex depth);
+    virtual void transitionAncestorToStart(FsmIndex depth);
+   
+   /**
+    * transitions leaving a region must be deferred, so handles that would cross the Collection are left unbound (and walk)
+    */
+    virtual bool resolveTransition(FsmTransition& /*transition*/, FsmIndex /*depth*/) {
+      return false;
+    }
+    
+   /**
+    * over-ride saveState to record which regions stopped short
+    */
+    virtual void saveState(FsmSnapshotWriter& writer);
+    
+   /**
+    * over-ride restoreState to finish the pass in the regions that stopped short
+    */
+    virtual void restoreState(FsmSnapshotReader& reader);
+};
+
+#endif  // ARDUINO
+
+#endif  // _FSM_PARALLEL_H
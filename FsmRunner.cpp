@@ -0,0 +1,53 @@
+#ifndef ARDUINO
+
+#include <FsmRunner.h>
+
+#include <chrono>
+
+bool FsmRunner::runOnce() {
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_stop) {
+      return false;
+    }
+    
+    _wakeup = false;
+  }
+  
+  _root->update();
+  _updateCount++;
+  
+  unsigned long wait = _root->timeToDeadline();
+  if (wait > _maxSleep) {
+    wait = _maxSleep;
+  }
+  
+  std::unique_lock<std::mutex> lock(_mutex);
+  
+  if (wait == FSM_NO_DEADLINE) {
+    _signal.wait(lock, [this] { return _wakeup || _stop; });
+  }
+  else if (wait > 0) {
+    _signal.wait_for(lock, std::chrono::milliseconds(wait), [this] { return _wakeup || _stop; });
+  }
+  
+  return !_stop;
+}
+
+void FsmRunner::run() {
+  while (runOnce()) { }
+}
+
+void FsmRunner::wakeup() {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _wakeup = true;
+  _signal.notify_all();
+}
+
+void FsmRunner::stop() {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _stop = true;
+  _signal.notify_all();
+}
+
+#endif  // ARDUINO
@@ -0,0 +1,81 @@
+/** @file FsmRunner.h 
+  *  Copyright (c) 2016 Ozbotics 
+  *  Distributed under the MIT license (see LICENSE)
+  */ 
+#ifndef _FSM_RUNNER_H
+ #define _FSM_RUNNER_H
+
+#ifndef ARDUINO
+
+#include <FSM.h>
+
+#include <condition_variable>
+#include <mutex>
+
+/**
+ * Host run loop for an FSM that sleeps while there is nothing to do
+ *
+ * Rather than calling root.update() continuously, the runner updates the root
+ *  then sleeps until the root's earliest deadline (see FsmUpdatable::timeToDeadline()) 
+ *  or until another thread calls wakeup(), eg; after changing a Value the FSM depends on.
+ *
+ * On Arduino the same idea applies in loop(): 
+ *   root.update(); 
+ *   then sleep for root.timeToDeadline() milliseconds (or until an interrupt)
+ */
+class FsmRunner {
+  protected:
+    FsmUpdatable* _root;              /**< protected variable _root The FSM being run */
+    unsigned long _maxSleep;          /**< protected variable _maxSleep Longest sleep (ms) between updates, FSM_NO_DEADLINE for no limit */
+    unsigned long _updateCount;       /**< protected variable _updateCount Number of updates so far */
+    
+    std::mutex _mutex;                /**< protected variable _mutex Guards _wakeup & _stop */
+    std::condition_variable _signal;  /**< protected variable _signal Signalled by wakeup() & stop() */
+    bool _wakeup;                     /**< protected variable _wakeup Has wakeup() been called since the last update */
+    bool _stop;                       /**< protected variable _stop Has stop() been called */
+
+  public:
+   /**
+    * Constructor
+    *
+    * @param root The FSM to run
+    * @param maxSleep Longest sleep (ms) between updates, defaults to no limit
+    */
+    FsmRunner(FsmUpdatable* root, unsigned long maxSleep=FSM_NO_DEADLINE) : 
+      _root(root), _maxSleep(maxSleep), _updateCount(0), _wakeup(false), _stop(false) { }
+    
+   /**
+    * update the root once, then sleep until its next deadline, wakeup() or stop()
+    *
+    * @return false once stop() has been called
+    */
+    bool runOnce();
+    
+   /**
+    * call runOnce() until stop() is called
+    */
+    void run();
+    
+   /**
+    * wake the runner so that the root is updated promptly
+    *  safe to call from any thread
+    */
+    void wakeup();
+    
+   /**
+    * make run() return
+    *  safe to call from any thread
+    */
+    void stop();
+    
+   /**
+    * get the number of root updates so far
+    */
+    unsigned long getUpdateCount() {
+      return _updateCount;
+    }
+};
+
+#endif  // ARDUINO
+
+#endif  // _FSM_RUNNER_H
@@ -0,0 +1,59 @@
+#ifndef ARDUINO
+
+#include <FsmSimulator.h>
+
+FsmSimulator* FsmSimulator::_current = NULL;
+
+FsmSimulator::FsmSimulator(FsmUpdatable* root, unsigned long tick) : _root(root), _tick(tick ? tick : 1), _updateCount(0) {
+  _now = (uint64_t) millis() * 1000;
+  
+  _previous = _current;
+  _current = this;
+  _previousClock = setHostClock(_clock);
+}
+
+FsmSimulator::~FsmSimulator() {
+  _current = _previous;
+  setHostClock(_previousClock);
+}
+
+uint64_t FsmSimulator::_clock() {
+  return _current->_now;
+}
+
+unsigned long FsmSimulator::run(unsigned long duration) {
+  uint64_t end = _now + (uint64_t) duration * 1000;
+  unsigned long updates = 0;
+  unsigned int instant = 0;
+  
+  while (_now < end) {
+    _root->update();
+    updates++;
+    
+    unsigned long wait = _root->timeToDeadline();
+    
+    if (wait == 0) {
+      // due again: update at the same instant, unless it is polling
+      if (++instant < FSM_SIMULATOR_UPDATES_PER_INSTANT) {
+        continue;
+      }
+      
+      wait = _tick;
+    }
+    
+    instant = 0;
+    
+    if ((wait == FSM_NO_DEADLINE) || ((uint64_t) wait * 1000 >= end - _now)) {
+      _now = end;
+    }
+    else {
+      _now += (uint64_t) wait * 1000;
+    }
+  }
+  
+  _updateCount += updates;
+  
+  return updates;
+}
+
+#endif  // ARDUINO
@@ -0,0 +1,103 @@
+/** @file FsmSimulator.h
+  *  Copyright (c) 2016 Ozbotics
+  *  Distributed under the MIT license (see LICENSE)
+  */
+#ifndef _FSM_SIMULATOR_H
+ #define _FSM_SIMULATOR_H
+
+#ifndef ARDUINO
+
+#include <FSM.h>
+
+/**
+ * updates at one simulated instant before the clock is advanced by the tick
+ *  (so that States that are always due, eg; a polled Select, cannot stall the simulation)
+ */
+#ifndef FSM_SIMULATOR_UPDATES_PER_INSTANT
+ #define FSM_SIMULATOR_UPDATES_PER_INSTANT 16
+#endif
+
+/**
+ * Host run loop for an FSM on a simulated clock, faster than real time
+ *
+ * While a simulator exists it replaces the clock behind millis() and micros() (see setHostClock()),
+ *  so every Timer, Delay and quiescent State runs on simulated time. run() updates the root, then,
+ *  rather than sleeping like FsmRunner, jumps the clock straight to the root's next deadline (see FsmUpdatable::timeToDeadline()).
+ *  An hour long Delay costs a couple of updates, and a run is deterministic: it depends only on the machine and the durations.
+ *
+ * While the root stays due (deadline 0) it is updated again at the same instant, up to FSM_SIMULATOR_UPDATES_PER_INSTANT times,
+ *  then the clock is advanced by the tick (the polling interval of a real loop()).
+ *
+ *   FsmSimulator simulator(&root);
+ *   simulator.run(24UL * 60 * 60 * 1000);   // a day of simulated time
+ *   ... change a Value, root.wake()
+ *   simulator.run(60 * 1000);
+ *
+ * Simulated time starts at the millis() the simulator is constructed, so Timers already running carry on.
+ *  One simulator is current at a time; destroying it restores the previous clock.
+ */
+class FsmSimulator {
+  protected:
+    static FsmSimulator* _current;    /**< protected variable _current The simulator whose clock is installed */
+    
+    FsmUpdatable* _root;              /**< protected variable _root The FSM being run */
+    uint64_t _now;                    /**< protected variable _now Simulated time, in microseconds */
+    unsigned long _tick;              /**< protected variable _tick Clock advance (ms) when the root stays due */
+    unsigned long _updateCount;       /**< protected variable _updateCount Number of updates so far */
+    FsmSimulator* _previous;          /**< protected variable _previous The simulator that was current before */
+    HostClock _previousClock;         /**< protected variable _previousClock The clock that was installed before */
+    
+    static uint64_t _clock();
+    
+  public:
+   /**
+    * Constructor
+    *  installs the simulated clock
+    *
+    * @param root The FSM to run
+    * @param tick Clock advance (ms) when the root stays due, eg; while polling
+    */
+    FsmSimulator(FsmUpdatable* root, unsigned long tick=1);
+    
+   /**
+    * Destructor
+    *  restores the previous clock
+    */
+    ~FsmSimulator();
+    
+   /**
+    * run the root for a period of simulated time
+    *  the root is updated at each deadline before the end; one due at the end is left for the next run()
+    *
+    * @param duration Simulated milliseconds
+    * @return the number of updates
+    */
+    unsigned long run(unsigned long duration);
+    
+   /**
+    * advance the clock without updating the root
+    *
+    * @param duration Simulated milliseconds
+    */
+    void advance(unsigned long duration) {
+      _now += (uint64_t) duration * 1000;
+    }
+    
+   /**
+    * get the simulated millis()
+    */
+    unsigned long now() {
+      return (unsigned long)(_now / 1000);
+    }
+    
+   /**
+    * get the number of root updates so far
+    */
+    unsigned long getUpdateCount() {
+      return _updateCount;
+    }
+};
+
+#endif  // ARDUINO
+
+#endif  // _FSM_SIMULATOR_H
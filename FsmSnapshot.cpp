@@ -0,0 +1,128 @@
+#include <FsmSnapshot.h>
+#include <FSM.h>
+
+/*
+ * header: "FSM", version, FSM count (2), fingerprint (2), record bytes (4), checksum of the records (2)
+ */
+
+uint16_t FsmSnapshot::_fingerprint(FsmUpdatable* fsm, uint16_t fingerprint, uint16_t& count) {
+  FsmDescription description;
+  fsm->describe(description);
+  
+  FsmCollection* collection = fsm->asCollection();
+  FsmIndex childCount = collection ? collection->getChildCount() : 0;
+  
+  fingerprint = (fingerprint * 31) + description.kind;
+  fingerprint = (fingerprint * 31) + childCount;
+  count++;
+  
+  for (FsmIndex i=0; i<childCount; i++) {
+    fingerprint = _fingerprint(collection->getChild(i), fingerprint, count);
+  }
+  
+  return fingerprint;
+}
+
+void FsmSnapshot::_save(FsmUpdatable* fsm, FsmSnapshotWriter& writer) {
+  fsm->saveState(writer);
+  
+  FsmCollection* collection = fsm->asCollection();
+  if (collection) {
+    for (FsmIndex i=0; i<collection->getChildCount(); i++) {
+      _save(collection->getChild(i), writer);
+    }
+  }
+}
+
+void FsmSnapshot::_restore(FsmUpdatable* fsm, FsmSnapshotReader& reader) {
+  fsm->restoreState(reader);
+  
+  FsmCollection* collection = fsm->asCollection();
+  if (collection) {
+    for (FsmIndex i=0; (i<collection->getChildCount()) && !reader.isFailed(); i++) {
+      _restore(collection->getChild(i), reader);
+    }
+  }
+}
+
+uint16_t FsmSnapshot::_checksum(const byte* data, size_t size) {
+  // Fletcher-16, reducing once per block (the sums cannot overflow 32 bits within 4096 bytes)
+  uint32_t sum1 = 0;
+  uint32_t sum2 = 0;
+  
+  while (size) {
+    size_t block = (size < 4096) ? size : 4096;
+    size -= block;
+    
+    while (block--) {
+      sum1 += *data++;
+      sum2 += sum1;
+    }
+    
+    sum1 %= 255;
+    sum2 %= 255;
+  }
+  
+  return (uint16_t)((sum2 << 8) | sum1);
+}
+
+size_t FsmSnapshot::save(FsmUpdatable* root, byte* buffer, size_t capacity) {
+  uint16_t count = 0;
+  uint16_t fingerprint = _fingerprint(root, 0, count);
+  
+  // the records first, then the header that describes them
+  bool fits = capacity > FSM_SNAPSHOT_HEADER_SIZE;
+  FsmSnapshotWriter records(fits ? buffer + FSM_SNAPSHOT_HEADER_SIZE : NULL, fits ? capacity - FSM_SNAPSHOT_HEADER_SIZE : 0, millis());
+  _save(root, records);
+  
+  size_t size = FSM_SNAPSHOT_HEADER_SIZE + records.getSize();
+  
+  if (size <= capacity) {
+    FsmSnapshotWriter header(buffer, FSM_SNAPSHOT_HEADER_SIZE, 0);
+    
+    header.writeByte('F');
+    header.writeByte('S');
+    header.writeByte('M');
+    header.writeByte(FSM_SNAPSHOT_VERSION);
+    header.writeUInt16(count);
+    header.writeUInt16(fingerprint);
+    header.writeUInt32((uint32_t) records.getSize());
+    header.writeUInt16(_checksum(buffer + FSM_SNAPSHOT_HEADER_SIZE, records.getSize()));
+  }
+  
+  return size;
+}
+
+bool FsmSnapshot::restore(FsmUpdatable* root, const byte* buffer, size_t size) {
+  if (size < FSM_SNAPSHOT_HEADER_SIZE) {
+    return false;
+  }
+  
+  FsmSnapshotReader header(buffer, FSM_SNAPSHOT_HEADER_SIZE, 0);
+  
+  if ((header.readByte() != 'F') || (header.readByte() != 'S') || (header.readByte() != 'M') ||
+      (header.readByte() != FSM_SNAPSHOT_VERSION)) {
+    return false;
+  }
+  
+  uint16_t savedCount = header.readUInt16();
+  uint16_t savedFingerprint = header.readUInt16();
+  uint32_t recordSize = header.readUInt32();
+  uint16_t savedChecksum = header.readUInt16();
+  
+  if ((recordSize != size - FSM_SNAPSHOT_HEADER_SIZE) || 
+      (_checksum(buffer + FSM_SNAPSHOT_HEADER_SIZE, recordSize) != savedChecksum)) {
+    return false;
+  }
+  
+  uint16_t count = 0;
+  
+  if ((_fingerprint(root, 0, count) != savedFingerprint) || (count != savedCount)) {
+    return false;
+  }
+  
+  FsmSnapshotReader records(buffer + FSM_SNAPSHOT_HEADER_SIZE, recordSize, millis());
+  _restore(root, records);
+  
+  return !records.isFailed() && records.isAtEnd();
+}
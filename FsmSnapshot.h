@@ -0,0 +1,221 @@
+/** @file FsmSnapshot.h
+  *  Copyright (c) 2016 Ozbotics
+  *  Distributed under the MIT license (see LICENSE)
+  */
+#ifndef _FSM_SNAPSHOT_H
+ #define _FSM_SNAPSHOT_H
+
+#include <Arduino.h>
+
+#include "FsmConfig.h"
+
+class FsmUpdatable;
+
+#define FSM_SNAPSHOT_VERSION 3      /**< format of the blobs written by FsmSnapshot::save() */
+#define FSM_SNAPSHOT_HEADER_SIZE 14 /**< bytes before the per FSM records */
+
+/**
+ * Bits of the flags byte that starts each FSM's record
+ */
+enum FsmSnapshotFlag {
+  FSM_SNAPSHOT_QUIESCENT  = 0x01,  /**< FsmUpdatable::isQuiescent() */
+  FSM_SNAPSHOT_WAKE_TIMED = 0x02,  /**< FsmUpdatable::isWakeTimed(), the time to wake follows */
+  FSM_SNAPSHOT_ENTERED    = 0x04   /**< FsmState::isEntered() */
+};
+
+/**
+ * Writes the records of a snapshot (see FsmUpdatable::saveState())
+ *
+ * Integers are written little endian, whatever the platform, and times as the milliseconds remaining
+ *  (so that a snapshot can be restored after millis() has restarted).
+ *  Once the buffer is full, writes are only counted (so that the required size is known).
+ */
+class FsmSnapshotWriter {
+  protected:
+    byte* _buffer;        /**< protected variable _buffer Where to write */
+    size_t _capacity;     /**< protected variable _capacity Size of _buffer */
+    size_t _size;         /**< protected variable _size Bytes written (or that would have been) */
+    unsigned long _now;   /**< protected variable _now millis() when the snapshot was started */
+
+  public:
+   /**
+    * Constructor
+    *
+    * @param buffer Where to write
+    * @param capacity Size of buffer
+    * @param now millis() at which the snapshot is taken
+    */
+    FsmSnapshotWriter(byte* buffer, size_t capacity, unsigned long now) : _buffer(buffer), _capacity(capacity), _size(0), _now(now) { }
+
+    void writeByte(byte value) {
+      if (_size < _capacity) {
+        _buffer[_size] = value;
+      }
+
+      _size++;
+    }
+
+    void writeUInt16(uint16_t value) {
+      writeByte((byte) value);
+      writeByte((byte)(value >> 8));
+    }
+
+    void writeUInt32(uint32_t value) {
+      writeUInt16((uint16_t) value);
+      writeUInt16((uint16_t)(value >> 16));
+    }
+
+   /**
+    * write a millis() time, as the time remaining until it (0 if it has passed)
+    */
+    void writeTime(unsigned long time) {
+      int32_t remaining = (int32_t) ((uint32_t) time - (uint32_t) _now);
+
+      writeUInt32((remaining > 0) ? (uint32_t) remaining : 0);
+    }
+
+   /**
+    * get the number of bytes written (or that would have been, had the buffer been large enough)
+    */
+    size_t getSize() {
+      return _size;
+    }
+
+   /**
+    * get the millis() at which the snapshot is taken
+    */
+    unsigned long getNow() {
+      return _now;
+    }
+};
+
+/**
+ * Reads the records of a snapshot (see FsmUpdatable::restoreState())
+ *
+ * Reading past the end returns zeros and marks the reader as failed.
+ */
+class FsmSnapshotReader {
+  protected:
+    const byte* _buffer;  /**< protected variable _buffer Where to read */
+    size_t _size;         /**< protected variable _size Size of _buffer */
+    size_t _position;     /**< protected variable _position Bytes read */
+    unsigned long _now;   /**< protected variable _now millis() when the restore was started */
+    bool _failed;         /**< protected variable _failed Read past the end */
+
+  public:
+   /**
+    * Constructor
+    *
+    * @param buffer Where to read
+    * @param size Size of buffer
+    * @param now millis() at which the snapshot is restored
+    */
+    FsmSnapshotReader(const byte* buffer, size_t size, unsigned long now) : _buffer(buffer), _size(size), _position(0), _now(now), _failed(false) { }
+
+    byte readByte() {
+      if (_position >= _size) {
+        _failed = true;
+        return 0;
+      }
+
+      return _buffer[_position++];
+    }
+
+    uint16_t readUInt16() {
+      uint16_t low = readByte();
+
+      return low | ((uint16_t) readByte() << 8);
+    }
+
+    uint32_t readUInt32() {
+      uint32_t low = readUInt16();
+
+      return low | ((uint32_t) readUInt16() << 16);
+    }
+
+   /**
+    * read a time written by FsmSnapshotWriter::writeTime(), as a millis() time
+    */
+    unsigned long readTime() {
+      return _now + readUInt32();
+    }
+
+   /**
+    * mark the snapshot as not matching the FSM (eg; from a user FSM that finds an unexpected value)
+    */
+    void fail() {
+      _failed = true;
+    }
+
+    bool isFailed() {
+      return _failed;
+    }
+
+   /**
+    * have all the bytes been read
+    */
+    bool isAtEnd() {
+      return _position == _size;
+    }
+
+   /**
+    * get the millis() at which the snapshot is restored
+    */
+    unsigned long getNow() {
+      return _now;
+    }
+};
+
+/**
+ * Saves the runtime configuration of an FSM tree to a compact binary blob, and restores it
+ *
+ * The blob holds, for every FSM in the tree (depth first), whether it is entered and quiescent,
+ *  the focused State of Sequences, the last value seen by Selects and the time remaining on the Timers they start,
+ *  and whatever user FSMs add (see FsmUpdatable::saveState()). Compiled FsmTables and FsmBanks save their nodes.
+ *
+ * restore() puts the tree back into the saved configuration without running any enter actions:
+ *  the next update() carries on where the saved machine left off. Time does not pass while a snapshot is stored,
+ *  ie; a Delay resumes with the time it had remaining.
+ *
+ * The header carries a version, the number of FSMs, a fingerprint of the tree's shape (kinds and child counts)
+ *  and a checksum, so a blob from another build of the machine (or a corrupted one) is rejected before the tree is touched.
+ *  Operands (Values, Enumerators, ...) belong to the application and are not saved.
+ *
+ *   byte blob[64];
+ *   size_t size = FsmSnapshot::save(&root, blob, sizeof(blob));
+ *   ... after a restart, having rebuilt the tree
+ *   FsmSnapshot::restore(&root, blob, size);
+ */
+class FsmSnapshot {
+  friend class FsmTable;
+  
+  protected:
+    static uint16_t _fingerprint(FsmUpdatable* fsm, uint16_t fingerprint, uint16_t& count);
+    static void _save(FsmUpdatable* fsm, FsmSnapshotWriter& writer);
+    static void _restore(FsmUpdatable* fsm, FsmSnapshotReader& reader);
+    static uint16_t _checksum(const byte* data, size_t size);
+
+  public:
+   /**
+    * save the tree's runtime configuration
+    *
+    * @param root The root of the tree
+    * @param buffer Where to write the blob
+    * @param capacity Size of buffer
+    * @return the size of the blob; if larger than capacity, the buffer does not hold a usable blob
+    */
+    static size_t save(FsmUpdatable* root, byte* buffer, size_t capacity);
+
+   /**
+    * restore the tree's runtime configuration
+    *
+    * @param root The root of a tree with the same shape as the one saved
+    * @param buffer The blob, from save()
+    * @param size Size of the blob
+    * @return false if the blob is not a valid snapshot of this tree (which is left unchanged,
+    *   unless a user FSM or compiled machine rejects its record part way, see FsmSnapshotReader::fail())
+    */
+    static bool restore(FsmUpdatable* root, const byte* buffer, size_t size);
+};
+
+#endif  // _FSM_SNAPSHOT_H
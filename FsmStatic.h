@@ -0,0 +1,537 @@
+/** @file FsmStatic.h 
+  *  Copyright (c) 2016 Ozbotics 
+  *  Distributed under the MIT license (see LICENSE)
+  */ 
+#ifndef _FSM_STATIC_H
+ #define _FSM_STATIC_H
+
+#include <FSM.h>
+
+/**
+ * Compile-time FSMs
+ *
+ * The FsmStatic* templates describe the same constructs as the runtime classes in FSM.h
+ *  (Sequence, Collection, Delay, Finish, BranchOnConditionFalse, SelectStateFromCondition, ...)
+ *  but as types. Children are held by value, so a whole machine is one object that can live in static storage,
+ *  and every update() is resolved at compile time (no virtual dispatch, no heap), letting the compiler inline the tick.
+ *
+ * For example, the runtime tree
+ *   FsmSequence* seq = new FsmSequence();
+ *   seq->addChild(new FsmBranchOnConditionFalse(&cond, 2));
+ *   seq->addChild(new FsmDelay(&duration));
+ *   seq->addChild(new FsmFinish());
+ *
+ * is written as
+ *   FsmStaticMachine< 
+ *     FsmStaticSequence<
+ *       FsmStaticBranchOnConditionFalse<&cond, 2>,
+ *       FsmStaticDelay<&duration>,
+ *       FsmStaticFinish 
+ *     > 
+ *   > machine;
+ *
+ * Transitions are returned from update() as an FsmStaticRequest, and travel up the tree by value.
+ *  Semantics match the runtime classes, with two simplifications:
+ *   a State may make at most one request per update (the first wins)
+ *   a Collection passes up at most one request per update (from its first requesting child)
+ *
+ * User defined States derive from FsmStaticState<Self>, hide any of _enterState(), _updateState(), _exitState()
+ *  and declare 'friend class FsmStaticState<Self>;'
+ *
+ * Static States have no traceId and no counters: they record no FsmTrace events, and FsmStats does not see them.
+ */
+
+/**
+ * The kinds of transition a static State can request
+ */
+enum FsmStaticOp {
+  FSM_STATIC_NONE,      /**< no request */
+  FSM_STATIC_NEXT,      /**< move the target Sequence to its next State */
+  FSM_STATIC_PREVIOUS,  /**< move the target Sequence to its previous State */
+  FSM_STATIC_TO,        /**< move the target Sequence to State 'index' */
+  FSM_STATIC_START,     /**< move the target Sequence to its start State */
+  FSM_STATIC_FINISH     /**< move the target Sequence to its start State, and its parent to its next State (see FsmFinish) */
+};
+
+/**
+ * A transition request, travelling up the tree
+ */
+struct FsmStaticRequest {
+  byte op;         /**< the FsmStaticOp */
+  FsmIndex depth;  /**< the number of ancestor hops remaining (parent=1) */
+  FsmIndex index;  /**< target State for FSM_STATIC_TO */
+
+  bool isNone() const {
+    return op == FSM_STATIC_NONE;
+  }
+
+  static FsmStaticRequest none() {
+    FsmStaticRequest request = { FSM_STATIC_NONE, 0, 0 };
+    return request;
+  }
+
+  static FsmStaticRequest make(byte op, FsmIndex depth, FsmIndex index=0) {
+    FsmStaticRequest request = { op, depth, index };
+    return request;
+  }
+};
+
+/* --------------------------------------------------------------------------------------- */
+
+/**
+ * The base of all static States (CRTP, Derived is the State itself)
+ *
+ * Mirrors FsmState: calls _enterState(), _updateState() & _exitState() as required
+ */
+template <class Derived>
+class FsmStaticState {
+  protected:
+    byte _flags;  /**< protected variable  _flags FSM_FLAG_ENTERED & FSM_FLAG_LEAVING */ 
+
+   /**
+    * hide this to define what happens when the State is Entered
+    */
+    FsmStaticRequest _enterState() { 
+      return FsmStaticRequest::none(); 
+    }
+
+   /**
+    * hide this to define what happens when the State is Updated
+    */
+    FsmStaticRequest _updateState() { 
+      return FsmStaticRequest::none(); 
+    }
+
+   /**
+    * hide this to define what happens when the State is Exited
+    */
+    void _exitState() { }
+
+   /**
+    * handle leaving the state.
+    *  calls _exitState()
+    */
+    void _leaveState() {
+      _self()._exitState();
+
+      _flags = 0;
+    }
+
+   /**
+    * make a transition request (see FsmState::_transitionAncestorTo())
+    *
+    * @param op The FsmStaticOp
+    * @param depth The number of ancestor hops (parent=1)
+    * @param index The target state for FSM_STATIC_TO
+    */
+    FsmStaticRequest _request(byte op, FsmIndex depth, FsmIndex index=0) {
+      if (depth == 1) {
+        _flags |= FSM_FLAG_LEAVING;
+      }
+
+      return FsmStaticRequest::make(op, depth, index);
+    }
+
+    Derived& _self() {
+      return *static_cast<Derived*>(this);
+    }
+
+  public:
+   /**
+    * Constructor
+    */
+    FsmStaticState() : _flags(0) { }
+
+   /**
+    * on update, call _enterState(), _updateState() & _exitState (via _leaveState()) as required
+    *
+    * @return any transition request for an ancestor
+    */
+    inline FsmStaticRequest update() {
+      FsmStaticRequest request = FsmStaticRequest::none();
+
+      if (!(_flags & FSM_FLAG_ENTERED)) {
+        _flags |= FSM_FLAG_ENTERED;
+        request = _self()._enterState();
+      }
+
+      FsmStaticRequest updateRequest = _self()._updateState();
+      if (request.isNone()) {
+        request = updateRequest;
+      }
+
+      if (_flags & FSM_FLAG_LEAVING) {
+        _self()._leaveState();
+      }
+
+      return request;
+    }
+
+   /**
+    * on forceExit, call _exitState (via _leaveState())
+    */
+    inline void forceExit() {
+      _self()._leaveState();
+    }
+};
+
+/* --------------------------------------------------------------------------------------- */
+
+/**
+ * Holds the children of a static Collection by value
+ */
+template <class... Children>
+class FsmStaticChildren;
+
+template <>
+class FsmStaticChildren<> {
+  public:
+    static const FsmIndex count = 0;
+
+    inline FsmStaticRequest updateAll() { return FsmStaticRequest::none(); }
+    inline FsmStaticRequest updateAt(FsmIndex) { return FsmStaticRequest::none(); }
+    inline void forceExitAll() { }
+    inline void forceExitAt(FsmIndex) { }
+};
+
+template <class Head, class... Tail>
+class FsmStaticChildren<Head, Tail...> {
+  protected:
+    Head _head;                      /**< protected variable _head The first child */
+    FsmStaticChildren<Tail...> _tail; /**< protected variable _tail The remaining children */
+
+  public:
+    static const FsmIndex count = 1 + sizeof...(Tail);
+
+   /**
+    * update every child
+    *
+    * @return the first transition request made
+    */
+    inline FsmStaticRequest updateAll() {
+      FsmStaticRequest request = _head.update();
+      FsmStaticRequest tailRequest = _tail.updateAll();
+
+      return request.isNone() ? tailRequest : request;
+    }
+
+   /**
+    * update the child at index
+    */
+    inline FsmStaticRequest updateAt(FsmIndex index) {
+      return (index == 0) ? _head.update() : _tail.updateAt(index - 1);
+    }
+
+    inline void forceExitAll() {
+      _head.forceExit();
+      _tail.forceExitAll();
+    }
+
+    inline void forceExitAt(FsmIndex index) {
+      if (index == 0) {
+        _head.forceExit();
+      }
+      else {
+        _tail.forceExitAt(index - 1);
+      }
+    }
+
+    Head& head() { return _head; }
+    FsmStaticChildren<Tail...>& tail() { return _tail; }
+};
+
+/**
+ * The index of State T amongst Children, as a constant
+ *  eg; FsmStaticIndexOf<FsmStaticFinish, A, B, FsmStaticFinish>::value == 2
+ */
+template <class T, class... Children>
+struct FsmStaticIndexOf;
+
+template <class T, class... Tail>
+struct FsmStaticIndexOf<T, T, Tail...> {
+  static const FsmIndex value = 0;
+};
+
+template <class T, class Head, class... Tail>
+struct FsmStaticIndexOf<T, Head, Tail...> {
+  static const FsmIndex value = 1 + FsmStaticIndexOf<T, Tail...>::value;
+};
+
+/* --------------------------------------------------------------------------------------- */
+
+/**
+ * A static Collection (see FsmCollection), all children are updated
+ */
+template <class... Children>
+class FsmStaticCollection : public FsmStaticState<FsmStaticCollection<Children...> > {
+  friend class FsmStaticState<FsmStaticCollection<Children...> >;
+  typedef FsmStaticState<FsmStaticCollection<Children...> > Base;
+
+  protected:
+    FsmStaticChildren<Children...> _children;  /**< protected variable _children The child States */
+
+    inline FsmStaticRequest _updateState() {
+      FsmStaticRequest request = _children.updateAll();
+
+      if (request.isNone()) {
+        return request;
+      }
+
+      // a Collection has no focus, so only requests for ancestors are honoured
+      if (request.depth == 1) {
+        if (request.op == FSM_STATIC_FINISH) {
+          return this->_request(FSM_STATIC_NEXT, 1);
+        }
+
+        return FsmStaticRequest::none();
+      }
+
+      return this->_request(request.op, request.depth - 1, request.index);
+    }
+
+    void _leaveState() {
+      Base::_leaveState();
+      _children.forceExitAll();
+    }
+
+  public:
+    static const FsmIndex childCount = sizeof...(Children);
+
+    FsmStaticChildren<Children...>& children() { return _children; }
+};
+
+/* --------------------------------------------------------------------------------------- */
+
+/**
+ * The base of static Sequences (see FsmSequence), only the focused child is updated
+ */
+template <class Derived, FsmIndex StartInd, class... Children>
+class FsmStaticSequenceBase : public FsmStaticState<Derived> {
+  friend class FsmStaticState<Derived>;
+  typedef FsmStaticState<Derived> Base;
+
+  protected:
+    FsmStaticChildren<Children...> _children;  /**< protected variable _children The child States */
+    FsmIndex _currentChildInd;                 /**< protected variable _currentChildInd Index of the focused State */
+
+    void _transitionTo(FsmIndex childInd) {
+      _currentChildInd = (childInd < childCount) ? childInd : StartInd;
+    }
+
+    void _transitionToPrevious() {
+      _currentChildInd = (_currentChildInd == 0) ? childCount - 1 : _currentChildInd - 1;
+    }
+
+   /**
+    * apply or pass on a request from the focused child
+    */
+    inline FsmStaticRequest _handle(FsmStaticRequest request) {
+      if (request.isNone()) {
+        return request;
+      }
+
+      if (request.depth > 1) {
+        return this->_request(request.op, request.depth - 1, request.index);
+      }
+
+      switch (request.op) {
+        case FSM_STATIC_NEXT:
+          _transitionTo(_currentChildInd + 1);
+          break;
+
+        case FSM_STATIC_PREVIOUS:
+          _transitionToPrevious();
+          break;
+
+        case FSM_STATIC_TO:
+          _transitionTo(request.index);
+          break;
+
+        case FSM_STATIC_START:
+          _currentChildInd = StartInd;
+          break;
+
+        case FSM_STATIC_FINISH:
+          _currentChildInd = StartInd;
+          return this->_request(FSM_STATIC_NEXT, 1);
+      }
+
+      return FsmStaticRequest::none();
+    }
+
+    inline FsmStaticRequest _updateState() {
+      return _handle(_children.updateAt(_currentChildInd));
+    }
+
+    void _leaveState() {
+      Base::_leaveState();
+      _children.forceExitAt(_currentChildInd);
+    }
+
+  public:
+    static const FsmIndex childCount = sizeof...(Children);
+    static const FsmIndex startChildInd = StartInd;
+
+    FsmStaticSequenceBase() : _currentChildInd(StartInd) { }
+
+   /**
+    * over-ride forceExit to reset focus to start State
+    */
+    inline void forceExit() {
+      Base::forceExit();
+      _currentChildInd = StartInd;
+    }
+
+    FsmIndex getCurrentChildInd() { return _currentChildInd; }
+    FsmStaticChildren<Children...>& children() { return _children; }
+};
+
+/**
+ * A static Sequence starting at its first child
+ */
+template <class... Children>
+class FsmStaticSequence : public FsmStaticSequenceBase<FsmStaticSequence<Children...>, 0, Children...> { };
+
+/**
+ * A static Sequence starting at child StartInd (see FsmSequence(FsmIndex startChildInd))
+ */
+template <FsmIndex StartInd, class... Children>
+class FsmStaticSequenceFrom : public FsmStaticSequenceBase<FsmStaticSequenceFrom<StartInd, Children...>, StartInd, Children...> { };
+
+/**
+ * Choose between two states based on a Condition (see FsmSelectStateFromCondition)
+ *  FalseState is focused while the Condition is false, TrueState while it is true
+ */
+template <Value<bool>* V, class FalseState, class TrueState>
+class FsmStaticSelectStateFromCondition : 
+  public FsmStaticSequenceBase<FsmStaticSelectStateFromCondition<V, FalseState, TrueState>, 0, FalseState, TrueState> {
+  
+  friend class FsmStaticState<FsmStaticSelectStateFromCondition<V, FalseState, TrueState> >;
+  typedef FsmStaticSequenceBase<FsmStaticSelectStateFromCondition<V, FalseState, TrueState>, 0, FalseState, TrueState> Base;
+
+  protected:
+    bool _oldValue;  /**< protected variable _oldValue last value */ 
+
+    FsmStaticRequest _enterState() {
+      _oldValue = V->getValue();
+      this->_transitionTo((FsmIndex) _oldValue);
+
+      return FsmStaticRequest::none();
+    }
+
+    inline FsmStaticRequest _updateState() {
+      bool value = V->getValue();
+
+      if (_oldValue != value) {
+        _oldValue = value;
+        this->_children.forceExitAt(this->_currentChildInd);
+        this->_transitionTo((FsmIndex) value);
+      }
+
+      return Base::_updateState();
+    }
+
+  public:
+    FsmStaticSelectStateFromCondition() : _oldValue(false) { }
+};
+
+/* --------------------------------------------------------------------------------------- */
+
+/**
+ * Remain in this State for the duration (see FsmDelay)
+ */
+template <Value<Duration>* DurationValue>
+class FsmStaticDelay : public FsmStaticState<FsmStaticDelay<DurationValue> > {
+  friend class FsmStaticState<FsmStaticDelay<DurationValue> >;
+
+  protected:
+    Timer _timer;  /**< protected variable  _timer Timer used to countdown duration */
+
+    FsmStaticRequest _enterState() {
+      _timer.start(DurationValue->getValue());
+
+      return FsmStaticRequest::none();
+    }
+
+    inline FsmStaticRequest _updateState() {
+      if (_timer.isComplete()) {
+        return this->_request(FSM_STATIC_NEXT, 1);
+      }
+
+      return FsmStaticRequest::none();
+    }
+};
+
+/**
+ * Marks the end of a Sequence (see FsmFinish)
+ */
+class FsmStaticFinish : public FsmStaticState<FsmStaticFinish> {
+  friend class FsmStaticState<FsmStaticFinish>;
+
+  protected:
+    FsmStaticRequest _enterState() {
+      return _request(FSM_STATIC_FINISH, 1);
+    }
+};
+
+/**
+ * Transition to next if the Condition is true, otherwise to BranchInd (see FsmBranchOnConditionFalse)
+ */
+template <Condition** C, FsmIndex BranchInd=0>
+class FsmStaticBranchOnConditionFalse : public FsmStaticState<FsmStaticBranchOnConditionFalse<C, BranchInd> > {
+  friend class FsmStaticState<FsmStaticBranchOnConditionFalse<C, BranchInd> >;
+
+  protected:
+    FsmStaticRequest _enterState() {
+      if ((*C)->getValue()) {
+        return this->_request(FSM_STATIC_NEXT, 1);
+      }
+
+      return this->_request(FSM_STATIC_TO, 1, BranchInd);
+    }
+};
+
+/**
+ * Call Action on entry, then transition to next
+ *  (the static equivalent of small enter-and-advance States such as FsmStartTimer or FsmDebugPrint)
+ */
+template <void (*Action)()>
+class FsmStaticAction : public FsmStaticState<FsmStaticAction<Action> > {
+  friend class FsmStaticState<FsmStaticAction<Action> >;
+
+  protected:
+    FsmStaticRequest _enterState() {
+      Action();
+
+      return this->_request(FSM_STATIC_NEXT, 1);
+    }
+};
+
+/**
+ * Do nothing until forced to exit (see FsmIdle)
+ */
+class FsmStaticIdle : public FsmStaticState<FsmStaticIdle> { };
+
+/* --------------------------------------------------------------------------------------- */
+
+/**
+ * The top of a static FSM
+ *  declare at file scope to keep the whole machine in static storage
+ */
+template <class Root>
+class FsmStaticMachine {
+  protected:
+    Root _root;  /**< protected variable _root The top State */
+
+  public:
+   /**
+    * update the machine, requests that reach the top are ignored (as with a runtime root)
+    */
+    inline void update() {
+      _root.update();
+    }
+
+    Root& root() { return _root; }
+};
+
+#endif  // _FSM_STATIC_H
@@ -0,0 +1,106 @@
+#include <FsmStats.h>
+#include <FSM.h>
+
+size_t FsmStats::_snapshot(FsmUpdatable* fsm, FsmIndex depth, FsmIndex index, FsmStatsRecord* out, size_t max, size_t count, unsigned long now) {
+  if (count < max) {
+    FsmStatsRecord& record = out[count];
+    FsmState* state = fsm->asState();
+
+    record.fsm = fsm;
+    record.depth = depth;
+    record.index = index;
+    record.entered = state && state->isEntered();
+    record.stats.clear();
+
+#ifdef FSM_STATS
+    if (state) {
+      record.stats = state->getStats();
+
+      if (record.entered) {
+        record.stats.timeInState += now - record.stats.enteredAt;
+      }
+    }
+#endif
+  }
+
+  count++;
+
+  FsmCollection* collection = fsm->asCollection();
+  if (collection) {
+    for (FsmIndex i=0; i<collection->getChildCount(); i++) {
+      count = _snapshot(collection->getChild(i), depth + 1, i, out, max, count, now);
+    }
+  }
+
+  return count;
+}
+
+size_t FsmStats::snapshot(FsmUpdatable* root, FsmStatsRecord* out, size_t max) {
+#ifdef FSM_STATS
+  unsigned long now = FSM_STATS_CLOCK();
+#else
+  unsigned long now = 0;
+#endif
+
+  return _snapshot(root, 0, 0, out, max, 0, now);
+}
+
+void FsmStats::reset(FsmUpdatable* root) {
+#ifdef FSM_STATS
+  FsmState* state = root->asState();
+
+  if (state) {
+    FsmStateStats& stats = state->getStats();
+    unsigned long enteredAt = stats.enteredAt;
+
+    stats.clear();
+
+    // a State that is entered now counts its current visit from the reset
+    if (state->isEntered()) {
+      stats.enteredAt = FSM_STATS_CLOCK();
+    }
+    else {
+      stats.enteredAt = enteredAt;
+    }
+  }
+
+  FsmCollection* collection = root->asCollection();
+  if (collection) {
+    for (FsmIndex i=0; i<collection->getChildCount(); i++) {
+      reset(collection->getChild(i));
+    }
+  }
+#else
+  (void) root;
+#endif
+}
+
+void FsmStats::print(Print& out, const FsmStatsRecord* records, size_t count) {
+  for (size_t n=0; n<count; n++) {
+    const FsmStatsRecord& record = records[n];
+
+    for (FsmIndex d=0; d<record.depth; d++) {
+      out.print(F("  "));
+    }
+
+    if (record.fsm->getName()) {
+      out.print(record.fsm->getName());
+    }
+    else {
+      out.print('[');
+      out.print((unsigned int) record.index);
+      out.print(']');
+    }
+
+    out.print(record.entered ? F(" * enters=") : F(" enters="));
+    out.print(record.stats.enterCount);
+    out.print(F(" updates="));
+    out.print(record.stats.updateCount);
+    out.print(F(" update="));
+    out.print(record.stats.updateTime);
+    out.print(F(" max="));
+    out.print(record.stats.maxUpdateTime);
+    out.print(F(" inState="));
+    out.println(record.stats.timeInState);
+  }
+}
@@ -0,0 +1,97 @@
+/** @file FsmStats.h
+  *  Copyright (c) 2016 Ozbotics
+  *  Distributed under the MIT license (see LICENSE)
+  */
+#ifndef _FSM_STATS_H
+ #define _FSM_STATS_H
+
+#include <Arduino.h>
+
+#include "FsmConfig.h"
+
+class FsmUpdatable;
+
+/**
+ * The performance counters of one FsmState (collected when FSM_STATS is defined)
+ *
+ * Times are FSM_STATS_CLOCK() ticks (microseconds by default), and wrap with it.
+ *  A Collection's update time includes its children's, so the hot States are those
+ *  whose update time is not accounted for by their children.
+ */
+struct FsmStateStats {
+  unsigned long enterCount;     /**< times the State was entered */
+  unsigned long updateCount;    /**< times _updateState() ran */
+  unsigned long updateTime;     /**< cumulative _updateState() time */
+  unsigned long maxUpdateTime;  /**< longest single _updateState() */
+  unsigned long timeInState;    /**< cumulative time from _enterState() to _leaveState() */
+  unsigned long enteredAt;      /**< FSM_STATS_CLOCK() when last entered */
+
+ /**
+  * zero the counters
+  */
+  void clear() {
+    enterCount = 0;
+    updateCount = 0;
+    updateTime = 0;
+    maxUpdateTime = 0;
+    timeInState = 0;
+    enteredAt = 0;
+  }
+};
+
+/**
+ * One FSM of an FsmStats::snapshot()
+ */
+struct FsmStatsRecord {
+  FsmUpdatable* fsm;    /**< the FSM */
+  FsmIndex depth;       /**< its depth in the tree (root=0) */
+  FsmIndex index;       /**< its index within its parent */
+  bool entered;         /**< it is currently entered (timeInState then includes the current visit) */
+  FsmStateStats stats;  /**< its counters (zero for FSMs that are not FsmStates) */
+};
+
+/**
+ * Collects the FsmState counters of a whole tree
+ *
+ * With FSM_STATS defined, each FsmState counts its enters and updates, and times its _updateState()
+ *  and its visits (from enter to leave). Without FSM_STATS the State carries no counters and
+ *  update() is unchanged; snapshot() then reports the tree with zero counters.
+ *
+ * Only FSMs that run FsmState::update() are counted: States compiled into an FsmTable or FsmBank are not,
+ *  and the FsmStatic templates carry no counters.
+ *
+ *   static FsmStatsRecord records[32];
+ *   size_t count = FsmStats::snapshot(&root, records, 32);
+ *   FsmStats::print(Serial, records, count);
+ */
+class FsmStats {
+  protected:
+    static size_t _snapshot(FsmUpdatable* fsm, FsmIndex depth, FsmIndex index, FsmStatsRecord* out, size_t max, size_t count, unsigned long now);
+
+  public:
+   /**
+    * copy the counters of every FSM in the tree (depth first, parents before children)
+    *
+    * @param root The root of the tree
+    * @param out Where to copy the records
+    * @param max Size of out
+    * @return the number of FSMs in the tree (records beyond max are not written)
+    */
+    static size_t snapshot(FsmUpdatable* root, FsmStatsRecord* out, size_t max);
+
+   /**
+    * zero the counters of every FSM in the tree
+    */
+    static void reset(FsmUpdatable* root);
+
+   /**
+    * print records as an indented table, one FSM per line
+    *
+    * @param out Where to print (eg; Serial)
+    * @param records From snapshot()
+    * @param count Number of records
+    */
+    static void print(Print& out, const FsmStatsRecord* records, size_t count);
+};
+
+#endif  // _FSM_STATS_H
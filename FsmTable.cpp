@@ -0,0 +1,785 @@
+#include <FsmTable.h>
+#include <string.h>
+
+/**
+ * is fsm exactly the built-in class of its kind (rather than a derived class that may behave differently)
+ */
+static bool _isExactly(byte kind, FsmUpdatable* fsm) {
+  switch (kind) {
+    case FSM_KIND_COLLECTION:                return FsmCollection::isExactly(fsm);
+    case FSM_KIND_SEQUENCE:                  return FsmSequence::isExactly(fsm);
+    case FSM_KIND_SELECT:                    return FsmSelectStateFromCondition::isExactly(fsm);
+    case FSM_KIND_DELAY:                     return FsmDelay::isExactly(fsm);
+    case FSM_KIND_START_TIMER:               return FsmStartTimer::isExactly(fsm);
+    case FSM_KIND_WAIT_TIMER:                return FsmWaitUntilTimerIsComplete::isExactly(fsm);
+    case FSM_KIND_FINISH:                    return FsmFinish::isExactly(fsm);
+    case FSM_KIND_BRANCH_ON_END_OF_LIST:     return FsmBranchOnEndOfList::isExactly(fsm);
+    case FSM_KIND_FINISH_ON_END_OF_LIST:     return FsmFinishOnEndOfList::isExactly(fsm);
+    case FSM_KIND_BRANCH_ON_CONDITION_FALSE: return FsmBranchOnConditionFalse::isExactly(fsm);
+    case FSM_KIND_ASSIGN_CONDITION:          return FsmAssignConditionToValue::isExactly(fsm);
+    case FSM_KIND_DEBUG_PRINT:               return FsmDebugPrint::isExactly(fsm);
+    case FSM_KIND_IDLE:                      return FsmIdle::isExactly(fsm);
+    case FSM_KIND_DEBUG_STATE:               return FsmDebugState::isExactly(fsm);
+  }
+  
+  return true;
+}
+
+void FsmTable::describeExact(FsmUpdatable* fsm, FsmDescription& description) {
+  fsm->describe(description);
+  
+  if (!_isExactly(description.kind, fsm)) {
+    description.kind = FSM_KIND_USER;
+  }
+}
+
+static bool _isCollectionKind(byte kind) {
+  return (kind == FSM_KIND_COLLECTION) || (kind == FSM_KIND_SEQUENCE) || (kind == FSM_KIND_SELECT);
+}
+
+static bool _isSequenceKind(byte kind) {
+  return (kind == FSM_KIND_SEQUENCE) || (kind == FSM_KIND_SELECT);
+}
+
+
+void FsmTableProxy::transitionAncestorToNext(FsmIndex depth) {
+  _table->_request(FSM_TABLE_NEXT, _node, depth);
+}
+
+void FsmTableProxy::transitionAncestorToPrevious(FsmIndex depth) {
+  _table->_request(FSM_TABLE_PREVIOUS, _node, depth);
+}
+
+void FsmTableProxy::transitionAncestorTo(FsmIndex childInd, FsmIndex depth) {
+  _table->_request(FSM_TABLE_TO, _node, depth, childInd);
+}
+
+void FsmTableProxy::transitionAncestorToStart(FsmIndex depth) {
+  _table->_request(FSM_TABLE_START, _node, depth);
+}
+
+void FsmTableProxy::_wakeProxied() {
+  if (_table) {
+    _table->_wakePath(_node);
+  }
+}
+
+bool FsmTableProxy::_leaveProxied() {
+  return _table && _table->_leavePath(_node);
+}
+
+
+void FsmTable::_clear() {
+  // give user defined FSMs back their original parents
+  for (uint16_t n=0; n<_nodeCount; n++) {
+    if (_nodes[n].kind == FSM_KIND_USER) {
+      _userFsm(n)->setParent((FsmCollection*) _operands[_nodes[n].operand + 1]);
+    }
+  }
+  
+  FsmArena::release(_nodes);
+  FsmArena::release(_operands);
+  delete[] _proxies;
+  FsmArena::release(_strings);
+  
+  _nodes = NULL;
+  _nodeCount = 0;
+  _operands = NULL;
+  _operandCount = 0;
+  _proxies = NULL;
+  _proxyCount = 0;
+  _strings = NULL;
+  _stringsSize = 0;
+}
+
+uint16_t FsmTable::_countNodes(FsmUpdatable* fsm, uint16_t* userCount, size_t* stringsSize) {
+  FsmDescription description;
+  describeExact(fsm, description);
+  
+  if (description.kind == FSM_KIND_USER) {
+    (*userCount)++;
+    return 1;
+  }
+  
+  if ((description.kind == FSM_KIND_DEBUG_PRINT) || (description.kind == FSM_KIND_DEBUG_STATE)) {
+    *stringsSize += strlen((const char*) description.operand1) + 1;
+  }
+  
+  unsigned long count = 1;
+  
+  if (_isCollectionKind(description.kind)) {
+    FsmCollection* collection = fsm->asCollection();
+    
+    for (FsmIndex i=0; i<collection->getChildCount(); i++) {
+      count += _countNodes(collection->getChild(i), userCount, stringsSize);
+      
+      if (count >= FSM_TABLE_NONE) {
+        return FSM_TABLE_NONE;
+      }
+    }
+  }
+  
+  return (uint16_t) count;
+}
+
+bool FsmTable::compile(FsmUpdatable* root) {
+  _clear();
+  root->resolve();
+  
+  uint16_t userCount = 0;
+  size_t stringsSize = 0;
+  uint16_t count = _countNodes(root, &userCount, &stringsSize);
+  
+  if (count == FSM_TABLE_NONE) {
+    return false;
+  }
+  
+  FsmUpdatable** queue = (FsmUpdatable**) malloc(count * sizeof(FsmUpdatable*));
+  _nodes = (FsmTableNode*) FsmArena::allocateCleared(count * sizeof(FsmTableNode));
+  _operands = (void**) FsmArena::allocate(2 * count * sizeof(void*));
+  _proxies = userCount ? new FsmTableProxy[userCount] : NULL;
+  _strings = stringsSize ? (char*) FsmArena::allocate(stringsSize) : NULL;
+  
+  if (!queue || !_nodes || !_operands || (userCount && !_proxies) || (stringsSize && !_strings)) {
+    free(queue);
+    _clear();
+    return false;
+  }
+  
+  // breadth first, so that the children of each node are contiguous
+  uint16_t tail = 1;
+  queue[0] = root;
+  _nodes[0].parent = FSM_TABLE_NONE;
+  
+  for (uint16_t n=0; n<count; n++) {
+    FsmUpdatable* fsm = queue[n];
+    FsmTableNode& node = _nodes[n];
+    FsmDescription description;
+    describeExact(fsm, description);
+    
+    node.kind = description.kind;
+    node.operand = _operandCount;
+#ifdef FSM_TRACE
+    node.traceId = fsm->traceId;
+#endif
+    
+    if (description.kind == FSM_KIND_USER) {
+      FsmTableProxy* proxy = &_proxies[_proxyCount++];
+      proxy->attach(this, node.parent);
+      
+      _operands[_operandCount++] = fsm;
+      _operands[_operandCount++] = fsm->getParent();
+      fsm->setParent(proxy);
+      fsm->resolve();
+      _nodeCount++;
+      continue;
+    }
+    
+    // nothing that the tree owns, so that a tree of built-in FSMs can be deleted once compiled
+    if ((description.kind == FSM_KIND_DEBUG_PRINT) || (description.kind == FSM_KIND_DEBUG_STATE)) {
+      char* copy = _strings + _stringsSize;
+      
+      strcpy(copy, (const char*) description.operand1);
+      _stringsSize += strlen(copy) + 1;
+      description.operand1 = copy;
+    }
+    else if (description.kind == FSM_KIND_DELAY) {
+      // the node's wakeTime is the deadline of the Delay's own Timer
+      description.operand1 = NULL;
+    }
+    
+    _operands[_operandCount++] = description.operand1;
+    _operands[_operandCount++] = description.operand2;
+    
+    if (_isCollectionKind(description.kind)) {
+      FsmCollection* collection = fsm->asCollection();
+      
+      node.firstChild = tail;
+      node.childCount = collection->getChildCount();
+      node.startChildInd = (description.kind == FSM_KIND_SEQUENCE) ? description.index : 0;
+      node.currentChildInd = node.startChildInd;
+      node.microsteps = description.microsteps ? description.microsteps : 1;
+      
+      for (FsmIndex i=0; i<node.childCount; i++) {
+        queue[tail] = collection->getChild(i);
+        _nodes[tail].parent = n;
+        tail++;
+      }
+    }
+    else {
+      node.branchInd = description.index;
+    }
+    
+    _nodeCount++;
+  }
+  
+  free(queue);
+  
+  // resolve branch targets against their parent, as FsmSequence::_transitionTo() would
+  for (uint16_t n=1; n<_nodeCount; n++) {
+    FsmTableNode& node = _nodes[n];
+    FsmTableNode& parent = _nodes[node.parent];
+    
+    if (((node.kind == FSM_KIND_BRANCH_ON_END_OF_LIST) || (node.kind == FSM_KIND_BRANCH_ON_CONDITION_FALSE)) && 
+        (node.branchInd >= parent.childCount)) {
+      node.branchInd = parent.startChildInd;
+    }
+  }
+  
+  // pair each wait with the one start of its Timer, as FsmWaitUntilTimerIsComplete::resolve() would
+  for (uint16_t n=0; n<_nodeCount; n++) {
+    FsmTableNode& node = _nodes[n];
+    
+    if (node.kind != FSM_KIND_WAIT_TIMER) {
+      continue;
+    }
+    
+    byte count = 0;
+    node.starter = FSM_TABLE_NONE;
+    
+    for (uint16_t m=0; m<_nodeCount; m++) {
+      if ((_nodes[m].kind == FSM_KIND_START_TIMER) && (_operands[_nodes[m].operand] == _operands[node.operand])) {
+        node.starter = m;
+        count++;
+      }
+    }
+    
+    if (count != 1) {
+      node.starter = FSM_TABLE_NONE;
+    }
+  }
+  
+  return true;
+}
+
+
+void FsmTable::_sleep(uint16_t n) {
+  _nodes[n].flags = (_nodes[n].flags | FSM_TABLE_QUIESCENT) & ~FSM_TABLE_WAKE_TIMED;
+}
+
+void FsmTable::_sleepFor(uint16_t n, unsigned long duration) {
+  _nodes[n].flags |= FSM_TABLE_QUIESCENT | FSM_TABLE_WAKE_TIMED;
+  _nodes[n].wakeTime = millis() + duration;
+}
+
+
+void FsmTable::_request(byte op, uint16_t n, FsmIndex depth, FsmIndex childInd) {
+  if (n == FSM_TABLE_NONE) {
+    return;
+  }
+  
+  // walk up as FsmCollection::transitionAncestorTo() does, marking the child of the target as leaving
+  while (depth > 0) {
+    uint16_t parent = _nodes[n].parent;
+    
+    if (parent == FSM_TABLE_NONE) {
+      return;
+    }
+    
+    if (depth == 1) {
+      _nodes[n].flags |= FSM_TABLE_LEAVING;
+    }
+    
+    n = parent;
+    depth--;
+  }
+  
+  FsmTableNode& node = _nodes[n];
+  
+  // a Collection has no focus
+  if (!_isSequenceKind(node.kind)) {
+    return;
+  }
+  
+  switch (op) {
+    case FSM_TABLE_NEXT:
+      _transitionTo(n, node.currentChildInd + 1);
+      break;
+      
+    case FSM_TABLE_PREVIOUS:
+      _transitionTo(n, (node.currentChildInd == 0) ? node.childCount - 1 : node.currentChildInd - 1);
+      break;
+      
+    case FSM_TABLE_TO:
+      _transitionTo(n, childInd);
+      break;
+      
+    case FSM_TABLE_START:
+      node.currentChildInd = node.startChildInd;
+      break;
+  }
+}
+
+void FsmTable::_transitionAncestor(byte op, uint16_t n, FsmIndex depth, FsmIndex childInd) {
+  // as FsmState::_transitionAncestorTo*(), the FsmTableOp in the order of the FsmTraceType requests
+  FSM_TRACE_EVENT(_nodes[n].traceId, FSM_TRACE_REQUEST_NEXT + op, depth, childInd);
+  
+  _request(op, n, depth, childInd);
+}
+
+void FsmTable::_transitionTo(uint16_t n, FsmIndex childInd) {
+  FsmTableNode& node = _nodes[n];
+  
+  node.currentChildInd = (childInd < node.childCount) ? childInd : node.startChildInd;
+}
+
+void FsmTable::_wakePath(uint16_t n) {
+  // as FsmUpdatable::wake(), up to the root and on to the table's own ancestors
+  while ((n != FSM_TABLE_NONE) && (_nodes[n].flags & FSM_TABLE_QUIESCENT)) {
+    _nodes[n].flags &= ~FSM_TABLE_QUIESCENT;
+    n = _nodes[n].parent;
+  }
+  
+  if (n == FSM_TABLE_NONE) {
+    wake();
+  }
+}
+
+bool FsmTable::_leavePath(uint16_t n) {
+  uint16_t leaving = FSM_TABLE_NONE;
+  
+  for (; n != FSM_TABLE_NONE; n = _nodes[n].parent) {
+    if (_nodes[n].flags & FSM_TABLE_LEAVING) {
+      leaving = n;
+    }
+  }
+  
+  if (leaving == FSM_TABLE_NONE) {
+    return false;
+  }
+  
+  // as FsmState::dispatch(): outside of update() nothing else will
+  _leaveNode(leaving);
+  
+  if (_nodes[leaving].parent != FSM_TABLE_NONE) {
+    _wakePath(_nodes[leaving].parent);
+  }
+  
+  return true;
+}
+
+
+void FsmTable::update() {
+  if (_nodeCount) {
+    _updateNode(0);
+  }
+}
+
+void FsmTable::forceExit() {
+  if (_nodeCount) {
+    _forceExitNode(0);
+  }
+}
+
+void FsmTable::wakeAll() {
+  for (uint16_t n=0; n<_nodeCount; n++) {
+    if (_nodes[n].kind == FSM_KIND_USER) {
+      _userFsm(n)->wake();
+    }
+    
+    _nodes[n].flags &= ~FSM_TABLE_QUIESCENT;
+  }
+}
+
+void FsmTable::saveState(FsmSnapshotWriter& writer) {
+  FsmUpdatable::saveState(writer);
+  writer.writeUInt16(_nodeCount);
+  
+  for (uint16_t n=0; n<_nodeCount; n++) {
+    const FsmTableNode& node = _nodes[n];
+    
+    if (node.kind == FSM_KIND_USER) {
+      FsmSnapshot::_save(_userFsm(n), writer);
+      continue;
+    }
+    
+    writer.writeByte(node.flags & ~FSM_TABLE_LEAVING);
+    
+    if (_isSequenceKind(node.kind)) {
+      writer.writeUInt16(node.currentChildInd);
+    }
+    
+    if (node.flags & FSM_TABLE_WAKE_TIMED) {
+      writer.writeTime(node.wakeTime);
+    }
+    
+    // as FsmDelay::saveState() and FsmStartTimer::saveState()
+    if ((node.kind == FSM_KIND_START_TIMER) || ((node.kind == FSM_KIND_DELAY) && (node.flags & FSM_TABLE_ENTERED))) {
+      writer.writeUInt32(_timeUntil(node.wakeTime));
+    }
+  }
+}
+
+void FsmTable::restoreState(FsmSnapshotReader& reader) {
+  FsmUpdatable::restoreState(reader);
+  
+  if (reader.readUInt16() != _nodeCount) {
+    reader.fail();
+    return;
+  }
+  
+  for (uint16_t n=0; (n<_nodeCount) && !reader.isFailed(); n++) {
+    FsmTableNode& node = _nodes[n];
+    
+    if (node.kind == FSM_KIND_USER) {
+      FsmSnapshot::_restore(_userFsm(n), reader);
+      continue;
+    }
+    
+    node.flags = reader.readByte();
+    
+    if (_isSequenceKind(node.kind)) {
+      node.currentChildInd = (FsmIndex) reader.readUInt16();
+      
+      if (node.currentChildInd >= node.childCount) {
+        reader.fail();
+      }
+    }
+    
+    if (node.flags & FSM_TABLE_WAKE_TIMED) {
+      node.wakeTime = reader.readTime();
+    }
+    
+    if ((node.kind == FSM_KIND_START_TIMER) || ((node.kind == FSM_KIND_DELAY) && (node.flags & FSM_TABLE_ENTERED))) {
+      Duration remaining = reader.readUInt32();
+      
+      if (node.kind == FSM_KIND_DELAY) {
+        _sleepFor(n, remaining);
+      }
+      else {
+        ((Timer*) _operands[node.operand])->start(remaining);
+        node.wakeTime = millis() + remaining;
+      }
+    }
+  }
+}
+
+unsigned long FsmTable::timeToDeadline() {
+  return _nodeCount ? _timeToDeadline(0) : FSM_NO_DEADLINE;
+}
+
+void FsmTable::_updateNode(uint16_t n) {
+  FsmTableNode& node = _nodes[n];
+  
+  if (node.kind == FSM_KIND_USER) {
+    _userFsm(n)->update();
+    return;
+  }
+  
+  if (node.flags & FSM_TABLE_QUIESCENT) {
+    if (_isDormant(n, millis())) {
+      return;
+    }
+    
+    node.flags &= ~FSM_TABLE_QUIESCENT;
+  }
+  
+  if (!(node.flags & FSM_TABLE_ENTERED)) {
+    node.flags |= FSM_TABLE_ENTERED;
+    FSM_TRACE_EVENT(node.traceId, FSM_TRACE_ENTER);
+    _enterNode(n);
+  }
+  
+  _updateNodeState(n);
+  
+  if (node.flags & FSM_TABLE_LEAVING) {
+    _leaveNode(n);
+  }
+}
+
+void FsmTable::_enterNode(uint16_t n) {
+  FsmTableNode& node = _nodes[n];
+  void** operands = &_operands[node.operand];
+  
+  switch (node.kind) {
+    case FSM_KIND_SELECT: {
+      bool value = ((Value<bool>*) operands[0])->getValue();
+      
+      node.flags = value ? (node.flags | FSM_TABLE_OLD_VALUE) : (node.flags & ~FSM_TABLE_OLD_VALUE);
+      _transitionTo(n, (FsmIndex) value);
+      break;
+    }
+    
+    case FSM_KIND_DELAY: {
+      _sleepFor(n, ((Value<Duration>*) operands[1])->getValue());
+      break;
+    }
+      
+    case FSM_KIND_START_TIMER: {
+      Duration duration = ((Value<Duration>*) operands[1])->getValue();
+      
+      ((Timer*) operands[0])->start(duration);
+      node.wakeTime = millis() + duration;
+      _transitionAncestor(FSM_TABLE_NEXT, n, 1);
+      break;
+    }
+      
+    case FSM_KIND_FINISH:
+      _transitionAncestor(FSM_TABLE_START, n, 1);
+      _transitionAncestor(FSM_TABLE_NEXT, n, 2);
+      break;
+      
+    case FSM_KIND_BRANCH_ON_END_OF_LIST:
+      if (((EnumeratorBase*) operands[0])->moveNext()) {
+        _transitionAncestor(FSM_TABLE_NEXT, n, 1);
+      }
+      else {
+        _transitionAncestor(FSM_TABLE_TO, n, 1, node.branchInd);
+      }
+      break;
+      
+    case FSM_KIND_FINISH_ON_END_OF_LIST:
+      if (((EnumeratorBase*) operands[0])->moveNext()) {
+        _transitionAncestor(FSM_TABLE_NEXT, n, 1);
+      }
+      else {
+        _transitionAncestor(FSM_TABLE_START, n, 1);
+        _transitionAncestor(FSM_TABLE_NEXT, n, 2);
+      }
+      break;
+      
+    case FSM_KIND_BRANCH_ON_CONDITION_FALSE:
+      if ((*(Condition**) operands[0])->getValue()) {
+        _transitionAncestor(FSM_TABLE_NEXT, n, 1);
+      }
+      else {
+        _transitionAncestor(FSM_TABLE_TO, n, 1, node.branchInd);
+      }
+      break;
+      
+    case FSM_KIND_ASSIGN_CONDITION:
+      ((Value<bool>*) operands[1])->setValue(((Condition*) operands[0])->getValue());
+      _transitionAncestor(FSM_TABLE_NEXT, n, 1);
+      break;
+      
+    case FSM_KIND_DEBUG_PRINT:
+      Serial.println((char*) operands[0]);
+      _transitionAncestor(FSM_TABLE_NEXT, n, 1);
+      break;
+      
+    case FSM_KIND_IDLE:
+      _sleep(n);
+      break;
+      
+    case FSM_KIND_DEBUG_STATE:
+      Serial.print(F("Entering "));
+      Serial.println((char*) operands[0]);
+      _sleep(n);
+      break;
+  }
+}
+
+void FsmTable::_updateNodeState(uint16_t n) {
+  FsmTableNode& node = _nodes[n];
+  
+  switch (node.kind) {
+    case FSM_KIND_COLLECTION:
+      _updateCollection(n);
+      break;
+      
+    case FSM_KIND_SEQUENCE:
+      _updateSequence(n);
+      break;
+      
+    case FSM_KIND_SELECT: {
+      bool value = ((Value<bool>*) _operands[node.operand])->getValue();
+      
+      if (value != (bool)(node.flags & FSM_TABLE_OLD_VALUE)) {
+        node.flags ^= FSM_TABLE_OLD_VALUE;
+        _forceExitNode(node.firstChild + node.currentChildInd);
+        _transitionTo(n, (FsmIndex) value);
+      }
+      
+      // the Condition is polled on every update, so never become quiescent
+      _stepSequence(n);
+      break;
+    }
+    
+    case FSM_KIND_DELAY:
+      if (!_timeUntil(node.wakeTime)) {
+        _transitionAncestor(FSM_TABLE_NEXT, n, 1);
+      }
+      else {
+        _sleepFor(n, _timeUntil(node.wakeTime));
+      }
+      break;
+      
+    case FSM_KIND_WAIT_TIMER:
+      if (((Timer*) _operands[node.operand])->isComplete()) {
+        _transitionAncestor(FSM_TABLE_NEXT, n, 1);
+      }
+      else if (node.starter != FSM_TABLE_NONE) {
+        // as FsmWaitUntilTimerIsComplete::_updateState(), polling once past its start's deadline
+        unsigned long remaining = _timeUntil(_nodes[node.starter].wakeTime);
+        
+        if (remaining) {
+          _sleepFor(n, remaining);
+        }
+      }
+      break;
+  }
+}
+
+void FsmTable::_updateCollection(uint16_t n) {
+  FsmTableNode& node = _nodes[n];
+  uint16_t end = node.firstChild + node.childCount;
+  uint16_t earliest = FSM_TABLE_NONE;
+  bool awake = false;
+  unsigned long now = 0;
+  bool haveNow = false;
+  
+  for (uint16_t child = node.firstChild; child < end; child++) {
+    if (!haveNow && _isQuiescent(child) && _isWakeTimed(child)) {
+      now = millis();
+      haveNow = true;
+    }
+    
+    if (!_isDormant(child, now)) {
+      _updateNode(child);
+      
+      if (!_isQuiescent(child)) {
+        awake = true;
+        continue;
+      }
+    }
+    
+    if (!awake && _isWakeTimed(child) && 
+        ((earliest == FSM_TABLE_NONE) || ((int32_t) (_getWakeTime(child) - _getWakeTime(earliest)) < 0))) {
+      earliest = child;
+    }
+  }
+  
+  if (!awake && !(node.flags & FSM_TABLE_LEAVING)) {
+    if (earliest != FSM_TABLE_NONE) {
+      node.flags |= FSM_TABLE_QUIESCENT | FSM_TABLE_WAKE_TIMED;
+      node.wakeTime = _getWakeTime(earliest);
+    }
+    else {
+      _sleep(n);
+    }
+  }
+}
+
+void FsmTable::_stepSequence(uint16_t n) {
+  FsmTableNode& node = _nodes[n];
+  FsmIndex microsteps = node.microsteps;
+  
+  for (;;) {
+    FsmIndex childInd = node.currentChildInd;
+    _updateNode(node.firstChild + childInd);
+    
+    // run to completion, as FsmSequence::_updateState()
+    if ((node.currentChildInd == childInd) || (node.flags & FSM_TABLE_LEAVING) || (--microsteps == 0)) {
+      break;
+    }
+  }
+}
+
+void FsmTable::_updateSequence(uint16_t n) {
+  FsmTableNode& node = _nodes[n];
+  
+  _stepSequence(n);
+  
+  // the focused child may have changed, if so it has yet to be entered
+  uint16_t child = node.firstChild + node.currentChildInd;
+  
+  if (_isQuiescent(child) && !(node.flags & FSM_TABLE_LEAVING)) {
+    if (_isWakeTimed(child)) {
+      node.flags |= FSM_TABLE_QUIESCENT | FSM_TABLE_WAKE_TIMED;
+      node.wakeTime = _getWakeTime(child);
+    }
+    else {
+      _sleep(n);
+    }
+  }
+}
+
+void FsmTable::_leaveNode(uint16_t n) {
+  FsmTableNode& node = _nodes[n];
+  
+  FSM_TRACE_EVENT(node.traceId, FSM_TRACE_EXIT);
+  
+  if (node.kind == FSM_KIND_DEBUG_STATE) {
+    Serial.print(F("Exiting "));
+    Serial.println((char*) _operands[node.operand]);
+  }
+  
+  node.flags &= ~(FSM_TABLE_ENTERED | FSM_TABLE_LEAVING | FSM_TABLE_QUIESCENT);
+  
+  if (node.kind == FSM_KIND_COLLECTION) {
+    for (uint16_t child = node.firstChild; child < node.firstChild + node.childCount; child++) {
+      _forceExitNode(child);
+    }
+  }
+  else if (_isSequenceKind(node.kind)) {
+    _forceExitNode(node.firstChild + node.currentChildInd);
+  }
+}
+
+void FsmTable::_forceExitNode(uint16_t n) {
+  FsmTableNode& node = _nodes[n];
+  
+  if (node.kind == FSM_KIND_USER) {
+    _userFsm(n)->forceExit();
+    return;
+  }
+  
+  FSM_TRACE_EVENT(node.traceId, FSM_TRACE_FORCE_EXIT);
+  _leaveNode(n);
+  
+  if (_isSequenceKind(node.kind)) {
+    node.currentChildInd = node.startChildInd;
+  }
+}
+
+unsigned long FsmTable::_timeToDeadline(uint16_t n) {
+  FsmTableNode& node = _nodes[n];
+  
+  if (node.kind == FSM_KIND_USER) {
+    return _userFsm(n)->timeToDeadline();
+  }
+  
+  if (!(node.flags & FSM_TABLE_ENTERED) || (node.flags & FSM_TABLE_LEAVING)) {
+    return 0;
+  }
+  
+  if (node.flags & FSM_TABLE_QUIESCENT) {
+    if (!(node.flags & FSM_TABLE_WAKE_TIMED)) {
+      return FSM_NO_DEADLINE;
+    }
+    
+    return _timeUntil(node.wakeTime);
+  }
+  
+  switch (node.kind) {
+    case FSM_KIND_COLLECTION: {
+      unsigned long deadline = FSM_NO_DEADLINE;
+      
+      for (uint16_t child = node.firstChild; (child < node.firstChild + node.childCount) && (deadline > 0); child++) {
+        unsigned long childDeadline = _timeToDeadline(child);
+        
+        if (childDeadline < deadline) {
+          deadline = childDeadline;
+        }
+      }
+      
+      return deadline;
+    }
+    
+    case FSM_KIND_SEQUENCE:
+      return _timeToDeadline(node.firstChild + node.currentChildInd);
+      
+    case FSM_KIND_DELAY:
+      return _timeUntil(node.wakeTime);
+      
+    case FSM_KIND_WAIT_TIMER:
+      return ((node.starter != FSM_TABLE_NONE) && !((Timer*) _operands[node.operand])->isComplete()) ? 
+        _timeUntil(_nodes[node.starter].wakeTime) : 0;
+      
+    case FSM_KIND_IDLE:
+    case FSM_KIND_DEBUG_STATE:
+      return FSM_NO_DEADLINE;
+  }
+  
+  return 0;
+}
@@ -0,0 +1,282 @@
+/** @file FsmTable.h 
+  *  Copyright (c) 2016 Ozbotics 
+  *  Distributed under the MIT license (see LICENSE)
+  */ 
+#ifndef _FSM_TABLE_H
+ #define _FSM_TABLE_H
+
+#include <FSM.h>
+
+#define FSM_TABLE_NONE 0xFFFF  /**< no node (eg; the parent of the root) */
+
+/**
+ * Bits of FsmTableNode::flags
+ */
+enum FsmTableFlag {
+  FSM_TABLE_ENTERED    = 0x01,  /**< the node has been entered (FSM_FLAG_ENTERED) */
+  FSM_TABLE_LEAVING    = 0x02,  /**< the node is leaving (FSM_FLAG_LEAVING) */
+  FSM_TABLE_QUIESCENT  = 0x04,  /**< the node is quiescent (FSM_FLAG_QUIESCENT) */
+  FSM_TABLE_WAKE_TIMED = 0x08,  /**< the node wakes at wakeTime (FSM_FLAG_WAKE_TIMED) */
+  FSM_TABLE_OLD_VALUE  = 0x10   /**< last value seen by a Select (FsmSelectStateFromCondition::_oldValue) */
+};
+
+/**
+ * Transitions applied by FsmTable::_request()
+ */
+enum FsmTableOp {
+  FSM_TABLE_NEXT,      /**< focus on the next State */
+  FSM_TABLE_PREVIOUS,  /**< focus on the previous State */
+  FSM_TABLE_TO,        /**< focus on the specified State */
+  FSM_TABLE_START      /**< focus on the start State */
+};
+
+/**
+ * One node of a compiled FSM
+ *
+ * Nodes are stored breadth first, so the children of a node are contiguous
+ */
+struct FsmTableNode {
+  byte kind;                /**< the FsmKind, ie; the opcode */
+  byte flags;               /**< FsmTableFlag bits */
+  FsmIndex childCount;      /**< number of children (Collections and Sequences) */
+  FsmIndex startChildInd;   /**< start child (Sequences) */
+  FsmIndex currentChildInd; /**< focused child (Sequences) */
+  union {
+    FsmIndex branchInd;     /**< resolved branch target (branch States) */
+    FsmIndex microsteps;    /**< States that may be entered per update (Sequences) */
+  };
+  uint16_t parent;          /**< index of the parent node, FSM_TABLE_NONE for the root */
+  union {
+    uint16_t firstChild;    /**< index of the first child node (Collections and Sequences) */
+    uint16_t starter;       /**< the one START_TIMER node that starts its Timer, else FSM_TABLE_NONE (WAIT_TIMER) */
+  };
+  uint16_t operand;         /**< index of the first of this node's operands */
+  uint32_t wakeTime;        /**< millis() (32 bits, see FsmUpdatable::_timeUntil()) at which to wake, if FSM_TABLE_WAKE_TIMED; the Timer's deadline (DELAY, START_TIMER) */
+#ifdef FSM_TRACE
+  uint16_t traceId;         /**< traceId of the FSM the node was compiled from, recorded in its FsmTrace events */
+#endif
+};
+
+class FsmTable;
+
+/**
+ * Stands in as the parent of a user defined FSM inside a compiled FsmTable
+ *  so that the user FSM's ancestor transitions are applied to the table
+ */
+class FsmTableProxy : public FsmCollection {
+  protected:
+    FsmTable* _table;             /**< protected variable _table The table */
+    uint16_t _node;               /**< protected variable _node The table node standing in for the user FSM's parent */
+    
+   /**
+    * over-ride _wakeProxied to wake the table nodes from the user FSM's parent to the root
+    */
+    virtual void _wakeProxied();
+    
+   /**
+    * over-ride _leaveProxied to complete the leave of the highest leaving table node on the path
+    */
+    virtual bool _leaveProxied();
+    
+  public:
+    FsmTableProxy() : _table(NULL), _node(FSM_TABLE_NONE), FsmCollection() {
+      _flags |= FSM_FLAG_PROXY;
+    }
+    
+    void attach(FsmTable* table, uint16_t node) {
+      _table = table;
+      _node = node;
+    }
+    
+    virtual void transitionAncestorToNext(FsmIndex depth);
+    virtual void transitionAncestorToPrevious(FsmIndex depth);
+    virtual void transitionAncestorTo(FsmIndex childInd, FsmIndex depth);
+    virtual void transitionAncestorToStart(FsmIndex depth);
+    
+   /**
+    * transitions must reach the table, so FsmTransition handles are left unbound (and walk)
+    */
+    virtual bool resolveTransition(FsmTransition& /*transition*/, FsmIndex /*depth*/) {
+      return false;
+    }
+};
+
+/**
+ * A built FSM tree, flattened into a compact table and run by an interpreter
+ *
+ * compile() walks a built tree once and records, for every node, its kind (an opcode),
+ *  its runtime state and the index of its parent and first child, breadth first. 
+ *  Pointers the built-in States work with (Timers, Values, Conditions, Enumerators) go into a separate operand array,
+ *  and messages are copied into the table's own string pool.
+ *
+ * update() then runs the machine from the table: a switch on the opcode per node, no virtual calls, no pointer chasing 
+ *  through the tree, and transitions resolved against the table's parent indices.
+ *  Behaviour matches the runtime classes (including quiescence and timeToDeadline()).
+ *
+ * User defined FSMs (FSM_KIND_USER) are kept as opaque leaves: the table calls their update(),
+ *  and their ancestor transitions reach the table through an FsmTableProxy.
+ *  compile() calls resolve() on the tree first (so named branches are resolved before they are flattened),
+ *  and again on each user defined FSM once it is behind its proxy (so its FsmTransition handles fall back to the proxy).
+ *  A class derived from a built-in FSM is detected (see FSM_EXACT_CLASS, with or without RTTI) and treated as user defined.
+ *
+ * With FSM_TRACE defined, each node records the FsmTrace events of the State it was compiled from, under its traceId.
+ *  The table keeps no FSM_STATS counters (see FsmStats), other than those of its user defined FSMs.
+ *
+ * Compile the tree before its first update, then update the table instead of the tree.
+ *  The table holds no pointer into a tree of built-in FSMs (a Delay's deadline takes the place of its Timer),
+ *  so that tree may be deleted once compiled, leaving only the table. A tree holding user defined FSMs still owns them,
+ *  and must out-live the table. Compiled within an FsmArena::Scope, the table's storage comes from the arena
+ *  (and is released with it).
+ */
+class FsmTable : public FsmUpdatable {
+  friend class FsmTableProxy;
+  friend class FsmBank;
+  
+  protected:
+    FsmTableNode* _nodes;      /**< protected variable _nodes The nodes, breadth first */
+    uint16_t _nodeCount;       /**< protected variable _nodeCount Number of nodes */
+    void** _operands;          /**< protected variable _operands Operands of the nodes */
+    uint16_t _operandCount;    /**< protected variable _operandCount Number of operands */
+    FsmTableProxy* _proxies;   /**< protected variable _proxies Proxy parents of user defined FSMs */
+    uint16_t _proxyCount;      /**< protected variable _proxyCount Number of proxies */
+    char* _strings;            /**< protected variable _strings Copies of the messages (FsmDebugPrint, FsmDebugState) */
+    size_t _stringsSize;       /**< protected variable _stringsSize Size of _strings in bytes */
+    
+    void _clear();
+    uint16_t _countNodes(FsmUpdatable* fsm, uint16_t* userCount, size_t* stringsSize);
+    
+    void _updateNode(uint16_t n);
+    void _enterNode(uint16_t n);
+    void _updateNodeState(uint16_t n);
+    void _updateCollection(uint16_t n);
+    void _stepSequence(uint16_t n);
+    void _updateSequence(uint16_t n);
+    void _leaveNode(uint16_t n);
+    void _forceExitNode(uint16_t n);
+    unsigned long _timeToDeadline(uint16_t n);
+    
+    void _request(byte op, uint16_t n, FsmIndex depth, FsmIndex childInd=0);
+    void _transitionAncestor(byte op, uint16_t n, FsmIndex depth, FsmIndex childInd=0);
+    void _transitionTo(uint16_t n, FsmIndex childInd);
+    void _wakePath(uint16_t n);
+    bool _leavePath(uint16_t n);
+    
+    bool _isQuiescent(uint16_t n) {
+      const FsmTableNode& node = _nodes[n];
+      
+      return (node.kind == FSM_KIND_USER) ? _userFsm(n)->isQuiescent() : (node.flags & FSM_TABLE_QUIESCENT);
+    }
+    
+    bool _isDormant(uint16_t n, unsigned long now) {
+      const FsmTableNode& node = _nodes[n];
+      
+      if (node.kind == FSM_KIND_USER) {
+        return _userFsm(n)->isDormant(now);
+      }
+      
+      return (node.flags & FSM_TABLE_QUIESCENT) && 
+        (!(node.flags & FSM_TABLE_WAKE_TIMED) || ((int32_t) ((uint32_t) now - node.wakeTime) < 0));
+    }
+    
+    bool _isWakeTimed(uint16_t n) {
+      const FsmTableNode& node = _nodes[n];
+      
+      return (node.kind == FSM_KIND_USER) ? _userFsm(n)->isWakeTimed() : (node.flags & FSM_TABLE_WAKE_TIMED);
+    }
+    
+    uint32_t _getWakeTime(uint16_t n) {
+      const FsmTableNode& node = _nodes[n];
+      
+      return (node.kind == FSM_KIND_USER) ? _userFsm(n)->getWakeTime() : node.wakeTime;
+    }
+    
+    void _sleep(uint16_t n);
+    void _sleepFor(uint16_t n, unsigned long duration);
+    
+    FsmUpdatable* _userFsm(uint16_t n) {
+      return (FsmUpdatable*) _operands[_nodes[n].operand];
+    }
+    
+  public:
+   /**
+    * Constructor
+    */
+    FsmTable() : _nodes(NULL), _nodeCount(0), _operands(NULL), _operandCount(0), _proxies(NULL), _proxyCount(0), _strings(NULL), _stringsSize(0), FsmUpdatable() { }
+    
+   /**
+    * Destructor
+    *  gives user defined FSMs back their original parents
+    */
+    ~FsmTable() {
+      _clear();
+    }
+    
+   /**
+    * flatten a built tree into this table
+    *  a tree of built-in FSMs may then be deleted (see above)
+    *
+    * @param root The top of the tree
+    * @return false if the tree is too large or storage could not be allocated
+    */
+    bool compile(FsmUpdatable* root);
+    
+   /**
+    * update the compiled machine
+    */
+    virtual void update();
+    
+   /**
+    * force the compiled machine to exit
+    */
+    virtual void forceExit();
+    
+   /**
+    * see FsmUpdatable::timeToDeadline()
+    */
+    virtual unsigned long timeToDeadline();
+    
+   /**
+    * end quiescence throughout the table
+    *  (call after changing a Value a quiescent State depends on; waking a user defined FSM wakes its path through the table)
+    */
+    void wakeAll();
+    
+   /**
+    * over-ride saveState to record every node (and the user defined FSMs, with their subtrees), see FsmSnapshot
+    */
+    virtual void saveState(FsmSnapshotWriter& writer);
+    
+   /**
+    * over-ride restoreState to restore every node
+    */
+    virtual void restoreState(FsmSnapshotReader& reader);
+    
+   /**
+    * describe fsm as the table sees it: anything that is not exactly a built-in class is user defined
+    *  (see FSM_EXACT_CLASS)
+    */
+    static void describeExact(FsmUpdatable* fsm, FsmDescription& description);
+    
+   /**
+    * get the number of nodes
+    */
+    uint16_t getNodeCount() {
+      return _nodeCount;
+    }
+    
+   /**
+    * get a node, eg; to inspect its runtime state
+    */
+    const FsmTableNode& getNode(uint16_t n) {
+      return _nodes[n];
+    }
+    
+   /**
+    * get the number of bytes used by the table
+    */
+    size_t getMemoryUsage() {
+      return sizeof(FsmTable) + (_nodeCount * sizeof(FsmTableNode)) + (_operandCount * sizeof(void*)) + (_proxyCount * sizeof(FsmTableProxy)) + _stringsSize;
+    }
+};
+
+#endif  // _FSM_TABLE_H
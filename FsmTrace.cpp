@@ -0,0 +1,56 @@
+#include <FsmTrace.h>
+
+FsmTraceEvent* FsmTrace::_buffer = NULL;
+FsmTraceEvent* FsmTrace::_events = NULL;
+uint32_t FsmTrace::_mask = 0;
+uint32_t FsmTrace::_head = 0;
+uint32_t FsmTrace::_tail = 0;
+uint32_t FsmTrace::_dropped = 0;
+uint16_t FsmTrace::_nextId = 0;
+
+void FsmTrace::begin(FsmTraceEvent* buffer, uint32_t capacity) {
+  uint32_t size = 1;
+  
+  while ((size << 1) && ((size << 1) <= capacity)) {
+    size <<= 1;
+  }
+  
+  _events = NULL;
+  _buffer = (capacity > 0) ? buffer : NULL;
+  _mask = size - 1;
+  _head = 0;
+  _tail = 0;
+  _dropped = 0;
+  _events = _buffer;
+}
+
+uint32_t FsmTrace::drain(FsmTraceEvent* out, uint32_t max) {
+  if (!_buffer) {
+    return 0;
+  }
+  
+#if defined(__AVR__)
+  uint32_t head = _head;
+#else
+  uint32_t head = __atomic_load_n(&_head, __ATOMIC_ACQUIRE);
+#endif
+  
+  // anything older than one buffer's worth has been overwritten
+  if (head - _tail > _mask + 1) {
+    _dropped += head - _tail - (_mask + 1);
+    _tail = head - (_mask + 1);
+  }
+  
+  uint32_t count = head - _tail;
+  if (count > max) {
+    count = max;
+  }
+  
+  for (uint32_t i = 0; i < count; i++) {
+    out[i] = _buffer[(_tail + i) & _mask];
+  }
+  
+  _tail += count;
+  
+  return count;
+}
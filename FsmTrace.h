@@ -0,0 +1,140 @@
+/** @file FsmTrace.h
+  *  Copyright (c) 2016 Ozbotics
+  *  Distributed under the MIT license (see LICENSE)
+  */
+#ifndef _FSM_TRACE_H
+ #define _FSM_TRACE_H
+
+#include <Arduino.h>
+
+#include "FsmConfig.h"
+
+/**
+ * The kinds of FsmTraceEvent
+ */
+enum FsmTraceType {
+  FSM_TRACE_ENTER,             /**< the State was entered */
+  FSM_TRACE_EXIT,              /**< the State left (its _exitState() ran) */
+  FSM_TRACE_FORCE_EXIT,        /**< the State was forced to exit (by an ancestor) */
+  FSM_TRACE_REQUEST_NEXT,      /**< the State requested its ancestor at depth focus on the next State */
+  FSM_TRACE_REQUEST_PREVIOUS,  /**< the State requested its ancestor at depth focus on the previous State */
+  FSM_TRACE_REQUEST_TO,        /**< the State requested its ancestor at depth focus on State index */
+  FSM_TRACE_REQUEST_START      /**< the State requested its ancestor at depth focus on its start State */
+};
+
+/**
+ * One recorded event (12 bytes)
+ */
+struct FsmTraceEvent {
+  uint32_t time;   /**< FSM_TRACE_CLOCK() when recorded */
+  uint16_t node;   /**< traceId of the FSM */
+  uint16_t index;  /**< target State index (FSM_TRACE_REQUEST_TO) */
+  byte type;       /**< the FsmTraceType */
+  byte depth;      /**< ancestor hops of a request (clamped to 255) */
+};
+
+/**
+ * A fixed size ring buffer of binary State events
+ *
+ * With FSM_TRACE defined, FsmState records its enters, exits, forced exits and transition requests here,
+ *  and an FsmTable records them for the States it was compiled from. An FsmBank records nothing
+ *  (its instances share the definition's nodes, so their events could not be told apart), nor do the FsmStatic templates.
+ *  Recording is a few stores and an index increment: no formatting, no Serial, no locks,
+ *  so tracing can stay enabled (eg; in the field) without changing the timing being debugged.
+ *  When the buffer is full the oldest events are overwritten (and counted by getDropped() when drained).
+ *
+ * drain() copies out the events recorded since the last drain, eg; to write them to Serial or a file;
+ *  FsmTraceDecoder (on hosts) turns them into text or Chrome trace JSON.
+ *
+ * Events are keyed by FsmUpdatable::traceId, assigned in construction order.
+ *
+ *   static FsmTraceEvent events[256];
+ *   FsmTrace::begin(events, 256);
+ */
+class FsmTrace {
+  protected:
+    static FsmTraceEvent* _buffer;  /**< protected variable _buffer The ring buffer */
+    static FsmTraceEvent* _events;  /**< protected variable _events The ring buffer while recording, otherwise NULL */
+    static uint32_t _mask;          /**< protected variable _mask Capacity - 1 (capacity is a power of 2) */
+    static uint32_t _head;          /**< protected variable _head Number of events recorded */
+    static uint32_t _tail;          /**< protected variable _tail Number of events drained (or dropped) */
+    static uint32_t _dropped;       /**< protected variable _dropped Events overwritten before being drained */
+    static uint16_t _nextId;        /**< protected variable _nextId The next traceId */
+
+  public:
+   /**
+    * start recording
+    *
+    * @param buffer Storage for the events, which must out-live the recording
+    * @param capacity Number of events in buffer (rounded down to a power of 2)
+    */
+    static void begin(FsmTraceEvent* buffer, uint32_t capacity);
+
+   /**
+    * stop recording (events not yet drained can still be drained)
+    */
+    static void end() {
+      _events = NULL;
+    }
+
+   /**
+    * record an event
+    *  single writer on AVR (call from loop(), not interrupts); lock-free for concurrent writers elsewhere
+    *
+    * @param node The traceId of the FSM
+    * @param type The FsmTraceType
+    * @param depth Ancestor hops of a request
+    * @param index Target State index of a request
+    */
+    static void record(uint16_t node, byte type, FsmIndex depth=0, FsmIndex index=0) {
+      FsmTraceEvent* events = _events;
+
+      if (!events) {
+        return;
+      }
+
+#if defined(__AVR__)
+      FsmTraceEvent& event = events[_head++ & _mask];
+#else
+      FsmTraceEvent& event = events[__atomic_fetch_add(&_head, 1, __ATOMIC_RELAXED) & _mask];
+#endif
+
+      event.time = FSM_TRACE_CLOCK();
+      event.node = node;
+      event.index = (uint16_t) index;
+      event.type = type;
+      event.depth = (depth > 255) ? 255 : (byte) depth;
+    }
+
+   /**
+    * copy out the events recorded since the last drain (oldest first)
+    *  best called while the FSM is not being updated; events recorded during the copy may be torn
+    *
+    * @param out Where to copy the events
+    * @param max Size of out
+    * @return the number of events copied
+    */
+    static uint32_t drain(FsmTraceEvent* out, uint32_t max);
+
+   /**
+    * get the number of events overwritten before they could be drained
+    */
+    static uint32_t getDropped() {
+      return _dropped;
+    }
+
+   /**
+    * allocate a traceId (called by FsmUpdatable's constructor when FSM_TRACE is defined)
+    */
+    static uint16_t nextId() {
+      return _nextId++;
+    }
+};
+
+#ifdef FSM_TRACE
+ #define FSM_TRACE_EVENT(node, ...) FsmTrace::record((node), __VA_ARGS__)
+#else
+ #define FSM_TRACE_EVENT(node, ...) ((void) 0)
+#endif
+
+#endif  // _FSM_TRACE_H
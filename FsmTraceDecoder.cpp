@@ -0,0 +1,156 @@
+#ifndef ARDUINO
+
+#include <FsmTraceDecoder.h>
+
+#include <set>
+
+static const char* _kindName(byte kind) {
+  switch (kind) {
+    case FSM_KIND_COLLECTION:                return "Collection";
+    case FSM_KIND_SEQUENCE:                  return "Sequence";
+    case FSM_KIND_SELECT:                    return "Select";
+    case FSM_KIND_DELAY:                     return "Delay";
+    case FSM_KIND_START_TIMER:               return "StartTimer";
+    case FSM_KIND_WAIT_TIMER:                return "WaitTimer";
+    case FSM_KIND_FINISH:                    return "Finish";
+    case FSM_KIND_BRANCH_ON_END_OF_LIST:     return "BranchOnEndOfList";
+    case FSM_KIND_FINISH_ON_END_OF_LIST:     return "FinishOnEndOfList";
+    case FSM_KIND_BRANCH_ON_CONDITION_FALSE: return "BranchOnConditionFalse";
+    case FSM_KIND_ASSIGN_CONDITION:          return "AssignCondition";
+    case FSM_KIND_DEBUG_PRINT:               return "DebugPrint";
+    case FSM_KIND_IDLE:                      return "Idle";
+    case FSM_KIND_DEBUG_STATE:               return "DebugState";
+  }
+  
+  return "State";
+}
+
+/**
+ * escape a label for a JSON string
+ */
+static std::string _jsonEscape(const std::string& text) {
+  std::string escaped;
+  
+  for (char c : text) {
+    if ((c == '"') || (c == '\\')) {
+      escaped += '\\';
+    }
+    
+    if ((unsigned char) c >= 0x20) {
+      escaped += c;
+    }
+  }
+  
+  return escaped;
+}
+
+void FsmTraceDecoder::_addNames(FsmUpdatable* fsm, const std::string& path) {
+#ifdef FSM_TRACE
+  _labels[fsm->traceId] = path;
+#endif
+  
+  FsmCollection* collection = fsm->asCollection();
+  if (!collection) {
+    return;
+  }
+  
+  for (FsmIndex i=0; i<collection->getChildCount(); i++) {
+    FsmUpdatable* child = collection->getChild(i);
+    std::string label;
+    
+    if (child->getName()) {
+      label = child->getName();
+    }
+    else {
+      FsmDescription description;
+      child->describe(description);
+      label = std::string(_kindName(description.kind)) + "[" + std::to_string(i) + "]";
+    }
+    
+    _addNames(child, path + "/" + label);
+  }
+}
+
+std::string FsmTraceDecoder::getLabel(uint16_t node) {
+  std::map<uint16_t, std::string>::iterator label = _labels.find(node);
+  
+  return (label == _labels.end()) ? "#" + std::to_string(node) : label->second;
+}
+
+const char* FsmTraceDecoder::typeName(byte type) {
+  switch (type) {
+    case FSM_TRACE_ENTER:            return "enter";
+    case FSM_TRACE_EXIT:             return "exit";
+    case FSM_TRACE_FORCE_EXIT:       return "forceExit";
+    case FSM_TRACE_REQUEST_NEXT:     return "next";
+    case FSM_TRACE_REQUEST_PREVIOUS: return "previous";
+    case FSM_TRACE_REQUEST_TO:       return "to";
+    case FSM_TRACE_REQUEST_START:    return "start";
+  }
+  
+  return "?";
+}
+
+void FsmTraceDecoder::writeText(FILE* out, const FsmTraceEvent* events, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    const FsmTraceEvent& event = events[i];
+    
+    fprintf(out, "%10lu %s %s", (unsigned long) event.time, getLabel(event.node).c_str(), typeName(event.type));
+    
+    if (event.type >= FSM_TRACE_REQUEST_NEXT) {
+      fprintf(out, " depth=%u", (unsigned) event.depth);
+    }
+    
+    if (event.type == FSM_TRACE_REQUEST_TO) {
+      fprintf(out, " index=%u", (unsigned) event.index);
+    }
+    
+    fprintf(out, "\n");
+  }
+}
+
+void FsmTraceDecoder::writeChromeJson(FILE* out, const FsmTraceEvent* events, size_t count) {
+  std::set<uint16_t> open;
+  std::set<uint16_t> named;
+  
+  fprintf(out, "{\"traceEvents\":[");
+  
+  const char* separator = "\n";
+  for (size_t i = 0; i < count; i++) {
+    const FsmTraceEvent& event = events[i];
+    std::string label = _jsonEscape(getLabel(event.node));
+    
+    // one track per FSM, so enter / exit slices always nest
+    if (named.insert(event.node).second) {
+      fprintf(out, "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":0,\"tid\":%u,\"args\":{\"name\":\"%s\"}}", 
+        separator, (unsigned) event.node, label.c_str());
+      separator = ",\n";
+    }
+    
+    switch (event.type) {
+      case FSM_TRACE_ENTER:
+        if (open.insert(event.node).second) {
+          fprintf(out, "%s{\"ph\":\"B\",\"name\":\"%s\",\"pid\":0,\"tid\":%u,\"ts\":%lu}", 
+            separator, label.c_str(), (unsigned) event.node, (unsigned long) event.time);
+        }
+        break;
+        
+      case FSM_TRACE_EXIT:
+        // forced exits of States that were never entered have no slice to end
+        if (open.erase(event.node)) {
+          fprintf(out, "%s{\"ph\":\"E\",\"pid\":0,\"tid\":%u,\"ts\":%lu}", 
+            separator, (unsigned) event.node, (unsigned long) event.time);
+        }
+        break;
+        
+      default:
+        fprintf(out, "%s{\"ph\":\"i\",\"s\":\"t\",\"name\":\"%s\",\"pid\":0,\"tid\":%u,\"ts\":%lu,\"args\":{\"depth\":%u,\"index\":%u}}", 
+          separator, typeName(event.type), (unsigned) event.node, (unsigned long) event.time, (unsigned) event.depth, (unsigned) event.index);
+        break;
+    }
+  }
+  
+  fprintf(out, "\n]}\n");
+}
+
+#endif  // ARDUINO
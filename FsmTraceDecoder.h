@@ -0,0 +1,73 @@
+/** @file FsmTraceDecoder.h 
+  *  Copyright (c) 2016 Ozbotics 
+  *  Distributed under the MIT license (see LICENSE)
+  */ 
+#ifndef _FSM_TRACE_DECODER_H
+ #define _FSM_TRACE_DECODER_H
+
+#ifndef ARDUINO
+
+#include <FSM.h>
+
+#include <stdio.h>
+#include <map>
+#include <string>
+
+/**
+ * Host side decoding of FsmTrace events, drained from a device (or a host run)
+ *
+ * Events name their FSM by traceId; label them with addNames() (from the tree that recorded them, 
+ *  when built with FSM_TRACE) or setLabel(). Unlabelled FSMs are shown as '#traceId'.
+ *
+ * writeText() prints one line per event. 
+ * writeChromeJson() writes the Chrome trace event format (chrome://tracing, Perfetto): 
+ *  each FSM is a track, the time between enter and exit a slice, and requests are instant events.
+ */
+class FsmTraceDecoder {
+  protected:
+    std::map<uint16_t, std::string> _labels;  /**< protected variable _labels Label of each traceId */
+    
+    void _addNames(FsmUpdatable* fsm, const std::string& path);
+    
+  public:
+   /**
+    * label every FSM in a tree, by the path of names (or kinds) from the root, eg; 'Root/Seq0/Delay[1]'
+    *  requires FSM_TRACE (otherwise FSMs have no traceId, and nothing is labelled)
+    *
+    * @param root The top of the tree
+    */
+    void addNames(FsmUpdatable* root) {
+      _addNames(root, root->getName() ? root->getName() : "root");
+    }
+    
+   /**
+    * label one traceId
+    */
+    void setLabel(uint16_t node, const char* label) {
+      _labels[node] = label;
+    }
+    
+   /**
+    * get the label of a traceId
+    */
+    std::string getLabel(uint16_t node);
+    
+   /**
+    * write the events as text, one per line:  time(us) label event [depth] [index]
+    */
+    void writeText(FILE* out, const FsmTraceEvent* events, size_t count);
+    
+   /**
+    * write the events as a Chrome trace JSON document
+    */
+    void writeChromeJson(FILE* out, const FsmTraceEvent* events, size_t count);
+    
+   /**
+    * get the name of an FsmTraceType, eg; "enter"
+    */
+    static const char* typeName(byte type);
+};
+
+#endif  // ARDUINO
+
+#endif  // _FSM_TRACE_DECODER_H
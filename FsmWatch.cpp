@@ -0,0 +1,21 @@
+#include <FsmWatch.h>
+#include <FSM.h>
+
+void FsmWatchedValueBase::_notify() {
+  for (FsmWatch** watch = _watches.begin(); watch != _watches.end(); watch++) {
+    (*watch)->changed = true;
+
+    if ((*watch)->fsm) {
+      (*watch)->fsm->wake();
+    }
+  }
+}
+
+void FsmWatchedValueBase::removeWatch(FsmWatch* watch) {
+  for (int w = 0; w < _watches.size(); w++) {
+    if (_watches.get(w) == watch) {
+      _watches.removeUnordered(w);
+      return;
+    }
+  }
+}
@@ -0,0 +1,200 @@
+/** @file FsmWatch.h
+  *  Copyright (c) 2016 Ozbotics
+  *  Distributed under the MIT license (see LICENSE)
+  */
+#ifndef _FSM_WATCH_H
+ #define _FSM_WATCH_H
+
+#include <Arduino.h>
+#include <Value.h>
+#include <ValueExpr.h>
+#include <Condition.h>
+
+#include "FsmConfig.h"
+#include "FsmArray.h"
+
+class FsmUpdatable;
+
+/**
+ * An observer's registration with one or more FsmWatchedValue(s)
+ *
+ * When a watched Value changes, changed is set and fsm (if any) is woken,
+ *  so an FSM that only reacts to the Value can sleep until then, and skip reading it otherwise.
+ */
+struct FsmWatch {
+  FsmUpdatable* fsm;  /**< woken when a watched Value changes, may be NULL */
+  bool changed;       /**< set when a watched Value changes, cleared by the observer */
+};
+
+/**
+ * The part of FsmWatchedValue that does not depend on the type of the Value
+ */
+class FsmWatchedValueBase {
+  protected:
+    FsmArray<FsmWatch*> _watches;  /**< protected variable _watches The registered observers */
+
+   /**
+    * tell the observers that the Value has changed
+    */
+    void _notify();
+
+  public:
+   /**
+    * register an observer
+    *  the watch must out-live its registration (see removeWatch()).
+    *  Registrations come from the heap, as the Value may out-live an FsmArena the observer is built in
+    *
+    * @return false if the registration could not be allocated
+    */
+    bool addWatch(FsmWatch* watch) {
+      FsmArena::HeapScope heap;
+
+      return _watches.add(watch);
+    }
+
+   /**
+    * unregister an observer
+    */
+    void removeWatch(FsmWatch* watch);
+
+   /**
+    * get the number of registered observers
+    */
+    int getWatchCount() {
+      return _watches.size();
+    }
+};
+
+/**
+ * A Value that notifies its observers when setValue() changes it
+ *
+ * Use in place of a plain Value<T> for inputs that change slowly (eg; a sensor reading filtered to a boolean):
+ *  FsmSelectStateFromCondition then sleeps until the Value changes, rather than polling it on every update,
+ *  and FsmCachedCondition re-evaluates its Condition only when one of its inputs has changed.
+ *
+ * setValue() must be called from the thread that updates the FSMs (eg; loop(), not an interrupt handler,
+ *  which should post an FsmEvent instead), since it wakes them.
+ */
+template <class T>
+class FsmWatchedValue : public Value<T>, public FsmWatchedValueBase {
+  public:
+   /**
+    * Constructor
+    */
+    FsmWatchedValue() : Value<T>() { }
+
+   /**
+    * Constructor
+    *
+    * @param value The initial value
+    */
+    FsmWatchedValue(T value) : Value<T>(value) { }
+
+   /**
+    * set the value, notifying the observers if it has changed
+    */
+    virtual void setValue(T value) {
+      if (value != this->_value) {
+        Value<T>::setValue(value);
+        _notify();
+      }
+    }
+};
+
+/* --------------------------------------------------------------------------------------- */
+
+/**
+ * A Condition that caches the result of another, re-evaluating it only after a watched input has changed
+ *
+ * For use with FsmBranchOnConditionFalse (or anywhere else a Condition is read repeatedly) when the Condition is
+ *  an expensive tree over a few slowly changing inputs. Every input the Condition reads must be watched,
+ *  otherwise a change to it is missed until invalidate() is called.
+ *
+ *   FsmWatchedValue<bool> door;
+ *   FsmCachedCondition cached(&doorIsClosedAndLightIsOn);
+ *   cached.watch(&door);
+ *   cached.watch(&light);
+ *   Condition* condition = &cached;
+ *   seq->addChild(new FsmBranchOnConditionFalse(&condition, 3));
+ */
+class FsmCachedCondition : public Condition {
+  protected:
+    Condition* _condition;                   /**< protected variable _condition The Condition being cached */
+    FsmWatch _watch;                         /**< protected variable _watch Registration with the inputs (changed means the cache is stale) */
+    FsmArray<FsmWatchedValueBase*> _inputs;  /**< protected variable _inputs The inputs _watch is registered with */
+
+  public:
+   /**
+    * Constructor
+    *
+    * @param condition The Condition to cache
+    */
+    FsmCachedCondition(Condition* condition) : _condition(condition), Condition() {
+      _watch.fsm = NULL;
+      _watch.changed = true;
+    }
+
+   /**
+    * Destructor
+    *  unregisters from the inputs still watched
+    */
+    ~FsmCachedCondition() {
+      for (FsmWatchedValueBase** input = _inputs.begin(); input != _inputs.end(); input++) {
+        (*input)->removeWatch(&_watch);
+      }
+    }
+
+   /**
+    * re-evaluate whenever input changes
+    *  the FsmCachedCondition must not out-live input (call unwatch() first if it does)
+    *
+    * @return false if the registration could not be allocated
+    */
+    bool watch(FsmWatchedValueBase* input) {
+      if (!input->addWatch(&_watch)) {
+        return false;
+      }
+
+      if (!_inputs.add(input)) {
+        input->removeWatch(&_watch);
+        return false;
+      }
+
+      return true;
+    }
+
+   /**
+    * stop watching input
+    */
+    void unwatch(FsmWatchedValueBase* input) {
+      input->removeWatch(&_watch);
+
+      for (int i = 0; i < _inputs.size(); i++) {
+        if (_inputs.get(i) == input) {
+          _inputs.removeUnordered(i);
+          return;
+        }
+      }
+    }
+
+   /**
+    * re-evaluate on the next getValue() (eg; after changing an input that is not watched)
+    */
+    void invalidate() {
+      _watch.changed = true;
+    }
+
+   /**
+    * get the cached result, re-evaluating the Condition if an input has changed
+    */
+    virtual bool getValue() {
+      if (_watch.changed) {
+        _watch.changed = false;
+        this->_value = _condition->getValue();
+      }
+
+      return this->_value;
+    }
+};
+
+#endif  // _FSM_WATCH_H
@@ -144,6 +144,13 @@ class FsmUseIntFactorEffects : public FsmSequence {
     ~FsmUseIntFactorEffects() {
       delete _ifeEnumerator;
     }
+    
+   /**
+    * the enter action is this class's own, so tools (eg; FsmTable) must run it as it is
+    */
+    virtual void describe(FsmDescription& description) {
+      FsmUpdatable::describe(description);
+    }
 
     
 };
@@ -186,6 +193,13 @@ class FsmUseFactorEffects : public FsmSequence {
     ~FsmUseFactorEffects() {
       delete _feEnumerator;
     }
+    
+   /**
+    * the enter action is this class's own, so tools (eg; FsmTable) must run it as it is
+    */
+    virtual void describe(FsmDescription& description) {
+      FsmUpdatable::describe(description);
+    }
 };
 
 
@@ -207,20 +221,20 @@ void setup() {
   delayDurationValue.setValue(1000);
   sequenceDurationValue.setValue(5000);
 
-  root.name = "Root";
+  root.setName("Root");
 
 
   FsmSequence* seq0 = new FsmSequence();
-  seq0->name = "Seq0";
+  seq0->setName("Seq0");
   root.addChild(seq0);
 
   FsmUseFactorEffects* useFe = new FsmUseFactorEffects(&feList, &ifeList);
-  useFe->name = "UseFe";
+  useFe->setName("UseFe");
   seq0->addChild(useFe);
 
 /*
   FsmSequence* seq1 = new FsmSequence();
-  seq1->name = "Seq1";
+  seq1->setName("Seq1");
   seq0->addChild(seq1);
 
   seq1->addChild(new FsmDebugPrint("Started Seq 1"));
@@ -228,7 +242,7 @@ void setup() {
 
 
   FsmSequence* seq2 = new FsmSequence();
-  seq2->name = "Seq2";
+  seq2->setName("Seq2");
   seq0->addChild(seq2);
   
   seq2->addChild(new FsmDebugPrint("Started Seq 2"));
@@ -237,16 +251,16 @@ void setup() {
 
 /*
   FsmUseIntFactorEffects* useEcUp = new FsmUseIntFactorEffects(&ifeList);
-  useEcUp->name = "UseEcUp";
+  useEcUp->setName("UseEcUp");
   seq0->addChild(useEcUp);
 */
 /*
   FsmUseIntFactorEffects* useEcUp = new FsmUseIntFactorEffects(ecUpEnum);
-  useEcUp->name = "UseEcUp";
+  useEcUp->setName("UseEcUp");
   seq0->addChild(useEcUp);
 
   FsmUseIntFactorEffects* useEcDown = new FsmUseIntFactorEffects(ecDownEnum);
-  useEcDown->name = "useEcDown";
+  useEcDown->setName("useEcDown");
   seq0->addChild(useEcDown);
 */
 
@@ -288,6 +302,7 @@ void setup() {
   seq0->addChild(new FsmDebugPrint("Actual Ending 1"));
 */
   
+  root.resolve();
 
 }
 
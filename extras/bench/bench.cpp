@@ -0,0 +1,146 @@
+/** @file bench.cpp
+  *  Copyright (c) 2016 Ozbotics
+  *  Distributed under the MIT license (see LICENSE)
+  */
+#include "bench.h"
+
+#include <Arduino.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <string>
+#include <vector>
+
+struct BenchEntry {
+  const char* name;
+  Bench::Function fn;
+  long arg;
+};
+
+static std::vector<BenchEntry>& _registry() {
+  static std::vector<BenchEntry> registry;
+  return registry;
+}
+
+uint64_t Bench::_now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+}
+
+int Bench::add(const char* name, Function fn, const long* args, int count) {
+  for (int i=0; i<count; i++) {
+    BenchEntry entry = { name, fn, args[i] };
+    _registry().push_back(entry);
+  }
+  
+  return count;
+}
+
+static void _usage(const char* prog) {
+  fprintf(stderr, 
+    "usage: %s [--format=text|csv|json] [--filter=substring] [--min-time=seconds] [--repetitions=n] [--list]\n", prog);
+}
+
+int Bench::main(int argc, char** argv) {
+  const char* format = "text";
+  const char* filter = NULL;
+  double minTime = 0.1;
+  int repetitions = 3;
+  bool list = false;
+
+  for (int i=1; i<argc; i++) {
+    if (strncmp(argv[i], "--format=", 9) == 0) {
+      format = argv[i] + 9;
+    }
+    else if (strncmp(argv[i], "--filter=", 9) == 0) {
+      filter = argv[i] + 9;
+    }
+    else if (strncmp(argv[i], "--min-time=", 11) == 0) {
+      minTime = atof(argv[i] + 11);
+    }
+    else if (strncmp(argv[i], "--repetitions=", 14) == 0) {
+      repetitions = atoi(argv[i] + 14);
+    }
+    else if (strcmp(argv[i], "--list") == 0) {
+      list = true;
+    }
+    else {
+      _usage(argv[0]);
+      return (strcmp(argv[i], "--help") == 0) ? 0 : 1;
+    }
+  }
+
+  if ((strcmp(format, "text") != 0) && (strcmp(format, "csv") != 0) && (strcmp(format, "json") != 0)) {
+    _usage(argv[0]);
+    return 1;
+  }
+
+  // benchmarked states must not spend their time printing
+  Serial.setStream(NULL);
+
+  bool json = (strcmp(format, "json") == 0);
+  bool csv = (strcmp(format, "csv") == 0);
+  bool first = true;
+
+  if (json) {
+    printf("{\n  \"benchmarks\": [");
+  }
+  else if (csv) {
+    printf("name,arg,iterations,ns_per_op,items_per_op,ns_per_item,bytes\n");
+  }
+  else if (!list) {
+    printf("%-44s %10s %14s %12s %12s %10s\n", "benchmark", "arg", "iterations", "ns/op", "ns/item", "bytes");
+  }
+
+  for (size_t i=0; i<_registry().size(); i++) {
+    BenchEntry& entry = _registry()[i];
+    
+    if (filter && !strstr(entry.name, filter)) {
+      continue;
+    }
+
+    if (list) {
+      printf("%s/%ld\n", entry.name, entry.arg);
+      continue;
+    }
+
+    Bench bench(entry.name, entry.arg, minTime, repetitions);
+    entry.fn(bench, entry.arg);
+    
+    if (!bench.hasRun()) {
+      continue;
+    }
+
+    double nsPerItem = (bench.getItemsPerOp() > 0) ? bench.getNsPerOp() / bench.getItemsPerOp() : bench.getNsPerOp();
+
+    if (json) {
+      printf("%s\n    { \"name\": \"%s\", \"arg\": %ld, \"iterations\": %llu, \"ns_per_op\": %.3f, \"items_per_op\": %.1f, \"ns_per_item\": %.3f, \"bytes\": %ld }",
+        first ? "" : ",", entry.name, entry.arg, (unsigned long long) bench.getIterations(), bench.getNsPerOp(), bench.getItemsPerOp(), nsPerItem, bench.getBytes());
+    }
+    else if (csv) {
+      printf("%s,%ld,%llu,%.3f,%.1f,%.3f,%ld\n", 
+        entry.name, entry.arg, (unsigned long long) bench.getIterations(), bench.getNsPerOp(), bench.getItemsPerOp(), nsPerItem, bench.getBytes());
+    }
+    else {
+      printf("%-44s %10ld %14llu %12.2f %12.2f %10s\n", 
+        entry.name, entry.arg, (unsigned long long) bench.getIterations(), bench.getNsPerOp(), nsPerItem, 
+        (bench.getBytes() >= 0) ? std::to_string(bench.getBytes()).c_str() : "");
+    }
+    
+    fflush(stdout);
+    first = false;
+  }
+
+  if (json) {
+    printf("\n  ]\n}\n");
+  }
+
+  return 0;
+}
+
+int main(int argc, char** argv) {
+  return Bench::main(argc, argv);
+}
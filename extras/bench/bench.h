@@ -0,0 +1,130 @@
+/** @file bench.h
+  *  Copyright (c) 2016 Ozbotics
+  *  Distributed under the MIT license (see LICENSE)
+  *
+  *  A tiny self contained micro-benchmark harness for the host build.
+  *
+  *  Benchmarks are plain functions registered with FSM_BENCHMARK().
+  *  Each one builds its fixture, then hands the operation to be measured to Bench::run().
+  *  Results are printed as text, CSV or JSON (see --help).
+  */
+#ifndef _FSM_BENCH_H
+ #define _FSM_BENCH_H
+
+#include <stdint.h>
+
+/**
+ * Measures one operation and records the result
+ */
+class Bench {
+  public:
+    typedef void (*Function)(Bench& bench, long arg);
+
+  protected:
+    const char* _name;   /**< protected variable _name Name of the running benchmark */
+    long _arg;           /**< protected variable _arg Argument of the running benchmark */
+    double _minTime;     /**< protected variable _minTime Minimum measured time per repetition (seconds) */
+    int _repetitions;    /**< protected variable _repetitions Number of repetitions, the fastest is reported */
+    
+    uint64_t _iterations;  /**< protected variable _iterations Iterations of the fastest repetition */
+    double _nsPerOp;       /**< protected variable _nsPerOp Result of the fastest repetition */
+    double _itemsPerOp;    /**< protected variable _itemsPerOp Items processed per operation (0 if not set) */
+    long _bytes;           /**< protected variable _bytes Memory used by the fixture (-1 if not set) */
+    bool _ran;             /**< protected variable _ran Was run() called */
+
+    static uint64_t _now();
+    
+  public:
+    Bench(const char* name, long arg, double minTime, int repetitions) : 
+      _name(name), _arg(arg), _minTime(minTime), _repetitions(repetitions), 
+      _iterations(0), _nsPerOp(0), _itemsPerOp(0), _bytes(-1), _ran(false) { }
+
+   /**
+    * measure op(), called repeatedly until the minimum time has passed
+    *
+    * @param op The operation to measure
+    */
+    template <typename Op>
+    void run(Op op) {
+      _ran = true;
+      
+      for (int r=0; r<_repetitions; r++) {
+        uint64_t iterations = 1;
+        
+        while (true) {
+          uint64_t start = _now();
+          for (uint64_t i=0; i<iterations; i++) {
+            op();
+          }
+          uint64_t elapsed = _now() - start;
+
+          if ((elapsed >= (uint64_t)(_minTime * 1e9)) || (iterations >= (1ull << 40))) {
+            double nsPerOp = (double) elapsed / (double) iterations;
+            
+            if ((_iterations == 0) || (nsPerOp < _nsPerOp)) {
+              _nsPerOp = nsPerOp;
+              _iterations = iterations;
+            }
+            break;
+          }
+          
+          iterations *= (elapsed < 1000000) ? 10 : 2;
+        }
+      }
+    }
+
+   /**
+    * report a throughput, eg; the number of states touched by one operation
+    */
+    void setItemsPerOp(double items) { _itemsPerOp = items; }
+    
+   /**
+    * report the memory used by the fixture, eg; to compare representations
+    */
+    void setBytes(long bytes) { _bytes = bytes; }
+    
+    const char* getName() { return _name; }
+    long getArg() { return _arg; }
+    uint64_t getIterations() { return _iterations; }
+    double getNsPerOp() { return _nsPerOp; }
+    double getItemsPerOp() { return _itemsPerOp; }
+    long getBytes() { return _bytes; }
+    bool hasRun() { return _ran; }
+
+   /**
+    * register a benchmark (use FSM_BENCHMARK())
+    *
+    * @param name Name of the benchmark
+    * @param fn The benchmark function
+    * @param args Arguments, the benchmark is run once per argument
+    * @param count Number of arguments
+    */
+    static int add(const char* name, Function fn, const long* args, int count);
+
+   /**
+    * parse the command line, run the selected benchmarks and print the results
+    */
+    static int main(int argc, char** argv);
+};
+
+/**
+ * prevent the compiler from optimising away a value
+ */
+template <typename T>
+inline void benchKeep(T const& value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+#define FSM_BENCH_CONCAT2(a, b) a##b
+#define FSM_BENCH_CONCAT(a, b) FSM_BENCH_CONCAT2(a, b)
+
+/**
+ * register fn as benchmark 'name', run once per argument
+ *  FSM_BENCHMARK("collection/update", benchCollection, 1, 8, 64)
+ */
+#define FSM_BENCHMARK(name, fn, ...) \
+  static const long FSM_BENCH_CONCAT(_benchArgs_, __LINE__)[] = { __VA_ARGS__ }; \
+  static const int FSM_BENCH_CONCAT(_benchReg_, __LINE__) = Bench::add(name, fn, FSM_BENCH_CONCAT(_benchArgs_, __LINE__), \
+    sizeof(FSM_BENCH_CONCAT(_benchArgs_, __LINE__)) / sizeof(long));
+
+#endif  // _FSM_BENCH_H
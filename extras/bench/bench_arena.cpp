@@ -0,0 +1,75 @@
+/** @file bench_arena.cpp
+  *  Copyright (c) 2016 Ozbotics
+  *  Distributed under the MIT license (see LICENSE)
+  *
+  *  Building and tearing down machines from the heap, and from an FsmArena
+  */
+#include "bench.h"
+
+#include <FSM.h>
+
+static Value<Duration> _duration(100);
+static char _message[] = "step";
+
+/**
+ * a Collection of width Sequences, each: Delay, DebugPrint, Finish
+ */
+static FsmCollection* _buildMachine(long width) {
+  FsmCollection* root = new FsmCollection();
+  root->reserveChildren(width);
+  
+  for (long i=0; i<width; i++) {
+    FsmSequence* seq = new FsmSequence();
+    seq->addChild(new FsmDelay(&_duration));
+    seq->addChild(new FsmDebugPrint(_message));
+    seq->addChild(new FsmFinish());
+    root->addChild(seq);
+  }
+  
+  return root;
+}
+
+static void benchBuildHeap(Bench& bench, long width) {
+  bench.setItemsPerOp(width * 4);
+  bench.run([&] {
+    FsmCollection* root = _buildMachine(width);
+    benchKeep(root);
+    delete root;
+  });
+}
+FSM_BENCHMARK("arena/build/heap", benchBuildHeap, 1, 16, 128)
+
+static void benchBuildArena(Bench& bench, long width) {
+  FsmArena arena(64 * 1024);
+  {
+    FsmArena::Scope scope(arena);
+    _buildMachine(width);
+    bench.setBytes(arena.getOverflowCount() ? -1 : arena.getUsed());
+    arena.reset();
+  }
+  
+  bench.setItemsPerOp(width * 4);
+  bench.run([&] {
+    FsmArena::Scope scope(arena);
+    benchKeep(_buildMachine(width));
+    arena.reset();
+  });
+}
+FSM_BENCHMARK("arena/build/arena", benchBuildArena, 1, 16, 128)
+
+/**
+ * build with the arena, but tear down with delete (destructors run, arena memory is not freed)
+ */
+static void benchBuildArenaDelete(Bench& bench, long width) {
+  FsmArena arena(64 * 1024);
+  
+  bench.setItemsPerOp(width * 4);
+  bench.run([&] {
+    FsmArena::Scope scope(arena);
+    FsmCollection* root = _buildMachine(width);
+    benchKeep(root);
+    delete root;
+    arena.reset();
+  });
+}
+FSM_BENCHMARK("arena/build/arena_delete", benchBuildArenaDelete, 1, 16, 128)
@@ -0,0 +1,93 @@
+/** @file bench_bank.cpp
+  *  Copyright (c) 2016 Ozbotics
+  *  Distributed under the MIT license (see LICENSE)
+  *
+  *  Many instances of one machine, as separate trees and as an FsmBank
+  */
+#include "bench.h"
+
+#include <FSM.h>
+#include <FsmBank.h>
+
+#include <vector>
+
+static Condition _condition(true);
+static Condition* _conditionPtr = &_condition;
+static Value<bool> _output(false);
+static Value<Duration> _longDuration(3600000UL);
+
+/**
+ * branch, two assignments, finish: one leaf runs per update
+ */
+static FsmSequence* _buildStepper() {
+  FsmSequence* outer = new FsmSequence();
+  FsmSequence* seq = new FsmSequence();
+  seq->addChild(new FsmBranchOnConditionFalse(&_conditionPtr, 3));
+  seq->addChild(new FsmAssignConditionToValue(&_condition, &_output));
+  seq->addChild(new FsmAssignConditionToValue(&_condition, &_output));
+  seq->addChild(new FsmFinish());
+  outer->addChild(seq);
+  
+  return outer;
+}
+
+/**
+ * waits on a long delay, then finishes
+ */
+static FsmSequence* _buildWaiter() {
+  FsmSequence* seq = new FsmSequence();
+  seq->addChild(new FsmDelay(&_longDuration));
+  seq->addChild(new FsmFinish());
+  
+  return seq;
+}
+
+static void benchTrees(Bench& bench, long instances, FsmSequence* (*build)()) {
+  std::vector<FsmSequence*> trees;
+  for (long i=0; i<instances; i++) {
+    trees.push_back(build());
+  }
+  
+  bench.setItemsPerOp(instances);
+  bench.run([&] {
+    for (FsmSequence* tree : trees) {
+      tree->update();
+    }
+  });
+  
+  for (FsmSequence* tree : trees) {
+    delete tree;
+  }
+}
+
+static void benchBank(Bench& bench, long instances, FsmSequence* (*build)()) {
+  FsmSequence* definition = build();
+  FsmBank bank;
+  bank.compile(definition, (uint16_t) instances);
+  
+  bench.setItemsPerOp(instances);
+  bench.setBytes(bank.getMemoryUsage());
+  bench.run([&] { bank.update(); });
+  
+  delete definition;
+}
+
+static void benchSteppingTrees(Bench& bench, long instances) {
+  benchTrees(bench, instances, _buildStepper);
+}
+FSM_BENCHMARK("bank/stepping/trees", benchSteppingTrees, 1, 100, 10000)
+
+static void benchSteppingBank(Bench& bench, long instances) {
+  benchBank(bench, instances, _buildStepper);
+}
+FSM_BENCHMARK("bank/stepping/bank", benchSteppingBank, 1, 100, 10000)
+
+static void benchWaitingTrees(Bench& bench, long instances) {
+  benchTrees(bench, instances, _buildWaiter);
+}
+FSM_BENCHMARK("bank/waiting/trees", benchWaitingTrees, 1, 100, 10000)
+
+static void benchWaitingBank(Bench& bench, long instances) {
+  benchBank(bench, instances, _buildWaiter);
+}
+FSM_BENCHMARK("bank/waiting/bank", benchWaitingBank, 1, 100, 10000)
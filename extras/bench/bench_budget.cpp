@@ -0,0 +1,52 @@
+/** @file bench_budget.cpp
+  *  Copyright (c) 2016 Ozbotics
+  *  Distributed under the MIT license (see LICENSE)
+  *
+  *  Tick latency of a Collection of busy States: update() against update(budget)
+  */
+#include "bench.h"
+
+#include <FSM.h>
+
+#define BENCH_BUDGET_WORK 10  /**< microseconds each busy State spends per update */
+
+/**
+ * spends BENCH_BUDGET_WORK microseconds on every update (a heavy region)
+ */
+class BenchSpinningState : public FsmState {
+  protected:
+    virtual void _updateState() {
+      unsigned long started = micros();
+      
+      while (micros() - started < BENCH_BUDGET_WORK) { }
+    }
+};
+
+/**
+ * one op is one update of a Collection of count busy States (in Collections of 4, to stop in nested passes)
+ */
+static void benchBudget(Bench& bench, long count, unsigned long budget) {
+  FsmCollection root;
+  
+  for (long i=0; i<count; i+=4) {
+    FsmCollection* region = new FsmCollection();
+    
+    for (long j=i; (j<i+4) && (j<count); j++) {
+      region->addChild(new BenchSpinningState());
+    }
+    
+    root.addChild(region);
+  }
+  
+  bench.run([&] { root.update(budget); });
+}
+
+static void benchUnbounded(Bench& bench, long count) {
+  benchBudget(bench, count, 0);
+}
+FSM_BENCHMARK("budget/busy/unbounded", benchUnbounded, 4, 32)
+
+static void benchBudget100us(Bench& bench, long count) {
+  benchBudget(bench, count, 100);
+}
+FSM_BENCHMARK("budget/busy/100us", benchBudget100us, 4, 32)
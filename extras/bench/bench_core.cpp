@@ -0,0 +1,226 @@
+/** @file bench_core.cpp
+  *  Copyright (c) 2016 Ozbotics
+  *  Distributed under the MIT license (see LICENSE)
+  *
+  *  Benchmarks of the FSM core: FsmState::update, FsmCollection::_updateState and the ancestor transitions
+  */
+#include "bench.h"
+
+#include <FSM.h>
+
+/**
+ * Requests a transition to the next state on every update
+ */
+class BenchStep : public FsmState {
+  protected:
+    virtual void _updateState() {
+      _transitionAncestorToNext(1);
+    }
+};
+
+/**
+ * Requests a transition to the start of an ancestor on every update
+ */
+class BenchJump : public FsmState {
+  protected:
+    FsmIndex _depth;
+    
+    virtual void _updateState() {
+      _transitionAncestorTo(0, _depth);
+    }
+    
+  public:
+    BenchJump(FsmIndex depth) : _depth(depth), FsmState() { }
+};
+
+/**
+ * Exposes the ancestor transitions so that the walk can be measured on its own
+ */
+class BenchProbe : public FsmState {
+  public:
+    void to(FsmIndex childInd, FsmIndex depth) { _transitionAncestorTo(childInd, depth); }
+    void next(FsmIndex depth) { _transitionAncestorToNext(depth); }
+    void start(FsmIndex depth) { _transitionAncestorToStart(depth); }
+};
+
+/**
+ * build a chain of 'depth' nested Sequences, with leaf as the innermost state
+ *
+ * @return the outermost Sequence
+ */
+static FsmSequence* _buildChain(long depth, FsmState* leaf) {
+  FsmSequence* outer = new FsmSequence();
+  FsmSequence* seq = outer;
+  
+  for (long d=1; d<depth; d++) {
+    FsmSequence* inner = new FsmSequence();
+    seq->addChild(inner);
+    seq = inner;
+  }
+  
+  seq->addChild(leaf);
+  
+  return outer;
+}
+
+static Value<Duration> _longDuration(3600000UL);
+
+
+static void benchStateUpdateIdle(Bench& bench, long) {
+  FsmIdle state;
+  
+  bench.run([&] { state.update(); });
+}
+FSM_BENCHMARK("state/update/idle", benchStateUpdateIdle, 0)
+
+static void benchStateUpdateDelay(Bench& bench, long) {
+  FsmDelay state(&_longDuration);
+  
+  bench.run([&] { state.update(); });
+}
+FSM_BENCHMARK("state/update/delay", benchStateUpdateDelay, 0)
+
+static void benchStateEnterExit(Bench& bench, long) {
+  FsmSequence seq;
+  seq.addChild(new BenchStep());
+  seq.addChild(new BenchStep());
+  
+  bench.run([&] { seq.update(); });
+}
+FSM_BENCHMARK("state/update/enter_exit", benchStateEnterExit, 0)
+
+
+static void benchCollectionIdle(Bench& bench, long width) {
+  FsmCollection root;
+  for (long i=0; i<width; i++) {
+    root.addChild(new FsmIdle());
+  }
+  
+  bench.setItemsPerOp(width);
+  bench.run([&] { root.update(); });
+}
+FSM_BENCHMARK("collection/update/idle", benchCollectionIdle, 1, 8, 32, 128, 255, 1024, 4096)
+
+static void benchCollectionDelay(Bench& bench, long width) {
+  FsmCollection root;
+  for (long i=0; i<width; i++) {
+    root.addChild(new FsmDelay(&_longDuration));
+  }
+  
+  bench.setItemsPerOp(width);
+  bench.run([&] { root.update(); });
+}
+FSM_BENCHMARK("collection/update/delay", benchCollectionDelay, 1, 8, 32, 128, 255, 1024, 4096)
+
+static void benchCollectionSequences(Bench& bench, long width) {
+  FsmCollection root;
+  for (long i=0; i<width; i++) {
+    FsmSequence* seq = new FsmSequence();
+    seq->addChild(new FsmIdle());
+    root.addChild(seq);
+  }
+  
+  bench.setItemsPerOp(width);
+  bench.run([&] { root.update(); });
+}
+FSM_BENCHMARK("collection/update/sequences", benchCollectionSequences, 1, 8, 32, 128, 255, 1024, 4096)
+
+static void benchSequenceCurrent(Bench& bench, long length) {
+  FsmSequence seq((FsmIndex)(length - 1));
+  for (long i=0; i<length; i++) {
+    seq.addChild(new FsmIdle());
+  }
+  
+  bench.run([&] { seq.update(); });
+}
+FSM_BENCHMARK("sequence/update/last_child", benchSequenceCurrent, 1, 8, 32, 128, 255, 1024, 4096)
+
+static void benchSequenceStepping(Bench& bench, long length) {
+  FsmSequence seq;
+  for (long i=0; i<length; i++) {
+    seq.addChild(new BenchStep());
+  }
+  
+  bench.run([&] { seq.update(); });
+}
+FSM_BENCHMARK("sequence/update/stepping", benchSequenceStepping, 1, 8, 32, 128, 255, 1024, 4096)
+
+
+static void benchTransitionTo(Bench& bench, long depth) {
+  BenchProbe* probe = new BenchProbe();
+  FsmSequence* root = _buildChain(depth, probe);
+  
+  bench.run([&] { probe->to(0, (FsmIndex) depth); });
+  
+  delete root;
+}
+FSM_BENCHMARK("transition/to", benchTransitionTo, 1, 2, 4, 8, 16, 32, 256)
+
+static void benchTransitionNext(Bench& bench, long depth) {
+  BenchProbe* probe = new BenchProbe();
+  FsmSequence* root = _buildChain(depth, probe);
+  
+  bench.run([&] { probe->next((FsmIndex) depth); });
+  
+  delete root;
+}
+FSM_BENCHMARK("transition/next", benchTransitionNext, 1, 2, 4, 8, 16, 32, 256)
+
+static void benchTransitionStart(Bench& bench, long depth) {
+  BenchProbe* probe = new BenchProbe();
+  FsmSequence* root = _buildChain(depth, probe);
+  
+  bench.run([&] { probe->start((FsmIndex) depth); });
+  
+  delete root;
+}
+FSM_BENCHMARK("transition/start", benchTransitionStart, 1, 2, 4, 8, 16, 32, 256)
+
+static void benchTransitionTick(Bench& bench, long depth) {
+  FsmSequence* root = _buildChain(depth, new BenchJump((FsmIndex) depth));
+  
+  bench.setItemsPerOp(depth);
+  bench.run([&] { root->update(); });
+  
+  delete root;
+}
+FSM_BENCHMARK("transition/tick", benchTransitionTick, 1, 2, 4, 8, 16, 32, 256)
+
+/**
+ * Fires a bound FsmTransition instead of walking the ancestors
+ */
+class BenchHandle : public FsmState {
+  protected:
+    FsmIndex _depth;
+    
+  public:
+    FsmTransition transition;
+    
+    BenchHandle(FsmIndex depth) : _depth(depth), FsmState() { }
+    
+    virtual void resolve() {
+      transition.bind(this, _depth);
+    }
+};
+
+static void benchTransitionHandleNext(Bench& bench, long depth) {
+  BenchHandle* probe = new BenchHandle((FsmIndex) depth);
+  FsmSequence* root = _buildChain(depth, probe);
+  root->resolve();
+  
+  bench.run([&] { probe->transition.toNext(); });
+  
+  delete root;
+}
+FSM_BENCHMARK("transition/handle/next", benchTransitionHandleNext, 1, 2, 4, 8, 16, 32, 256)
+
+static void benchTransitionHandleTo(Bench& bench, long depth) {
+  BenchHandle* probe = new BenchHandle((FsmIndex) depth);
+  FsmSequence* root = _buildChain(depth, probe);
+  root->resolve();
+  
+  bench.run([&] { probe->transition.to(0); });
+  
+  delete root;
+}
+FSM_BENCHMARK("transition/handle/to", benchTransitionHandleTo, 1, 2, 4, 8, 16, 32, 256)
@@ -0,0 +1,96 @@
+/** @file bench_coroutine.cpp
+  *  Copyright (c) 2016 Ozbotics
+  *  Distributed under the MIT license (see LICENSE)
+  *
+  *  A scripted sequence of steps, as a Sequence of States and as a coroutine State
+  */
+#include "bench.h"
+
+#include <FSM.h>
+#include <FsmCoroutine.h>
+
+#ifdef __cpp_impl_coroutine
+
+static Value<Duration> _zero(0);
+static Condition _true(true);
+static Value<bool> _out(false);
+static unsigned long _passes = 0;
+
+/**
+ * counts a pass through the script, then moves on
+ */
+class BenchScriptCount : public FsmState {
+  protected:
+    virtual void _enterState() {
+      _passes++;
+      _transitionAncestorToNext(1);
+    }
+};
+
+/**
+ * the script as a coroutine: steps x (assign, delay)
+ */
+class BenchScript : public FsmCoroutineState {
+  protected:
+    long _steps;
+    
+    virtual Script _run() {
+      _passes++;
+      
+      for (long i=0; i<_steps; i++) {
+        _out.setValue(_true.getValue());
+        co_await delay(&_zero);
+      }
+    }
+    
+  public:
+    BenchScript(long steps) : _steps(steps), FsmCoroutineState() { }
+};
+
+/**
+ * one op is a whole pass through the script, however many updates that takes
+ */
+static void _benchPasses(Bench& bench, FsmUpdatable* root) {
+  bench.run([&] {
+    unsigned long passes = _passes;
+    
+    while (_passes == passes) {
+      root->update();
+    }
+  });
+}
+
+static void benchScriptTree(Bench& bench, long steps) {
+  FsmArena arena(256 * 1024);
+  FsmArena::Scope scope(arena);
+  FsmSequence* root = new FsmSequence();
+  
+  root->addChild(new BenchScriptCount());
+  for (long i=0; i<steps; i++) {
+    root->addChild(new FsmAssignConditionToValue(&_true, &_out));
+    root->addChild(new FsmDelay(&_zero));
+  }
+  root->update();
+  
+  bench.setItemsPerOp(steps);
+  bench.setBytes(arena.getUsed());
+  _benchPasses(bench, root);
+}
+FSM_BENCHMARK("coroutine/script/tree", benchScriptTree, 4, 32)
+
+static void benchScriptCoroutine(Bench& bench, long steps) {
+  FsmArena arena(256 * 1024);
+  FsmArena::Scope scope(arena);
+  FsmSequence* root = new FsmSequence();
+  
+  root->addChild(new BenchScript(steps));
+  root->update();
+  
+  // the nodes only: the frame is recycled by FsmCoroutinePool
+  bench.setItemsPerOp(steps);
+  bench.setBytes(arena.getUsed());
+  _benchPasses(bench, root);
+}
+FSM_BENCHMARK("coroutine/script/coroutine", benchScriptCoroutine, 4, 32)
+
+#endif  // __cpp_impl_coroutine
@@ -0,0 +1,56 @@
+/** @file bench_deadline.cpp
+  *  Copyright (c) 2016 Ozbotics
+  *  Distributed under the MIT license (see LICENSE)
+  *
+  *  Benchmarks of the deadline query used by FsmRunner to decide how long to sleep
+  */
+#include "bench.h"
+
+#include <FSM.h>
+#include <FsmRunner.h>
+
+static Value<Duration> _longDuration(3600000UL);
+
+static void benchDeadlineDelays(Bench& bench, long width) {
+  FsmCollection root;
+  for (long i=0; i<width; i++) {
+    root.addChild(new FsmDelay(&_longDuration));
+  }
+  root.update();
+  
+  bench.setItemsPerOp(width);
+  bench.run([&] { benchKeep(root.timeToDeadline()); });
+}
+FSM_BENCHMARK("deadline/collection/delay", benchDeadlineDelays, 1, 8, 32, 128, 255)
+
+static void benchDeadlineSequences(Bench& bench, long width) {
+  FsmCollection root;
+  for (long i=0; i<width; i++) {
+    FsmSequence* seq = new FsmSequence();
+    seq->addChild(new FsmIdle());
+    root.addChild(seq);
+  }
+  root.update();
+  
+  bench.setItemsPerOp(width);
+  bench.run([&] { benchKeep(root.timeToDeadline()); });
+}
+FSM_BENCHMARK("deadline/collection/sequences", benchDeadlineSequences, 1, 8, 32, 128, 255)
+
+/**
+ * updates needed to get through a 20ms delay, busy-polling vs FsmRunner
+ *  reported as 'iterations' of a single op that runs the whole delay
+ */
+static Value<Duration> _shortDuration(20);
+
+static void benchRunnerDelay(Bench& bench, long) {
+  FsmSequence root;
+  root.addChild(new FsmDelay(&_shortDuration));
+  root.addChild(new FsmDelay(&_shortDuration));
+  
+  FsmRunner runner(&root);
+  
+  bench.setItemsPerOp(1);
+  bench.run([&] { runner.runOnce(); });
+}
+FSM_BENCHMARK("deadline/runner/run_once_20ms_delay", benchRunnerDelay, 0)
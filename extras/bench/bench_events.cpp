@@ -0,0 +1,75 @@
+/** @file bench_events.cpp
+  *  Copyright (c) 2016 Ozbotics
+  *  Distributed under the MIT license (see LICENSE)
+  *
+  *  Reacting to inputs by polling Conditions, and by dispatching events
+  */
+#include "bench.h"
+
+#include <FSM.h>
+
+static Value<bool> _input(false);
+
+/**
+ * width Selects, each polling the input on every update
+ */
+static void benchPolledInputs(Bench& bench, long width) {
+  FsmCollection root;
+  for (long i=0; i<width; i++) {
+    FsmSelectStateFromCondition* select = new FsmSelectStateFromCondition(&_input);
+    select->addChild(new FsmIdle());
+    select->addChild(new FsmIdle());
+    root.addChild(select);
+  }
+  
+  bench.setItemsPerOp(width);
+  bench.run([&] { root.update(); });
+}
+FSM_BENCHMARK("events/idle_update/polled", benchPolledInputs, 16, 1024)
+
+/**
+ * width Sequences, each waiting for its own event
+ */
+static FsmCollection* _buildWaiters(long width) {
+  FsmCollection* root = new FsmCollection();
+  for (long i=0; i<width; i++) {
+    FsmSequence* seq = new FsmSequence();
+    seq->addChild(new FsmWaitForEvent((FsmEventId) i));
+    seq->addChild(new FsmWaitForEvent((FsmEventId) i));
+    root->addChild(seq);
+  }
+  
+  return root;
+}
+
+static void benchEventInputs(Bench& bench, long width) {
+  FsmCollection* root = _buildWaiters(width);
+  root->update();
+  
+  bench.setItemsPerOp(width);
+  bench.run([&] { root->update(); });
+  
+  delete root;
+}
+FSM_BENCHMARK("events/idle_update/waiting", benchEventInputs, 16, 1024)
+
+/**
+ * post and dispatch one event, then update so that the next State is entered
+ */
+static void benchDispatch(Bench& bench, long width) {
+  FsmCollection* root = _buildWaiters(width);
+  FsmEventDispatcher events(16);
+  events.build(root);
+  root->update();
+  
+  FsmEventId id = 0;
+  bench.run([&] {
+    events.post(id);
+    events.dispatch();
+    root->update();
+    id = (id + 1) % width;
+  });
+  
+  delete root;
+}
+FSM_BENCHMARK("events/post_dispatch_update", benchDispatch, 16, 1024)
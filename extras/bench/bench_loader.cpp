@@ -0,0 +1,111 @@
+/** @file bench_loader.cpp
+  *  Copyright (c) 2016 Ozbotics
+  *  Distributed under the MIT license (see LICENSE)
+  *
+  *  Building a machine in code, and with FsmLoader from text and binary definitions
+  */
+#include "bench.h"
+
+#include <FSM.h>
+#include <FsmLoader.h>
+
+#include <string>
+
+static Value<Duration> _duration(100);
+static char _message[] = "step";
+
+static const FsmBinding _bindings[] = {
+  { "duration", &_duration, NULL }
+};
+
+/**
+ * a Collection of width Sequences, each: Delay, DebugPrint, Finish (as bench_arena.cpp)
+ */
+static FsmCollection* _buildInCode(long width) {
+  FsmCollection* root = new FsmCollection();
+  root->reserveChildren(width);
+
+  for (long i=0; i<width; i++) {
+    FsmSequence* seq = new FsmSequence();
+    seq->addChild(new FsmDelay(&_duration));
+    seq->addChild(new FsmDebugPrint(_message));
+    seq->addChild(new FsmFinish());
+    root->addChild(seq);
+  }
+
+  return root;
+}
+
+/**
+ * the same machine, as a text definition
+ */
+static std::string _definition(long width) {
+  std::string text = "collection\n";
+
+  for (long i=0; i<width; i++) {
+    text += "  sequence\n    delay duration\n    debug_print step\n    finish\n";
+  }
+
+  return text;
+}
+
+static void benchLoadCode(Bench& bench, long width) {
+  FsmArena arena(256 * 1024);
+
+  bench.setItemsPerOp(width * 4);
+  bench.run([&] {
+    FsmArena::Scope scope(arena);
+    benchKeep(_buildInCode(width));
+    arena.reset();
+  });
+}
+FSM_BENCHMARK("loader/code", benchLoadCode, 16, 128)
+
+static void benchLoadText(Bench& bench, long width) {
+  FsmArena arena(256 * 1024);
+  FsmLoader loader(_bindings, 1);
+  std::string text = _definition(width);
+
+  bench.setItemsPerOp(width * 4);
+  bench.setBytes(text.size());
+  bench.run([&] {
+    FsmArena::Scope scope(arena);
+    benchKeep(loader.loadText(text.c_str()));
+    arena.reset();
+  });
+}
+FSM_BENCHMARK("loader/text", benchLoadText, 16, 128)
+
+static void benchLoadBinary(Bench& bench, long width) {
+  FsmArena arena(256 * 1024);
+  FsmLoader loader(_bindings, 1);
+  std::string text = _definition(width);
+  size_t size = loader.compile(text.c_str(), NULL, 0);
+  byte* definition = (byte*) malloc(size);
+  loader.compile(text.c_str(), definition, size);
+
+  bench.setItemsPerOp(width * 4);
+  bench.setBytes(size);
+  bench.run([&] {
+    FsmArena::Scope scope(arena);
+    benchKeep(loader.loadBinary(definition, size));
+    arena.reset();
+  });
+
+  free(definition);
+}
+FSM_BENCHMARK("loader/binary", benchLoadBinary, 16, 128)
+
+static void benchCompile(Bench& bench, long width) {
+  FsmLoader loader(_bindings, 1);
+  std::string text = _definition(width);
+  size_t size = loader.compile(text.c_str(), NULL, 0);
+  byte* definition = (byte*) malloc(size);
+
+  bench.setItemsPerOp(width * 4);
+  bench.setBytes(text.size());
+  bench.run([&] { benchKeep(loader.compile(text.c_str(), definition, size)); });
+
+  free(definition);
+}
+FSM_BENCHMARK("loader/compile", benchCompile, 16, 128)
@@ -0,0 +1,64 @@
+/** @file bench_microsteps.cpp
+  *  Copyright (c) 2016 Ozbotics
+  *  Distributed under the MIT license (see LICENSE)
+  *
+  *  A chain of transient States, entered one per update and run to completion in one update
+  */
+#include "bench.h"
+
+#include <FSM.h>
+
+static unsigned long _passes = 0;
+
+/**
+ * moves on as soon as it is entered (a transient State), optionally counting a pass through the chain
+ */
+class BenchTransientStep : public FsmState {
+  protected:
+    bool _counts;
+    
+    virtual void _enterState() {
+      if (_counts) {
+        _passes++;
+      }
+      _transitionAncestorToNext(1);
+    }
+  
+  public:
+    BenchTransientStep(bool counts) : _counts(counts), FsmState() { }
+};
+
+/**
+ * a Sequence of length transient States; one op is a whole pass through it, however many updates that takes
+ */
+static void benchChain(Bench& bench, long length, FsmIndex microsteps) {
+  FsmSequence root;
+  root.setMicrosteps(microsteps);
+  
+  for (long i=0; i<length; i++) {
+    root.addChild(new BenchTransientStep(i == 0));
+  }
+  
+  unsigned long updates = 0;
+  
+  bench.run([&] {
+    unsigned long passes = _passes;
+    
+    while (_passes == passes) {
+      root.update();
+      updates++;
+    }
+  });
+  
+  benchKeep(updates);
+}
+
+static void benchStepped(Bench& bench, long length) {
+  benchChain(bench, length, 1);
+}
+FSM_BENCHMARK("microsteps/chain/one_per_update", benchStepped, 5, 50)
+
+static void benchRunToCompletion(Bench& bench, long length) {
+  benchChain(bench, length, (FsmIndex) length);
+}
+FSM_BENCHMARK("microsteps/chain/run_to_completion", benchRunToCompletion, 5, 50)
@@ -0,0 +1,64 @@
+/** @file bench_names.cpp
+  *  Copyright (c) 2016 Ozbotics
+  *  Distributed under the MIT license (see LICENSE)
+  *
+  *  Looking up children by name, before and after resolve()
+  */
+#include "bench.h"
+
+#include <FSM.h>
+
+#include <string>
+#include <vector>
+
+/**
+ * a Sequence of width named Idle states ("state0", "state1", ...)
+ */
+static FsmSequence* _buildNamed(long width, std::vector<std::string>& names) {
+  FsmSequence* seq = new FsmSequence();
+  
+  names.resize(width);
+  for (long i=0; i<width; i++) {
+    names[i] = "state" + std::to_string(i);
+    
+    FsmIdle* state = new FsmIdle();
+    state->setName(names[i].c_str());
+    seq->addChild(state);
+  }
+  
+  return seq;
+}
+
+static void benchIndexOfLinear(Bench& bench, long width) {
+  std::vector<std::string> names;
+  FsmSequence* seq = _buildNamed(width, names);
+  const char* last = names[width - 1].c_str();
+  
+  bench.run([&] { benchKeep(seq->indexOf(last)); });
+  
+  delete seq;
+}
+FSM_BENCHMARK("names/index_of/linear", benchIndexOfLinear, 8, 64, 1024)
+
+static void benchIndexOfHashed(Bench& bench, long width) {
+  std::vector<std::string> names;
+  FsmSequence* seq = _buildNamed(width, names);
+  const char* last = names[width - 1].c_str();
+  seq->resolve();
+  
+  bench.run([&] { benchKeep(seq->indexOf(last)); });
+  
+  delete seq;
+}
+FSM_BENCHMARK("names/index_of/hashed", benchIndexOfHashed, 8, 64, 1024)
+
+static void benchResolve(Bench& bench, long width) {
+  std::vector<std::string> names;
+  FsmSequence* seq = _buildNamed(width, names);
+  
+  bench.setItemsPerOp(width);
+  bench.run([&] { seq->resolve(); });
+  
+  delete seq;
+}
+FSM_BENCHMARK("names/resolve", benchResolve, 8, 64, 1024)
@@ -0,0 +1,117 @@
+/** @file bench_optimizer.cpp
+  *  Copyright (c) 2016 Ozbotics
+  *  Distributed under the MIT license (see LICENSE)
+  *
+  *  A Sequence of instantaneous States (and unreachable ones), as built and after FsmOptimizer
+  */
+#include "bench.h"
+
+#include <FSM.h>
+#include <FsmOptimizer.h>
+
+static unsigned long _passes = 0;
+
+/**
+ * a Condition that counts the times it is read, ie; passes through the chain
+ */
+class BenchCountingCondition : public Condition {
+  public:
+    virtual bool getValue() {
+      _passes++;
+      return true;
+    }
+};
+
+static BenchCountingCondition _counter;
+static Value<bool> _assigned;
+static Timer _timer;
+static Value<Duration> _duration(100);
+static char _message[] = "step";
+static Value<bool> _selector(false);
+
+#define BENCH_OPTIMIZER_SIBLINGS 8  /**< polling Selects updated beside the chain, standing in for the rest of a machine */
+
+/**
+ * a Sequence that starts at 2 (so the first two States are dead), then length instantaneous States
+ */
+static FsmSequence* _build(long length) {
+  FsmSequence* root = new FsmSequence(2);
+
+  root->addChild(new FsmDebugPrint(_message));
+  root->addChild(new FsmDelay(&_duration));
+  root->addChild(new FsmAssignConditionToValue(&_counter, &_assigned));
+
+  for (long i=1; i<length; i++) {
+    if (i & 1) {
+      root->addChild(new FsmStartTimer(&_timer, &_duration));
+    }
+    else {
+      root->addChild(new FsmDebugPrint(_message));
+    }
+  }
+
+  return root;
+}
+
+/**
+ * one op is a whole pass through the chain, however many updates that takes
+ *  (each update also polls the siblings, so fewer updates per pass is less time)
+ */
+static void benchChain(Bench& bench, long length, bool optimize) {
+  FsmCollection* root = new FsmCollection();
+  root->addChild(_build(length));
+
+  for (int i=0; i<BENCH_OPTIMIZER_SIBLINGS; i++) {
+    FsmSelectStateFromCondition* select = new FsmSelectStateFromCondition(&_selector);
+    select->addChild(new FsmIdle());
+    select->addChild(new FsmIdle());
+    root->addChild(select);
+  }
+
+  if (optimize) {
+    FsmOptimizer optimizer;
+    optimizer.optimize(root);
+  }
+
+  unsigned long updates = 0;
+
+  bench.run([&] {
+    unsigned long passes = _passes;
+
+    while (_passes == passes) {
+      root->update();
+      updates++;
+    }
+  });
+
+  benchKeep(updates);
+  delete root;
+}
+
+static void benchAsBuilt(Bench& bench, long length) {
+  benchChain(bench, length, false);
+}
+FSM_BENCHMARK("optimizer/chain/as_built", benchAsBuilt, 4, 32)
+
+static void benchOptimized(Bench& bench, long length) {
+  benchChain(bench, length, true);
+}
+FSM_BENCHMARK("optimizer/chain/optimized", benchOptimized, 4, 32)
+
+/**
+ * the cost of optimizing, per State (building the tree each time, in an arena)
+ */
+static void benchOptimize(Bench& bench, long length) {
+  FsmArena arena(64 * 1024);
+
+  bench.setItemsPerOp(length + 2);
+  bench.run([&] {
+    FsmArena::Scope scope(arena);
+    FsmOptimizer optimizer;
+    FsmSequence* root = _build(length);
+    optimizer.optimize(root);
+    benchKeep(root);
+    arena.reset();
+  });
+}
+FSM_BENCHMARK("optimizer/optimize", benchOptimize, 4, 32)
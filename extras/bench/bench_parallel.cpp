@@ -0,0 +1,69 @@
+/** @file bench_parallel.cpp
+  *  Copyright (c) 2016 Ozbotics
+  *  Distributed under the MIT license (see LICENSE)
+  *
+  *  Wide Collections of busy regions, updated serially and on an FsmThreadPool
+  */
+#include "bench.h"
+
+#include <FSM.h>
+#include <FsmParallel.h>
+
+/**
+ * does a fixed amount of arithmetic on every update
+ */
+class BenchBusyState : public FsmState {
+  protected:
+    double _sum;
+    
+    virtual void _updateState() {
+      for (int i=0; i<2000; i++) {
+        _sum += i * 0.5;
+      }
+      benchKeep(_sum);
+    }
+    
+  public:
+    BenchBusyState() : _sum(0), FsmState() { }
+};
+
+static void _addRegions(FsmCollection* collection, long regions) {
+  for (long i=0; i<regions; i++) {
+    FsmSequence* region = new FsmSequence();
+    region->addChild(new BenchBusyState());
+    collection->addChild(region);
+  }
+}
+
+static void benchSerialRegions(Bench& bench, long regions) {
+  FsmCollection root;
+  _addRegions(&root, regions);
+  
+  bench.setItemsPerOp(regions);
+  bench.run([&] { root.update(); });
+}
+FSM_BENCHMARK("parallel/busy_regions/serial", benchSerialRegions, 8, 64)
+
+static void benchParallelRegions(Bench& bench, long regions) {
+  static FsmThreadPool pool;
+  FsmParallelCollection root(&pool);
+  _addRegions(&root, regions);
+  
+  bench.setItemsPerOp(regions);
+  bench.run([&] { root.update(); });
+}
+FSM_BENCHMARK("parallel/busy_regions/pool", benchParallelRegions, 8, 64)
+
+static void benchParallelDispatch(Bench& bench, long) {
+  static FsmThreadPool pool;
+  FsmParallelCollection root(&pool);
+  
+  for (int i=0; i<8; i++) {
+    FsmSequence* region = new FsmSequence();
+    region->addChild(new FsmState());
+    root.addChild(region);
+  }
+  
+  bench.run([&] { root.update(); });
+}
+FSM_BENCHMARK("parallel/dispatch_overhead", benchParallelDispatch, 0)
@@ -0,0 +1,82 @@
+/** @file bench_quiescence.cpp
+  *  Copyright (c) 2016 Ozbotics
+  *  Distributed under the MIT license (see LICENSE)
+  *
+  *  Benchmarks of updating trees where most branches are quiescent
+  */
+#include "bench.h"
+
+#include <FSM.h>
+
+/**
+ * Always has work to do
+ */
+class BenchBusy : public FsmState {
+  protected:
+    unsigned long _count;
+    
+    virtual void _updateState() {
+      _count++;
+    }
+    
+  public:
+    BenchBusy() : _count(0), FsmState() { }
+};
+
+static Value<Duration> _longDuration(3600000UL);
+
+static void benchOneBusyManyIdle(Bench& bench, long width) {
+  FsmCollection root;
+  root.addChild(new BenchBusy());
+  for (long i=1; i<width; i++) {
+    FsmSequence* seq = new FsmSequence();
+    seq->addChild(new FsmIdle());
+    root.addChild(seq);
+  }
+  
+  bench.setItemsPerOp(width);
+  bench.run([&] { root.update(); });
+}
+FSM_BENCHMARK("quiescence/collection/one_busy_rest_idle", benchOneBusyManyIdle, 1, 8, 32, 128, 255)
+
+static void benchOneBusyManyDelays(Bench& bench, long width) {
+  FsmCollection root;
+  root.addChild(new BenchBusy());
+  for (long i=1; i<width; i++) {
+    FsmSequence* seq = new FsmSequence();
+    seq->addChild(new FsmDelay(&_longDuration));
+    root.addChild(seq);
+  }
+  
+  bench.setItemsPerOp(width);
+  bench.run([&] { root.update(); });
+}
+FSM_BENCHMARK("quiescence/collection/one_busy_rest_delay", benchOneBusyManyDelays, 1, 8, 32, 128, 255)
+
+static void benchAllIdle(Bench& bench, long width) {
+  FsmCollection root;
+  for (long i=0; i<width; i++) {
+    FsmSequence* seq = new FsmSequence();
+    seq->addChild(new FsmIdle());
+    root.addChild(seq);
+  }
+  
+  bench.setItemsPerOp(width);
+  bench.run([&] { root.update(); });
+}
+FSM_BENCHMARK("quiescence/collection/all_idle", benchAllIdle, 1, 8, 32, 128, 255)
+
+static void benchWakeDeep(Bench& bench, long depth) {
+  FsmSequence root;
+  FsmSequence* seq = &root;
+  for (long d=1; d<depth; d++) {
+    FsmSequence* inner = new FsmSequence();
+    seq->addChild(inner);
+    seq = inner;
+  }
+  FsmIdle* leaf = new FsmIdle();
+  seq->addChild(leaf);
+  
+  bench.run([&] { leaf->wake(); root.update(); });
+}
+FSM_BENCHMARK("quiescence/wake_and_update", benchWakeDeep, 1, 4, 16)
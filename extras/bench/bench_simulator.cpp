@@ -0,0 +1,50 @@
+/** @file bench_simulator.cpp
+  *  Copyright (c) 2016 Ozbotics
+  *  Distributed under the MIT license (see LICENSE)
+  *
+  *  Running a day long schedule on the simulated clock
+  */
+#include "bench.h"
+
+#include <FSM.h>
+#include <FsmSimulator.h>
+
+static Value<Duration> _hour(60UL * 60 * 1000);
+static Value<Duration> _minute(60UL * 1000);
+static char _message[] = "tick";
+
+/**
+ * width Sequences: an hour's Delay, then a minute's, each offset by a minute from the last
+ */
+static FsmCollection* _buildSchedule(long width) {
+  FsmCollection* root = new FsmCollection();
+  root->reserveChildren(width);
+  
+  for (long i=0; i<width; i++) {
+    FsmSequence* seq = new FsmSequence();
+    seq->setMicrosteps(4);
+    seq->addChild(new FsmDelay(&_hour));
+    seq->addChild(new FsmDebugPrint(_message));
+    seq->addChild(new FsmDelay(&_minute));
+    seq->addChild(new FsmFinish());
+    root->addChild(seq);
+  }
+  
+  return root;
+}
+
+static void benchSimulateDay(Bench& bench, long width) {
+  FsmCollection* root = _buildSchedule(width);
+  
+  {
+    FsmSimulator simulator(root);
+    unsigned long updates = simulator.run(24UL * 60 * 60 * 1000);
+    
+    // per op: a simulated day; per item: a root update
+    bench.setItemsPerOp(updates);
+    bench.run([&] { benchKeep(simulator.run(24UL * 60 * 60 * 1000)); });
+  }
+  
+  delete root;
+}
+FSM_BENCHMARK("simulator/day", benchSimulateDay, 1, 64)
@@ -0,0 +1,57 @@
+/** @file bench_snapshot.cpp
+  *  Copyright (c) 2016 Ozbotics
+  *  Distributed under the MIT license (see LICENSE)
+  *
+  *  Saving and restoring the runtime configuration of a machine
+  */
+#include "bench.h"
+
+#include <FSM.h>
+
+static Value<Duration> _duration(1000);
+
+/**
+ * width Sequences, each part way through a Delay
+ */
+static FsmCollection* _buildDelays(long width) {
+  FsmCollection* root = new FsmCollection();
+  for (long i=0; i<width; i++) {
+    FsmSequence* seq = new FsmSequence();
+    seq->addChild(new FsmDelay(&_duration));
+    seq->addChild(new FsmDelay(&_duration));
+    root->addChild(seq);
+  }
+  
+  root->update();
+  
+  return root;
+}
+
+static void benchSave(Bench& bench, long width) {
+  FsmCollection* root = _buildDelays(width);
+  size_t capacity = FsmSnapshot::save(root, NULL, 0);
+  byte* blob = (byte*) malloc(capacity);
+  
+  bench.setItemsPerOp(width);
+  bench.setBytes(capacity);
+  bench.run([&] { benchKeep(FsmSnapshot::save(root, blob, capacity)); });
+  
+  free(blob);
+  delete root;
+}
+FSM_BENCHMARK("snapshot/save", benchSave, 16, 1024)
+
+static void benchRestore(Bench& bench, long width) {
+  FsmCollection* root = _buildDelays(width);
+  size_t capacity = FsmSnapshot::save(root, NULL, 0);
+  byte* blob = (byte*) malloc(capacity);
+  FsmSnapshot::save(root, blob, capacity);
+  
+  bench.setItemsPerOp(width);
+  bench.setBytes(capacity);
+  bench.run([&] { benchKeep(FsmSnapshot::restore(root, blob, capacity)); });
+  
+  free(blob);
+  delete root;
+}
+FSM_BENCHMARK("snapshot/restore", benchRestore, 16, 1024)
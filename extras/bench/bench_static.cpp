@@ -0,0 +1,106 @@
+/** @file bench_static.cpp
+  *  Copyright (c) 2016 Ozbotics
+  *  Distributed under the MIT license (see LICENSE)
+  *
+  *  The same machines built from the runtime (virtual) classes and from the FsmStatic templates
+  */
+#include "bench.h"
+
+#include <FSM.h>
+#include <FsmStatic.h>
+
+static unsigned long _count = 0;
+static void _countAction() { _count++; }
+
+Condition benchStaticCondition(true);
+Condition* benchStaticConditionPtr = &benchStaticCondition;
+Value<bool> benchStaticSelector(false);
+
+/**
+ * runtime equivalent of FsmStaticAction<_countAction>
+ */
+class BenchCountAction : public FsmState {
+  protected:
+    virtual void _enterState() {
+      _countAction();
+      _transitionAncestorToNext(1);
+    }
+};
+
+/**
+ * branch, two actions, finish: one leaf runs per update
+ */
+static FsmSequence* _buildRuntimeStepper() {
+  FsmSequence* seq = new FsmSequence();
+  seq->addChild(new FsmBranchOnConditionFalse(&benchStaticConditionPtr, 3));
+  seq->addChild(new BenchCountAction());
+  seq->addChild(new BenchCountAction());
+  seq->addChild(new FsmFinish());
+  
+  return seq;
+}
+
+typedef FsmStaticSequence<
+  FsmStaticBranchOnConditionFalse<&benchStaticConditionPtr, 3>,
+  FsmStaticAction<_countAction>,
+  FsmStaticAction<_countAction>,
+  FsmStaticFinish
+> StaticStepper;
+
+
+static void benchRuntimeStepper(Bench& bench, long) {
+  FsmSequence root;
+  root.addChild(_buildRuntimeStepper());
+  
+  bench.run([&] { root.update(); });
+}
+FSM_BENCHMARK("static/stepper/virtual", benchRuntimeStepper, 0)
+
+static FsmStaticMachine<FsmStaticSequence<StaticStepper> > _staticStepper;
+
+static void benchStaticStepper(Bench& bench, long) {
+  bench.run([&] { _staticStepper.update(); });
+}
+FSM_BENCHMARK("static/stepper/template", benchStaticStepper, 0)
+
+
+static void benchRuntimeCollection(Bench& bench, long) {
+  FsmCollection root;
+  for (int i=0; i<8; i++) {
+    FsmSequence* seq = new FsmSequence();
+    seq->addChild(_buildRuntimeStepper());
+    root.addChild(seq);
+  }
+  
+  bench.setItemsPerOp(8);
+  bench.run([&] { root.update(); });
+}
+FSM_BENCHMARK("static/collection_of_8_steppers/virtual", benchRuntimeCollection, 8)
+
+typedef FsmStaticSequence<StaticStepper> StaticOuter;
+static FsmStaticMachine<FsmStaticCollection<
+  StaticOuter, StaticOuter, StaticOuter, StaticOuter, StaticOuter, StaticOuter, StaticOuter, StaticOuter
+> > _staticCollection;
+
+static void benchStaticCollection(Bench& bench, long) {
+  bench.setItemsPerOp(8);
+  bench.run([&] { _staticCollection.update(); });
+}
+FSM_BENCHMARK("static/collection_of_8_steppers/template", benchStaticCollection, 8)
+
+
+static void benchRuntimeSelect(Bench& bench, long) {
+  FsmSelectStateFromCondition root(&benchStaticSelector);
+  root.addChild(_buildRuntimeStepper());
+  root.addChild(_buildRuntimeStepper());
+  
+  bench.run([&] { root.update(); });
+}
+FSM_BENCHMARK("static/select_stepper/virtual", benchRuntimeSelect, 0)
+
+static FsmStaticMachine<FsmStaticSelectStateFromCondition<&benchStaticSelector, StaticStepper, StaticStepper> > _staticSelect;
+
+static void benchStaticSelect(Bench& bench, long) {
+  bench.run([&] { _staticSelect.update(); });
+}
+FSM_BENCHMARK("static/select_stepper/template", benchStaticSelect, 0)
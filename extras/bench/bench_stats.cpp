@@ -0,0 +1,46 @@
+/** @file bench_stats.cpp
+  *  Copyright (c) 2016 Ozbotics
+  *  Distributed under the MIT license (see LICENSE)
+  *
+  *  Cost of the FsmState performance counters (configure with -DFSM_STATS=ON to collect them)
+  */
+#include "bench.h"
+
+#include <FSM.h>
+
+/**
+ * Steps to the next state on every update: one enter, one update and one exit per update
+ */
+class BenchStatsStep : public FsmState {
+  protected:
+    virtual void _updateState() {
+      _transitionAncestorToNext(1);
+    }
+};
+
+static void benchStatsStepping(Bench& bench, long) {
+  FsmSequence seq;
+  for (int i=0; i<8; i++) {
+    seq.addChild(new BenchStatsStep());
+  }
+  
+  bench.run([&] { seq.update(); });
+}
+#ifdef FSM_STATS
+FSM_BENCHMARK("stats/sequence_stepping/counted", benchStatsStepping, 0)
+#else
+FSM_BENCHMARK("stats/sequence_stepping/uncounted", benchStatsStepping, 0)
+#endif
+
+static void benchStatsSnapshot(Bench& bench, long children) {
+  static FsmStatsRecord records[1024 + 1];
+  FsmSequence seq;
+  for (long i=0; i<children; i++) {
+    seq.addChild(new BenchStatsStep());
+  }
+  seq.update();
+  
+  bench.setItemsPerOp(children + 1);
+  bench.run([&] { benchKeep(FsmStats::snapshot(&seq, records, children + 1)); });
+}
+FSM_BENCHMARK("stats/snapshot", benchStatsSnapshot, 16, 1024)
@@ -0,0 +1,159 @@
+/** @file bench_table.cpp
+  *  Copyright (c) 2016 Ozbotics
+  *  Distributed under the MIT license (see LICENSE)
+  *
+  *  The same machines run as a tree of objects and as a compiled FsmTable
+  */
+#include "bench.h"
+
+#include <FSM.h>
+#include <FsmTable.h>
+
+static Condition _condition(true);
+static Condition* _conditionPtr = &_condition;
+static Value<bool> _output(false);
+static Value<Duration> _longDuration(3600000UL);
+
+/**
+ * approximate heap footprint of a tree of built-in States (object sizes plus child arrays)
+ */
+static long _treeBytes(FsmUpdatable* fsm) {
+  FsmDescription description;
+  fsm->describe(description);
+  
+  switch (description.kind) {
+    case FSM_KIND_COLLECTION: {
+      FsmCollection* collection = fsm->asCollection();
+      long bytes = sizeof(FsmCollection) + collection->getChildCount() * sizeof(FsmUpdatable*);
+      
+      for (FsmIndex i=0; i<collection->getChildCount(); i++) {
+        bytes += _treeBytes(collection->getChild(i));
+      }
+      return bytes;
+    }
+    
+    case FSM_KIND_SEQUENCE: {
+      FsmCollection* collection = fsm->asCollection();
+      long bytes = sizeof(FsmSequence) + collection->getChildCount() * sizeof(FsmUpdatable*);
+      
+      for (FsmIndex i=0; i<collection->getChildCount(); i++) {
+        bytes += _treeBytes(collection->getChild(i));
+      }
+      return bytes;
+    }
+    
+    case FSM_KIND_DELAY:                     return sizeof(FsmDelay) + sizeof(Timer);
+    case FSM_KIND_BRANCH_ON_CONDITION_FALSE: return sizeof(FsmBranchOnConditionFalse);
+    case FSM_KIND_ASSIGN_CONDITION:          return sizeof(FsmAssignConditionToValue);
+    case FSM_KIND_FINISH:                    return sizeof(FsmFinish);
+    case FSM_KIND_IDLE:                      return sizeof(FsmIdle);
+  }
+  
+  return sizeof(FsmState);
+}
+
+/**
+ * branch, two assignments, finish: one leaf runs per update
+ */
+static FsmSequence* _buildStepper() {
+  FsmSequence* outer = new FsmSequence();
+  FsmSequence* seq = new FsmSequence();
+  seq->addChild(new FsmBranchOnConditionFalse(&_conditionPtr, 3));
+  seq->addChild(new FsmAssignConditionToValue(&_condition, &_output));
+  seq->addChild(new FsmAssignConditionToValue(&_condition, &_output));
+  seq->addChild(new FsmFinish());
+  outer->addChild(seq);
+  
+  return outer;
+}
+
+static FsmCollection* _buildSteppers(long width) {
+  FsmCollection* root = new FsmCollection();
+  for (long i=0; i<width; i++) {
+    root->addChild(_buildStepper());
+  }
+  
+  return root;
+}
+
+/**
+ * one stepper per 8 children, the rest are Sequences waiting on a long delay
+ */
+static FsmCollection* _buildMixed(long width) {
+  FsmCollection* root = new FsmCollection();
+  for (long i=0; i<width; i++) {
+    if (i % 8 == 0) {
+      root->addChild(_buildStepper());
+    }
+    else {
+      FsmSequence* seq = new FsmSequence();
+      seq->addChild(new FsmDelay(&_longDuration));
+      seq->addChild(new FsmFinish());
+      root->addChild(seq);
+    }
+  }
+  
+  return root;
+}
+
+
+static void benchTreeSteppers(Bench& bench, long width) {
+  FsmCollection* root = _buildSteppers(width);
+  
+  bench.setItemsPerOp(width);
+  bench.setBytes(_treeBytes(root));
+  bench.run([&] { root->update(); });
+  
+  delete root;
+}
+FSM_BENCHMARK("table/steppers/tree", benchTreeSteppers, 1, 16, 128)
+
+static void benchTableSteppers(Bench& bench, long width) {
+  FsmCollection* root = _buildSteppers(width);
+  FsmTable table;
+  table.compile(root);
+  
+  // the table holds nothing of a tree of built-in States, so it runs alone
+  delete root;
+  
+  bench.setItemsPerOp(width);
+  bench.setBytes(table.getMemoryUsage());
+  bench.run([&] { table.update(); });
+}
+FSM_BENCHMARK("table/steppers/table", benchTableSteppers, 1, 16, 128)
+
+static void benchTreeMixed(Bench& bench, long width) {
+  FsmCollection* root = _buildMixed(width);
+  
+  bench.setItemsPerOp(width);
+  bench.setBytes(_treeBytes(root));
+  bench.run([&] { root->update(); });
+  
+  delete root;
+}
+FSM_BENCHMARK("table/mixed/tree", benchTreeMixed, 16, 128, 255)
+
+static void benchTableMixed(Bench& bench, long width) {
+  FsmCollection* root = _buildMixed(width);
+  FsmTable table;
+  table.compile(root);
+  
+  // the table holds nothing of a tree of built-in States, so it runs alone
+  delete root;
+  
+  bench.setItemsPerOp(width);
+  bench.setBytes(table.getMemoryUsage());
+  bench.run([&] { table.update(); });
+}
+FSM_BENCHMARK("table/mixed/table", benchTableMixed, 16, 128, 255)
+
+static void benchTableCompile(Bench& bench, long width) {
+  FsmCollection* root = _buildMixed(width);
+  FsmTable table;
+  
+  bench.setItemsPerOp(table.compile(root) ? table.getNodeCount() : 0);
+  bench.run([&] { table.compile(root); });
+  
+  delete root;
+}
+FSM_BENCHMARK("table/compile", benchTableCompile, 16, 255)
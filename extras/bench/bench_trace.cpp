@@ -0,0 +1,66 @@
+/** @file bench_trace.cpp
+  *  Copyright (c) 2016 Ozbotics
+  *  Distributed under the MIT license (see LICENSE)
+  *
+  *  Cost of recording FsmTrace events (configure with -DFSM_TRACE=ON to trace the FSM core too)
+  */
+#include "bench.h"
+
+#include <FSM.h>
+
+static FsmTraceEvent _events[4096];
+static FsmTraceEvent _drained[4096];
+
+static void benchTraceRecord(Bench& bench, long) {
+  FsmTrace::begin(_events, 4096);
+  
+  bench.run([&] { FsmTrace::record(1, FSM_TRACE_REQUEST_NEXT, 1); });
+  
+  FsmTrace::end();
+}
+FSM_BENCHMARK("trace/record", benchTraceRecord, 0)
+
+static void benchTraceDrain(Bench& bench, long) {
+  FsmTrace::begin(_events, 4096);
+  
+  bench.setItemsPerOp(4096);
+  bench.run([&] { 
+    for (int i=0; i<4096; i++) {
+      FsmTrace::record(1, FSM_TRACE_ENTER);
+    }
+    benchKeep(FsmTrace::drain(_drained, 4096));
+  });
+  
+  FsmTrace::end();
+}
+FSM_BENCHMARK("trace/record_and_drain", benchTraceDrain, 0)
+
+/**
+ * Steps to the next state on every update: one enter, one request and one exit per update
+ */
+class BenchTraceStep : public FsmState {
+  protected:
+    virtual void _updateState() {
+      _transitionAncestorToNext(1);
+    }
+};
+
+static void benchTraceStepping(Bench& bench, long recording) {
+  FsmSequence seq;
+  for (int i=0; i<8; i++) {
+    seq.addChild(new BenchTraceStep());
+  }
+  
+  if (recording) {
+    FsmTrace::begin(_events, 4096);
+  }
+  
+  bench.run([&] { seq.update(); });
+  
+  FsmTrace::end();
+}
+#ifdef FSM_TRACE
+FSM_BENCHMARK("trace/sequence_stepping/traced", benchTraceStepping, 0, 1)
+#else
+FSM_BENCHMARK("trace/sequence_stepping/untraced", benchTraceStepping, 0)
+#endif
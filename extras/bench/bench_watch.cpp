@@ -0,0 +1,137 @@
+/** @file bench_watch.cpp
+  *  Copyright (c) 2016 Ozbotics
+  *  Distributed under the MIT license (see LICENSE)
+  *
+  *  Condition-driven States reading their inputs on every update, and only when they change
+  */
+#include "bench.h"
+
+#include <FSM.h>
+
+static Value<bool> _polled(false);
+static FsmWatchedValue<bool> _watched(false);
+
+/**
+ * width Selects over one input, either polled or watched
+ */
+template <class V>
+static void benchSelects(Bench& bench, long width, V* input) {
+  FsmCollection root;
+  for (long i=0; i<width; i++) {
+    FsmSelectStateFromCondition* select = new FsmSelectStateFromCondition(input);
+    select->addChild(new FsmIdle());
+    select->addChild(new FsmIdle());
+    root.addChild(select);
+  }
+  
+  root.update();
+  
+  bench.setItemsPerOp(width);
+  bench.run([&] { root.update(); });
+}
+
+static void benchPolledSelects(Bench& bench, long width) {
+  benchSelects(bench, width, &_polled);
+}
+FSM_BENCHMARK("watch/idle_update/polled", benchPolledSelects, 16, 1024)
+
+static void benchWatchedSelects(Bench& bench, long width) {
+  benchSelects(bench, width, &_watched);
+}
+FSM_BENCHMARK("watch/idle_update/watched", benchWatchedSelects, 16, 1024)
+
+/**
+ * toggle the input then update, so every Select switches
+ */
+static void benchWatchedToggle(Bench& bench, long width) {
+  FsmCollection root;
+  FsmWatchedValue<bool> input(false);
+  
+  for (long i=0; i<width; i++) {
+    FsmSelectStateFromCondition* select = new FsmSelectStateFromCondition(&input);
+    select->addChild(new FsmIdle());
+    select->addChild(new FsmIdle());
+    root.addChild(select);
+  }
+  
+  root.update();
+  
+  bool value = false;
+  bench.setItemsPerOp(width);
+  bench.run([&] {
+    value = !value;
+    input.setValue(value);
+    root.update();
+  });
+}
+FSM_BENCHMARK("watch/toggle_update/watched", benchWatchedToggle, 16, 1024)
+
+/**
+ * a Condition over depth inputs, all of which must be true
+ */
+class BenchAllOf : public Condition {
+  protected:
+    Value<bool>** _inputs;
+    long _count;
+  
+  public:
+    BenchAllOf(Value<bool>** inputs, long count) : _inputs(inputs), _count(count), Condition() { }
+    
+    virtual bool getValue() {
+      bool value = true;
+      
+      for (long i=0; i<_count; i++) {
+        value = _inputs[i]->getValue() && value;
+      }
+      
+      return value;
+    }
+};
+
+/**
+ * a Sequence that branches on a Condition over depth inputs, then steps through to the start again
+ */
+static void benchBranch(Bench& bench, long depth, bool cached) {
+  FsmWatchedValue<bool>* inputs = new FsmWatchedValue<bool>[depth];
+  Value<bool>** pointers = new Value<bool>*[depth];
+  
+  for (long i=0; i<depth; i++) {
+    inputs[i].setValue(true);
+    pointers[i] = &inputs[i];
+  }
+  
+  BenchAllOf allOf(pointers, depth);
+  FsmCachedCondition cachedAllOf(&allOf);
+  
+  for (long i=0; i<depth; i++) {
+    cachedAllOf.watch(&inputs[i]);
+  }
+  
+  Condition* condition = cached ? (Condition*) &cachedAllOf : (Condition*) &allOf;
+  
+  FsmSequence root;
+  FsmSequence* seq = new FsmSequence();
+  seq->addChild(new FsmBranchOnConditionFalse(&condition, 2));
+  seq->addChild(new FsmFinish());
+  seq->addChild(new FsmFinish());
+  root.addChild(seq);
+  
+  bench.run([&] { root.update(); });
+  
+  for (long i=0; i<depth; i++) {
+    cachedAllOf.unwatch(&inputs[i]);
+  }
+  
+  delete[] pointers;
+  delete[] inputs;
+}
+
+static void benchEvaluatedBranch(Bench& bench, long depth) {
+  benchBranch(bench, depth, false);
+}
+FSM_BENCHMARK("watch/branch/evaluated", benchEvaluatedBranch, 4, 64)
+
+static void benchCachedBranch(Bench& bench, long depth) {
+  benchBranch(bench, depth, true);
+}
+FSM_BENCHMARK("watch/branch/cached", benchCachedBranch, 4, 64)
@@ -0,0 +1,45 @@
+/** @file bench_xfsm.cpp
+  *  Copyright (c) 2016 Ozbotics
+  *  Distributed under the MIT license (see LICENSE)
+  *
+  *  Benchmark of the examples/xFSM workload
+  */
+#include "bench.h"
+#include "xfsm_workload.h"
+
+static void benchXFsmTick(Bench& bench, long itemCount) {
+  XFsmWorkload workload((int) itemCount);
+  
+  bench.run([&] { workload.root.update(); });
+}
+FSM_BENCHMARK("xfsm/tick", benchXFsmTick, 4, 64, 1024)
+
+/**
+ * one op is a whole pass over the lists, however many updates that takes
+ */
+static void benchXFsmPass(Bench& bench, long itemCount, bool forEach) {
+  XFsmWorkload workload((int) itemCount, forEach);
+  unsigned long updates = 0;
+  
+  bench.setItemsPerOp(itemCount);
+  bench.run([&] {
+    unsigned long passes = workload.useFe->passes;
+    
+    while (workload.useFe->passes == passes) {
+      workload.root.update();
+      updates++;
+    }
+  });
+  
+  benchKeep(updates);
+}
+
+static void benchXFsmPassLoop(Bench& bench, long itemCount) {
+  benchXFsmPass(bench, itemCount, false);
+}
+FSM_BENCHMARK("xfsm/pass/branch_loop", benchXFsmPassLoop, 4, 64, 1024)
+
+static void benchXFsmPassForEach(Bench& bench, long itemCount) {
+  benchXFsmPass(bench, itemCount, true);
+}
+FSM_BENCHMARK("xfsm/pass/for_each", benchXFsmPassForEach, 4, 64, 1024)
@@ -0,0 +1,190 @@
+/** @file xfsm_workload.h
+  *  Copyright (c) 2016 Ozbotics
+  *  Distributed under the MIT license (see LICENSE)
+  *
+  *  The examples/xFSM machine, ported to the host so that it can be benchmarked
+  */
+#ifndef _XFSM_WORKLOAD_H
+ #define _XFSM_WORKLOAD_H
+
+#include <LinkedList.h>
+#include <TaggedItem.h>
+#include <Enumerator.h>
+#include <FilteredEnumerator.h>
+#include <TagFilteredEnumerator.h>
+
+#include <FSM.h>
+
+namespace Factor
+{
+   enum Type { NONE, T, EC, PH };
+};
+
+namespace Effect
+{
+   enum Type { NONE, UP, DOWN };
+};
+
+struct FactorEffect
+{
+  Factor::Type factor;
+  Effect::Type effect;
+  
+  inline bool operator==(const FactorEffect& candidate)
+  {
+    return ( (factor == candidate.factor) && (effect == candidate.effect) );
+  }
+
+  inline bool operator!=(const FactorEffect& candidate)
+  {
+    return ( !operator==(candidate) );
+  }
+};
+
+typedef TaggedItem<int, FactorEffect> IntFactorEffect;
+typedef LinkedList<IntFactorEffect> IntFactorEffectLinkedList;
+typedef TagFilteredEnumerator<IntFactorEffect, FactorEffect> IntFactorEffectFilteredEnumerator;
+
+typedef LinkedList<FactorEffect> FactorEffectLinkedList;
+typedef Enumerator<FactorEffect> FactorEffectEnumerator;
+
+
+class FsmDebugPrintIntFactorEffect : public FsmState {
+  protected:
+    IntFactorEffectFilteredEnumerator* _ifeEnumerator;
+    
+    virtual void _enterState() {
+      Serial.println(_ifeEnumerator->getCurrent().item);
+      _transitionAncestorToNext(1);
+    }
+    
+  public:
+    FsmDebugPrintIntFactorEffect(IntFactorEffectFilteredEnumerator* ifeEnumerator) : _ifeEnumerator(ifeEnumerator), FsmState() { }
+};
+
+class FsmUseIntFactorEffects : public FsmSequence {
+  protected:
+    IntFactorEffectFilteredEnumerator* _ifeEnumerator;
+    FactorEffectEnumerator* _feEnumerator;
+    
+    virtual void _enterState() {
+      _ifeEnumerator->reset();
+      _ifeEnumerator->setFilterTag(_feEnumerator->getCurrent());
+    }
+    
+  public:
+    FsmUseIntFactorEffects(IntFactorEffectLinkedList* ifeList, FactorEffectEnumerator* feEnumerator) : _feEnumerator(feEnumerator), FsmSequence(1) { 
+      _ifeEnumerator = new IntFactorEffectFilteredEnumerator(ifeList, (FactorEffect) { Factor::NONE, Effect::NONE });
+      
+      addChild(new FsmFinish());
+      addChild(new FsmBranchOnEndOfList(_ifeEnumerator, 0));
+      addChild(new FsmDebugPrintIntFactorEffect(_ifeEnumerator));
+    }
+
+    ~FsmUseIntFactorEffects() {
+      delete _ifeEnumerator;
+    }
+    
+   /**
+    * the enter action is this class's own, so tools (eg; FsmTable) must run it as it is
+    */
+    virtual void describe(FsmDescription& description) {
+      FsmUpdatable::describe(description);
+    }
+};
+
+/**
+ * FsmUseIntFactorEffects as one FsmForEach: the loop's FsmBranchOnEndOfList, body State and FsmFinish in one State
+ */
+class FsmForEachIntFactorEffect : public FsmForEach {
+  protected:
+    IntFactorEffectFilteredEnumerator* _ifeEnumerator;
+    FactorEffectEnumerator* _feEnumerator;
+    
+    virtual void _enterState() {
+      _ifeEnumerator->setFilterTag(_feEnumerator->getCurrent());
+      FsmForEach::_enterState();
+    }
+    
+    virtual void _forEachItem() {
+      Serial.println(_ifeEnumerator->getCurrent().item);
+    }
+    
+  public:
+    FsmForEachIntFactorEffect(IntFactorEffectLinkedList* ifeList, FactorEffectEnumerator* feEnumerator) : 
+      _feEnumerator(feEnumerator), FsmForEach(new IntFactorEffectFilteredEnumerator(ifeList, (FactorEffect) { Factor::NONE, Effect::NONE })) { 
+      _ifeEnumerator = (IntFactorEffectFilteredEnumerator*) _enumerator;
+    }
+
+    ~FsmForEachIntFactorEffect() {
+      delete _ifeEnumerator;
+    }
+};
+
+class FsmUseFactorEffects : public FsmSequence {
+  protected:
+    FactorEffectEnumerator* _feEnumerator;
+    
+    virtual void _enterState() {
+      _feEnumerator->reset();
+      passes++;
+    }
+    
+  public:
+    unsigned long passes;  /**< public variable passes Times the lists have been started */
+    
+    FsmUseFactorEffects(FactorEffectLinkedList* feList, IntFactorEffectLinkedList* ifeList, bool forEach=false) : passes(0), FsmSequence(1) { 
+      _feEnumerator = new FactorEffectEnumerator(feList);
+      
+      addChild(new FsmFinish());
+      addChild(new FsmBranchOnEndOfList(_feEnumerator, 0));
+      
+      if (forEach) {
+        addChild(new FsmForEachIntFactorEffect(ifeList, _feEnumerator));
+      }
+      else {
+        addChild(new FsmUseIntFactorEffects(ifeList, _feEnumerator));
+      }
+    }
+
+    ~FsmUseFactorEffects() {
+      delete _feEnumerator;
+    }
+    
+   /**
+    * the enter action is this class's own, so tools (eg; FsmTable) must run it as it is
+    */
+    virtual void describe(FsmDescription& description) {
+      FsmUpdatable::describe(description);
+    }
+};
+
+/**
+ * The lists and root FSM of the xFSM example
+ *
+ * The example uses two FactorEffects and four IntFactorEffects, 
+ *  itemCount scales the IntFactorEffect list (alternating EC UP / EC DOWN as in the example)
+ *  forEach replaces the inner loop with an FsmForEach
+ */
+struct XFsmWorkload {
+  FactorEffectLinkedList feList;
+  IntFactorEffectLinkedList ifeList;
+  FsmCollection root;
+  FsmUseFactorEffects* useFe;
+
+  XFsmWorkload(int itemCount, bool forEach=false) {
+    feList.add({ Factor::EC, Effect::UP });
+    feList.add({ Factor::EC, Effect::DOWN });
+
+    for (int i=0; i<itemCount; i++) {
+      ifeList.add({ i + 1, { Factor::EC, (i % 2) ? Effect::DOWN : Effect::UP } });
+    }
+
+    FsmSequence* seq0 = new FsmSequence();
+    root.addChild(seq0);
+    useFe = new FsmUseFactorEffects(&feList, &ifeList, forEach);
+    seq0->addChild(useFe);
+  }
+};
+
+#endif  // _XFSM_WORKLOAD_H
@@ -0,0 +1,40 @@
+/** @file Arduino.cpp
+  *  Copyright (c) 2016 Ozbotics
+  *  Distributed under the MIT license (see LICENSE)
+  */
+#include <Arduino.h>
+
+#include <chrono>
+#include <thread>
+
+HardwareSerial Serial;
+
+static const std::chrono::steady_clock::time_point _startTime = std::chrono::steady_clock::now();
+static HostClock _clock = NULL;
+
+static uint64_t _now() {
+  if (_clock) {
+    return _clock();
+  }
+
+  return (uint64_t) std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - _startTime).count();
+}
+
+HostClock setHostClock(HostClock clock) {
+  HostClock previous = _clock;
+  _clock = clock;
+
+  return previous;
+}
+
+unsigned long millis() {
+  return (unsigned long)(_now() / 1000);
+}
+
+unsigned long micros() {
+  return (unsigned long) _now();
+}
+
+void delay(unsigned long ms) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
@@ -0,0 +1,120 @@
+/** @file Arduino.h
+  *  Copyright (c) 2016 Ozbotics
+  *  Distributed under the MIT license (see LICENSE)
+  *
+  *  Minimal host (Linux) stand-in for the parts of the Arduino core used by FSM.
+  *  Only used by the host build (see CMakeLists.txt), never by the Arduino IDE.
+  */
+#ifndef _ARDUINO_HOST_H
+ #define _ARDUINO_HOST_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+class __FlashStringHelper;
+#define F(string_literal) (reinterpret_cast<const __FlashStringHelper *>(string_literal))
+
+/**
+ * Arduino String, backed by std::string
+ */
+class String {
+  protected:
+    std::string _str;  /**< protected variable _str The characters */
+
+  public:
+    String() { }
+    String(const char* str) : _str(str ? str : "") { }
+    String(const String& other) : _str(other._str) { }
+    String(long value) : _str(std::to_string(value)) { }
+
+    const char* c_str() const { return _str.c_str(); }
+    unsigned int length() const { return (unsigned int) _str.length(); }
+
+    String& operator=(const String& other) { _str = other._str; return *this; }
+    bool operator==(const String& other) const { return _str == other._str; }
+};
+
+/**
+ * Arduino Print, writes to a stdio stream
+ *
+ * Host only: the stream may be set to NULL to discard output (eg; while benchmarking)
+ */
+class Print {
+  protected:
+    FILE* _stream;  /**< protected variable _stream Output stream, NULL discards */
+
+    void _write(const char* str) {
+      if (_stream) {
+        fputs(str, _stream);
+      }
+    }
+
+  public:
+    Print() : _stream(stdout) { }
+
+    void setStream(FILE* stream) { _stream = stream; }
+    FILE* getStream() { return _stream; }
+
+    void print(const char* str) { _write(str); }
+    void print(const __FlashStringHelper* str) { _write(reinterpret_cast<const char*>(str)); }
+    void print(const String& str) { _write(str.c_str()); }
+    void print(char c) { char buf[2] = { c, 0 }; _write(buf); }
+    void print(int value) { print((long) value); }
+    void print(unsigned int value) { print((unsigned long) value); }
+    void print(long value) { char buf[24]; snprintf(buf, sizeof(buf), "%ld", value); _write(buf); }
+    void print(unsigned long value) { char buf[24]; snprintf(buf, sizeof(buf), "%lu", value); _write(buf); }
+    void print(double value) { char buf[32]; snprintf(buf, sizeof(buf), "%.2f", value); _write(buf); }
+
+    void println() { _write("\n"); }
+
+    template <typename T>
+    void println(T value) {
+      print(value);
+      println();
+    }
+};
+
+/**
+ * Arduino HardwareSerial
+ */
+class HardwareSerial : public Print {
+  public:
+    void begin(unsigned long baud) { (void) baud; }
+};
+
+extern HardwareSerial Serial;
+
+/**
+ * Host only: the clock behind millis() and micros(), in microseconds since start-up
+ */
+typedef uint64_t (*HostClock)();
+
+/**
+ * Host only: replace the clock behind millis() and micros() (and so every Timer), eg; with a simulated one (see FsmSimulator)
+ *
+ * @param clock The clock, NULL for the real (steady) clock
+ * @return the previous clock
+ */
+HostClock setHostClock(HostClock clock);
+
+/**
+ * milliseconds since start-up
+ */
+unsigned long millis();
+
+/**
+ * microseconds since start-up
+ */
+unsigned long micros();
+
+/**
+ * block for the specified number of milliseconds
+ */
+void delay(unsigned long ms);
+
+#endif  // _ARDUINO_HOST_H
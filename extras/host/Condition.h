@@ -0,0 +1,21 @@
+/** @file Condition.h
+  *  Copyright (c) 2016 Ozbotics
+  *  Distributed under the MIT license (see LICENSE)
+  *
+  *  Host stand-in for the Ozbotics Condition library.
+  */
+#ifndef _CONDITION_HOST_H
+ #define _CONDITION_HOST_H
+
+#include <ValueExpr.h>
+
+/**
+ * A boolean expression
+ */
+class Condition : public ValueExpr<bool> {
+  public:
+    Condition() : ValueExpr<bool>(false) { }
+    Condition(bool value) : ValueExpr<bool>(value) { }
+};
+
+#endif  // _CONDITION_HOST_H
@@ -0,0 +1,61 @@
+/** @file Enumerator.h
+  *  Copyright (c) 2016 Ozbotics
+  *  Distributed under the MIT license (see LICENSE)
+  *
+  *  Host stand-in for the Ozbotics Enumerator library.
+  */
+#ifndef _ENUMERATOR_HOST_H
+ #define _ENUMERATOR_HOST_H
+
+#include <LinkedList.h>
+
+/**
+ * The untyped interface of all Enumerators
+ */
+class EnumeratorBase {
+  public:
+    virtual ~EnumeratorBase() { }
+
+   /**
+    * advance to the next item
+    *
+    * @return false when there are no more items
+    */
+    virtual bool moveNext()=0;
+
+   /**
+    * move back to before the first item
+    */
+    virtual void reset()=0;
+};
+
+/**
+ * Enumerate the items of a LinkedList
+ */
+template <class T>
+class Enumerator : public EnumeratorBase {
+  protected:
+    LinkedList<T>* _list;  /**< protected variable _list The List being enumerated */
+    int _index;            /**< protected variable _index Index of the current item, -1 before the first */
+
+  public:
+    Enumerator(LinkedList<T>* list) : _list(list), _index(-1) { }
+
+    virtual bool moveNext() {
+      if (_index < _list->size()) {
+        _index++;
+      }
+
+      return _index < _list->size();
+    }
+
+    virtual void reset() {
+      _index = -1;
+    }
+
+    virtual T getCurrent() {
+      return _list->get(_index);
+    }
+};
+
+#endif  // _ENUMERATOR_HOST_H
@@ -0,0 +1,35 @@
+/** @file FilteredEnumerator.h
+  *  Copyright (c) 2016 Ozbotics
+  *  Distributed under the MIT license (see LICENSE)
+  *
+  *  Host stand-in for the Ozbotics FilteredEnumerator library.
+  */
+#ifndef _FILTEREDENUMERATOR_HOST_H
+ #define _FILTEREDENUMERATOR_HOST_H
+
+#include <Enumerator.h>
+
+/**
+ * Enumerate only the items of a LinkedList that pass a filter
+ *  derived classes implement _filter()
+ */
+template <class T>
+class FilteredEnumerator : public Enumerator<T> {
+  protected:
+    virtual bool _filter(T item)=0;
+
+  public:
+    FilteredEnumerator(LinkedList<T>* list) : Enumerator<T>(list) { }
+
+    virtual bool moveNext() {
+      while (Enumerator<T>::moveNext()) {
+        if (_filter(this->getCurrent())) {
+          return true;
+        }
+      }
+
+      return false;
+    }
+};
+
+#endif  // _FILTEREDENUMERATOR_HOST_H
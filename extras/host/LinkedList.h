@@ -0,0 +1,147 @@
+/** @file LinkedList.h
+  *  Copyright (c) 2016 Ozbotics
+  *  Distributed under the MIT license (see LICENSE)
+  *
+  *  Host stand-in for the Arduino LinkedList library.
+  *  Mirrors its singly linked storage and its 'last node got' cache,
+  *   so that host measurements reflect the cost of the real thing.
+  */
+#ifndef _LINKEDLIST_HOST_H
+ #define _LINKEDLIST_HOST_H
+
+#include <Arduino.h>
+
+template<class T>
+struct ListNode {
+  T data;
+  ListNode<T>* next;
+};
+
+/**
+ * Singly linked list with a cache of the most recently accessed node
+ */
+template <typename T>
+class LinkedList {
+  protected:
+    int _size;                   /**< protected variable _size Number of items */
+    ListNode<T>* _root;          /**< protected variable _root First node */
+    ListNode<T>* _last;          /**< protected variable _last Last node */
+    
+    bool _isCached;              /**< protected variable _isCached Is _lastNodeGot valid */
+    int _lastIndexGot;           /**< protected variable _lastIndexGot Index of _lastNodeGot */
+    ListNode<T>* _lastNodeGot;   /**< protected variable _lastNodeGot Most recently accessed node */
+
+    ListNode<T>* _getNode(int index) {
+      int pos = 0;
+      ListNode<T>* current = _root;
+
+      if (_isCached && (_lastIndexGot <= index)) {
+        pos = _lastIndexGot;
+        current = _lastNodeGot;
+      }
+
+      while ((pos < index) && current) {
+        current = current->next;
+        pos++;
+      }
+
+      if (pos == index) {
+        _isCached = true;
+        _lastIndexGot = index;
+        _lastNodeGot = current;
+        
+        return current;
+      }
+      
+      return NULL;
+    }
+
+  public:
+    LinkedList() : _size(0), _root(NULL), _last(NULL), _isCached(false), _lastIndexGot(0), _lastNodeGot(NULL) { }
+    
+    ~LinkedList() {
+      clear();
+    }
+
+    int size() {
+      return _size;
+    }
+
+    bool add(T item) {
+      ListNode<T>* node = new ListNode<T>();
+      node->data = item;
+      node->next = NULL;
+
+      if (_root) {
+        _last->next = node;
+        _last = node;
+      }
+      else {
+        _root = node;
+        _last = node;
+      }
+
+      _size++;
+      _isCached = false;
+      
+      return true;
+    }
+
+    bool set(int index, T item) {
+      ListNode<T>* node = _getNode(index);
+      
+      if (!node) {
+        return false;
+      }
+      
+      node->data = item;
+      return true;
+    }
+
+    T get(int index) {
+      ListNode<T>* node = _getNode(index);
+      
+      return (node ? node->data : T());
+    }
+
+    T remove(int index) {
+      if ((index < 0) || (index >= _size)) {
+        return T();
+      }
+
+      ListNode<T>* prev = (index > 0) ? _getNode(index - 1) : NULL;
+      ListNode<T>* node = prev ? prev->next : _root;
+      T data = node->data;
+
+      if (prev) {
+        prev->next = node->next;
+      }
+      else {
+        _root = node->next;
+      }
+
+      if (node == _last) {
+        _last = prev;
+      }
+
+      delete node;
+      _size--;
+      _isCached = false;
+      
+      return data;
+    }
+
+    void clear() {
+      while (_root) {
+        ListNode<T>* next = _root->next;
+        delete _root;
+        _root = next;
+      }
+      
+      _last = NULL;
+      _size = 0;
+      _isCached = false;
+    }
+};
+
+#endif  // _LINKEDLIST_HOST_H
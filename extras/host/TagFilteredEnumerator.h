@@ -0,0 +1,32 @@
+/** @file TagFilteredEnumerator.h
+  *  Copyright (c) 2016 Ozbotics
+  *  Distributed under the MIT license (see LICENSE)
+  *
+  *  Host stand-in for the Ozbotics TagFilteredEnumerator library.
+  */
+#ifndef _TAGFILTEREDENUMERATOR_HOST_H
+ #define _TAGFILTEREDENUMERATOR_HOST_H
+
+#include <FilteredEnumerator.h>
+
+/**
+ * Enumerate only the TaggedItems whose tag matches the filter tag
+ */
+template <class T, class Tag>
+class TagFilteredEnumerator : public FilteredEnumerator<T> {
+  protected:
+    Tag _filterTag;  /**< protected variable _filterTag Items with this tag are enumerated */
+
+    virtual bool _filter(T item) {
+      return item.tag == _filterTag;
+    }
+
+  public:
+    TagFilteredEnumerator(LinkedList<T>* list, Tag filterTag) : FilteredEnumerator<T>(list), _filterTag(filterTag) { }
+
+    void setFilterTag(Tag filterTag) {
+      _filterTag = filterTag;
+    }
+};
+
+#endif  // _TAGFILTEREDENUMERATOR_HOST_H
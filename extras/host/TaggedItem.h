@@ -0,0 +1,19 @@
+/** @file TaggedItem.h
+  *  Copyright (c) 2016 Ozbotics
+  *  Distributed under the MIT license (see LICENSE)
+  *
+  *  Host stand-in for the Ozbotics TaggedItem library.
+  */
+#ifndef _TAGGEDITEM_HOST_H
+ #define _TAGGEDITEM_HOST_H
+
+/**
+ * An item with an associated tag
+ */
+template <class I, class T>
+struct TaggedItem {
+  I item;
+  T tag;
+};
+
+#endif  // _TAGGEDITEM_HOST_H
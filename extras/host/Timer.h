@@ -0,0 +1,43 @@
+/** @file Timer.h
+  *  Copyright (c) 2016 Ozbotics
+  *  Distributed under the MIT license (see LICENSE)
+  *
+  *  Host stand-in for the Ozbotics Timer library.
+  */
+#ifndef _TIMER_HOST_H
+ #define _TIMER_HOST_H
+
+#include <Arduino.h>
+
+typedef unsigned long Duration;
+
+/**
+ * Count down a Duration (in milliseconds)
+ */
+class Timer {
+  protected:
+    unsigned long _startTime;  /**< protected variable _startTime millis() when started */
+    Duration _duration;        /**< protected variable _duration Duration of the countdown */
+
+  public:
+    Timer() : _startTime(0), _duration(0) { }
+
+   /**
+    * start counting down
+    *
+    * @param duration The Duration to count down
+    */
+    void start(Duration duration) {
+      _startTime = millis();
+      _duration = duration;
+    }
+
+   /**
+    * has the Duration passed since start() was called
+    */
+    bool isComplete() {
+      return (millis() - _startTime) >= _duration;
+    }
+};
+
+#endif  // _TIMER_HOST_H
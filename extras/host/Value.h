@@ -0,0 +1,34 @@
+/** @file Value.h
+  *  Copyright (c) 2016 Ozbotics
+  *  Distributed under the MIT license (see LICENSE)
+  *
+  *  Host stand-in for the Ozbotics Value library.
+  */
+#ifndef _VALUE_HOST_H
+ #define _VALUE_HOST_H
+
+#include <Arduino.h>
+
+/**
+ * A value of type T that can be shared between producers and consumers
+ */
+template <class T>
+class Value {
+  protected:
+    T _value;  /**< protected variable _value The current value */
+
+  public:
+    Value() : _value() { }
+    Value(T value) : _value(value) { }
+    virtual ~Value() { }
+
+    virtual T getValue() {
+      return _value;
+    }
+
+    virtual void setValue(T value) {
+      _value = value;
+    }
+};
+
+#endif  // _VALUE_HOST_H
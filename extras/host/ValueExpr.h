@@ -0,0 +1,23 @@
+/** @file ValueExpr.h
+  *  Copyright (c) 2016 Ozbotics
+  *  Distributed under the MIT license (see LICENSE)
+  *
+  *  Host stand-in for the Ozbotics ValueExpr library.
+  */
+#ifndef _VALUEEXPR_HOST_H
+ #define _VALUEEXPR_HOST_H
+
+#include <Value.h>
+
+/**
+ * A Value computed from other Values
+ *  derived classes over-ride getValue()
+ */
+template <class T>
+class ValueExpr : public Value<T> {
+  public:
+    ValueExpr() : Value<T>() { }
+    ValueExpr(T value) : Value<T>(value) { }
+};
+
+#endif  // _VALUEEXPR_HOST_H
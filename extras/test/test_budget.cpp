@@ -0,0 +1,113 @@
+/** @file test_budget.cpp
+  *  Copyright (c) 2016 Ozbotics
+  *  Distributed under the MIT license (see LICENSE)
+  *
+  *  Budget test: update(budget) of a machine whose budget is spent inside the regions of an FsmParallelCollection,
+  *   on a simulated clock. Every busy State must be updated once per pass, however many updates a pass takes.
+  */
+#include <FSM.h>
+#include <FsmParallel.h>
+
+#include <atomic>
+#include <stdio.h>
+
+#define TEST_BUDGET_WORK 10     /**< simulated microseconds each busy State spends per update */
+#define TEST_BUDGET_REGIONS 4   /**< regions of the parallel Collection */
+#define TEST_BUDGET_STATES 4    /**< busy States per region (and in the serial Collection beside it) */
+#define TEST_BUDGET 50          /**< microseconds per update, less than one region's pass */
+#define TEST_BUDGET_UPDATES 201 /**< budgeted updates made */
+
+static int _failures = 0;
+
+static void _check(const char* what, bool ok) {
+  if (!ok) {
+    printf("FAIL: %s\n", what);
+    _failures++;
+  }
+}
+
+static std::atomic<uint64_t> _clock(0);
+
+static uint64_t _simulatedClock() {
+  return _clock.load();
+}
+
+/**
+ * counts its updates, each spending TEST_BUDGET_WORK of the simulated clock
+ */
+class TestBusyState : public FsmState {
+  protected:
+    virtual void _updateState() {
+      updates++;
+      _clock += TEST_BUDGET_WORK;
+    }
+
+  public:
+    unsigned long updates;  /**< public variable updates Number of updates */
+
+    TestBusyState() : updates(0), FsmState() { }
+};
+
+int main() {
+  setHostClock(_simulatedClock);
+
+  FsmThreadPool pool(3);
+  FsmCollection root;
+  FsmParallelCollection* regions = new FsmParallelCollection(&pool);
+  FsmCollection* serial = new FsmCollection();
+  TestBusyState* states[(TEST_BUDGET_REGIONS + 1) * TEST_BUDGET_STATES];
+  int count = 0;
+
+  for (int r=0; r<TEST_BUDGET_REGIONS; r++) {
+    FsmCollection* region = new FsmCollection();
+
+    for (int s=0; s<TEST_BUDGET_STATES; s++) {
+      region->addChild(states[count++] = new TestBusyState());
+    }
+
+    regions->addChild(region);
+  }
+
+  for (int s=0; s<TEST_BUDGET_STATES; s++) {
+    serial->addChild(states[count++] = new TestBusyState());
+  }
+
+  root.addChild(regions);
+  root.addChild(serial);
+
+  for (int u=0; u<TEST_BUDGET_UPDATES; u++) {
+    root.update(TEST_BUDGET);
+  }
+
+  unsigned long fewest = states[0]->updates;
+  unsigned long most = states[0]->updates;
+
+  for (int i=1; i<count; i++) {
+    fewest = (states[i]->updates < fewest) ? states[i]->updates : fewest;
+    most = (states[i]->updates > most) ? states[i]->updates : most;
+  }
+
+  printf("each busy State updated %lu to %lu times in %d updates\n", fewest, most, TEST_BUDGET_UPDATES);
+
+  _check("updates stop short once the budget is spent", most < TEST_BUDGET_UPDATES);
+  _check("no busy State is starved", fewest > 0);
+  _check("every busy State is updated once per pass", most - fewest <= 1);
+
+  // leaving abandons the pass that stopped short, and outside update(budget) every update is a whole pass
+  for (int i=0; i<count; i++) {
+    states[i]->updates = 0;
+  }
+
+  root.forceExit();
+  root.update();
+
+  for (int i=0; i<count; i++) {
+    _check("a visit starts with a whole pass", states[i]->updates == 1);
+  }
+
+  setHostClock(NULL);
+
+  printf("%s\n", _failures ? "budget failed" : "budget ok");
+
+  return _failures ? 1 : 0;
+}
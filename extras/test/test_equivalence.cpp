@@ -0,0 +1,487 @@
+/** @file test_equivalence.cpp
+  *  Copyright (c) 2016 Ozbotics
+  *  Distributed under the MIT license (see LICENSE)
+  *
+  *  Equivalence test: runs one timed script on a built tree, and on the same machine run in other ways (update(budget),
+  *   FsmTable, FsmBank, FsmStatic, FsmOptimizer, FsmLoader, and FsmSnapshot halfway through), and fails if the traces differ.
+ *   With FSM_TRACE defined, the tree's FsmTrace events must also match the table's.
+  */
+#include <FSM.h>
+#include <FsmBank.h>
+#include <FsmLoader.h>
+#include <FsmOptimizer.h>
+#include <FsmSnapshot.h>
+#include <FsmStatic.h>
+#include <FsmTable.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#define TEST_EQUIVALENCE_TRACE 256    /**< longest trace of a branch, in marks */
+#define TEST_EQUIVALENCE_STEPS 40     /**< steps of the script, each TEST_EQUIVALENCE_STEP apart */
+#define TEST_EQUIVALENCE_STEP 10000   /**< simulated microseconds between steps */
+#define TEST_EQUIVALENCE_UPDATES 40   /**< updates per step, enough for any machine to settle */
+#define TEST_EQUIVALENCE_BUDGET 3     /**< microseconds per budgeted update (each read of the clock takes one) */
+#define TEST_EQUIVALENCE_SNAPSHOT 512 /**< largest snapshot, in bytes */
+#define TEST_EQUIVALENCE_ARENA 4096   /**< arena the definition is loaded in, in bytes */
+#define TEST_EQUIVALENCE_EVENTS 1024  /**< most FsmTrace events of a run (a power of 2) */
+
+static int _failures = 0;
+
+static void _check(const char* what, bool ok) {
+  if (!ok) {
+    printf("FAIL: %s\n", what);
+    _failures++;
+  }
+}
+
+static uint64_t _clock = 0;
+
+/**
+ * each read takes a microsecond, so that update(budget) runs out part way through a pass
+ */
+static uint64_t _simulatedClock() {
+  return _clock++;
+}
+
+/**
+ * a trace per branch of the machine, so that the order the branches are updated in does not matter
+ */
+static char _traces[2][TEST_EQUIVALENCE_TRACE];
+
+static void _append(byte branch, char mark) {
+  size_t length = strlen(_traces[branch]);
+
+  if (length + 1 < TEST_EQUIVALENCE_TRACE) {
+    _traces[branch][length] = mark;
+    _traces[branch][length + 1] = '\0';
+  }
+}
+
+/**
+ * a Condition that appends its mark to its branch's trace each time it is read, ie; each time its State is entered
+ */
+class TestMark : public Condition {
+  protected:
+    byte _branch;
+    char _mark;
+
+  public:
+    TestMark(byte branch, char mark) : _branch(branch), _mark(mark) { }
+
+    virtual bool getValue() {
+      _append(_branch, _mark);
+      return true;
+    }
+};
+
+static TestMark _markA(0, 'A'), _markB(0, 'B'), _markC(0, 'C'), _markD(0, 'D'), _markE(0, 'E');
+static TestMark _markX(1, 'x'), _markY(1, 'y'), _markZ(1, 'z');
+static Value<bool> _assigned;
+static Condition _gate(true);
+static Condition* _gateCondition = &_gate;
+static Value<bool> _select(false);
+static Value<Duration> _long(30);
+static Value<Duration> _short(20);
+
+/**
+ * the script: the step at which each input changes, and its new value
+ */
+struct TestChange {
+  int step;
+  Value<bool>* input;
+  bool value;
+};
+
+static const TestChange _script[] = {
+  { 5, &_select, true },
+  { 8, &_gate, false },
+  { 14, &_select, false },
+  { 20, &_gate, true },
+  { 25, &_select, true },
+  { 33, &_select, false }
+};
+
+/**
+ * the machine, built in code
+ *
+ *  branch 0 loops A, wait, then B C D E (or just D E while the gate is shut), wait;
+ *  branch 1 marks x while the select is false, or y, wait, z while it is true
+ */
+static FsmUpdatable* _build() {
+  FsmSequence* loop = new FsmSequence();
+  loop->addChild(new FsmAssignConditionToValue(&_markA, &_assigned));
+  loop->addChild(new FsmDelay(&_long));
+  loop->addChild(new FsmBranchOnConditionFalse(&_gateCondition, 5));
+  loop->addChild(new FsmAssignConditionToValue(&_markB, &_assigned));
+  loop->addChild(new FsmAssignConditionToValue(&_markC, &_assigned));
+  loop->addChild(new FsmAssignConditionToValue(&_markD, &_assigned));
+  loop->addChild(new FsmAssignConditionToValue(&_markE, &_assigned));
+  loop->addChild(new FsmDelay(&_short));
+
+  FsmSequence* whileFalse = new FsmSequence();
+  whileFalse->addChild(new FsmAssignConditionToValue(&_markX, &_assigned));
+  whileFalse->addChild(new FsmIdle());
+
+  FsmSequence* whileTrue = new FsmSequence();
+  whileTrue->addChild(new FsmAssignConditionToValue(&_markY, &_assigned));
+  whileTrue->addChild(new FsmDelay(&_short));
+  whileTrue->addChild(new FsmAssignConditionToValue(&_markZ, &_assigned));
+  whileTrue->addChild(new FsmIdle());
+
+  FsmSelectStateFromCondition* select = new FsmSelectStateFromCondition(&_select);
+  select->addChild(whileFalse);
+  select->addChild(whileTrue);
+
+  FsmCollection* root = new FsmCollection();
+  root->addChild(loop);
+  root->addChild(select);
+
+  return root;
+}
+
+/**
+ * the machine, as a definition (branching by name rather than index)
+ */
+static const char _definition[] =
+  "collection\n"
+  "  sequence\n"
+  "    assign_condition markA assigned\n"
+  "    delay long\n"
+  "    branch_on_condition_false gate tail\n"
+  "    assign_condition markB assigned\n"
+  "    assign_condition markC assigned\n"
+  "    tail: assign_condition markD assigned\n"
+  "    assign_condition markE assigned\n"
+  "    delay short\n"
+  "  select select\n"
+  "    sequence\n"
+  "      assign_condition markX assigned\n"
+  "      idle\n"
+  "    sequence\n"
+  "      assign_condition markY assigned\n"
+  "      delay short\n"
+  "      assign_condition markZ assigned\n"
+  "      idle\n";
+
+static const FsmBinding _bindings[] = {
+  { "markA", &_markA, NULL },
+  { "markB", &_markB, NULL },
+  { "markC", &_markC, NULL },
+  { "markD", &_markD, NULL },
+  { "markE", &_markE, NULL },
+  { "markX", &_markX, NULL },
+  { "markY", &_markY, NULL },
+  { "markZ", &_markZ, NULL },
+  { "assigned", &_assigned, NULL },
+  { "gate", &_gateCondition, NULL },
+  { "select", &_select, NULL },
+  { "long", &_long, NULL },
+  { "short", &_short, NULL }
+};
+
+/**
+ * the machine, as a static type
+ */
+template <TestMark* M>
+void _staticMark() {
+  M->getValue();
+}
+
+typedef FsmStaticMachine<FsmStaticCollection<
+  FsmStaticSequence<
+    FsmStaticAction<_staticMark<&_markA> >,
+    FsmStaticDelay<&_long>,
+    FsmStaticBranchOnConditionFalse<&_gateCondition, 5>,
+    FsmStaticAction<_staticMark<&_markB> >,
+    FsmStaticAction<_staticMark<&_markC> >,
+    FsmStaticAction<_staticMark<&_markD> >,
+    FsmStaticAction<_staticMark<&_markE> >,
+    FsmStaticDelay<&_short> >,
+  FsmStaticSelectStateFromCondition<&_select,
+    FsmStaticSequence<FsmStaticAction<_staticMark<&_markX> >, FsmStaticIdle>,
+    FsmStaticSequence<FsmStaticAction<_staticMark<&_markY> >, FsmStaticDelay<&_short>,
+      FsmStaticAction<_staticMark<&_markZ> >, FsmStaticIdle> > > > TestStaticMachine;
+
+/**
+ * update any kind of machine, with or without a budget
+ */
+struct TestRunner {
+  virtual ~TestRunner() { }
+  virtual void update() = 0;
+};
+
+struct TestUpdatableRunner : public TestRunner {
+  FsmUpdatable* fsm;
+  unsigned long budget;
+
+  TestUpdatableRunner(FsmUpdatable* fsm, unsigned long budget=0) : fsm(fsm), budget(budget) { }
+
+  virtual void update() {
+    fsm->update(budget);
+  }
+};
+
+struct TestStaticRunner : public TestRunner {
+  TestStaticMachine machine;
+
+  virtual void update() {
+    machine.update();
+  }
+};
+
+/**
+ * clear the traces and reset the inputs, to run the script from the start
+ */
+static void _reset() {
+  _traces[0][0] = '\0';
+  _traces[1][0] = '\0';
+  _gate.setValue(true);
+  _select.setValue(false);
+}
+
+/**
+ * run steps [from, to) of the script: each step sets the clock, marks the traces, changes the inputs, then updates
+ */
+static void _run(TestRunner& runner, int from, int to) {
+  for (int s=from; s<to; s++) {
+    _clock = (uint64_t) s * TEST_EQUIVALENCE_STEP;
+    _append(0, '.');
+    _append(1, '.');
+
+    for (size_t c=0; c<sizeof(_script) / sizeof(_script[0]); c++) {
+      if (_script[c].step == s) {
+        _script[c].input->setValue(_script[c].value);
+      }
+    }
+
+    for (int u=0; u<TEST_EQUIVALENCE_UPDATES; u++) {
+      runner.update();
+    }
+  }
+}
+
+/**
+ * compare the traces of the last run with the tree's
+ */
+static void _compare(const char* what, char expected[2][TEST_EQUIVALENCE_TRACE]) {
+  bool same = (strcmp(_traces[0], expected[0]) == 0) && (strcmp(_traces[1], expected[1]) == 0);
+
+  if (!same) {
+    printf("%s:\n  %s\n  %s\n", what, _traces[0], _traces[1]);
+  }
+
+  _check(what, same);
+}
+
+#ifdef FSM_TRACE
+static FsmTraceEvent _events[2][TEST_EQUIVALENCE_EVENTS];
+
+/**
+ * run the whole script, recording its FsmTrace events with each node relative to the root's traceId
+ *  (so that the events of two builds of the machine compare equal), and without their times
+ *
+ * @return the number of events, 0 if some were dropped
+ */
+static uint32_t _runTraced(TestRunner& runner, uint16_t rootId, FsmTraceEvent* out) {
+  static FsmTraceEvent buffer[TEST_EQUIVALENCE_EVENTS];
+
+  FsmTrace::begin(buffer, TEST_EQUIVALENCE_EVENTS);
+  _run(runner, 0, TEST_EQUIVALENCE_STEPS);
+  FsmTrace::end();
+
+  uint32_t count = FsmTrace::drain(out, TEST_EQUIVALENCE_EVENTS);
+
+  // the clock advances as it is read, and the table reads it less often: compare the events without their times
+  for (uint32_t i=0; i<count; i++) {
+    out[i].node -= rootId;
+    out[i].time = 0;
+  }
+
+  return FsmTrace::getDropped() ? 0 : count;
+}
+#endif
+
+int main() {
+  char expected[2][TEST_EQUIVALENCE_TRACE];
+  int half = TEST_EQUIVALENCE_STEPS / 2;
+
+  setHostClock(_simulatedClock);
+
+  // the built tree, whose traces the others must match
+  {
+    _reset();
+    FsmUpdatable* root = _build();
+    TestUpdatableRunner runner(root);
+    _run(runner, 0, TEST_EQUIVALENCE_STEPS);
+    delete root;
+
+    memcpy(expected, _traces, sizeof(expected));
+    printf("tree:\n  %s\n  %s\n", expected[0], expected[1]);
+
+    _check("the gate skips B and C", strstr(expected[0], "BCDE") && strstr(expected[0], ".DE"));
+    _check("the select follows its input", strstr(expected[1], "y..z") && strstr(expected[1], "z.......x"));
+  }
+
+  {
+    _reset();
+    FsmUpdatable* root = _build();
+    TestUpdatableRunner runner(root, TEST_EQUIVALENCE_BUDGET);
+    _run(runner, 0, TEST_EQUIVALENCE_STEPS);
+    delete root;
+    _compare("the tree, updated within a budget", expected);
+  }
+
+  {
+    _reset();
+    FsmUpdatable* root = _build();
+    FsmTable table;
+    _check("the machine compiles to a table", table.compile(root));
+    delete root;  // the table keeps nothing of a tree of built-in States
+    TestUpdatableRunner runner(&table);
+    _run(runner, 0, TEST_EQUIVALENCE_STEPS);
+    _compare("the table", expected);
+  }
+
+#ifdef FSM_TRACE
+  // the table records the events of the States it was compiled from
+  {
+    _reset();
+    FsmUpdatable* root = _build();
+    TestUpdatableRunner treeRunner(root);
+    uint32_t treeCount = _runTraced(treeRunner, root->traceId, _events[0]);
+    delete root;
+
+    _reset();
+    root = _build();
+    FsmTable table;
+    table.compile(root);
+    uint16_t rootId = root->traceId;
+    delete root;
+    TestUpdatableRunner tableRunner(&table);
+    uint32_t tableCount = _runTraced(tableRunner, rootId, _events[1]);
+
+    printf("trace: %u events\n", (unsigned) treeCount);
+    _check("the tree is traced", treeCount > 0);
+    _check("the table traces the tree's events",
+      (tableCount == treeCount) && (memcmp(_events[0], _events[1], treeCount * sizeof(FsmTraceEvent)) == 0));
+  }
+#endif
+
+  {
+    _reset();
+    FsmUpdatable* root = _build();
+    FsmBank bank;
+    _check("the machine compiles to a bank", bank.compile(root, 1));
+    delete root;  // the bank keeps nothing of a tree of built-in States
+    TestUpdatableRunner runner(&bank);
+    _run(runner, 0, TEST_EQUIVALENCE_STEPS);
+    _compare("the bank", expected);
+  }
+
+  {
+    _reset();
+    TestStaticRunner* runner = new TestStaticRunner();
+    _run(*runner, 0, TEST_EQUIVALENCE_STEPS);
+    delete runner;
+    _compare("the static machine", expected);
+  }
+
+  {
+    _reset();
+    FsmUpdatable* root = _build();
+    FsmOptimizer optimizer;
+    _check("the machine optimizes", optimizer.optimize(root));
+    _check("the optimizer fuses B C and D E", optimizer.getFusionCount() == 2);
+    TestUpdatableRunner runner(root);
+    _run(runner, 0, TEST_EQUIVALENCE_STEPS);
+    delete root;
+    _compare("the optimized tree", expected);
+  }
+
+  // loaded within an arena, which frees the names the loader copies along with the tree
+  {
+    _reset();
+    FsmArena arena(TEST_EQUIVALENCE_ARENA);
+    FsmArena::Scope scope(arena);
+    FsmLoader loader(_bindings, sizeof(_bindings) / sizeof(_bindings[0]));
+    FsmUpdatable* root = loader.loadText(_definition);
+    _check("the definition loads", root != NULL);
+
+    if (root) {
+      TestUpdatableRunner runner(root);
+      _run(runner, 0, TEST_EQUIVALENCE_STEPS);
+      delete root;
+      _compare("the loaded tree", expected);
+    }
+  }
+
+  // half the script, within a budget (so a pass may have stopped short), then the rest on a restored copy
+  {
+    _reset();
+    byte snapshot[TEST_EQUIVALENCE_SNAPSHOT];
+    FsmUpdatable* first = _build();
+    TestUpdatableRunner firstRunner(first, TEST_EQUIVALENCE_BUDGET);
+    _run(firstRunner, 0, half);
+    size_t size = FsmSnapshot::save(first, snapshot, sizeof(snapshot));
+    delete first;
+
+    FsmUpdatable* second = _build();
+    _check("the tree saves", size > 0);
+    _check("the tree restores", FsmSnapshot::restore(second, snapshot, size));
+    TestUpdatableRunner secondRunner(second, TEST_EQUIVALENCE_BUDGET);
+    _run(secondRunner, half, TEST_EQUIVALENCE_STEPS);
+    delete second;
+    _compare("the restored tree", expected);
+  }
+
+  {
+    _reset();
+    byte snapshot[TEST_EQUIVALENCE_SNAPSHOT];
+    FsmUpdatable* firstRoot = _build();
+    FsmTable first;
+    first.compile(firstRoot);
+    delete firstRoot;
+    TestUpdatableRunner firstRunner(&first);
+    _run(firstRunner, 0, half);
+    size_t size = FsmSnapshot::save(&first, snapshot, sizeof(snapshot));
+
+    FsmUpdatable* secondRoot = _build();
+    FsmTable second;
+    second.compile(secondRoot);
+    delete secondRoot;
+    _check("the table saves", size > 0);
+    _check("the table restores", FsmSnapshot::restore(&second, snapshot, size));
+    TestUpdatableRunner secondRunner(&second);
+    _run(secondRunner, half, TEST_EQUIVALENCE_STEPS);
+    _compare("the restored table", expected);
+  }
+
+  {
+    _reset();
+    byte snapshot[TEST_EQUIVALENCE_SNAPSHOT];
+    FsmUpdatable* firstRoot = _build();
+    FsmBank first;
+    first.compile(firstRoot, 1);
+    delete firstRoot;
+    TestUpdatableRunner firstRunner(&first);
+    _run(firstRunner, 0, half);
+    size_t size = FsmSnapshot::save(&first, snapshot, sizeof(snapshot));
+
+    FsmUpdatable* secondRoot = _build();
+    FsmBank second;
+    second.compile(secondRoot, 1);
+    delete secondRoot;
+    _check("the bank saves", size > 0);
+    _check("the bank restores", FsmSnapshot::restore(&second, snapshot, size));
+    TestUpdatableRunner secondRunner(&second);
+    _run(secondRunner, half, TEST_EQUIVALENCE_STEPS);
+    _compare("the restored bank", expected);
+  }
+
+  setHostClock(NULL);
+
+  printf("%s\n", _failures ? "equivalence failed" : "equivalence ok");
+
+  return _failures ? 1 : 0;
+}
@@ -0,0 +1,135 @@
+/** @file test_events.cpp
+  *  Copyright (c) 2016 Ozbotics
+  *  Distributed under the MIT license (see LICENSE)
+  *
+  *  Event test: runs one script of updates and dispatched events on a built tree, and on the same machine compiled
+  *   into an FsmTable (where FsmWaitForEvent is user defined, behind an FsmTableProxy), and fails if the traces differ.
+  */
+#include <FSM.h>
+#include <FsmEvent.h>
+#include <FsmTable.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#define TEST_EVENTS_TRACE 64  /**< longest trace, in marks */
+
+static int _failures = 0;
+
+static void _check(const char* what, bool ok) {
+  if (!ok) {
+    printf("FAIL: %s\n", what);
+    _failures++;
+  }
+}
+
+/**
+ * a Condition that appends its mark to a trace each time it is read, ie; each time its State is entered
+ */
+class TestMark : public Condition {
+  protected:
+    char* _trace;
+    char _mark;
+
+  public:
+    TestMark(char* trace, char mark) : _trace(trace), _mark(mark) { }
+
+    virtual bool getValue() {
+      size_t length = strlen(_trace);
+
+      if (length + 1 < TEST_EVENTS_TRACE) {
+        _trace[length] = _mark;
+        _trace[length + 1] = '\0';
+      }
+
+      return true;
+    }
+};
+
+/**
+ * moves the grandparent on when the event arrives (so the leaving State is a table node, not the user FSM)
+ */
+class TestLeaveParentOnEvent : public FsmWaitForEvent {
+  protected:
+    virtual void _onEvent(const FsmEvent& /*event*/) {
+      _transitionAncestorToNext(2);
+    }
+
+  public:
+    TestLeaveParentOnEvent(FsmEventId eventId) : FsmWaitForEvent(eventId) { }
+};
+
+/**
+ * one machine, and the trace its marks append to
+ */
+struct TestMachine {
+  char trace[TEST_EVENTS_TRACE];
+  TestMark a, b, c, d, x;
+  Value<bool> assigned;
+  FsmSequence* root;
+
+  TestMachine() : a(trace, 'A'), b(trace, 'B'), c(trace, 'C'), d(trace, 'D'), x(trace, 'X'), root(NULL) {
+    trace[0] = '\0';
+
+    FsmSequence* inner = new FsmSequence();
+    inner->addChild(new FsmAssignConditionToValue(&c, &assigned));
+    inner->addChild(new TestLeaveParentOnEvent(2));
+    inner->addChild(new FsmAssignConditionToValue(&x, &assigned));
+
+    root = new FsmSequence();
+    root->addChild(new FsmAssignConditionToValue(&a, &assigned));
+    root->addChild(new FsmWaitForEvent(1));
+    root->addChild(new FsmAssignConditionToValue(&b, &assigned));
+    root->addChild(inner);
+    root->addChild(new FsmAssignConditionToValue(&d, &assigned));
+    root->addChild(new FsmWaitForEvent(3));
+  }
+
+  ~TestMachine() {
+    delete root;
+  }
+};
+
+/**
+ * updates, then each event in turn followed by more updates, marking each event in the trace
+ */
+static void _run(TestMachine& machine, FsmUpdatable* fsm) {
+  static const FsmEventId script[] = { 1, 2, 3, 2, 1, 2 };
+
+  FsmEventDispatcher dispatcher(4);
+  dispatcher.build(machine.root);
+
+  for (size_t s=0; s<=sizeof(script) / sizeof(script[0]); s++) {
+    if (s > 0) {
+      size_t length = strlen(machine.trace);
+      machine.trace[length] = '0' + script[s - 1];
+      machine.trace[length + 1] = '\0';
+
+      FsmEvent event = { script[s - 1], 0, NULL };
+      dispatcher.dispatch(event);
+    }
+
+    for (int u=0; u<8; u++) {
+      fsm->update();
+    }
+  }
+}
+
+int main() {
+  TestMachine tree;
+  _run(tree, tree.root);
+
+  TestMachine compiled;
+  FsmTable table;
+  _check("the machine compiles", table.compile(compiled.root));
+  _run(compiled, &table);
+
+  printf("tree:  %s\ntable: %s\n", tree.trace, compiled.trace);
+
+  _check("the tree follows the events", strcmp(tree.trace, "A1BC2D3A21B2D") == 0);
+  _check("the table follows the events as the tree does", strcmp(tree.trace, compiled.trace) == 0);
+
+  printf("%s\n", _failures ? "events failed" : "events ok");
+
+  return _failures ? 1 : 0;
+}
@@ -0,0 +1,155 @@
+/** @file test_footprint.cpp
+  *  Copyright (c) 2016 Ozbotics
+  *  Distributed under the MIT license (see LICENSE)
+  *
+  *  Size regression test: prints the footprint of each kind of FSM beside that of the original layout,
+  *   and fails if the packed layout regresses, or is larger than the original.
+  */
+#include <FSM.h>
+#include <FsmStatic.h>
+#include <LinkedList.h>
+
+#include <stdio.h>
+#include <string.h>
+
+static int _failures = 0;
+
+/**
+ * round size up to a multiple of alignment
+ */
+static size_t _align(size_t size, size_t alignment) {
+  return ((size + alignment - 1) / alignment) * alignment;
+}
+
+static void _check(const char* what, bool ok) {
+  if (!ok) {
+    printf("FAIL: %s\n", what);
+    _failures++;
+  }
+}
+
+/**
+ * the original layout, before flags were packed, children held in an array, Timers held inline,
+ *  and names kept beside the tree (members only, as sizes are all that matter)
+ */
+class BaselineUpdatable {
+  protected:
+    FsmCollection* _parent;
+  public:
+    virtual ~BaselineUpdatable() { }
+};
+
+class BaselineState : public BaselineUpdatable {
+  protected:
+    bool _entered;
+    bool _leaving;
+};
+
+class BaselineCollection : public BaselineState {
+  protected:
+    LinkedList<FsmUpdatable*> _children;
+};
+
+class BaselineSequence : public BaselineCollection {
+  protected:
+    byte _currentChildInd;
+    byte _startChildInd;
+};
+
+class BaselineSelect : public BaselineSequence {
+  protected:
+    Value<bool>* _value;
+    bool _oldValue;
+};
+
+class BaselineDelay : public BaselineState {
+  protected:
+    Timer* _timer;                    // allocated on its own
+    Value<Duration>* _durationValue;
+};
+
+class BaselineBranchOnConditionFalse : public BaselineState {
+  protected:
+    Condition** _condition;
+    byte _branchInd;
+};
+
+class BaselineDebugPrint : public BaselineState {
+  protected:
+    String* _msg;                     // allocated on its own
+};
+
+#define TEST_FOOTPRINT_CHILDREN 8  /**< children of the Collections compared, whose storage is counted */
+
+static void _print(const char* name, size_t size, size_t baseline) {
+  printf("%-32s %4u %8u\n", name, (unsigned) size, (unsigned) baseline);
+}
+
+#define FOOTPRINT(T, BASELINE) _print(#T, sizeof(T), BASELINE)
+
+int main() {
+  // a Collection's children cost a pointer each, where the LinkedList allocated a node each; a Timer or message was allocated on its own
+  size_t collectionChildren = TEST_FOOTPRINT_CHILDREN * sizeof(FsmUpdatable*);
+  size_t baselineChildren = TEST_FOOTPRINT_CHILDREN * sizeof(ListNode<FsmUpdatable*>);
+
+  printf("%-32s %4s %8s\n", "", "size", "baseline");
+  FOOTPRINT(FsmUpdatable, sizeof(BaselineUpdatable));
+  FOOTPRINT(FsmState, sizeof(BaselineState));
+  FOOTPRINT(FsmCollection, sizeof(BaselineCollection));
+  FOOTPRINT(FsmSequence, sizeof(BaselineSequence));
+  FOOTPRINT(FsmSelectStateFromCondition, sizeof(BaselineSelect));
+  FOOTPRINT(FsmDelay, sizeof(BaselineDelay) + sizeof(Timer));
+  FOOTPRINT(FsmStartTimer, sizeof(BaselineDelay));
+  FOOTPRINT(FsmWaitUntilTimerIsComplete, sizeof(BaselineState) + sizeof(Timer*));
+  FOOTPRINT(FsmFinish, sizeof(BaselineState));
+  FOOTPRINT(FsmBranchOnConditionFalse, sizeof(BaselineBranchOnConditionFalse));
+  FOOTPRINT(FsmDebugPrint, sizeof(BaselineDebugPrint) + sizeof(String));
+  FOOTPRINT(FsmIdle, sizeof(BaselineState));
+  FOOTPRINT(FsmStaticFinish, sizeof(BaselineState));
+  FOOTPRINT(FsmStaticIdle, sizeof(BaselineState));
+  _print("FsmCollection + children", sizeof(FsmCollection) + collectionChildren, sizeof(BaselineCollection) + baselineChildren);
+  
+  // vtable pointer, parent and the 32 bit wake time, then a byte of flags (and the trace id): no name, which is kept beside the tree
+  size_t updatable = sizeof(void*) + sizeof(FsmCollection*) + sizeof(uint32_t) + sizeof(byte);
+#ifdef FSM_TRACE
+  updatable += sizeof(uint16_t);
+#endif
+  _check("FsmUpdatable holds only what update() reads", sizeof(FsmUpdatable) <= _align(updatable, alignof(FsmUpdatable)));
+  
+#ifndef FSM_STATS
+  // entered & leaving are bits of the base's flags, so a State adds nothing
+  _check("FsmState adds no fields", sizeof(FsmState) == sizeof(FsmUpdatable));
+  _check("FsmFinish adds no fields", sizeof(FsmFinish) == sizeof(FsmUpdatable));
+  _check("FsmIdle adds no fields", sizeof(FsmIdle) == sizeof(FsmUpdatable));
+  
+  // a Delay's Timer is held inline, not allocated on its own
+  _check("FsmDelay holds its Timer inline", sizeof(FsmDelay) <= _align(sizeof(FsmState) + sizeof(Timer) + sizeof(void*), alignof(FsmDelay)));
+
+#if UINTPTR_MAX > 0xFFFFFFFF
+  // with 64 bit pointers, the wake time and flags fit where the two bools were; with narrower ones a State is a wake time larger
+  _check("FsmState is no larger than the baseline", sizeof(FsmState) <= sizeof(BaselineState));
+  _check("FsmBranchOnConditionFalse is no larger than the baseline", sizeof(FsmBranchOnConditionFalse) <= sizeof(BaselineBranchOnConditionFalse));
+  _check("FsmSelectStateFromCondition is no larger than the baseline", sizeof(FsmSelectStateFromCondition) <= sizeof(BaselineSelect));
+#endif
+
+  _check("a Collection and its children are smaller than the baseline's",
+    sizeof(FsmCollection) + collectionChildren < sizeof(BaselineCollection) + baselineChildren);
+  _check("a Sequence is smaller than the baseline", sizeof(FsmSequence) < sizeof(BaselineSequence));
+  _check("FsmDelay is smaller than the baseline with its Timer", sizeof(FsmDelay) < sizeof(BaselineDelay) + sizeof(Timer));
+  _check("FsmDebugPrint is smaller than the baseline with its String", sizeof(FsmDebugPrint) < sizeof(BaselineDebugPrint) + sizeof(String));
+#endif
+  
+  _check("static States are a byte of flags", (sizeof(FsmStaticFinish) == 1) && (sizeof(FsmStaticIdle) == 1));
+  
+  // names are held only for the FSMs that have one
+  FsmIdle named;
+  FsmIdle unnamed;
+  int entries = FsmColdTable::size();
+  _check("a name is recorded", named.setName("named") && !strcmp(named.getName(), "named"));
+  _check("an unnamed FSM has no name", unnamed.getName() == NULL);
+  _check("only the named FSM has an entry", FsmColdTable::size() == entries + 1);
+  
+  printf("%s\n", _failures ? "footprint regressed" : "footprint ok");
+  
+  return _failures ? 1 : 0;
+}
@@ -0,0 +1,93 @@
+/** @file test_loader.cpp
+  *  Copyright (c) 2016 Ozbotics
+  *  Distributed under the MIT license (see LICENSE)
+  *
+  *  Loader test: loads a binary definition, then copies of it with one FSM's depth corrupted, which must be rejected.
+  */
+#include <FSM.h>
+#include <FsmLoader.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#define TEST_LOADER_CAPACITY 256  /**< largest binary definition, in bytes */
+#define TEST_LOADER_HEADER 6      /**< bytes before the first FSM of a binary definition */
+
+static int _failures = 0;
+
+static void _check(const char* what, bool ok) {
+  if (!ok) {
+    printf("FAIL: %s\n", what);
+    _failures++;
+  }
+}
+
+/**
+ * the depths, depth first, are 0 1 2 3 4 1 2 1
+ */
+static const char _definition[] =
+  "collection\n"
+  "  sequence\n"
+  "    sequence\n"
+  "      sequence\n"
+  "        idle\n"
+  "  sequence\n"
+  "    idle\n"
+  "  idle\n";
+
+/**
+ * find the depth byte of the n'th FSM of a binary definition (each is 8 bytes, then three counted strings)
+ */
+static byte* _depthOf(byte* definition, int n) {
+  byte* record = definition + TEST_LOADER_HEADER;
+
+  for (int f=0; f<n; f++) {
+    record += 8;
+
+    for (int s=0; s<3; s++) {
+      record += 1 + record[0];
+    }
+  }
+
+  return record + 1;
+}
+
+/**
+ * load a copy of the definition with the n'th FSM moved to depth, expecting it to be rejected
+ */
+static void _checkRejected(const char* what, const byte* definition, size_t size, int n, byte depth) {
+  byte corrupt[TEST_LOADER_CAPACITY];
+  memcpy(corrupt, definition, size);
+  *_depthOf(corrupt, n) = depth;
+
+  FsmLoader loader;
+  FsmUpdatable* root = loader.loadBinary(corrupt, size);
+
+  _check(what, !root && (loader.getError() == FSM_LOADER_BAD_FORMAT) && (loader.getErrorLine() == n + 1));
+  delete root;
+}
+
+int main() {
+  byte definition[TEST_LOADER_CAPACITY];
+  FsmLoader loader;
+  size_t size = loader.compile(_definition, definition, sizeof(definition));
+
+  _check("the definition compiles", (size > 0) && (size <= sizeof(definition)));
+  if (_failures) {
+    return 1;
+  }
+
+  FsmUpdatable* root = loader.loadBinary(definition, size);
+  _check("the definition loads", root != NULL);
+  delete root;
+
+  // an FSM is at most one deeper than the one before, whatever was built earlier at the depth it jumps to
+  _checkRejected("a jump past unused depths is rejected", definition, size, 2, 9);
+  _checkRejected("a jump under an earlier branch is rejected", definition, size, 6, 4);
+  _checkRejected("a jump to the deepest depth is rejected", definition, size, 1, FSM_LOADER_MAX_DEPTH - 1);
+  _checkRejected("a depth past the deepest is rejected", definition, size, 1, FSM_LOADER_MAX_DEPTH);
+
+  printf("%s\n", _failures ? "loader failed" : "loader ok");
+
+  return _failures ? 1 : 0;
+}